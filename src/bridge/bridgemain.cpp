@@ -1375,6 +1375,16 @@ BRIDGE_IMPEXP void GuiFocusView(int hWindow)
     _gui_sendmessage(GUI_FOCUS_VIEW, (void*)hWindow, nullptr);
 }
 
+BRIDGE_IMPEXP int GuiReferenceInitializeView(const char* name)
+{
+    return (int)(duint)_gui_sendmessage(GUI_REF_INITIALIZE, (void*)name, (void*)true);
+}
+
+BRIDGE_IMPEXP bool GuiReferenceUpdateView(const REFVIEWUPDATE* update)
+{
+    return !!_gui_sendmessage(GUI_REF_UPDATEVIEW, (void*)update, nullptr);
+}
+
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
     hInst = hinstDLL;
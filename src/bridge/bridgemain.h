@@ -833,7 +833,7 @@ typedef enum
     GUI_UPDATE_SEHCHAIN,            // param1=unused,               param2=unused
     GUI_SYMBOL_REFRESH_CURRENT,     // param1=unused,               param2=unused
     GUI_UPDATE_MEMORY_VIEW,         // param1=unused,               param2=unused
-    GUI_REF_INITIALIZE,             // param1=const char* name,     param2=unused
+    GUI_REF_INITIALIZE,             // param1=const char* name,     param2=bool detached
     GUI_LOAD_SOURCE_FILE,           // param1=const char* path,     param2=line
     GUI_MENU_SET_ICON,              // param1=int hMenu,            param2=ICONINFO*
     GUI_MENU_SET_ENTRY_ICON,        // param1=int hEntry,           param2=ICONINFO*
@@ -853,6 +853,7 @@ typedef enum
     GUI_UNREGISTER_SCRIPT_LANG,     // param1=int id,               param2=unused
     GUI_UPDATE_ARGUMENT_VIEW,       // param1=unused,               param2=unused
     GUI_FOCUS_VIEW,                 // param1=int hWindow,          param2=unused
+    GUI_REF_UPDATEVIEW,             // param1=REFVIEWUPDATE* update param2=unused
 } GUIMSG;
 
 //GUI Typedefs
@@ -868,6 +869,27 @@ typedef struct
     const char* str;
 } CELLINFO;
 
+typedef struct
+{
+    int width;
+    const char* title;
+} REFCOLUMNINFO;
+
+//changes to the reference view with the id returned by GuiReferenceInitializeView, negative values and null pointers are left alone
+typedef struct
+{
+    int id;
+    int columnCount;
+    const REFCOLUMNINFO* columns;
+    int searchStartCol;
+    int rowCount;
+    int cellCount;
+    const CELLINFO* cells;
+    int progress;
+    int taskProgress;
+    const char* taskTitle;
+} REFVIEWUPDATE;
+
 typedef struct
 {
     duint start;
@@ -969,6 +991,8 @@ BRIDGE_IMPEXP void GuiRegisterScriptLanguage(SCRIPTTYPEINFO* info);
 BRIDGE_IMPEXP void GuiUnregisterScriptLanguage(int id);
 BRIDGE_IMPEXP void GuiUpdateArgumentWidget();
 BRIDGE_IMPEXP void GuiFocusView(int hWindow);
+BRIDGE_IMPEXP int GuiReferenceInitializeView(const char* name);
+BRIDGE_IMPEXP bool GuiReferenceUpdateView(const REFVIEWUPDATE* update);
 BRIDGE_IMPEXP bool GuiIsUpdateDisabled();
 BRIDGE_IMPEXP void GuiUpdateEnable(bool updateNow);
 BRIDGE_IMPEXP void GuiUpdateDisable();
@@ -2,6 +2,7 @@
 #include <thread>
 #include "AnalysisPass.h"
 #include "memory.h"
+#include "console.h"
 
 AnalysisPass::AnalysisPass(duint VirtualStart, duint VirtualEnd, BBlockArray & MainBlocks) : m_MainBlocks(MainBlocks)
 {
@@ -14,19 +15,16 @@ AnalysisPass::AnalysisPass(duint VirtualStart, duint VirtualEnd, BBlockArray & M
 
     // Read remote instruction data to local memory
     m_DataSize = VirtualEnd - VirtualStart;
-    m_Data = (unsigned char*)VirtualAlloc(nullptr, m_DataSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if(!m_Image.Read(VirtualStart, m_DataSize))
+        dprintf("Failed to read %p-%p, the unreadable pages are analysed as zeroes\n", VirtualStart, VirtualEnd);
+    m_Data = m_Image.Data();
 
-    if(!MemRead(VirtualStart, m_Data, m_DataSize))
-    {
-        VirtualFree(m_Data, 0, MEM_RELEASE);
-        assert(false);
-    }
+    // Decoded once and shared with the other passes over this range
+    m_Store = InstructionStoreGet(VirtualStart, m_Data, m_DataSize);
 }
 
 AnalysisPass::~AnalysisPass()
 {
-    if(m_Data)
-        VirtualFree(m_Data, 0, MEM_RELEASE);
 }
 
 BasicBlock* AnalysisPass::FindBBlockInRange(duint Address)
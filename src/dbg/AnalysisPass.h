@@ -2,6 +2,8 @@
 
 #include "_global.h"
 #include "BasicBlock.h"
+#include "instructionstore.h"
+#include "imageview.h"
 
 class AnalysisPass
 {
@@ -17,7 +19,9 @@ protected:
     duint m_VirtualEnd;
     duint m_DataSize;
     unsigned char* m_Data;
+    ImageView m_Image;
     BBlockArray & m_MainBlocks;
+    std::shared_ptr<const InstructionStore> m_Store;
 
     inline unsigned char* AnalysisPass::TranslateAddress(duint Address)
     {
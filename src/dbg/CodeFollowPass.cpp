@@ -1,10 +1,31 @@
+#include <ppl.h>
 #include "AnalysisPass.h"
 #include "CodeFollowPass.h"
+#include "memory.h"
+#include "module.h"
+#include "addrinfo.h"
+
+#ifndef IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK
+#define IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK 0xF0000000
+#define IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT 28
+#endif // IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK
+
+// Upper limit for the TLS callback array, it is only terminated by a null pointer
+#define TLS_CALLBACK_MAX 256
+
+enum
+{
+    FOLLOW_INSTRUCTION = 1 << 0, // An instruction starts here
+    FOLLOW_INVALID = 1 << 1,     // The instruction could not be decoded
+    FOLLOW_LEADER = 1 << 2,      // A block starts here (seed, branch target or fall through)
+    FOLLOW_FUNCTION = 1 << 3,    // A function starts here (seed or call target)
+};
 
 CodeFollowPass::CodeFollowPass(duint VirtualStart, duint VirtualEnd, BBlockArray & MainBlocks)
     : AnalysisPass(VirtualStart, VirtualEnd, MainBlocks)
 {
-
+    // Seeds are only available if the address range is within a loaded module
+    m_ModuleStart = ModBaseFromAddr(VirtualStart);
 }
 
 CodeFollowPass::~CodeFollowPass()
@@ -19,74 +40,340 @@ const char* CodeFollowPass::GetName()
 bool CodeFollowPass::Analyse()
 {
     // First gather all possible function references with certain tables
-    //
-    // This includes:
+    std::vector<duint> seeds;
+    GatherSeeds(seeds);
+
+    if(seeds.empty())
+        return false;
+
+    m_State.reset(new std::atomic<unsigned char>[m_DataSize]());
+
+    for(auto seed : seeds)
+        MarkState(seed, FOLLOW_LEADER | FOLLOW_FUNCTION);
+
+    // Each thread follows the code reachable from its share of the seeds. An
+    // instruction is claimed by the first thread that reaches it, the others stop there.
+    duint threadCount = IdealThreadCount();
+
+    concurrency::parallel_for(duint(0), threadCount, [&](duint i)
+    {
+        FollowWorker(seeds, i, threadCount);
+    });
+
+    // Split the visited instructions into basic blocks
+    CreateBlocks();
+
+    // Free memory ASAP
+    m_State.reset();
+    return true;
+}
+
+void CodeFollowPass::GatherSeeds(std::vector<duint> & Seeds)
+{
+    if(m_ModuleStart == 0)
+        return;
+
     // Main entry
-    // Module exports
-    // Module import references (?)
-    // Control flow guard
-    // RUNTIME_FUNCTION
-    // TLS callbacks
-    // FLS callbacks
-    return false;
+    Seeds.push_back(ModEntryFromAddr(m_ModuleStart));
+
+    // Module exports (return value ignored)
+    apienumexports(m_ModuleStart, [&](duint Base, const char* Module, const char* Name, duint Address)
+    {
+        Seeds.push_back(Address);
+    });
+
+    // RUNTIME_FUNCTION, TLS callbacks and control flow guard
+    GatherTableSeeds(Seeds);
+
+    // Only keep the seeds within analysis limits
+    Seeds.erase(std::remove_if(Seeds.begin(), Seeds.end(), [this](duint Seed)
+    {
+        return !ValidateAddress(Seed);
+    }), Seeds.end());
+
+    // Sort and remove duplicates
+    std::sort(Seeds.begin(), Seeds.end());
+    Seeds.erase(std::unique(Seeds.begin(), Seeds.end()), Seeds.end());
 }
 
-duint CodeFollowPass::GetReferenceOperand(const cs_x86 & Context)
+void CodeFollowPass::GatherTableSeeds(std::vector<duint> & Seeds)
 {
-    for(int i = 0; i < Context.op_count; i++)
+    // The headers are read from the debuggee, the file on disk might be packed
+    IMAGE_DOS_HEADER dosHeader;
+    IMAGE_NT_HEADERS ntHeaders;
+
+    if(!MemRead(m_ModuleStart, &dosHeader, sizeof(dosHeader)) || dosHeader.e_magic != IMAGE_DOS_SIGNATURE)
+        return;
+
+    if(!MemRead(m_ModuleStart + dosHeader.e_lfanew, &ntHeaders, sizeof(ntHeaders)) || ntHeaders.Signature != IMAGE_NT_SIGNATURE)
+        return;
+
+    const auto & directories = ntHeaders.OptionalHeader.DataDirectory;
+    auto directoryCount = ntHeaders.OptionalHeader.NumberOfRvaAndSizes;
+
+    // The table sizes come from the debuggee, tables that do not fit in the module are skipped
+    auto moduleSize = ModSizeFromAddr(m_ModuleStart);
+
+#ifdef _WIN64
+    // RUNTIME_FUNCTION exception information
+    if(directoryCount > IMAGE_DIRECTORY_ENTRY_EXCEPTION && directories[IMAGE_DIRECTORY_ENTRY_EXCEPTION].VirtualAddress)
     {
-        auto operand = Context.operands[i];
+        const auto & directory = directories[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+        std::vector<RUNTIME_FUNCTION> functions;
 
-        // Looking for immediate references
-        if(operand.type == X86_OP_IMM)
+        if(directory.VirtualAddress < moduleSize && directory.Size <= moduleSize - directory.VirtualAddress)
+            functions.resize(directory.Size / sizeof(RUNTIME_FUNCTION));
+
+        if(!functions.empty() && MemRead(m_ModuleStart + directory.VirtualAddress, functions.data(), functions.size() * sizeof(RUNTIME_FUNCTION)))
+        {
+            for(const auto & function : functions)
+                Seeds.push_back(m_ModuleStart + function.BeginAddress);
+        }
+    }
+#endif // _WIN64
+
+    // TLS callbacks (null terminated array of pointers)
+    if(directoryCount > IMAGE_DIRECTORY_ENTRY_TLS && directories[IMAGE_DIRECTORY_ENTRY_TLS].VirtualAddress)
+    {
+        IMAGE_TLS_DIRECTORY tls;
+
+        if(MemRead(m_ModuleStart + directories[IMAGE_DIRECTORY_ENTRY_TLS].VirtualAddress, &tls, sizeof(tls)) && tls.AddressOfCallBacks)
         {
-            duint dest = (duint)operand.imm;
+            duint callback;
 
-            if(ValidateAddress(dest))
-                return dest;
+            for(duint i = 0; i < TLS_CALLBACK_MAX; i++)
+            {
+                if(!MemRead(duint(tls.AddressOfCallBacks) + i * sizeof(duint), &callback, sizeof(callback)) || !callback)
+                    break;
+
+                Seeds.push_back(callback);
+            }
         }
     }
 
-    return 0;
+    // Control flow guard function table
+    if(directoryCount > IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG && directories[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].VirtualAddress)
+    {
+        IMAGE_LOAD_CONFIG_DIRECTORY config;
+        memset(&config, 0, sizeof(config));
+
+        // The Size member of the structure is the real size, older images do not have the guard fields
+        duint configStart = m_ModuleStart + directories[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].VirtualAddress;
+
+        if(!MemRead(configStart, &config.Size, sizeof(config.Size)))
+            return;
+
+        if(config.Size < FIELD_OFFSET(IMAGE_LOAD_CONFIG_DIRECTORY, GuardFlags) + sizeof(config.GuardFlags))
+            return;
+
+        if(!MemRead(configStart, &config, min(duint(config.Size), sizeof(config))))
+            return;
+
+        if(config.GuardCFFunctionTable && config.GuardCFFunctionCount)
+        {
+            // Every entry is an RVA followed by a number of metadata bytes
+            duint stride = sizeof(DWORD) + ((config.GuardFlags & IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK) >> IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT);
+            auto tableStart = duint(config.GuardCFFunctionTable);
+            std::vector<unsigned char> table;
+
+            if(tableStart >= m_ModuleStart && tableStart - m_ModuleStart < moduleSize &&
+                    config.GuardCFFunctionCount <= (moduleSize - (tableStart - m_ModuleStart)) / stride)
+                table.resize(duint(config.GuardCFFunctionCount) * stride);
+
+            if(!table.empty() && MemRead(duint(config.GuardCFFunctionTable), table.data(), table.size()))
+            {
+                for(duint i = 0; i < table.size(); i += stride)
+                    Seeds.push_back(m_ModuleStart + *(DWORD*)&table[i]);
+            }
+        }
+    }
 }
 
-duint CodeFollowPass::GetMemoryOperand(Capstone & Disasm, const cs_x86 & Context, bool* Indirect)
+void CodeFollowPass::FollowWorker(const std::vector<duint> & Seeds, duint Start, duint Step)
 {
-    if(Context.op_count <= 0)
-        return 0;
+    Capstone disasm;
+    size_t hint = InstructionStore::npos;
+    std::vector<duint> work;
 
-    // Only the first operand matters
-    auto operand = Context.operands[0];
-
-    // Jumps and calls only
-    if(Disasm.InGroup(CS_GRP_CALL) || Disasm.InGroup(CS_GRP_JUMP))
+    for(duint i = Start; i < Seeds.size(); i += Step)
     {
-        // Looking for memory references
-        if(operand.type == X86_OP_MEM)
+        work.push_back(Seeds[i]);
+
+        while(!work.empty())
         {
-            // Notify if the operand was indirect
-            if(Indirect)
+            duint addr = work.back();
+            work.pop_back();
+
+            while(ValidateAddress(addr))
             {
-                if(operand.mem.base != X86_REG_INVALID ||
-                        operand.mem.index != X86_REG_INVALID ||
-                        operand.mem.scale != 0)
+                // Stop if the instruction was already visited (possibly by another thread)
+                if(m_State[addr - m_VirtualStart].fetch_or(FOLLOW_INSTRUCTION) & FOLLOW_INSTRUCTION)
+                    break;
+
+                DECODEDINSTR instr;
+
+                if(!Decode(disasm, addr, instr, hint))
                 {
-                    *Indirect = true;
-                    return 0;
+                    MarkState(addr, FOLLOW_INVALID);
+                    break;
                 }
+
+                duint next = addr + instr.size;
+
+                if(instr.flags & DECODED_RET)
+                    break;
+
+                if(instr.flags & (DECODED_CALL | DECODED_JUMP | DECODED_LOOP))
+                {
+                    // Indirect branches have no known destination
+                    if(ValidateAddress(instr.branch))
+                    {
+                        MarkState(instr.branch, (instr.flags & DECODED_CALL) ? FOLLOW_LEADER | FOLLOW_FUNCTION : FOLLOW_LEADER);
+                        work.push_back(instr.branch);
+                    }
+
+                    // Unconditional jumps don't fall through, calls are assumed to return
+                    if(instr.flags & DECODED_JMP)
+                        break;
+
+                    MarkState(next, FOLLOW_LEADER);
+                }
+
+                addr = next;
             }
+        }
+    }
+}
+
+void CodeFollowPass::CreateBlocks()
+{
+    Capstone disasm;
+    size_t hint = InstructionStore::npos;
+
+    duint blockBegin = 0;            // BBlock starting virtual address (0 if there is no open block)
+    bool blockPrevPad = false;       // Indicator if the last block was padding
+    duint insnCount = 0;             // Temporary number of instructions counted for a block
 
-            // TODO: Read pointer
-            // TODO: Find virtual tables (new pass?)
-            // TODO: Translate RIP-Relative
-            return 0;
+    auto createBlock = [&](duint End, duint Flags) -> BasicBlock &
+    {
+        BasicBlock block { blockBegin, End - 1, Flags, 0, insnCount };
+
+        if(m_State[blockBegin - m_VirtualStart] & FOLLOW_FUNCTION)
+            block.SetFlag(BASIC_BLOCK_FLAG_CALL_TARGET);
+
+        m_MainBlocks.push_back(block);
+        blockBegin = 0;
+        insnCount = 0;
+        return m_MainBlocks.back();
+    };
+
+    m_MainBlocks.clear();
+
+    for(duint addr = m_VirtualStart; addr < m_VirtualEnd;)
+    {
+        unsigned char state = m_State[addr - m_VirtualStart];
+        DECODEDINSTR instr;
+
+        if(!(state & FOLLOW_INSTRUCTION) || (state & FOLLOW_INVALID) || !Decode(disasm, addr, instr, hint))
+        {
+            // Bytes the code never reaches end the current block
+            if(blockBegin)
+                createBlock(addr, BASIC_BLOCK_FLAG_NONE);
+
+            blockPrevPad = false;
+            addr++;
+            continue;
+        }
 
-            duint dest = (duint)operand.mem.disp;
+        bool padding = (instr.flags & DECODED_FILLING) != 0;
 
-            if(ValidateAddress(dest))
-                return dest;
+        // Branch targets start a new block, padding gets a block of its own
+        if(blockBegin && (state & FOLLOW_LEADER))
+        {
+            createBlock(addr, BASIC_BLOCK_FLAG_NONE);
+            blockPrevPad = false;
         }
+        else if(blockBegin && padding)
+        {
+            createBlock(addr, BASIC_BLOCK_FLAG_PREPAD);
+            blockPrevPad = false;
+        }
+
+        if(!blockBegin)
+            blockBegin = addr;
+
+        insnCount++;
+        addr += instr.size;
+
+        // Append padding to the previous padding block
+        if(padding && blockPrevPad && !(state & FOLLOW_LEADER))
+        {
+            auto & lastBlock = m_MainBlocks.back();
+            lastBlock.VirtualEnd = addr - 1;
+            lastBlock.InstrCount++;
+            blockBegin = 0;
+            insnCount = 0;
+            continue;
+        }
+
+        // The basic block ends here if it is a branch
+        bool call = (instr.flags & DECODED_CALL) != 0;
+        bool jmp = (instr.flags & (DECODED_JUMP | DECODED_LOOP)) != 0;
+        bool ret = (instr.flags & DECODED_RET) != 0;
+
+        if(call || jmp || ret || padding)
+        {
+            duint flags = BASIC_BLOCK_FLAG_NONE;
+
+            if(call)
+                flags |= BASIC_BLOCK_FLAG_CALL;
+
+            if(ret)
+                flags |= BASIC_BLOCK_FLAG_RET;
+
+            if(padding)
+                flags |= BASIC_BLOCK_FLAG_PAD;
+
+            auto & block = createBlock(addr, flags);
+
+            if(!padding && !ret)
+            {
+                // Check if absolute jump, regardless of operand
+                if(instr.flags & DECODED_JMP)
+                    block.SetFlag(BASIC_BLOCK_FLAG_ABSJMP);
+
+                // Branch target immediate, otherwise indirect (register or memory)
+                if(instr.flags & DECODED_OP0IMM)
+                    block.Target = instr.refs[0];
+                else
+                    block.SetFlag(BASIC_BLOCK_FLAG_INDIRECT);
+            }
+
+            blockPrevPad = padding;
+        }
+    }
+
+    if(blockBegin)
+        createBlock(m_VirtualEnd, BASIC_BLOCK_FLAG_NONE);
+}
+
+void CodeFollowPass::MarkState(duint Address, unsigned char Flags)
+{
+    if(ValidateAddress(Address))
+        m_State[Address - m_VirtualStart].fetch_or(Flags);
+}
+
+bool CodeFollowPass::Decode(Capstone & Disasm, duint Address, DECODEDINSTR & Instr, size_t & Hint)
+{
+    // Instructions on the linear sweep are already decoded
+    size_t index = m_Store->Find(Address, Hint);
+
+    if(index != InstructionStore::npos)
+    {
+        Hint = index;
+        m_Store->Get(index, Instr);
+        return Instr.size != 0;
     }
 
-    return 0;
+    return InstructionDecode(Disasm, Address, TranslateAddress(Address), int(min(duint(MAX_DISASM_BUFFER), m_VirtualEnd - Address)), Instr);
 }
\ No newline at end of file
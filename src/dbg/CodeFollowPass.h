@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "AnalysisPass.h"
 #include "BasicBlock.h"
 #include <capstone_wrapper.h>
@@ -14,6 +15,15 @@ public:
     virtual bool Analyse() override;
 
 private:
-    duint GetReferenceOperand(const cs_x86 & Context);
-    duint GetMemoryOperand(Capstone & Disasm, const cs_x86 & Context, bool* Indirect);
+    duint m_ModuleStart;
+
+    // Per-byte state of the analysed range
+    std::unique_ptr<std::atomic<unsigned char>[]> m_State;
+
+    void GatherSeeds(std::vector<duint> & Seeds);
+    void GatherTableSeeds(std::vector<duint> & Seeds);
+    void FollowWorker(const std::vector<duint> & Seeds, duint Start, duint Step);
+    void CreateBlocks();
+    void MarkState(duint Address, unsigned char Flags);
+    bool Decode(Capstone & Disasm, duint Address, DECODEDINSTR & Instr, size_t & Hint);
 };
\ No newline at end of file
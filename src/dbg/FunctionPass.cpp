@@ -100,11 +100,17 @@ bool FunctionPass::Analyse()
 
     dprintf("%u functions\n", funcs.size());
 
-    FunctionDelRange(m_VirtualStart, m_VirtualEnd - 1, false);
+    std::vector<FUNCTIONRANGE> ranges;
+    ranges.reserve(funcs.size());
     for(auto & func : funcs)
     {
-        FunctionAdd(func.VirtualStart, func.VirtualEnd, false, func.InstrCount);
+        FUNCTIONRANGE range;
+        range.start = func.VirtualStart;
+        range.end = func.VirtualEnd;
+        range.instructioncount = func.InstrCount;
+        ranges.push_back(range);
     }
+    FunctionReplaceRange(m_VirtualStart, m_VirtualEnd - 1, ranges);
     GuiUpdateAllViews();
 
     delete[] threadFunctions;
@@ -151,10 +151,19 @@ void LinearPass::AnalysisWorker(duint Start, duint End, BBlockArray* Blocks)
     BasicBlock* lastBlock = nullptr; // Avoid an expensive call to std::vector::back()
 
     int insnCount = 0;               // Temporary number of instructions counted for a block
+    size_t storeIndex = InstructionStore::npos;
 
     for(duint i = Start; i < End;)
     {
-        if(!disasm.Disassemble(i, TranslateAddress(i), int(End - i)))
+        // Threads that start in the middle of an instruction decode until they synchronize with the store
+        DECODEDINSTR instr;
+        storeIndex = m_Store->Find(i, storeIndex);
+        if(storeIndex != InstructionStore::npos)
+            m_Store->Get(storeIndex, instr);
+        else
+            InstructionDecode(disasm, i, TranslateAddress(i), int(End - i), instr);
+
+        if(!instr.size || i + instr.size > End)
         {
             // Skip instructions that can't be determined
             i++;
@@ -162,21 +171,21 @@ void LinearPass::AnalysisWorker(duint Start, duint End, BBlockArray* Blocks)
         }
 
         // Increment counters
-        i += disasm.Size();
+        i += instr.size;
         blockEnd = i;
         insnCount++;
 
         // The basic block ends here if it is a branch
-        bool call = disasm.InGroup(CS_GRP_CALL);    // CALL
-        bool jmp = disasm.InGroup(CS_GRP_JUMP);     // JUMP
-        bool ret = disasm.InGroup(CS_GRP_RET);      // RETURN
-        bool padding = disasm.IsFilling();          // INSTRUCTION PADDING
+        bool call = (instr.flags & DECODED_CALL) != 0;      // CALL
+        bool jmp = (instr.flags & DECODED_JUMP) != 0;       // JUMP
+        bool ret = (instr.flags & DECODED_RET) != 0;        // RETURN
+        bool padding = (instr.flags & DECODED_FILLING) != 0; // INSTRUCTION PADDING
 
         if(padding)
         {
             // PADDING is treated differently. They are all created as their
             // own separate block for more analysis later.
-            duint realBlockEnd = blockEnd - disasm.Size();
+            duint realBlockEnd = blockEnd - instr.size;
 
             if((realBlockEnd - blockBegin) > 0)
             {
@@ -211,32 +220,19 @@ void LinearPass::AnalysisWorker(duint Start, duint End, BBlockArray* Blocks)
                 if(!padding)
                 {
                     // Check if absolute jump, regardless of operand
-                    if(disasm.GetId() == X86_INS_JMP)
+                    if(instr.flags & DECODED_JMP)
                         block->SetFlag(BASIC_BLOCK_FLAG_ABSJMP);
 
                     // Figure out the operand type(s)
-                    const auto & operand = disasm.x86().operands[0];
-
-                    if(operand.type == X86_OP_IMM)
+                    if(instr.flags & DECODED_OP0IMM)
                     {
                         // Branch target immediate
-                        block->Target = (duint)operand.imm;
+                        block->Target = instr.refs[0];
                     }
                     else
                     {
                         // Indirects (no operand, register, or memory)
                         block->SetFlag(BASIC_BLOCK_FLAG_INDIRECT);
-
-                        if(operand.type == X86_OP_MEM &&
-                                operand.mem.base == X86_REG_RIP &&
-                                operand.mem.index == X86_REG_INVALID &&
-                                operand.mem.scale == 1)
-                        {
-                            /*
-                            block->SetFlag(BASIC_BLOCK_FLAG_INDIRPTR);
-                            block->Target = (duint)operand.mem.disp;
-                            */
-                        }
                     }
                 }
             }
@@ -24,6 +24,11 @@
 #include "handles.h"
 #include "../bridge/bridgelist.h"
 #include "tcpconnections.h"
+#include "thread.h"
+#include "bookmark.h"
+#include "_exports.h"
+#include "loop.h"
+#include "mementropy.h"
 
 static DBGFUNCTIONS _dbgfunctions;
 
@@ -64,13 +69,8 @@ static bool _patchinrange(duint start, duint end)
     if(start > end)
         std::swap(start, end);
 
-    for(duint i = start; i <= end; i++)
-    {
-        if(_patchget(i))
-            return true;
-    }
-
-    return false;
+    // The range is inclusive, a range up to the last address ends at the last address
+    return PatchInRange(start, end != duint(-1) ? end + 1 : end);
 }
 
 static bool _mempatch(duint va, const unsigned char* src, duint size)
@@ -83,8 +83,8 @@ static void _patchrestorerange(duint start, duint end)
     if(start > end)
         std::swap(start, end);
 
-    for(duint i = start; i <= end; i++)
-        PatchDelete(i, true);
+    // The range is inclusive, a range up to the last address ends at the last address
+    PatchDelRange(start, end != duint(-1) ? end + 1 : end, true);
 
     GuiUpdatePatches();
 }
@@ -282,6 +282,76 @@ static bool _enumtcpconnections(ListOf(TCPCONNECTIONINFO) connections)
     return BridgeList<TCPCONNECTIONINFO>::CopyData(connections, connectionsV);
 }
 
+static bool _getsidebarinfo(SIDEBARINFO* info, int count)
+{
+    if(!DbgIsDebugging() || !info || count <= 0)
+        return false;
+    for(int i = 0; i < count; i++)
+    {
+        auto & cur = info[i];
+        cur.branchDestination = cur.isBranch ? _dbg_getbranchdestination(cur.addr) : 0;
+        cur.isJumpGoingToExecute = cur.branchDestination ? _dbg_isjumpgoingtoexecute(cur.addr) : false;
+        cur.bpxType = _dbg_bpgettypeat(cur.addr);
+        BREAKPOINT bp;
+        cur.isBpDisabled = BpGet(cur.addr, BPNORMAL, 0, &bp) && !bp.enabled;
+        cur.isBookmark = BookmarkGet(cur.addr);
+    }
+    return true;
+}
+
+static bool _getstackannotations(duint addr, duint count, STACKANNOTATION* annotations)
+{
+    if(!DbgIsDebugging() || !annotations || !count)
+        return false;
+    std::vector<STACK_COMMENT> comments(count);
+    if(!stackcommentgetrange(addr, count, comments.data()))
+        return false;
+    for(duint i = 0; i < count; i++)
+    {
+        auto & cur = annotations[i];
+        ADDRINFO addrinfo;
+        addrinfo.flags = flaglabel;
+        cur.hasLabel = _dbg_addrinfoget(addr + i * sizeof(duint), SEG_DEFAULT, &addrinfo);
+        cur.comment = comments[i];
+    }
+    return true;
+}
+
+static bool _getmemmapdiff(duint generation, MEMMAPDIFF* diff)
+{
+    if(!diff)
+        return false;
+    memset(diff, 0, sizeof(MEMMAPDIFF));
+    std::vector<MEMPAGE> pages;
+    std::vector<duint> removed;
+    diff->reset = !MemGetMapDiff(generation, pages, removed, &diff->generation);
+    diff->pageCount = int(pages.size());
+    if(diff->pageCount)
+    {
+        diff->pages = (MEMPAGE*)BridgeAlloc(pages.size() * sizeof(MEMPAGE));
+        memcpy(diff->pages, pages.data(), pages.size() * sizeof(MEMPAGE));
+    }
+    diff->removedCount = int(removed.size());
+    if(diff->removedCount)
+    {
+        diff->removed = (duint*)BridgeAlloc(removed.size() * sizeof(duint));
+        memcpy(diff->removed, removed.data(), removed.size() * sizeof(duint));
+    }
+    return true;
+}
+
+static duint _getthreadlistex(THREADLIST* list, unsigned int fields)
+{
+    ThreadGetList(list, fields);
+    return ThreadGetGeneration();
+}
+
+static bool _getmementropy(duint base, duint size, double* entropy)
+{
+    // Only returns the last measurement, reading the range is up to the entropy command
+    return entropy && EntropyGetCached(base, size, *entropy);
+}
+
 void dbgfunctionsinit()
 {
     _dbgfunctions.AssembleAtEx = _assembleatex;
@@ -331,4 +401,10 @@ void dbgfunctionsinit()
     _dbgfunctions.EnumHandles = _enumhandles;
     _dbgfunctions.GetHandleName = _gethandlename;
     _dbgfunctions.EnumTcpConnections = _enumtcpconnections;
+    _dbgfunctions.GetSideBarInfo = _getsidebarinfo;
+    _dbgfunctions.GetStackAnnotations = _getstackannotations;
+    _dbgfunctions.GetMemMapDiff = _getmemmapdiff;
+    _dbgfunctions.GetThreadListEx = _getthreadlistex;
+    _dbgfunctions.GetLoopDepth = LoopGetDepth;
+    _dbgfunctions.GetMemEntropy = _getmementropy;
 }
@@ -93,6 +93,44 @@ typedef struct
     unsigned int State;
 } TCPCONNECTIONINFO;
 
+typedef struct
+{
+    duint addr; // in: instruction address
+    bool isBranch; // in: resolve the branch destination of this instruction
+    duint branchDestination; // out: branch destination (0 if unresolved)
+    bool isJumpGoingToExecute; // out: the branch will be taken with the current flags
+    int bpxType; // out: BPXTYPE flags of enabled breakpoints
+    bool isBpDisabled; // out: there is a disabled software breakpoint
+    bool isBookmark; // out: there is a bookmark
+} SIDEBARINFO;
+
+typedef struct
+{
+    bool hasLabel; // there is a label at the stack address
+    STACK_COMMENT comment; // comment for the stack value (empty when there is none)
+} STACKANNOTATION;
+
+typedef struct
+{
+    duint generation; // memory map generation the client is at after applying this diff
+    bool reset; // the client generation was unknown, pages contains the whole map
+    int pageCount;
+    MEMPAGE* pages; // added and changed pages, sorted by address (free with BridgeFree)
+    int removedCount;
+    duint* removed; // base addresses of the removed pages, sorted (free with BridgeFree)
+} MEMMAPDIFF;
+
+enum THREADLISTFIELDS
+{
+    ThreadFieldBasic = 0, // THREADINFO only
+    ThreadFieldCip = 1,
+    ThreadFieldSuspendCount = 2,
+    ThreadFieldPriority = 4,
+    ThreadFieldWaitReason = 8,
+    ThreadFieldLastError = 16,
+    ThreadFieldAll = 31
+};
+
 typedef bool (*ASSEMBLEATEX)(duint addr, const char* instruction, char* error, bool fillnop);
 typedef bool (*SECTIONFROMADDR)(duint addr, char* section);
 typedef bool (*MODNAMEFROMADDR)(duint addr, char* modname, bool extension);
@@ -140,6 +178,12 @@ typedef TRACERECORDTYPE(*GETTRACERECORDTYPE)(duint pageAddress);
 typedef bool(*ENUMHANDLES)(ListOf(HANDLEINFO) handles);
 typedef bool(*GETHANDLENAME)(duint handle, char* name, size_t nameSize, char* typeName, size_t typeNameSize);
 typedef bool(*ENUMTCPCONNECTIONS)(ListOf(TCPCONNECTIONINFO) connections);
+typedef bool(*GETSIDEBARINFO)(SIDEBARINFO* info, int count);
+typedef bool(*GETSTACKANNOTATIONS)(duint addr, duint count, STACKANNOTATION* annotations);
+typedef bool(*GETMEMMAPDIFF)(duint generation, MEMMAPDIFF* diff);
+typedef duint(*GETTHREADLISTEX)(THREADLIST* list, unsigned int fields);
+typedef int(*GETLOOPDEPTH)(duint addr);
+typedef bool(*GETMEMENTROPY)(duint base, duint size, double* entropy);
 
 typedef struct DBGFUNCTIONS_
 {
@@ -190,6 +234,12 @@ typedef struct DBGFUNCTIONS_
     ENUMHANDLES EnumHandles;
     GETHANDLENAME GetHandleName;
     ENUMTCPCONNECTIONS EnumTcpConnections;
+    GETSIDEBARINFO GetSideBarInfo;
+    GETSTACKANNOTATIONS GetStackAnnotations;
+    GETMEMMAPDIFF GetMemMapDiff;
+    GETTHREADLISTEX GetThreadListEx;
+    GETLOOPDEPTH GetLoopDepth;
+    GETMEMENTROPY GetMemEntropy;
 } DBGFUNCTIONS;
 
 #ifdef BUILD_DBG
@@ -1,15 +1,63 @@
 #include "analysis.h"
 #include "memory.h"
+#include "console.h"
 
 Analysis::Analysis(duint base, duint size)
 {
     mBase = base;
     mSize = size;
-    mData = new unsigned char[mSize + MAX_DISASM_BUFFER];
-    MemRead(mBase, mData, mSize);
+    if(!mImage.Read(mBase, mSize))
+        dprintf("Failed to read %p-%p, the unreadable pages are analysed as zeroes\n", mBase, mBase + mSize);
+    mData = mImage.Data();
 }
 
 Analysis::~Analysis()
 {
-    delete[] mData;
+}
+
+const InstructionStore & Analysis::store()
+{
+    if(!mStore)
+        mStore = InstructionStoreGet(mBase, mData, mSize);
+    return *mStore;
+}
+
+bool Analysis::changesSince(duint serial, std::vector<std::pair<duint, duint>> & ranges)
+{
+    std::vector<std::pair<duint, duint>> changes;
+    if(!store().ChangesSince(serial, changes))
+        return false;
+    // A range that was patched several times has overlapping changes
+    std::sort(changes.begin(), changes.end());
+    for(const auto & change : changes)
+    {
+        if(!ranges.empty() && change.first <= ranges.back().second)
+            ranges.back().second = max(ranges.back().second, change.second);
+        else
+            ranges.push_back(change);
+    }
+    return true;
+}
+
+bool Analysis::rangesOverlap(const std::vector<std::pair<duint, duint>> & ranges, duint start, duint end)
+{
+    for(const auto & range : ranges)
+        if(start < range.second && end > range.first)
+            return true;
+    return false;
+}
+
+bool Analysis::decode(duint addr, DECODEDINSTR & instr)
+{
+    if(!inRange(addr))
+        return false;
+    auto index = store().Find(addr, mStoreIndex);
+    if(index != InstructionStore::npos)
+    {
+        mStoreIndex = index;
+        mStore->Get(index, instr);
+        return instr.size != 0;
+    }
+    // The address is in the middle of an instruction of the linear sweep
+    return InstructionDecode(mCp, addr, translateAddr(addr), int(min(duint(MAX_DISASM_BUFFER), mBase + mSize - addr)), instr);
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "_global.h"
 #include <capstone_wrapper.h>
+#include "instructionstore.h"
+#include "imageview.h"
+#include "threading.h"
 
 class Analysis
 {
@@ -17,7 +20,20 @@ protected:
     duint mBase;
     duint mSize;
     unsigned char* mData;
+    ImageView mImage;
     Capstone mCp;
+    std::shared_ptr<const InstructionStore> mStore;
+    size_t mStoreIndex = InstructionStore::npos;
+
+    // Shared instruction store of the range, decoded when it is first needed
+    const InstructionStore & store();
+
+    // Decodes the instruction at addr, sequential addresses are read from the shared instruction store
+    bool decode(duint addr, DECODEDINSTR & instr);
+
+    // Ranges changed since a previous result (see InstructionStore::ChangesSince), sorted and merged
+    bool changesSince(duint serial, std::vector<std::pair<duint, duint>> & ranges);
+    static bool rangesOverlap(const std::vector<std::pair<duint, duint>> & ranges, duint start, duint end);
 
     bool inRange(duint addr) const
     {
@@ -30,4 +46,35 @@ protected:
     }
 };
 
+// Results of the last runs of an analysis, the next run over the same range only redoes the parts that changed.
+// TResult needs base, size and serial (of the instruction store it was computed from) members.
+template<class TResult>
+class AnalysisResultCache
+{
+public:
+    std::shared_ptr<const TResult> Get(duint base, duint size) const
+    {
+        SHARED_ACQUIRE(LockAnalysisResults);
+        for(const auto & result : mResults)
+            if(result->base == base && result->size == size)
+                return result;
+        return nullptr;
+    }
+
+    void Put(const std::shared_ptr<const TResult> & result)
+    {
+        EXCLUSIVE_ACQUIRE(LockAnalysisResults);
+        mResults.erase(std::remove_if(mResults.begin(), mResults.end(), [&result](const std::shared_ptr<const TResult> & cached)
+        {
+            return cached->base == result->base && cached->size == result->size;
+        }), mResults.end());
+        mResults.push_back(result);
+        if(mResults.size() > 2)
+            mResults.erase(mResults.begin());
+    }
+
+private:
+    std::vector<std::shared_ptr<const TResult>> mResults;
+};
+
 #endif //_ANALYSIS_H
\ No newline at end of file
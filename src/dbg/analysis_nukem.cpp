@@ -1,9 +1,18 @@
 #include "analysis_nukem.h"
 #include "BasicBlock.h"
 #include "LinearPass.h"
+#include "CodeFollowPass.h"
 #include "FunctionPass.h"
 #include "console.h"
 
+static duint blockCoverage(const BBlockArray & blocks)
+{
+    duint bytes = 0;
+    for(const auto & block : blocks)
+        bytes += block.VirtualEnd - block.VirtualStart + 1;
+    return bytes;
+}
+
 void Analyse_nukem(duint base, duint size)
 {
     dputs("Starting analysis (Nukem)...");
@@ -12,12 +21,30 @@ void Analyse_nukem(duint base, duint size)
     duint end = base + size;
 
     BBlockArray blocks;
+    BBlockArray linearBlocks;
+
+    DWORD passTicks = GetTickCount();
+    LinearPass pass1(base, end, linearBlocks);
+    pass1.Analyse();
+    DWORD linearTicks = GetTickCount() - passTicks;
+    dprintf("%s: %u blocks, %u bytes (%u%%) in %ums\n", pass1.GetName(), DWORD(linearBlocks.size()), DWORD(blockCoverage(linearBlocks)), DWORD(blockCoverage(linearBlocks) * 100 / size), linearTicks);
 
-    LinearPass* pass1 = new LinearPass(base, end, blocks);
-    pass1->Analyse();
+    // Prefer the blocks reachable from the module's entry points, the linear sweep also decodes data
+    passTicks = GetTickCount();
+    CodeFollowPass pass2(base, end, blocks);
+    if(pass2.Analyse() && !blocks.empty())
+    {
+        DWORD followTicks = GetTickCount() - passTicks;
+        dprintf("%s: %u blocks, %u bytes (%u%%) in %ums\n", pass2.GetName(), DWORD(blocks.size()), DWORD(blockCoverage(blocks)), DWORD(blockCoverage(blocks) * 100 / size), followTicks);
+    }
+    else
+    {
+        dprintf("%s: no code reachable from known entry points, using the %s blocks\n", pass2.GetName(), pass1.GetName());
+        blocks.swap(linearBlocks);
+    }
 
-    FunctionPass* pass2 = new FunctionPass(base, end, blocks);
-    pass2->Analyse();
+    FunctionPass pass3(base, end, blocks);
+    pass3.Analyse();
 
     dprintf("Analysis finished in %ums!\n", GetTickCount() - ticks);
 }
\ No newline at end of file
@@ -132,4 +132,470 @@ bool assembleat(duint addr, const char* instruction, int* size, char* error, boo
     }
 
     return ret;
+}
+
+// Layout of an assembled instruction: [prefixes][opcode][modrm [sib]][displacement][immediate]
+struct ASMENCODING
+{
+    std::vector<unsigned char> prefixes; // legacy prefixes and REX
+    unsigned char rex;
+    unsigned char map; // 0: one byte opcode, 1: 0F, 2: 0F 38, 3: 0F 3A
+    unsigned char op;
+    bool hasModrm;
+    unsigned char modrm;
+    bool hasSib;
+    unsigned char sib;
+    int dispSize;
+    LONGLONG disp;
+    bool dispRelative; // RIP-relative displacement, the address in the text depends on the address
+    int immSize;
+    LONGLONG imm;
+    bool immRelative; // branch displacement, the target in the text depends on the address
+    int fullImmSize; // size of a full immediate (2 or 4 bytes)
+};
+
+static bool isprefix(unsigned char byte)
+{
+    switch(byte)
+    {
+    case 0x26:
+    case 0x2E:
+    case 0x36:
+    case 0x3E:
+    case 0x64:
+    case 0x65:
+    case 0x66:
+    case 0x67:
+    case 0xF0:
+    case 0xF2:
+    case 0xF3:
+        return true;
+    }
+    return false;
+}
+
+static bool hasmodrm(unsigned char map, unsigned char op)
+{
+    if(map == 0)
+    {
+        if(op < 0x40)
+            return (op & 7) < 4;
+        if((op >= 0x80 && op <= 0x8F) || (op >= 0xD0 && op <= 0xD3) || (op >= 0xD8 && op <= 0xDF))
+            return true;
+        switch(op)
+        {
+        case 0x62:
+        case 0x63:
+        case 0x69:
+        case 0x6B:
+        case 0xC0:
+        case 0xC1:
+        case 0xC6:
+        case 0xC7:
+        case 0xF6:
+        case 0xF7:
+        case 0xFE:
+        case 0xFF:
+            return true;
+        }
+        return false;
+    }
+    if(map == 1)
+    {
+        if((op >= 0x05 && op <= 0x0B) || (op >= 0x30 && op <= 0x37) || (op >= 0x80 && op <= 0x8F) || (op >= 0xC8 && op <= 0xCF))
+            return false;
+        switch(op)
+        {
+        case 0x77:
+        case 0xA0:
+        case 0xA1:
+        case 0xA2:
+        case 0xA8:
+        case 0xA9:
+        case 0xAA:
+            return false;
+        }
+    }
+    return true;
+}
+
+static int immsize(unsigned char map, unsigned char op, unsigned char reg, int fullSize, bool rexW, bool & relative)
+{
+    relative = false;
+    if(map == 1)
+    {
+        if(op >= 0x80 && op <= 0x8F)
+        {
+            relative = true;
+            return fullSize;
+        }
+        switch(op)
+        {
+        case 0x70:
+        case 0x71:
+        case 0x72:
+        case 0x73:
+        case 0xA4:
+        case 0xAC:
+        case 0xBA:
+        case 0xC2:
+        case 0xC4:
+        case 0xC5:
+        case 0xC6:
+            return 1;
+        }
+        return 0;
+    }
+    if(map)
+        return map == 3 ? 1 : 0;
+
+    if((op >= 0x70 && op <= 0x7F) || (op >= 0xE0 && op <= 0xE3) || op == 0xEB)
+    {
+        relative = true;
+        return 1;
+    }
+    if(op == 0xE8 || op == 0xE9)
+    {
+        relative = true;
+        return fullSize;
+    }
+    if(op < 0x40)
+        return (op & 7) == 4 ? 1 : (op & 7) == 5 ? fullSize : 0;
+    if((op >= 0xB0 && op <= 0xB7) || (op >= 0xE4 && op <= 0xE7))
+        return 1;
+    if(op >= 0xB8 && op <= 0xBF)
+        return rexW ? 8 : fullSize;
+    switch(op)
+    {
+    case 0x6A:
+    case 0x6B:
+    case 0x80:
+    case 0x82:
+    case 0x83:
+    case 0xA8:
+    case 0xC0:
+    case 0xC1:
+    case 0xC6:
+    case 0xCD:
+    case 0xD4:
+    case 0xD5:
+        return 1;
+    case 0x68:
+    case 0x69:
+    case 0x81:
+    case 0xA9:
+    case 0xC7:
+        return fullSize;
+    case 0xA0:
+    case 0xA1:
+    case 0xA2:
+    case 0xA3:
+        return sizeof(duint);
+    case 0xC2:
+    case 0xCA:
+        return 2;
+    case 0xC8:
+        return 3;
+    case 0xF6:
+        return reg < 2 ? 1 : 0;
+    case 0xF7:
+        return reg < 2 ? fullSize : 0;
+    }
+    return 0;
+}
+
+static LONGLONG readvalue(const unsigned char* data, int size)
+{
+    switch(size)
+    {
+    case 1:
+        return *(const signed char*)data;
+    case 2:
+        return *(const short*)data;
+    case 4:
+        return *(const int*)data;
+    case 8:
+        return *(const LONGLONG*)data;
+    }
+    ULONGLONG value = 0;
+    memcpy(&value, data, size);
+    return LONGLONG(value);
+}
+
+static bool parseencoding(const unsigned char* data, int size, ASMENCODING & enc)
+{
+    int i = 0;
+    bool opSize16 = false;
+    for(; i < size && isprefix(data[i]); i++)
+    {
+        // Other address sizes change the ModRM layout
+        if(data[i] == 0x67)
+            return false;
+        opSize16 |= data[i] == 0x66;
+        enc.prefixes.push_back(data[i]);
+    }
+    enc.rex = 0;
+#ifdef _WIN64
+    if(i < size && (data[i] & 0xF0) == 0x40)
+    {
+        enc.rex = data[i++];
+        enc.prefixes.push_back(enc.rex);
+    }
+    if(i < size && data[i] == 0x62) // EVEX
+        return false;
+#endif //_WIN64
+    if(i >= size || data[i] == 0xC4 || data[i] == 0xC5) // VEX
+        return false;
+
+    enc.map = 0;
+    if(data[i] == 0x0F)
+    {
+        enc.map = 1;
+        if(++i < size && (data[i] == 0x38 || data[i] == 0x3A))
+            enc.map = data[i++] == 0x38 ? 2 : 3;
+    }
+    if(i >= size)
+        return false;
+    enc.op = data[i++];
+
+    enc.hasModrm = hasmodrm(enc.map, enc.op);
+    enc.modrm = 0;
+    enc.hasSib = false;
+    enc.sib = 0;
+    enc.dispSize = 0;
+    enc.dispRelative = false;
+    if(enc.hasModrm)
+    {
+        if(i >= size)
+            return false;
+        enc.modrm = data[i++];
+        auto mod = enc.modrm >> 6;
+        auto rm = enc.modrm & 7;
+        if(mod != 3 && rm == 4)
+        {
+            if(i >= size)
+                return false;
+            enc.hasSib = true;
+            enc.sib = data[i++];
+        }
+        if(mod == 1)
+            enc.dispSize = 1;
+        else if(mod == 2 || (mod == 0 && (rm == 5 || (enc.hasSib && (enc.sib & 7) == 5))))
+            enc.dispSize = 4;
+#ifdef _WIN64
+        enc.dispRelative = mod == 0 && rm == 5;
+#endif //_WIN64
+    }
+    if(i + enc.dispSize > size)
+        return false;
+    enc.disp = readvalue(data + i, enc.dispSize);
+    i += enc.dispSize;
+
+    bool relative;
+    enc.fullImmSize = opSize16 ? 2 : 4;
+    enc.immSize = immsize(enc.map, enc.op, (enc.modrm >> 3) & 7, enc.fullImmSize, (enc.rex & 8) != 0, relative);
+    enc.immRelative = relative;
+
+    // Anything left over means the layout was not understood
+    if(i + enc.immSize != size)
+        return false;
+    enc.imm = readvalue(data + i, enc.immSize);
+    return true;
+}
+
+static void patternappend(std::vector<PatternByte> & pattern, LONGLONG value, int size, bool wildcard)
+{
+    for(int i = 0; i < size; i++)
+    {
+        auto byte = (unsigned char)(ULONGLONG(value) >> (i * 8));
+        PatternByte patternByte;
+        patternByte.nibble[0].data = byte >> 4;
+        patternByte.nibble[0].wildcard = wildcard;
+        patternByte.nibble[1].data = byte & 0xF;
+        patternByte.nibble[1].wildcard = wildcard;
+        pattern.push_back(patternByte);
+    }
+}
+
+static std::vector<PatternByte> encodingpattern(const ASMENCODING & enc)
+{
+    std::vector<PatternByte> pattern;
+    for(auto prefix : enc.prefixes)
+        patternappend(pattern, prefix, 1, false);
+    if(enc.map)
+        patternappend(pattern, 0x0F, 1, false);
+    if(enc.map >= 2)
+        patternappend(pattern, enc.map == 2 ? 0x38 : 0x3A, 1, false);
+    patternappend(pattern, enc.op, 1, false);
+    if(enc.hasModrm)
+        patternappend(pattern, enc.modrm, 1, false);
+    if(enc.hasSib)
+        patternappend(pattern, enc.sib, 1, false);
+    patternappend(pattern, enc.disp, enc.dispSize, enc.dispRelative);
+    patternappend(pattern, enc.imm, enc.immSize, enc.immRelative);
+    return pattern;
+}
+
+static bool fitsbyte(LONGLONG value)
+{
+    return value >= -128 && value <= 127;
+}
+
+// Encodings that only differ in the width of the displacement
+static void dispvariants(const ASMENCODING & enc, std::vector<ASMENCODING> & variants)
+{
+    variants.push_back(enc);
+    if(!enc.hasModrm)
+        return;
+    auto mod = enc.modrm >> 6;
+    auto rm = enc.modrm & 7;
+    if(mod == 3 || (mod == 0 && (rm == 5 || (enc.hasSib && (enc.sib & 7) == 5))))
+        return;
+    for(int newMod = 1; newMod <= 2; newMod++)
+    {
+        if(newMod == mod || (newMod == 1 && !fitsbyte(enc.disp)))
+            continue;
+        auto variant = enc;
+        variant.modrm = (unsigned char)(newMod << 6 | (enc.modrm & 0x3F));
+        variant.dispSize = newMod == 1 ? 1 : 4;
+        variants.push_back(variant);
+    }
+}
+
+static ASMENCODING opvariant(const ASMENCODING & enc, unsigned char map, unsigned char op, bool hasModrm, unsigned char modrm, int immSize)
+{
+    auto variant = enc;
+    variant.map = map;
+    variant.op = op;
+    variant.hasModrm = hasModrm;
+    variant.modrm = modrm;
+    if(!hasModrm)
+    {
+        variant.hasSib = false;
+        variant.dispSize = 0;
+    }
+    variant.immSize = immSize;
+    return variant;
+}
+
+// Encodings that only differ in the width of the immediate (including the short forms for the accumulator)
+static void immvariants(const ASMENCODING & enc, std::vector<ASMENCODING> & variants)
+{
+    variants.push_back(enc);
+    auto op = enc.op;
+    auto full = enc.fullImmSize;
+    if(enc.map == 1 && op >= 0x80 && op <= 0x8F) // jcc rel32
+        variants.push_back(opvariant(enc, 0, (unsigned char)(0x70 | (op & 0xF)), false, 0, 1));
+    if(enc.map)
+        return;
+
+    auto reg = (enc.modrm >> 3) & 7;
+    bool accumulator = enc.hasModrm && enc.modrm >> 6 == 3 && (enc.modrm & 7) == 0 && !(enc.rex & 1);
+    bool shortImm = fitsbyte(enc.imm);
+    switch(op)
+    {
+    case 0x80:
+        if(accumulator)
+            variants.push_back(opvariant(enc, 0, (unsigned char)(reg << 3 | 4), false, 0, 1));
+        break;
+    case 0x81:
+    case 0x83:
+        if(op == 0x83)
+            variants.push_back(opvariant(enc, 0, 0x81, true, enc.modrm, full));
+        else if(shortImm)
+            variants.push_back(opvariant(enc, 0, 0x83, true, enc.modrm, 1));
+        if(accumulator)
+            variants.push_back(opvariant(enc, 0, (unsigned char)(reg << 3 | 5), false, 0, full));
+        break;
+    case 0xF6:
+    case 0xF7:
+        if(accumulator && reg == 0)
+            variants.push_back(opvariant(enc, 0, op == 0xF6 ? 0xA8 : 0xA9, false, 0, op == 0xF6 ? 1 : full));
+        break;
+    case 0xA8:
+        variants.push_back(opvariant(enc, 0, 0xF6, true, 0xC0, 1));
+        break;
+    case 0xA9:
+        variants.push_back(opvariant(enc, 0, 0xF7, true, 0xC0, full));
+        break;
+    case 0x6A:
+        variants.push_back(opvariant(enc, 0, 0x68, false, 0, full));
+        break;
+    case 0x68:
+        if(shortImm)
+            variants.push_back(opvariant(enc, 0, 0x6A, false, 0, 1));
+        break;
+    case 0x6B:
+        variants.push_back(opvariant(enc, 0, 0x69, true, enc.modrm, full));
+        break;
+    case 0x69:
+        if(shortImm)
+            variants.push_back(opvariant(enc, 0, 0x6B, true, enc.modrm, 1));
+        break;
+    case 0xEB:
+        variants.push_back(opvariant(enc, 0, 0xE9, false, 0, full));
+        break;
+    case 0xE9:
+        variants.push_back(opvariant(enc, 0, 0xEB, false, 0, 1));
+        break;
+    default:
+        if(op >= 0x70 && op <= 0x7F) // jcc rel8
+            variants.push_back(opvariant(enc, 1, (unsigned char)(0x80 | (op & 0xF)), false, 0, full));
+        else if(op < 0x40 && (op & 7) == 4)
+            variants.push_back(opvariant(enc, 0, 0x80, true, (unsigned char)(0xC0 | (op & 0x38)), 1));
+        else if(op < 0x40 && (op & 7) == 5)
+        {
+            variants.push_back(opvariant(enc, 0, 0x81, true, (unsigned char)(0xC0 | (op & 0x38)), full));
+            if(shortImm)
+                variants.push_back(opvariant(enc, 0, 0x83, true, (unsigned char)(0xC0 | (op & 0x38)), 1));
+        }
+        break;
+    }
+}
+
+bool assemblepatterns(duint addr, const char* instruction, std::vector<std::vector<PatternByte>> & patterns, unsigned char* dest, int* size, char* error)
+{
+    unsigned char bytes[16];
+    int byteCount;
+    if(!assemble(addr, bytes, &byteCount, instruction, error))
+        return false;
+    if(dest)
+        memcpy(dest, bytes, byteCount);
+    if(size)
+        *size = byteCount;
+
+    patterns.clear();
+    ASMENCODING enc;
+    if(!parseencoding(bytes, byteCount, enc))
+    {
+        // Unknown layout, the displacement of a RIP-relative operand cannot be located so the caller has to compare
+        // every instruction
+        Capstone cp;
+        if(cp.Disassemble(addr, bytes, byteCount))
+        {
+            const auto & x86 = cp.x86();
+            for(int i = 0; i < cp.OpCount(); i++)
+            {
+                if(x86.operands[i].type == X86_OP_MEM && x86.operands[i].mem.base == X86_REG_RIP)
+                    return true;
+            }
+        }
+
+        // Only the assembled bytes are searched
+        patterns.emplace_back();
+        for(int i = 0; i < byteCount; i++)
+            patternappend(patterns.back(), bytes[i], 1, false);
+        return true;
+    }
+
+    std::vector<ASMENCODING> dispVariants;
+    dispvariants(enc, dispVariants);
+    for(const auto & dispVariant : dispVariants)
+    {
+        std::vector<ASMENCODING> variants;
+        immvariants(dispVariant, variants);
+        for(const auto & variant : variants)
+            patterns.push_back(encodingpattern(variant));
+    }
+    return true;
 }
\ No newline at end of file
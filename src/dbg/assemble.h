@@ -2,8 +2,12 @@
 #define _ASSEMBLE_H
 
 #include "_global.h"
+#include "patternfind.h"
 
 bool assemble(duint addr, unsigned char* dest, int* size, const char* instruction, char* error);
 bool assembleat(duint addr, const char* instruction, int* size, char* error, bool fillnop);
+//search patterns for the encodings of the instruction that only differ in the width of immediates and displacements
+//no patterns when the encoding depends on the address, every instruction has to be compared instead
+bool assemblepatterns(duint addr, const char* instruction, std::vector<std::vector<PatternByte>> & patterns, unsigned char* dest, int* size, char* error);
 
 #endif // _ASSEMBLE_H
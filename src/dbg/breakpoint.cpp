@@ -10,10 +10,79 @@
 #include "module.h"
 #include "value.h"
 #include "debugger.h"
+#include "expressionparser.h"
 
 typedef std::pair<BP_TYPE, duint> BreakpointKey;
 std::map<BreakpointKey, BREAKPOINT> breakpoints;
 
+// Hot part of a breakpoint, looked up by virtual address when the breakpoint is hit
+struct BREAKPOINTHOT
+{
+    BREAKPOINT* bp; // the complete breakpoint in the breakpoints map
+    duint addr;
+    bool enabled;
+    bool singleshoot;
+    bool fastResume;
+    std::shared_ptr<const ExpressionParser> breakCondition;
+    std::shared_ptr<const ExpressionParser> logCondition;
+    std::shared_ptr<const ExpressionParser> commandCondition;
+};
+
+// One index per BP_TYPE, rebuilt when breakpoints or modules changed
+static std::unordered_map<duint, BREAKPOINTHOT> breakpointsHot[BPMEMORY + 1];
+static volatile bool breakpointsHotDirty = true;
+static duint breakpointsHotGeneration = 0;
+
+static std::shared_ptr<const ExpressionParser> bpCompileCondition(const char* Condition)
+{
+    if(!*Condition)
+        return nullptr;
+    return std::make_shared<ExpressionParser>(Condition);
+}
+
+static bool bpHotIsStale()
+{
+    return breakpointsHotDirty || breakpointsHotGeneration != ModGetGeneration();
+}
+
+static void bpHotUpdate()
+{
+    // Unsynchronized check first, a breakpoint hit should not wait for the exclusive lock
+    if(!bpHotIsStale())
+        return;
+
+    EXCLUSIVE_ACQUIRE(LockBreakpoints);
+    if(!bpHotIsStale())
+        return;
+
+    breakpointsHotGeneration = ModGetGeneration();
+    for(auto & index : breakpointsHot)
+        index.clear();
+    for(auto & i : breakpoints)
+    {
+        auto & bp = i.second;
+        if(bp.type > BPMEMORY)
+            continue;
+
+        // Breakpoints in modules that are not loaded cannot be hit
+        auto base = ModBaseFromName(bp.mod);
+        if(*bp.mod && !base)
+            continue;
+
+        BREAKPOINTHOT hot;
+        hot.bp = &bp;
+        hot.addr = bp.addr + base;
+        hot.enabled = bp.enabled;
+        hot.singleshoot = bp.singleshoot;
+        hot.fastResume = bp.fastResume;
+        hot.breakCondition = bpCompileCondition(bp.breakCondition);
+        hot.logCondition = bpCompileCondition(bp.logCondition);
+        hot.commandCondition = bpCompileCondition(bp.commandCondition);
+        breakpointsHot[bp.type][hot.addr] = hot;
+    }
+    breakpointsHotDirty = false;
+}
+
 static void setBpActive(BREAKPOINT & bp)
 {
     if(bp.type == BPHARDWARE)  //TODO: properly implement this (check debug registers)
@@ -92,6 +161,7 @@ bool BpNew(duint Address, bool Enable, bool Singleshot, short OldBytes, BP_TYPE
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
 
     breakpoints.insert(std::make_pair(BreakpointKey(Type, ModHashFromAddr(Address)), bp));
+    breakpointsHotDirty = true;
     return true;
 }
 
@@ -152,12 +222,59 @@ bool BpGetAny(BP_TYPE Type, const char* Name, BREAKPOINT* Bp)
     return false;
 }
 
+bool BpHit(BP_TYPE Type, duint Address, BPHIT & Hit)
+{
+    if(Type > BPMEMORY)
+        return false;
+
+    while(true)
+    {
+        bpHotUpdate();
+
+        SHARED_ACQUIRE(LockBreakpoints);
+
+        // Breakpoints changed after the update, do it again
+        if(bpHotIsStale())
+            continue;
+
+        auto found = breakpointsHot[Type].find(Address);
+        if(found == breakpointsHot[Type].end() || !found->second.enabled)
+            return false;
+        const auto & hot = found->second;
+
+        Hit.addr = hot.addr;
+        Hit.type = Type;
+        Hit.titantype = hot.bp->titantype;
+        Hit.singleshoot = hot.singleshoot;
+        Hit.fastResume = hot.fastResume;
+        Hit.hitcount = InterlockedIncrement((volatile LONG*)&hot.bp->hitcount);
+        Hit.breakCondition = hot.breakCondition;
+        Hit.logCondition = hot.logCondition;
+        Hit.commandCondition = hot.commandCondition;
+        Hit.logText.clear();
+        if(hot.fastResume)
+            Hit.logText = hot.bp->logText;
+        return true;
+    }
+}
+
+bool BpHitCondition(const std::shared_ptr<const ExpressionParser> & Condition, bool Default)
+{
+    if(!Condition)
+        return Default;
+    duint value;
+    if(Condition->Calculate(value, valuesignedcalc()))
+        return value != 0;
+    return true;
+}
+
 bool BpDelete(duint Address, BP_TYPE Type)
 {
     ASSERT_DEBUGGING("Command function call");
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
 
     // Erase the index from the global list
+    breakpointsHotDirty = true;
     return (breakpoints.erase(BreakpointKey(Type, ModHashFromAddr(Address))) > 0);
 }
 
@@ -173,6 +290,7 @@ bool BpEnable(duint Address, BP_TYPE Type, bool Enable)
         return false;
 
     bpInfo->enabled = Enable;
+    breakpointsHotDirty = true;
 
     //Re-read oldbytes
     if(Enable && Type == BPNORMAL)
@@ -214,6 +332,7 @@ bool BpSetTitanType(duint Address, BP_TYPE Type, int TitanType)
         return false;
 
     bpInfo->titantype = TitanType;
+    breakpointsHotDirty = true;
     return true;
 }
 
@@ -229,6 +348,7 @@ bool BpSetBreakCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strcpy_s(bpInfo->breakCondition, Condition);
+    breakpointsHotDirty = true;
     return true;
 }
 
@@ -244,6 +364,7 @@ bool BpSetLogText(duint Address, BP_TYPE Type, const char* Log)
         return false;
 
     strcpy_s(bpInfo->logText, Log);
+    breakpointsHotDirty = true;
     return true;
 }
 
@@ -259,6 +380,7 @@ bool BpSetLogCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strcpy_s(bpInfo->logCondition, Condition);
+    breakpointsHotDirty = true;
     return true;
 }
 
@@ -289,6 +411,7 @@ bool BpSetCommandCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strcpy_s(bpInfo->commandCondition, Condition);
+    breakpointsHotDirty = true;
     return true;
 }
 
@@ -304,6 +427,7 @@ bool BpSetFastResume(duint Address, BP_TYPE Type, bool fastResume)
         return false;
 
     bpInfo->fastResume = fastResume;
+    breakpointsHotDirty = true;
     return true;
 }
 
@@ -514,6 +638,7 @@ void BpCacheLoad(JSON Root)
 
     // Remove all existing elements
     breakpoints.clear();
+    breakpointsHotDirty = true;
 
     // Get a handle to the root object -> breakpoints subtree
     const JSON jsonBreakpoints = json_object_get(Root, "breakpoints");
@@ -558,4 +683,5 @@ void BpClear()
 {
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
     breakpoints.clear();
+    breakpointsHotDirty = true;
 }
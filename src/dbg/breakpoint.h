@@ -2,6 +2,9 @@
 #define _BREAKPOINT_H
 
 #include "_global.h"
+#include <memory>
+
+class ExpressionParser;
 
 #define TITANSETDRX(titantype, drx) titantype &= 0x0FF; titantype |= (drx<<8)
 #define TITANGETDRX(titantype) (titantype >> 8) & 0xF
@@ -37,6 +40,21 @@ struct BREAKPOINT
     bool fastResume;                                  // if true, debugger resumes without any GUI/Script/Plugin interaction.
 };
 
+// Everything the debug loop needs when a breakpoint is hit, without the text fields
+struct BPHIT
+{
+    duint addr;                                                // virtual address of the breakpoint
+    BP_TYPE type;                                              // breakpoint type
+    DWORD titantype;                                           // type passed to titanengine
+    bool singleshoot;                                          // whether the breakpoint should be deleted on first hit
+    bool fastResume;                                           // if true, debugger resumes without any GUI/Script/Plugin interaction.
+    uint32 hitcount;                                           // hit counter, including this hit
+    std::shared_ptr<const ExpressionParser> breakCondition;    // compiled conditions, empty when not set
+    std::shared_ptr<const ExpressionParser> logCondition;
+    std::shared_ptr<const ExpressionParser> commandCondition;
+    String logText;                                            // text to log, only filled for fast resume breakpoints
+};
+
 // Breakpoint enumeration callback
 typedef bool (*BPENUMCALLBACK)(const BREAKPOINT* bp);
 
@@ -45,6 +63,8 @@ int BpGetList(std::vector<BREAKPOINT>* List);
 bool BpNew(duint Address, bool Enable, bool Singleshot, short OldBytes, BP_TYPE Type, DWORD TitanType, const char* Name);
 bool BpGet(duint Address, BP_TYPE Type, const char* Name, BREAKPOINT* Bp);
 bool BpGetAny(BP_TYPE Type, const char* Name, BREAKPOINT* Bp);
+bool BpHit(BP_TYPE Type, duint Address, BPHIT & Hit);
+bool BpHitCondition(const std::shared_ptr<const ExpressionParser> & Condition, bool Default);
 bool BpDelete(duint Address, BP_TYPE Type);
 bool BpEnable(duint Address, BP_TYPE Type, bool Enable);
 bool BpSetName(duint Address, BP_TYPE Type, const char* Name);
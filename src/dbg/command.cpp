@@ -8,34 +8,116 @@
 #include "value.h"
 #include "console.h"
 #include "commandparser.h"
+#include "threading.h"
 
 COMMAND* cmd_list = 0;
+static DWORD cmdloopthreadid = 0;
+static duint cmdgeneration = 0; //incremented every time a command is added, changed or removed
+static std::unordered_map<String, COMMAND*> cmd_map; //lowercase alias -> command
+
+//commands with arguments up to this size are executed without allocating memory
+#define CMD_ARGV_STACK_SIZE 512
+
+/**
+\brief Add the aliases of a command to the alias map. Requires LockCommands.
+\param [in] cmd The command.
+*/
+static void cmdmapadd(COMMAND* cmd)
+{
+    String name = StringUtils::ToLower(cmd->name);
+    size_t start = 0;
+    while(true)
+    {
+        size_t end = name.find('\1', start);
+        //the first registration of an alias wins, like the list order did before
+        cmd_map.insert(std::make_pair(name.substr(start, end == String::npos ? String::npos : end - start), cmd));
+        if(end == String::npos)
+            break;
+        start = end + 1;
+    }
+}
+
+/**
+\brief Rebuild the alias map from the command list. Requires LockCommands.
+*/
+static void cmdmaprebuild()
+{
+    cmd_map.clear();
+    for(COMMAND* cur = cmd_list; cur && cur->name; cur = cur->next)
+        cmdmapadd(cur);
+}
+
+/**
+\brief Find a command in the alias map. Requires LockCommands.
+\param name The name (or alias) of the command.
+\return null if the command was not found.
+*/
+static COMMAND* cmdmapfind(const char* name)
+{
+    auto found = cmd_map.find(StringUtils::ToLower(name));
+    return found != cmd_map.end() ? found->second : nullptr;
+}
+
+/**
+\brief Execute a command with the tokens of the parsed command line. The argv array and the argument strings share one allocation.
+\param [in] cmd The command to execute.
+\param [in] command The command text, passed as argv[0].
+\param args The arguments.
+\param argcount The number of arguments.
+\return A CMDRESULT.
+*/
+static CMDRESULT cmdexecargv(COMMAND* cmd, char* command, const String* args, int argcount)
+{
+    size_t size = (argcount + 1) * sizeof(char*);
+    for(int i = 0; i < argcount; i++)
+        size += args[i].length() + 1;
+    duint stackArena[CMD_ARGV_STACK_SIZE / sizeof(duint)];
+    Memory<char*> heapArena("cmdexecargv:arena");
+    char* arena = size <= sizeof(stackArena) ? (char*)stackArena : heapArena.realloc(size, "cmdexecargv:arena");
+    char** argv = (char**)arena;
+    char* strings = arena + (argcount + 1) * sizeof(char*);
+    argv[0] = command;
+    for(int i = 0; i < argcount; i++)
+    {
+        size_t len = args[i].length() + 1;
+        memcpy(strings, args[i].c_str(), len);
+        argv[i + 1] = strings;
+        strings += len;
+    }
+    return cmd->cbCommand(argcount + 1, argv);
+}
 
 /**
 \brief Finds a ::COMMAND in a command list.
 \param [in] command list.
 \param name The name of the command to find.
 \param [out] Link to the command.
-\return null if it fails, else a ::COMMAND*.
+\return null if it fails, else a ::COMMAND*. Requires LockCommands.
 */
-COMMAND* cmdfind(const char* name, COMMAND** link)
+static COMMAND* cmdfindlocked(const char* name, COMMAND** link)
 {
-    COMMAND* cur = cmd_list;
-    if(!cur->name)
-        return 0;
+    COMMAND* found = cmdmapfind(name);
+    if(!found || !link)
+        return found;
+    //only cmddel needs the previous entry
     COMMAND* prev = 0;
-    while(cur)
-    {
-        if(arraycontains(cur->name, name))
-        {
-            if(link)
-                *link = prev;
-            return cur;
-        }
+    for(COMMAND* cur = cmd_list; cur && cur != found; cur = cur->next)
         prev = cur;
-        cur = cur->next;
-    }
-    return 0;
+    *link = prev;
+    return found;
+}
+
+/**
+\brief Finds a ::COMMAND in a command list.
+\param [in] command list.
+\param name The name of the command to find.
+\param [out] Link to the command.
+\return null if it fails, else a ::COMMAND*.
+*/
+COMMAND* cmdfind(const char* name, COMMAND** link)
+{
+    SHARED_ACQUIRE(LockCommands);
+    return cmdfindlocked(name, link);
 }
 
 /**
@@ -44,8 +126,10 @@ COMMAND* cmdfind(const char* name, COMMAND** link)
 */
 COMMAND* cmdinit()
 {
+    EXCLUSIVE_ACQUIRE(LockCommands);
     cmd_list = (COMMAND*)emalloc(sizeof(COMMAND), "cmdinit:cmd");
     memset(cmd_list, 0, sizeof(COMMAND));
+    cmd_map.clear();
     return cmd_list;
 }
 
@@ -55,6 +139,8 @@ COMMAND* cmdinit()
 */
 void cmdfree()
 {
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    cmd_map.clear();
     COMMAND* cur = cmd_list;
     while(cur)
     {
@@ -75,7 +161,8 @@ void cmdfree()
 */
 bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly)
 {
-    if(!cmd_list || !cbCommand || !name || !*name || cmdfind(name, 0))
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    if(!cmd_list || !cbCommand || !name || !*name || cmdmapfind(name))
         return false;
     COMMAND* cmd;
     bool nonext = false;
@@ -91,6 +178,7 @@ bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly)
     strcpy(cmd->name, name);
     cmd->cbCommand = cbCommand;
     cmd->debugonly = debugonly;
+    cmdgeneration++;
     COMMAND* cur = cmd_list;
     if(!nonext)
     {
@@ -98,6 +186,7 @@ bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly)
             cur = cur->next;
         cur->next = cmd;
     }
+    cmdmapadd(cmd);
     return true;
 }
 
@@ -134,12 +223,14 @@ CBCOMMAND cmdset(const char* name, CBCOMMAND cbCommand, bool debugonly)
 {
     if(!cbCommand)
         return 0;
-    COMMAND* found = cmdfind(name, 0);
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    COMMAND* found = cmdfindlocked(name, 0);
     if(!found)
         return 0;
     CBCOMMAND old = found->cbCommand;
     found->cbCommand = cbCommand;
     found->debugonly = debugonly;
+    cmdgeneration++;
     return old;
 }
 
@@ -152,10 +243,12 @@ CBCOMMAND cmdset(const char* name, CBCOMMAND cbCommand, bool debugonly)
 bool cmddel(const char* name)
 {
     COMMAND* prev = 0;
-    COMMAND* found = cmdfind(name, &prev);
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    COMMAND* found = cmdfindlocked(name, &prev);
     if(!found)
         return false;
     efree(found->name, "cmddel:found->name");
+    cmdgeneration++;
     if(found == cmd_list)
     {
         COMMAND* next = cmd_list->next;
@@ -173,6 +266,8 @@ bool cmddel(const char* name)
         prev->next = found->next;
         efree(found, "cmddel:found");
     }
+    //the first entry is moved instead of freed, so the map is built again
+    cmdmaprebuild();
     return true;
 }
 
@@ -197,6 +292,7 @@ CMDRESULT cmdloop(CBCOMMAND cbUnknownCommand, CBCOMMANDPROVIDER cbCommandProvide
 {
     if(!cbUnknownCommand || !cbCommandProvider)
         return STATUS_ERROR;
+    cmdloopthreadid = GetCurrentThreadId();
     char command[deflen] = "";
     bool bLoop = true;
     while(bLoop)
@@ -231,19 +327,8 @@ CMDRESULT cmdloop(CBCOMMAND cbUnknownCommand, CBCOMMANDPROVIDER cbCommandProvide
                 else
                 {
                     Command commandParsed(command);
-                    int argcount = commandParsed.GetArgCount();
-                    char** argv = (char**)emalloc((argcount + 1) * sizeof(char*), "cmdloop:argv");
-                    argv[0] = command;
-                    for(int i = 0; i < argcount; i++)
-                    {
-                        argv[i + 1] = (char*)emalloc(deflen, "cmdloop:argv[i+1]");
-                        *argv[i + 1] = 0;
-                        strcpy_s(argv[i + 1], deflen, commandParsed.GetArg(i).c_str());
-                    }
-                    CMDRESULT res = cmd->cbCommand(argcount + 1, argv);
-                    for(int i = 0; i < argcount; i++)
-                        efree(argv[i + 1], "cmdloop:argv[i+1]");
-                    efree(argv, "cmdloop:argv");
+                    const auto & tokens = commandParsed.GetTokens();
+                    CMDRESULT res = cmdexecargv(cmd, command, tokens.size() ? tokens.data() + 1 : nullptr, commandParsed.GetArgCount());
                     if((error_is_fatal && res == STATUS_ERROR) || res == STATUS_EXIT)
                         bLoop = false;
                 }
@@ -399,18 +484,43 @@ CMDRESULT cmddirectexec(const char* cmd, ...)
     if(found->debugonly && !DbgIsDebugging())
         return STATUS_ERROR;
     Command cmdParsed(command);
-    int argcount = cmdParsed.GetArgCount();
-    char** argv = (char**)emalloc((argcount + 1) * sizeof(char*), "cmddirectexec:argv");
-    argv[0] = command;
-    for(int i = 0; i < argcount; i++)
-    {
-        argv[i + 1] = (char*)emalloc(deflen, "cmddirectexec:argv[i+1]");
-        *argv[i + 1] = 0;
-        strcpy_s(argv[i + 1], deflen, cmdParsed.GetArg(i).c_str());
-    }
-    CMDRESULT res = found->cbCommand(argcount + 1, argv);
-    for(int i = 0; i < argcount; i++)
-        efree(argv[i + 1], "cmddirectexec:argv[i+1]");
-    efree(argv, "cmddirectexec:argv");
-    return res;
+    const auto & tokens = cmdParsed.GetTokens();
+    return cmdexecargv(found, command, tokens.size() ? tokens.data() + 1 : nullptr, cmdParsed.GetArgCount());
+}
+
+/**
+\brief Execute a command that was already looked up and tokenised (used by the script engine).
+\param [in] cmd The command to execute.
+\param command The (formatted) command text, passed as argv[0].
+\param args The command arguments.
+\return A CMDRESULT.
+*/
+CMDRESULT cmddirectexecparsed(COMMAND* cmd, const char* command, const std::vector<String> & args)
+{
+    ASSERT_NONNULL(cmd);
+    if(!cmd->cbCommand)
+        return STATUS_ERROR;
+    if(cmd->debugonly && !DbgIsDebugging())
+        return STATUS_ERROR;
+    char commandCopy[deflen] = "";
+    strcpy_s(commandCopy, command);
+    return cmdexecargv(cmd, commandCopy, args.data(), (int)args.size());
+}
+
+/**
+\brief Get the command list generation, which changes every time a command is added, changed or removed.
+\return The generation.
+*/
+duint cmdgetgeneration()
+{
+    return cmdgeneration;
+}
+
+/**
+\brief Check if the calling thread runs the command loop (commands entered by the user).
+\return true if the calling thread is the command loop thread.
+*/
+bool cmdisloopthread()
+{
+    return GetCurrentThreadId() == cmdloopthreadid;
 }
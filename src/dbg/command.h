@@ -38,5 +38,8 @@ bool cmddel(const char* name);
 CMDRESULT cmdloop(CBCOMMAND cbUnknownCommand, CBCOMMANDPROVIDER cbCommandProvider, CBCOMMANDFINDER cbCommandFinder, bool error_is_fatal);
 COMMAND* cmdfindmain(char* command);
 CMDRESULT cmddirectexec(const char* cmd, ...);
+CMDRESULT cmddirectexecparsed(COMMAND* cmd, const char* command, const std::vector<String> & args);
+duint cmdgetgeneration();
+bool cmdisloopthread();
 
 #endif // _COMMAND_H
@@ -95,6 +95,11 @@ const int Command::GetArgCount()
     return _tokens.size() ? (int)_tokens.size() - 1 : 0;
 }
 
+const std::vector<String> & Command::GetTokens()
+{
+    return _tokens;
+}
+
 const String Command::GetArg(int argnum)
 {
     return (int)_tokens.size() < argnum + 1 ? String() : _tokens[argnum + 1];
@@ -10,6 +10,7 @@ public:
     const String GetText();
     const String GetArg(const int argnum);
     const int GetArgCount();
+    const std::vector<String> & GetTokens();
 
 private:
     String _data;
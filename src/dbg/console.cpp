@@ -4,6 +4,50 @@
 */
 
 #include "console.h"
+#include "threading.h"
+
+// Lines queued by dputs_async, they are written to the log by a background thread
+static std::vector<String> asyncLines;
+static volatile LONG asyncPending = 0;
+static bool asyncThreadRunning = false;
+
+/**
+\brief Writes the queued lines to the log. The caller must hold LockLogOutput.
+*/
+static void flushAsync()
+{
+    std::vector<String> lines;
+    {
+        EXCLUSIVE_ACQUIRE(LockLogQueue);
+        lines.swap(asyncLines);
+    }
+    if(lines.empty())
+        return;
+    String text;
+    for(const auto & line : lines)
+        text += line;
+    GuiAddLogMessage(text.c_str());
+    InterlockedExchangeAdd(&asyncPending, -LONG(lines.size()));
+}
+
+static DWORD WINAPI asyncLogThread(void* lpParameter)
+{
+    while(true)
+    {
+        // Give the debug loop some time to queue more lines, they are written at once
+        Sleep(10);
+        {
+            EXCLUSIVE_ACQUIRE(LockLogOutput);
+            flushAsync();
+        }
+        EXCLUSIVE_ACQUIRE(LockLogQueue);
+        if(asyncLines.empty())
+        {
+            asyncThreadRunning = false;
+            return 0;
+        }
+    }
+}
 
 /**
 \brief Print a line with text, terminated with a newline to the console.
@@ -41,5 +85,38 @@ void dprintf_args(const char* Format, va_list Args)
     char buffer[16384];
     vsnprintf_s(buffer, _TRUNCATE, Format, Args);
 
+    // Lines queued before this one have to be written first
+    if(asyncPending)
+    {
+        EXCLUSIVE_ACQUIRE(LockLogOutput);
+        flushAsync();
+        GuiAddLogMessage(buffer);
+        return;
+    }
+
     GuiAddLogMessage(buffer);
 }
+
+/**
+\brief Queue a line of text for the console without waiting for it to be written. Used by code that should not wait for the GUI, like logging breakpoints.
+\param text The text to print.
+*/
+void dputs_async(const char* Text)
+{
+    String line = Text;
+    if(line.empty() || line[line.length() - 1] != '\n')
+        line += '\n';
+
+    EXCLUSIVE_ACQUIRE(LockLogQueue);
+    asyncLines.push_back(line);
+    InterlockedIncrement(&asyncPending);
+    if(asyncThreadRunning)
+        return;
+
+    // The thread exits when there is nothing left to write
+    auto hThread = CreateThread(nullptr, 0, asyncLogThread, nullptr, 0, nullptr);
+    if(!hThread)
+        return; //the lines are written by the next dprintf
+    asyncThreadRunning = true;
+    CloseHandle(hThread);
+}
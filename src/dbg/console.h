@@ -6,5 +6,6 @@
 void dputs(const char* Text);
 void dprintf(const char* Format, ...);
 void dprintf_args(const char* Format, va_list Args);
+void dputs_async(const char* Text);
 
 #endif // _CONSOLE_H
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "memory.h"
 #include "function.h"
 
+AnalysisResultCache<ControlFlowAnalysis::Result> ControlFlowAnalysis::mResults;
+
 ControlFlowAnalysis::ControlFlowAnalysis(duint base, duint size, bool exceptionDirectory)
     : Analysis(base, size),
       mFunctionInfoSize(0),
@@ -66,33 +68,66 @@ void ControlFlowAnalysis::Analyse()
     dputs("Starting analysis...");
     auto ticks = GetTickCount();
 
-    BasicBlockStarts();
-    dprintf("Basic block starts in %ums!\n", GetTickCount() - ticks);
+    //only redo the blocks and functions that depend on changed bytes if this range was analysed before
+    std::vector<std::pair<duint, duint>> changes;
+    auto previous = mResults.Get(mBase, mSize);
+    if(previous && !changesSince(previous->serial, changes))
+        previous = nullptr;
+
+    if(previous)
+    {
+        updateBlockStarts(*previous, changes);
+        dprintf("%u changed range(s), basic block starts in %ums!\n", changes.size(), GetTickCount() - ticks);
+    }
+    else
+    {
+        BasicBlockStarts();
+        dprintf("Basic block starts in %ums!\n", GetTickCount() - ticks);
+    }
     ticks = GetTickCount();
 
-    BasicBlocks();
+    BasicBlocks(previous.get(), changes);
     dprintf("Basic blocks in %ums!\n", GetTickCount() - ticks);
     ticks = GetTickCount();
 
+    if(previous)
+        reuseFunctions(*previous);
     Functions();
     dprintf("Functions in %ums!\n", GetTickCount() - ticks);
     ticks = GetTickCount();
 
-    FunctionRanges();
+    FunctionRanges(previous.get());
     dprintf("Function ranges in %ums!\n", GetTickCount() - ticks);
 
+    auto result = std::make_shared<Result>();
+    result->base = mBase;
+    result->size = mSize;
+    result->serial = store().Serial();
+    result->starts = mStarts;
+    result->fillings = mFillings;
+    result->blocks = mBlocks;
+    result->functions = mFunctions;
+    for(const auto & range : mFunctionRanges)
+        result->functionEnds[range.first] = range.second;
+    mResults.Put(result);
+
     dprintf("Analysis finished!\n");
 }
 
 void ControlFlowAnalysis::SetMarkers()
 {
-    FunctionDelRange(mBase, mBase + mSize - 1, false);
+    std::vector<FUNCTIONRANGE> functions;
     auto size = mFunctionRanges.size();
+    functions.reserve(size);
     for(auto i = size - 1; i != -1; i--)
     {
-        const auto & range = mFunctionRanges[i];
-        FunctionAdd(range.first, range.second, false);
+        FUNCTIONRANGE function;
+        function.start = mFunctionRanges[i].first;
+        function.end = mFunctionRanges[i].second;
+        function.instructioncount = 0;
+        functions.push_back(function);
     }
+    FunctionReplaceRange(mBase, mBase + mSize - 1, functions);
     /*dprintf("digraph ControlFlow {\n");
     int i = 0;
     std::map<duint, int> nodeMap;
@@ -135,105 +170,212 @@ void ControlFlowAnalysis::SetMarkers()
 
 void ControlFlowAnalysis::BasicBlockStarts()
 {
-    mBlockStarts.insert(mBase);
-    auto bSkipFilling = false;
+    auto skipFilling = false;
     for(duint i = 0; i < mSize;)
     {
         auto addr = mBase + i;
-        if(mCp.Disassemble(addr, translateAddr(addr), MAX_DISASM_BUFFER))
+        DECODEDINSTR instr;
+        if(decode(addr, instr))
         {
-            if(bSkipFilling) //handle filling skip mode
-            {
-                if(!mCp.IsFilling()) //do nothing until the filling stopped
-                {
-                    bSkipFilling = false;
-                    mBlockStarts.insert(addr);
-                }
-            }
-            else if(mCp.InGroup(CS_GRP_RET)) //RET breaks control flow
-            {
-                bSkipFilling = true; //skip INT3/NOP/whatever filling bytes (those are not part of the control flow)
-            }
-            else if(mCp.InGroup(CS_GRP_JUMP) || mCp.IsLoop())   //branches
-            {
-                auto dest1 = getReferenceOperand();
-                duint dest2 = 0;
-                if(mCp.GetId() != X86_INS_JMP)    //conditional jump
-                    dest2 = addr + mCp.Size();
-
-                if(!dest1 && !dest2)  //TODO: better code for this (make sure absolutely no filling is inserted)
-                    bSkipFilling = true;
-                if(dest1)
-                    mBlockStarts.insert(dest1);
-                if(dest2)
-                    mBlockStarts.insert(dest2);
-            }
-            else if(mCp.InGroup(CS_GRP_CALL))
-            {
-                auto dest1 = getReferenceOperand();
-                if(dest1)
-                {
-                    mBlockStarts.insert(dest1);
-                    mFunctionStarts.insert(dest1);
-                }
-            }
-            else
-            {
-                auto dest1 = getReferenceOperand();
-                if(dest1)
-                    mBlockStarts.insert(dest1);
-            }
-            i += mCp.Size();
+            skipFilling = sweepInstruction(addr, &instr, skipFilling, true);
+            i += instr.size;
         }
         else
+        {
+            skipFilling = sweepInstruction(addr, nullptr, skipFilling, true);
             i++;
+        }
     }
+    populateBlockStarts();
 }
 
-void ControlFlowAnalysis::BasicBlocks()
+void ControlFlowAnalysis::updateBlockStarts(const Result & previous, const std::vector<std::pair<duint, duint>> & changes)
 {
-    for(auto i = mBlockStarts.begin(); i != mBlockStarts.end(); ++i)
+    //sweep the changed ranges again, past their end until the filling state lines up with the previous sweep
+    std::vector<std::pair<duint, duint>> swept;
+    auto count = store().Count();
+    size_t next = 0;
+    auto skipFilling = false;
+    for(const auto & change : changes)
     {
-        auto start = *i;
+        auto index = max(store().LowerBound(change.first), next);
+        if(index >= count)
+            break;
+        DECODEDINSTR instr;
+        if(index != next && index)
+        {
+            //the instruction before the change was not decoded again, it left the state the previous sweep had
+            store().Get(index - 1, instr);
+            skipFilling = std::binary_search(previous.fillings.begin(), previous.fillings.end(), instr.addr);
+            skipFilling = sweepInstruction(instr.addr, instr.size ? &instr : nullptr, skipFilling, false);
+        }
+        else if(!index)
+            skipFilling = false;
+        store().Get(index, instr);
+        auto start = instr.addr;
+        for(; index < count; index++)
+        {
+            store().Get(index, instr);
+            if(instr.addr >= change.second && skipFilling == std::binary_search(previous.fillings.begin(), previous.fillings.end(), instr.addr))
+                break;
+            skipFilling = sweepInstruction(instr.addr, instr.size ? &instr : nullptr, skipFilling, true);
+        }
+        swept.push_back({ start, index < count ? instr.addr : mBase + mSize });
+        next = index;
+    }
+
+    //keep what the previous sweep found outside of the swept ranges
+    for(const auto & start : previous.starts)
+        if(!rangesOverlap(swept, start.from, start.from + 1))
+            mStarts.push_back(start);
+    for(auto filling : previous.fillings)
+        if(!rangesOverlap(swept, filling, filling + 1))
+            mFillings.push_back(filling);
+    std::sort(mStarts.begin(), mStarts.end());
+    std::sort(mFillings.begin(), mFillings.end());
+    populateBlockStarts();
+}
+
+bool ControlFlowAnalysis::sweepInstruction(duint addr, const DECODEDINSTR* instr, bool skipFilling, bool record)
+{
+    if(skipFilling && record)
+        mFillings.push_back(addr);
+    if(!instr)  //invalid bytes do not change the state
+        return skipFilling;
+    auto insert = [&](duint dest, bool call)
+    {
+        if(record)
+            mStarts.push_back({ addr, dest, call });
+    };
+    if(skipFilling) //handle filling skip mode
+    {
+        if(!(instr->flags & DECODED_FILLING)) //do nothing until the filling stopped
+        {
+            insert(addr, false);
+            return false;
+        }
+        return true;
+    }
+    if(instr->flags & DECODED_RET) //RET breaks control flow
+        return true; //skip INT3/NOP/whatever filling bytes (those are not part of the control flow)
+    if(instr->flags & (DECODED_JUMP | DECODED_LOOP))   //branches
+    {
+        auto dest1 = getReferenceOperand(*instr);
+        duint dest2 = 0;
+        if(!(instr->flags & DECODED_JMP))    //conditional jump
+            dest2 = addr + instr->size;
+
+        if(!dest1 && !dest2)  //TODO: better code for this (make sure absolutely no filling is inserted)
+            return true;
+        if(dest1)
+            insert(dest1, false);
+        if(dest2)
+            insert(dest2, false);
+    }
+    else if(instr->flags & DECODED_CALL)
+    {
+        auto dest1 = getReferenceOperand(*instr);
+        if(dest1)
+            insert(dest1, true);
+    }
+    else
+    {
+        auto dest1 = getReferenceOperand(*instr);
+        if(dest1)
+            insert(dest1, false);
+    }
+    return false;
+}
+
+void ControlFlowAnalysis::populateBlockStarts()
+{
+    mBlockStarts.clear();
+    mBlockStarts.reserve(mStarts.size() + 1);
+    mBlockStarts.push_back(mBase);
+    for(const auto & start : mStarts)
+    {
+        mBlockStarts.push_back(start.to);
+        if(start.call)
+            mFunctionStarts.insert(start.to);
+    }
+    std::sort(mBlockStarts.begin(), mBlockStarts.end());
+    mBlockStarts.erase(std::unique(mBlockStarts.begin(), mBlockStarts.end()), mBlockStarts.end());
+}
+
+void ControlFlowAnalysis::BasicBlocks(const Result* previous, const std::vector<std::pair<duint, duint>> & changes)
+{
+    for(size_t i = 0; i < mBlockStarts.size(); i++)
+    {
+        auto start = mBlockStarts[i];
         if(!inRange(start))
             continue;
-        auto nextStart = mBase + mSize;
-        auto next = std::next(i);
-        if(next != mBlockStarts.end())
-            nextStart = *next;
+        auto nextStart = i + 1 < mBlockStarts.size() ? mBlockStarts[i + 1] : mBase + mSize;
+
+        //a block is only scanned again if it read changed bytes or the block start that cut it off moved
+        if(previous)
+        {
+            auto found = previous->blocks.find(start);
+            if(found != previous->blocks.end())
+            {
+                auto block = found->second;
+                auto sameEnd = block.nextStart ? nextStart == block.nextStart : nextStart > block.end;
+                if(sameEnd && !rangesOverlap(changes, start, block.scanEnd + MAX_DISASM_BUFFER))
+                {
+                    block.function = 0;
+                    insertBlock(block);
+                    mReusedBlocks.insert(start);
+                    continue;
+                }
+            }
+        }
+
         for(duint addr = start, prevaddr; addr < mBase + mSize;)
         {
             prevaddr = addr;
-            if(mCp.Disassemble(addr, translateAddr(addr), MAX_DISASM_BUFFER))
+            DECODEDINSTR instr;
+            if(decode(addr, instr))
             {
-                if(mCp.InGroup(CS_GRP_RET))
+                if(instr.flags & DECODED_RET)
                 {
-                    insertBlock(BasicBlock(start, addr, 0, 0)); //leaf block
+                    BasicBlock block(start, addr, 0, 0); //leaf block
+                    block.scanEnd = addr + instr.size;
+                    insertBlock(block);
                     break;
                 }
-                else if(mCp.InGroup(CS_GRP_JUMP) || mCp.IsLoop())
+                else if(instr.flags & (DECODED_JUMP | DECODED_LOOP))
                 {
-                    auto dest1 = getReferenceOperand();
-                    auto dest2 = mCp.GetId() != X86_INS_JMP ? addr + mCp.Size() : 0;
-                    insertBlock(BasicBlock(start, addr, dest1, dest2));
-                    insertParent(dest1, start);
-                    insertParent(dest2, start);
+                    auto dest1 = getReferenceOperand(instr);
+                    auto dest2 = !(instr.flags & DECODED_JMP) ? addr + instr.size : 0;
+                    BasicBlock block(start, addr, dest1, dest2);
+                    block.scanEnd = addr + instr.size;
+                    insertBlock(block);
                     break;
                 }
-                addr += mCp.Size();
+                addr += instr.size;
             }
             else
                 addr++;
             if(addr == nextStart)   //special case handling overlapping blocks
             {
-                insertBlock(BasicBlock(start, prevaddr, 0, nextStart));
-                insertParent(nextStart, start);
+                BasicBlock block(start, prevaddr, 0, nextStart);
+                block.scanEnd = nextStart;
+                block.nextStart = nextStart;
+                insertBlock(block);
                 break;
             }
         }
     }
     mBlockStarts.clear();
 
+    //the parents follow from the blocks, reused or not
+    for(const auto & it : mBlocks)
+    {
+        insertParent(it.second.left, it.first);
+        insertParent(it.second.right, it.first);
+    }
+    if(previous)
+        dprintf("%u/%u basic blocks reused...\n", mReusedBlocks.size(), mBlocks.size());
+
 #ifdef _WIN64
     auto count = 0;
     enumerateFunctionRuntimeEntries64([&](PRUNTIME_FUNCTION Function)
@@ -253,35 +395,58 @@ void ControlFlowAnalysis::BasicBlocks()
     dprintf("%u basic blocks, %u function starts detected...\n", mBlocks.size(), mFunctionStarts.size());
 }
 
+void ControlFlowAnalysis::reuseFunctions(const Result & previous)
+{
+    //a function is kept if all of its blocks were reused and none of them gained or lost being a function start
+    for(const auto & function : previous.functions)
+    {
+        auto reusable = true;
+        for(auto start : function.second)
+        {
+            if(!mReusedBlocks.count(start) || (start == function.first) != isFunctionStart(start))
+            {
+                reusable = false;
+                break;
+            }
+        }
+        if(!reusable)
+            continue;
+        for(auto start : function.second)
+            mBlocks[start].function = function.first;
+        mFunctions[function.first] = function.second;
+        mReusedFunctions.insert(function.first);
+    }
+    dprintf("%u/%u functions reused...\n", mReusedFunctions.size(), previous.functions.size());
+}
+
 void ControlFlowAnalysis::Functions()
 {
     typedef std::pair<BasicBlock*, const UintSet*> DelayedBlock;
     std::vector<DelayedBlock> delayedBlocks;
+    std::vector<BasicBlock*> assignedBlocks;
     for(auto & it : mBlocks)
     {
         auto block = &it.second;
+        if(block->function)  //block of a reused function
+            continue;
+        assignedBlocks.push_back(block);
         auto parents = findParents(block->start);
-        if(!block->function)
+        if(isFunctionStart(block->start))  //no parents = function start
         {
-            if(!parents || mFunctionStarts.count(block->start))  //no parents = function start
-            {
-                auto functionStart = block->start;
-                block->function = functionStart;
-                UintSet functionBlocks;
-                functionBlocks.insert(functionStart);
-                mFunctions[functionStart] = functionBlocks;
-            }
-            else //in function
-            {
-                auto function = findFunctionStart(block, parents);
-                if(!function)  //this happens with loops / unreferenced blocks sometimes
-                    delayedBlocks.push_back(DelayedBlock(block, parents));
-                else
-                    block->function = function;
-            }
+            auto functionStart = block->start;
+            block->function = functionStart;
+            UintSet functionBlocks;
+            functionBlocks.insert(functionStart);
+            mFunctions[functionStart] = functionBlocks;
+        }
+        else //in function
+        {
+            auto function = findFunctionStart(block, parents);
+            if(!function)  //this happens with loops / unreferenced blocks sometimes
+                delayedBlocks.push_back(DelayedBlock(block, parents));
+            else
+                block->function = function;
         }
-        else
-            DebugBreak(); //this should not happen
     }
     auto delayedCount = int(delayedBlocks.size());
     dprintf("%u/%u delayed blocks...\n", delayedCount, mBlocks.size());
@@ -312,26 +477,32 @@ void ControlFlowAnalysis::Functions()
     }
     dprintf("%u/%u delayed blocks resolved (%u/%u still left, probably unreferenced functions)\n", resolved, delayedCount, delayedCount - resolved, mBlocks.size());
     auto unreferencedCount = 0;
-    for(const auto & block : mBlocks)
+    for(auto block : assignedBlocks)
     {
-        auto found = mFunctions.find(block.second.function);
+        auto found = mFunctions.find(block->function);
         if(found == mFunctions.end())  //unreferenced block
         {
             unreferencedCount++;
             continue;
         }
-        found->second.insert(block.second.start);
+        found->second.insert(block->start);
+        mReusedFunctions.erase(found->first); //the function got a new block
     }
     dprintf("%u/%u unreferenced blocks\n", unreferencedCount, mBlocks.size());
     dprintf("%u functions found!\n", mFunctions.size());
 }
 
-void ControlFlowAnalysis::FunctionRanges()
+void ControlFlowAnalysis::FunctionRanges(const Result* previous)
 {
     //iterate over the functions and then find the deepest block = function end
     for(const auto & function : mFunctions)
     {
         auto start = function.first;
+        if(previous && mReusedFunctions.count(start))
+        {
+            mFunctionRanges.push_back({ start, previous->functionEnds.at(start) });
+            continue;
+        }
         auto end = start;
         for(auto blockstart : function.second)
         {
@@ -345,6 +516,11 @@ void ControlFlowAnalysis::FunctionRanges()
     }
 }
 
+bool ControlFlowAnalysis::isFunctionStart(duint start) const
+{
+    return !findParents(start) || mFunctionStarts.count(start) != 0;
+}
+
 void ControlFlowAnalysis::insertBlock(BasicBlock block)
 {
     if(mBlocks.find(block.start) != mBlocks.end())
@@ -411,25 +587,13 @@ String ControlFlowAnalysis::blockToString(const BasicBlock* block)
     return block->toString();
 }
 
-duint ControlFlowAnalysis::getReferenceOperand() const
+duint ControlFlowAnalysis::getReferenceOperand(const DECODEDINSTR & instr) const
 {
-    for(auto i = 0; i < mCp.OpCount(); i++)
+    for(auto i = 0; i < instr.refCount; i++)
     {
-        const auto & op = mCp.x86().operands[i];
-        if(op.type == X86_OP_IMM)
-        {
-            auto dest = duint(op.imm);
-            if(inRange(dest))
-                return dest;
-        }
-        else if(op.type == X86_OP_MEM)
-        {
-            auto dest = duint(op.mem.disp);
-            if(op.mem.base == X86_REG_RIP)  //rip-relative
-                dest += mCp.Address() + mCp.Size();
-            if(inRange(dest))
-                return dest;
-        }
+        auto dest = instr.refs[i]; //memory operands are already rip-relative resolved
+        if(inRange(dest))
+            return dest;
     }
     return 0;
 }
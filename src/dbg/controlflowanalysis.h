@@ -22,6 +22,8 @@ private:
         duint left;
         duint right;
         duint function;
+        duint scanEnd; //end of the bytes read to find the block end
+        duint nextStart; //next block start that cut this block off (0 if it ended on a branch)
 
         BasicBlock()
             : BasicBlock(0, 0, 0, 0)
@@ -32,8 +34,10 @@ private:
             : start(start),
               end(end),
               left(min(left, right)),
-              right(min(left, right)),
-              function(0)
+              right(max(left, right)),
+              function(0),
+              scanEnd(0),
+              nextStart(0)
         {
         }
 
@@ -43,30 +47,66 @@ private:
         }
     };
 
+    struct BlockStart
+    {
+        duint from; //instruction of the linear sweep that found the block start
+        duint to;
+        bool call;
+
+        bool operator<(const BlockStart & b) const
+        {
+            return from < b.from;
+        }
+    };
+
     typedef std::unordered_set<duint> UintSet;
 
+    //everything a later run needs to redo only the blocks and functions that depend on changed bytes
+    struct Result
+    {
+        duint base;
+        duint size;
+        duint serial;
+        std::vector<BlockStart> starts;
+        std::vector<duint> fillings; //addresses the linear sweep visited while skipping filling
+        std::unordered_map<duint, BasicBlock> blocks;
+        std::unordered_map<duint, UintSet> functions;
+        std::unordered_map<duint, duint> functionEnds;
+    };
+
+    static AnalysisResultCache<Result> mResults;
+
     duint mModuleBase;
     duint mFunctionInfoSize;
     void* mFunctionInfoData;
 
-    UintSet mBlockStarts;
+    std::vector<BlockStart> mStarts;
+    std::vector<duint> mFillings;
+    std::vector<duint> mBlockStarts; //sorted
     UintSet mFunctionStarts;
+    UintSet mReusedBlocks; //blocks taken from the previous result
+    UintSet mReusedFunctions; //functions taken from the previous result, their range is still valid
     std::unordered_map<duint, BasicBlock> mBlocks; //start of block -> block
     std::unordered_map<duint, UintSet> mParentMap; //start child -> parents
     std::unordered_map<duint, UintSet> mFunctions; //function start -> function block starts
     std::vector<Range> mFunctionRanges; //function start -> function range TODO: smarter stuff with overlapping ranges
 
     void BasicBlockStarts();
-    void BasicBlocks();
+    void updateBlockStarts(const Result & previous, const std::vector<std::pair<duint, duint>> & changes);
+    bool sweepInstruction(duint addr, const DECODEDINSTR* instr, bool skipFilling, bool record);
+    void populateBlockStarts();
+    void BasicBlocks(const Result* previous, const std::vector<std::pair<duint, duint>> & changes);
+    void reuseFunctions(const Result & previous);
     void Functions();
-    void FunctionRanges();
+    void FunctionRanges(const Result* previous);
+    bool isFunctionStart(duint start) const;
     void insertBlock(BasicBlock block);
     const BasicBlock* findBlock(duint start) const;
     void insertParent(duint child, duint parent);
     const UintSet* findParents(duint child) const;
     duint findFunctionStart(const BasicBlock* block, const UintSet* parents) const;
     static String blockToString(const BasicBlock* block);
-    duint getReferenceOperand() const;
+    duint getReferenceOperand(const DECODEDINSTR & instr) const;
 
 #ifdef _WIN64
     void enumerateFunctionRuntimeEntries64(std::function<bool(PRUNTIME_FUNCTION)> Callback) const;
@@ -54,6 +54,7 @@ void DbSave(DbLoadSaveType saveType)
         XrefCacheSave(root);
         TraceRecord.saveToDb(root);
         BpCacheSave(root);
+        PatchCacheSave(root);
 
         //save notes
         char* text = nullptr;
@@ -165,6 +166,7 @@ void DbLoad(DbLoadSaveType loadType)
         XrefCacheLoad(root);
         TraceRecord.loadFromDb(root);
         BpCacheLoad(root);
+        PatchCacheLoad(root);
 
 
         // Load notes
@@ -24,6 +24,11 @@
 #include "stackinfo.h"
 #include "stringformat.h"
 #include "TraceRecord.h"
+#include "jobs.h"
+#include "patches.h"
+#include "instructionstore.h"
+#include "mementropy.h"
+#include "memsnapshot.h"
 
 static PROCESS_INFORMATION g_pi = {0, 0, 0, 0};
 static char szBaseFileName[MAX_PATH] = "";
@@ -71,8 +76,11 @@ static DWORD WINAPI memMapThread(void* ptr)
         // Execute the update only if the delta if >= 1 second
         if((GetTickCount() - memMapThreadCounter) >= 1000)
         {
+            // Only notify the GUI when the memory map actually changed
+            duint generation = MemGetMapGeneration();
             MemUpdateMap();
-            GuiUpdateMemoryView();
+            if(MemGetMapGeneration() != generation)
+                GuiUpdateMemoryView();
 
             memMapThreadCounter = GetTickCount();
         }
@@ -241,6 +249,7 @@ void DebugUpdateGui(duint disasm_addr, bool stack)
         }
         GuiDisasmAt(disasm_addr, cip);
     }
+    SymPrioritize(disasm_addr);
     duint csp = GetContextDataEx(hActiveThread, UE_CSP);
     if(stack)
         DebugUpdateStack(csp, csp);
@@ -388,19 +397,6 @@ static void printMemBpInfo(const BREAKPOINT & bp, const void* ExceptionAddress)
     }
 }
 
-static bool getConditionValue(const char* expression)
-{
-    auto word = *(uint16*)expression;
-    if(word == '0')  // short circuit for condition "0\0"
-        return false;
-    if(word == '1')  //short circuit for condition "1\0"
-        return true;
-    duint value;
-    if(valfromstring(expression, &value))
-        return value != 0;
-    return true;
-}
-
 void cbPauseBreakpoint()
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
@@ -421,24 +417,24 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
 {
     hActiveThread = ThreadGetHandle(((DEBUG_EVENT*)GetDebugData())->dwThreadId);
     auto CIP = GetContextDataEx(hActiveThread, UE_CIP);
-    BREAKPOINT* bpPtr = nullptr;
-    SHARED_ACQUIRE(LockBreakpoints);
+    duint bpaddr = 0;
     switch(bptype)
     {
     case BPNORMAL:
-        bpPtr = BpInfoFromAddr(bptype, CIP);
+        bpaddr = CIP;
         break;
     case BPHARDWARE:
-        bpPtr = BpInfoFromAddr(bptype, duint(ExceptionAddress));
+        bpaddr = duint(ExceptionAddress);
         break;
     case BPMEMORY:
-        bpPtr = BpInfoFromAddr(bptype, MemFindBaseAddr(duint(ExceptionAddress), nullptr, true));
+        bpaddr = MemFindBaseAddr(duint(ExceptionAddress), nullptr, true);
     default:
         break;
     }
-    if(!(bpPtr && bpPtr->enabled))  //invalid / disabled breakpoint hit (most likely a bug)
+    // BpHit increments the hit count
+    BPHIT hit;
+    if(!BpHit(bptype, bpaddr, hit))  //invalid / disabled breakpoint hit (most likely a bug)
     {
-        SHARED_RELEASE();
         dputs("Breakpoint reached not in list!");
         GuiSetDebugState(paused);
         DebugUpdateGui(GetContextDataEx(hActiveThread, UE_CIP), true);
@@ -453,32 +449,23 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
         return;
     }
 
-    // increment hit count
-    InterlockedIncrement(&bpPtr->hitcount);
-
-    auto bp = *bpPtr;
-    SHARED_RELEASE();
-    bp.addr += ModBaseFromAddr(CIP);
-    bp.active = true; //a breakpoint that has been hit is active
-
     //get condition values
-    bool breakCondition;
-    bool logCondition;
-    bool commandCondition;
-    if(*bp.breakCondition)
-        breakCondition = getConditionValue(bp.breakCondition);
-    else
-        breakCondition = true; //break if no condition is set
-    if(bp.fastResume && !breakCondition)  // fast resume: ignore GUI/Script/Plugin/Other if the debugger would not break
+    bool breakCondition = BpHitCondition(hit.breakCondition, true); //break if no condition is set
+    bool logCondition = BpHitCondition(hit.logCondition, true); //log if no condition is set
+    if(hit.fastResume && !breakCondition)  // fast resume: ignore GUI/Script/Plugin/Other if the debugger would not break
+    {
+        // the log text is formatted now, writing it to the log is left to another thread
+        if(!hit.logText.empty() && logCondition)
+            dputs_async(stringformatinline(hit.logText).c_str());
         return;
-    if(*bp.logCondition)
-        logCondition = getConditionValue(bp.logCondition);
-    else
-        logCondition = true; //log if no condition is set
-    if(*bp.commandCondition)
-        commandCondition = getConditionValue(bp.commandCondition);
-    else
-        commandCondition = breakCondition; //if no condition is set, execute the command when the debugger would break
+    }
+    bool commandCondition = BpHitCondition(hit.commandCondition, breakCondition); //if no condition is set, execute the command when the debugger would break
+
+    // the text fields are only needed from here on
+    BREAKPOINT bp;
+    if(!BpGet(hit.addr, bptype, nullptr, &bp))
+        return;
+    bp.active = true; //a breakpoint that has been hit is active
 
     lock(WAITID_RUN);
     if(breakCondition)
@@ -774,6 +761,31 @@ void cbRtrStep()
         StepOver((void*)cbRtrStep);
 }
 
+static bool GetModuleInfoFromHeader(duint Base, const char* Path, IMAGEHLP_MODULEW64 & Info)
+{
+    // Symbols are loaded in the background, so the module information comes from the PE header
+    memset(&Info, 0, sizeof(Info));
+    Info.SizeOfStruct = sizeof(Info);
+    IMAGE_DOS_HEADER dosHeader;
+    IMAGE_NT_HEADERS ntHeaders;
+    if(!MemRead(Base, &dosHeader, sizeof(dosHeader)) || dosHeader.e_magic != IMAGE_DOS_SIGNATURE)
+        return false;
+    if(!MemRead(Base + dosHeader.e_lfanew, &ntHeaders, sizeof(ntHeaders)) || ntHeaders.Signature != IMAGE_NT_SIGNATURE)
+        return false;
+    Info.BaseOfImage = Base;
+    Info.ImageSize = ntHeaders.OptionalHeader.SizeOfImage;
+    Info.TimeDateStamp = ntHeaders.FileHeader.TimeDateStamp;
+    Info.CheckSum = ntHeaders.OptionalHeader.CheckSum;
+    Info.SymType = SymDeferred;
+    wcsncpy_s(Info.ImageName, StringUtils::Utf8ToUtf16(Path).c_str(), _TRUNCATE);
+    const wchar_t* fileName = wcsrchr(Info.ImageName, L'\\');
+    wcsncpy_s(Info.ModuleName, fileName ? fileName + 1 : Info.ImageName, _TRUNCATE);
+    wchar_t* extension = wcsrchr(Info.ModuleName, L'.');
+    if(extension)
+        *extension = L'\0';
+    return true;
+}
+
 static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
 {
     void* base = CreateProcessInfo->lpBaseOfImage;
@@ -798,17 +810,21 @@ static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
     sprintf_s(szServerSearchPath, "SRV*%s", szSymbolCachePath);
     SafeSymInitializeW(fdProcessInfo->hProcess, StringUtils::Utf8ToUtf16(szServerSearchPath).c_str(), false); //initialize symbols
     SafeSymRegisterCallbackW64(fdProcessInfo->hProcess, SymRegisterCallbackProc64, 0);
-    SafeSymLoadModuleExW(fdProcessInfo->hProcess, CreateProcessInfo->hFile, StringUtils::Utf8ToUtf16(DebugFileName).c_str(), 0, (DWORD64)base, 0, 0, 0);
 
     IMAGEHLP_MODULEW64 modInfo;
-    memset(&modInfo, 0, sizeof(modInfo));
-    modInfo.SizeOfStruct = sizeof(modInfo);
-    if(SafeSymGetModuleInfoW64(fdProcessInfo->hProcess, (DWORD64)base, &modInfo))
-        ModLoad((duint)base, modInfo.ImageSize, StringUtils::Utf16ToUtf8(modInfo.ImageName).c_str());
+    if(GetModuleInfoFromHeader((duint)base, DebugFileName, modInfo))
+    {
+        ModLoad((duint)base, modInfo.ImageSize, DebugFileName);
+        SymLoadModuleAsync((duint)base, modInfo.ImageSize, DebugFileName);
+        SymPrioritize((duint)base);
+    }
 
     char modname[256] = "";
     if(ModNameFromAddr((duint)base, modname, true))
+    {
         BpEnumAll(cbSetModuleBreakpoints, modname);
+        PatchApply(modname);
+    }
     BpEnumAll(cbSetModuleBreakpoints, "");
     GuiUpdateBreakpointsView();
     pCreateProcessBase = (duint)CreateProcessInfo->lpBaseOfImage;
@@ -903,8 +919,10 @@ static void cbExitProcess(EXIT_PROCESS_DEBUG_INFO* ExitProcess)
     PLUG_CB_EXITPROCESS callbackInfo;
     callbackInfo.ExitProcess = ExitProcess;
     plugincbcall(CB_EXITPROCESS, &callbackInfo);
+    //stop the background searches before the module and memory state goes away
+    JobCancelAll();
     //unload main module
-    SafeSymUnloadModule64(fdProcessInfo->hProcess, pCreateProcessBase);
+    SymUnloadModule(pCreateProcessBase);
     ModClear(); //clear all modules
 }
 
@@ -1017,19 +1035,23 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
     if(!GetFileNameFromHandle(LoadDll->hFile, DLLDebugFileName))
         strcpy_s(DLLDebugFileName, "??? (GetFileNameFromHandle failed)");
 
-    SafeSymLoadModuleExW(fdProcessInfo->hProcess, LoadDll->hFile, StringUtils::Utf8ToUtf16(DLLDebugFileName).c_str(), 0, (DWORD64)base, 0, 0, 0);
+    // Breakpoints only need the module table, the symbols are loaded in the background
     IMAGEHLP_MODULEW64 modInfo;
-    memset(&modInfo, 0, sizeof(modInfo));
-    modInfo.SizeOfStruct = sizeof(modInfo);
-    if(SafeSymGetModuleInfoW64(fdProcessInfo->hProcess, (DWORD64)base, &modInfo))
-        ModLoad((duint)base, modInfo.ImageSize, StringUtils::Utf16ToUtf8(modInfo.ImageName).c_str());
+    if(GetModuleInfoFromHeader((duint)base, DLLDebugFileName, modInfo))
+    {
+        ModLoad((duint)base, modInfo.ImageSize, DLLDebugFileName);
+        SymLoadModuleAsync((duint)base, modInfo.ImageSize, DLLDebugFileName);
+    }
 
     // Update memory map
     MemUpdateMapAsync();
 
     char modname[256] = "";
     if(ModNameFromAddr((duint)base, modname, true))
+    {
         BpEnumAll(cbSetModuleBreakpoints, modname);
+        PatchApply(modname);
+    }
     GuiUpdateBreakpointsView();
     bool bAlreadySetEntry = false;
 
@@ -1155,7 +1177,7 @@ static void cbUnloadDll(UNLOAD_DLL_DEBUG_INFO* UnloadDll)
     if(ModNameFromAddr((duint)base, modname, true))
         BpEnumAll(cbRemoveModuleBreakpoints, modname);
     GuiUpdateBreakpointsView();
-    SafeSymUnloadModule64(fdProcessInfo->hProcess, (DWORD64)base);
+    SymUnloadModule((duint)base);
     dprintf("DLL Unloaded: " fhex " %s\n", base, modname);
 
     if(bBreakOnNextDll || settingboolget("Events", "DllUnload"))
@@ -1315,6 +1337,8 @@ static void cbException(EXCEPTION_DEBUG_INFO* ExceptionData)
 
 static void cbDebugEvent(DEBUG_EVENT* DebugEvent)
 {
+    // Only the thread that reported the event is queried again, created and exited threads invalidate themselves
+    ThreadInvalidateCache(DebugEvent->dwThreadId);
     PLUG_CB_DEBUGEVENT debugEventInfo;
     debugEventInfo.DebugEvent = DebugEvent;
     plugincbcall(CB_DEBUGEVENT, &debugEventInfo);
@@ -1936,12 +1960,16 @@ static void debugLoopFunction(void* lpParameter, bool attach)
         DebugLoop();
     }
 
+    //stop the background searches (the process might not have sent an exit event)
+    JobCancelAll();
+
     //call plugin callback
     PLUG_CB_STOPDEBUG stopInfo;
     stopInfo.reserved = 0;
     plugincbcall(CB_STOPDEBUG, &stopInfo);
 
     //cleanup dbghelp
+    SymLoaderStop();
     SafeSymRegisterCallbackW64(hProcess, nullptr, 0);
     SafeSymCleanup(hProcess);
 
@@ -1952,6 +1980,9 @@ static void debugLoopFunction(void* lpParameter, bool attach)
     DbClose();
     ModClear();
     ThreadClear();
+    InstructionStoreClear();
+    EntropyClear();
+    MemSnapshotClear();
     TraceRecord.clear();
     GuiSetDebugState(stopped);
     GuiUpdateAllViews();
@@ -1608,6 +1608,7 @@ CMDRESULT cbDebugSwitchthread(int argc, char* argv[])
     }
     //switch thread
     hActiveThread = ThreadGetHandle((DWORD)threadid);
+    ThreadInvalidateCache(); //the thread view marks the active thread
     DebugUpdateGui(GetContextDataEx(hActiveThread, UE_CIP), true);
     dputs("Thread switched!");
     return STATUS_CONTINUE;
@@ -1631,6 +1632,7 @@ CMDRESULT cbDebugSuspendthread(int argc, char* argv[])
         return STATUS_ERROR;
     }
     dputs("Thread suspended");
+    ThreadInvalidateCache();
     GuiUpdateAllViews();
     return STATUS_CONTINUE;
 }
@@ -1653,6 +1655,7 @@ CMDRESULT cbDebugResumethread(int argc, char* argv[])
         return STATUS_ERROR;
     }
     dputs("Thread resumed!");
+    ThreadInvalidateCache();
     GuiUpdateAllViews();
     return STATUS_CONTINUE;
 }
@@ -1675,6 +1678,7 @@ CMDRESULT cbDebugKillthread(int argc, char* argv[])
     //terminate thread
     if(TerminateThread(ThreadGetHandle((DWORD)threadid), (DWORD)exitcode) != 0)
     {
+        ThreadInvalidateCache();
         GuiUpdateAllViews();
         dputs("Thread terminated");
         return STATUS_CONTINUE;
@@ -1761,6 +1765,7 @@ CMDRESULT cbDebugSetPriority(int argc, char* argv[])
         return STATUS_ERROR;
     }
     dputs("Thread priority changed!");
+    ThreadInvalidateCache();
     GuiUpdateAllViews();
     return STATUS_CONTINUE;
 }
@@ -1794,6 +1799,7 @@ CMDRESULT cbDebugDownloadSymbol(int argc, char* argv[])
         dputs("GetModuleFileNameExA failed!");
         return STATUS_ERROR;
     }
+    SymWaitModule(modbase, INFINITE); //do not race with the background symbol loader
     wchar_t szOldSearchPath[MAX_PATH] = L"";
     if(!SafeSymGetSearchPathW(fdProcessInfo->hProcess, szOldSearchPath, MAX_PATH)) //backup current search path
     {
@@ -11,6 +11,11 @@
 #include "debugger.h"
 #include "value.h"
 #include <capstone_wrapper.h>
+#include <emmintrin.h>
+#include <intrin.h>
+
+// Largest block of memory disasmgetstringsat reads at once
+#define STRING_BATCH_SIZE 0x10000
 
 duint disasmback(unsigned char* data, duint base, duint size, duint ip, int n)
 {
@@ -242,55 +247,153 @@ void disasmprint(duint addr)
         dprintf(" %d:%d:%" fext "X:%" fext "X:%" fext "X\n", i, instr.arg[i].type, instr.arg[i].constant, instr.arg[i].value, instr.arg[i].memvalue);
 }
 
-static bool isasciistring(const unsigned char* data, int maxlen)
+// One bit per byte of a 16 byte chunk: printable (isprint || isspace in the C locale), zero and 0x80-0xFF
+static void classifychunk(const unsigned char* data, DWORD & printable, DWORD & zero, DWORD & high)
 {
-    int len = 0;
-    for(char* p = (char*)data; *p; len++, p++)
-    {
-        if(len >= maxlen)
-            break;
-    }
+    // The signed compares reject 0x80-0xFF together with the control characters
+    const auto printLow = _mm_set1_epi8(0x1F);
+    const auto printHigh = _mm_set1_epi8(0x7F);
+    const auto spaceLow = _mm_set1_epi8(0x08);
+    const auto spaceHigh = _mm_set1_epi8(0x0E);
+    auto chunk = _mm_loadu_si128((const __m128i*)data);
+    auto print = _mm_and_si128(_mm_cmpgt_epi8(chunk, printLow), _mm_cmplt_epi8(chunk, printHigh));
+    auto space = _mm_and_si128(_mm_cmpgt_epi8(chunk, spaceLow), _mm_cmplt_epi8(chunk, spaceHigh));
+    printable = DWORD(_mm_movemask_epi8(_mm_or_si128(print, space)));
+    zero = DWORD(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_setzero_si128())));
+    high = DWORD(_mm_movemask_epi8(chunk));
+}
 
-    if(len < 2 || len + 1 >= maxlen)
-        return false;
-    for(int i = 0; i < len; i++)
-        if(!isprint(data[i]) && !isspace(data[i]))
+static DWORD lowestbit(DWORD mask)
+{
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+}
+
+// Well-formed UTF-8 (no overlong forms or surrogates) with at least one multibyte sequence
+static bool isutf8string(const unsigned char* data, duint len)
+{
+    bool multibyte = false;
+    for(duint i = 0; i < len;)
+    {
+        auto ch = data[i];
+        if(ch < 0x80)
+        {
+            i++;
+            continue;
+        }
+        duint count;
+        unsigned char low = 0x80, high = 0xBF;
+        if(ch >= 0xC2 && ch <= 0xDF)
+            count = 1;
+        else if(ch >= 0xE0 && ch <= 0xEF)
+        {
+            count = 2;
+            if(ch == 0xE0)
+                low = 0xA0;
+            else if(ch == 0xED)
+                high = 0x9F;
+        }
+        else if(ch >= 0xF0 && ch <= 0xF4)
+        {
+            count = 3;
+            if(ch == 0xF0)
+                low = 0x90;
+            else if(ch == 0xF4)
+                high = 0x8F;
+        }
+        else
+            return false;
+        if(i + count >= len || data[i + 1] < low || data[i + 1] > high)
             return false;
-    return true;
+        for(duint j = 2; j <= count; j++)
+            if((data[i + j] & 0xC0) != 0x80)
+                return false;
+        i += count + 1;
+        multibyte = true;
+    }
+    return multibyte;
 }
 
-static bool isunicodestring(const unsigned char* data, int maxlen)
+STRING_ENCODING disasmclassifystring(const unsigned char* data, duint size, int maxlen, int* length)
 {
-    int len = 0;
-    for(wchar_t* p = (wchar_t*)data; *p; len++, p++)
+    if(length)
+        *length = 0;
+    if(maxlen < 2)
+        return enc_none;
+
+    // First byte that is not printable, first byte that is neither printable nor part of a multibyte sequence and
+    // first character (even offset) that is not a printable byte followed by a zero byte. Each of them has to be the
+    // terminator of the string, usually the first chunk already rules out all three.
+    const duint none = ~duint(0);
+    auto asciiStop = none, utf8Stop = none, wideStop = none;
+    auto limit = min(size, duint(maxlen + 1) * 2);
+    unsigned char tail[16];
+    for(duint i = 0; i < limit && (asciiStop == none || utf8Stop == none || wideStop == none); i += 16)
     {
-        if(len >= maxlen)
-            break;
+        auto chunk = data + i;
+        if(size - i < sizeof(tail))
+        {
+            // The padding ends the string past the end of the data, that gets rejected below
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, chunk, size_t(size - i));
+            chunk = tail;
+        }
+        DWORD printable, zero, high;
+        classifychunk(chunk, printable, zero, high);
+        if(asciiStop == none && (~printable & 0xFFFF))
+            asciiStop = i + lowestbit(~printable & 0xFFFF);
+        if(utf8Stop == none && (~(printable | high) & 0xFFFF))
+            utf8Stop = i + lowestbit(~(printable | high) & 0xFFFF);
+        auto wide = printable & (zero >> 1) & 0x5555;
+        if(wideStop == none && (~wide & 0x5555))
+            wideStop = i + lowestbit(~wide & 0x5555);
     }
 
-    if(len < 2 || len + 1 >= maxlen)
-        return false;
-    for(int i = 0; i < len * 2; i += 2)
+    if(asciiStop < size && !data[asciiStop])
     {
-        if(data[i + 1]) //Extended ASCII only
-            return false;
-        if(!isprint(data[i]) && !isspace(data[i]))
-            return false;
+        if(asciiStop >= 2 && asciiStop <= duint(maxlen))
+        {
+            if(length)
+                *length = int(asciiStop);
+            return enc_ascii;
+        }
+    }
+    else if(utf8Stop < size && !data[utf8Stop] && utf8Stop >= 2 && utf8Stop <= duint(maxlen) && isutf8string(data, utf8Stop))
+    {
+        if(length)
+            *length = int(utf8Stop);
+        return enc_utf8;
+    }
+
+    // A single ASCII character can still be the start of an UTF-16 string
+    if(wideStop + 1 < size && !data[wideStop] && !data[wideStop + 1] && wideStop / 2 >= 2 && wideStop / 2 <= duint(maxlen))
+    {
+        if(length)
+            *length = int(wideStop / 2);
+        return enc_utf16le;
+    }
+    return enc_none;
+}
+
+void disasmclassifystrings(const unsigned char* data, duint base, duint size, const duint* addrs, size_t count, int maxlen, STRINGCLASS* results)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        auto offset = addrs[i] - base;
+        results[i].length = 0;
+        results[i].encoding = offset < size ? disasmclassifystring(data + offset, size - offset, maxlen, &results[i].length) : enc_none;
     }
-    return true;
 }
 
 bool disasmispossiblestring(duint addr)
 {
-    unsigned char data[11];
+    unsigned char data[16];
     memset(data, 0, sizeof(data));
-    if(!MemReadUnsafe(addr, data, sizeof(data) - 3))
+    if(!MemReadUnsafe(addr, data, 8))
         return false;
-    duint test = 0;
-    memcpy(&test, data, sizeof(duint));
-    if(isasciistring(data, sizeof(data)) || isunicodestring(data, _countof(data)))
-        return true;
-    return false;
+    auto encoding = disasmclassifystring(data, sizeof(data), 8, nullptr);
+    return encoding == enc_ascii || encoding == enc_utf16le;
 }
 
 bool disasmgetstringat(duint addr, STRING_TYPE* type, char* ascii, char* unicode, int maxlen)
@@ -307,37 +410,33 @@ bool disasmgetstringat(duint addr, STRING_TYPE* type, char* ascii, char* unicode
     auto asciiData = (char*)data();
     auto unicodeData = (wchar_t*)data();
 
-    // First check if this was an ASCII only string
-    if(isasciistring(data(), maxlen))
+    // UTF-8 strings are not reported, the escaping would turn every multibyte sequence into \x escapes
+    int length;
+    auto encoding = disasmclassifystring(data(), (maxlen + 1) * 2, maxlen - 2, &length);
+    if(encoding == enc_ascii)
     {
         if(type)
             *type = str_ascii;
 
         // Escape the string
-        String escaped = StringUtils::Escape(asciiData);
+        String escaped = StringUtils::Escape(String(asciiData, length));
 
         // Copy data back to outgoing parameter
         strncpy_s(ascii, min(int(escaped.length()) + 1, maxlen), escaped.c_str(), _TRUNCATE);
         return true;
     }
 
-    if(isunicodestring(data(), maxlen))
+    if(encoding == enc_utf16le)
     {
         if(type)
             *type = str_unicode;
 
-        // Determine string length only once, limited to output buffer size
-        int unicodeLength = min(int(wcslen(unicodeData)), maxlen);
-
         // Truncate each wchar_t to char
-        for(int i = 0; i < unicodeLength; i++)
+        for(int i = 0; i < length; i++)
             asciiData[i] = char(unicodeData[i] & 0xFF);
 
-        // Fix the null terminator (data len = maxlen + 1)
-        asciiData[unicodeLength] = '\0';
-
         // Escape the string
-        String escaped = StringUtils::Escape(asciiData);
+        String escaped = StringUtils::Escape(String(asciiData, length));
 
         // Copy data back to outgoing parameter
         strncpy_s(unicode, min(int(escaped.length()) + 1, maxlen), escaped.c_str(), _TRUNCATE);
@@ -347,6 +446,84 @@ bool disasmgetstringat(duint addr, STRING_TYPE* type, char* ascii, char* unicode
     return false;
 }
 
+void disasmgetstringsat(const duint* addrs, size_t count, int maxlen, STRING_TYPE* types, String* strings, duint* values)
+{
+    std::vector<size_t> order;
+    order.reserve(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        types[i] = str_none;
+        strings[i].clear();
+        if(values)
+            values[i] = 0;
+        if(MemIsValidReadPtr(addrs[i], true))
+            order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [addrs](size_t a, size_t b)
+    {
+        return addrs[a] < addrs[b];
+    });
+
+    // The addresses whose strings would overlap or lie close together are classified in one read, the pages that
+    // cannot be read stay zero and end the strings
+    auto span = duint(maxlen + 1) * 2;
+    std::vector<unsigned char> data;
+    std::vector<duint> batch;
+    std::vector<STRINGCLASS> results;
+    for(size_t first = 0; first < order.size();)
+    {
+        auto start = addrs[order[first]];
+        auto end = start + span;
+        auto last = first + 1;
+        for(; last < order.size(); last++)
+        {
+            auto next = addrs[order[last]];
+            if(next > end + PAGE_SIZE || next + span - start > STRING_BATCH_SIZE)
+                break;
+            end = max(end, next + span);
+        }
+        data.assign(size_t(end - start), 0);
+        MemRead(start, data.data(), end - start);
+
+        batch.clear();
+        for(auto i = first; i < last; i++)
+            batch.push_back(addrs[order[i]]);
+        results.resize(batch.size());
+        disasmclassifystrings(data.data(), start, end - start, batch.data(), batch.size(), maxlen - 2, results.data());
+        for(auto i = first; i < last; i++)
+        {
+            auto index = order[i];
+            auto text = data.data() + (addrs[index] - start);
+            if(values)
+                memcpy(&values[index], text, sizeof(duint));
+            const auto & result = results[i - first];
+            String string;
+            if(result.encoding == enc_ascii)
+            {
+                types[index] = str_ascii;
+                string.assign((const char*)text, result.length);
+            }
+            else if(result.encoding == enc_utf16le)
+            {
+                types[index] = str_unicode;
+
+                // Truncate each wchar_t to char
+                string.reserve(result.length);
+                for(int j = 0; j < result.length; j++)
+                    string.push_back(char(text[j * 2]));
+            }
+            else
+                continue;
+
+            // Same truncation as disasmgetstringat
+            strings[index] = StringUtils::Escape(string);
+            if(strings[index].length() >= size_t(maxlen))
+                strings[index].resize(maxlen - 1);
+        }
+        first = last;
+    }
+}
+
 int disasmgetsize(duint addr, unsigned char* data)
 {
     Capstone cp;
@@ -3,6 +3,20 @@
 
 #include "_global.h"
 
+typedef enum
+{
+    enc_none,
+    enc_ascii,
+    enc_utf16le,
+    enc_utf8
+} STRING_ENCODING;
+
+struct STRINGCLASS
+{
+    STRING_ENCODING encoding;
+    int length; //code units before the terminator
+};
+
 //functions
 duint disasmback(unsigned char* data, duint base, duint size, duint ip, int n);
 duint disasmnext(unsigned char* data, duint base, duint size, duint ip, int n);
@@ -10,8 +24,15 @@ const char* disasmtext(duint addr);
 void disasmprint(duint addr);
 void disasmget(unsigned char* buffer, duint addr, DISASM_INSTR* instr);
 void disasmget(duint addr, DISASM_INSTR* instr);
+//classifies the string at the start of data (at least 2 and at most maxlen code units followed by a terminator)
+STRING_ENCODING disasmclassifystring(const unsigned char* data, duint size, int maxlen, int* length);
+//classifies the strings at addrs that lie in a snapshot of [base, base + size)
+void disasmclassifystrings(const unsigned char* data, duint base, duint size, const duint* addrs, size_t count, int maxlen, STRINGCLASS* results);
 bool disasmispossiblestring(duint addr);
 bool disasmgetstringat(duint addr, STRING_TYPE* type, char* ascii, char* unicode, int maxlen);
+//gets the (escaped) strings at addrs like disasmgetstringat, nearby addresses share a single read of the memory
+//values receives the pointer at every address (optional, zero when it cannot be read)
+void disasmgetstringsat(const duint* addrs, size_t count, int maxlen, STRING_TYPE* types, String* strings, duint* values);
 int disasmgetsize(duint addr, unsigned char* data);
 int disasmgetsize(duint addr);
 
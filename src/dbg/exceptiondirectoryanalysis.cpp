@@ -83,9 +83,17 @@ void ExceptionDirectoryAnalysis::Analyse()
 
 void ExceptionDirectoryAnalysis::SetMarkers()
 {
-    FunctionDelRange(mBase, mBase + mSize - 1, false);
+    std::vector<FUNCTIONRANGE> functions;
+    functions.reserve(mFunctions.size());
     for(const auto & function : mFunctions)
-        FunctionAdd(function.first, function.second, false);
+    {
+        FUNCTIONRANGE range;
+        range.start = function.first;
+        range.end = function.second;
+        range.instructioncount = 0;
+        functions.push_back(range);
+    }
+    FunctionReplaceRange(mBase, mBase + mSize - 1, functions);
 }
 
 #ifdef _WIN64
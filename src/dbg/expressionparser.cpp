@@ -5,6 +5,23 @@ ExpressionParser::Token::Token(const String & data, const Type type)
 {
     mData = data;
     mType = type;
+    mValueType = VAL_NAME;
+    mNumber = 0;
+    if(mType == Type::Data)
+    {
+        //decide what kind of data this is only once
+        mValueType = valtypefromstring(mData.c_str());
+        if(isNumber())
+            valfromstring_type(mValueType, mData.c_str(), &mNumber);
+    }
+}
+
+ExpressionParser::Token::Token(duint number)
+{
+    mData = StringUtils::sprintf("%" fext "X", number);
+    mType = Type::Data;
+    mValueType = VAL_HEXNUMBER;
+    mNumber = number;
 }
 
 const String & ExpressionParser::Token::data() const
@@ -17,6 +34,16 @@ ExpressionParser::Token::Type ExpressionParser::Token::type() const
     return mType;
 }
 
+VALTYPE ExpressionParser::Token::valueType() const
+{
+    return mValueType;
+}
+
+duint ExpressionParser::Token::number() const
+{
+    return mNumber;
+}
+
 ExpressionParser::Token::Associativity ExpressionParser::Token::associativity() const
 {
     switch(mType)
@@ -94,17 +121,60 @@ int ExpressionParser::Token::precedence() const
     }
 }
 
+int ExpressionParser::Token::operandCount() const
+{
+    switch(mType)
+    {
+    case Type::OperatorUnarySub:
+    case Type::OperatorNot:
+    case Type::OperatorLogicalNot:
+        return 1;
+    case Type::OperatorMul:
+    case Type::OperatorHiMul:
+    case Type::OperatorDiv:
+    case Type::OperatorMod:
+    case Type::OperatorAdd:
+    case Type::OperatorSub:
+    case Type::OperatorShl:
+    case Type::OperatorShr:
+    case Type::OperatorAnd:
+    case Type::OperatorXor:
+    case Type::OperatorOr:
+    case Type::OperatorEqual:
+    case Type::OperatorNotEqual:
+    case Type::OperatorBigger:
+    case Type::OperatorSmaller:
+    case Type::OperatorBiggerEqual:
+    case Type::OperatorSmallerEqual:
+    case Type::OperatorLogicalAnd:
+    case Type::OperatorLogicalOr:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
 bool ExpressionParser::Token::isOperator() const
 {
     return mType != Type::Data && mType != Type::OpenBracket && mType != Type::CloseBracket;
 }
 
+bool ExpressionParser::Token::isNumber() const
+{
+    return mType == Type::Data && (mValueType == VAL_DECNUMBER || mValueType == VAL_HEXNUMBER);
+}
+
 ExpressionParser::ExpressionParser(const String & expression)
     : mExpression(fixClosingBrackets(expression)),
       mIsValidExpression(true)
 {
     tokenize();
     shuntingYard();
+    if(mIsValidExpression)
+    {
+        mSignedPrefixTokens = foldConstants(true);
+        mPrefixTokens = foldConstants(false);
+    }
 }
 
 String ExpressionParser::fixClosingBrackets(const String & expression)
@@ -493,14 +563,56 @@ bool ExpressionParser::signedOperation(const Token::Type type, const dsint op1,
     return true;
 }
 
+std::vector<ExpressionParser::Token> ExpressionParser::foldConstants(bool signedcalc) const
+{
+    //replace operations that only have numbers as operands by their result
+    std::vector<Token> result;
+    std::vector<bool> constant; //for every value on the calculation stack, whether it is a single number token at the end of result
+    result.reserve(mPrefixTokens.size());
+    for(const auto & token : mPrefixTokens)
+    {
+        if(!token.isOperator())
+        {
+            result.push_back(token);
+            constant.push_back(token.isNumber());
+            continue;
+        }
+        size_t operands = token.operandCount();
+        if(!operands || constant.size() < operands) //invalid expression, Calculate will fail on it
+            return mPrefixTokens;
+        bool fold = true;
+        for(size_t i = constant.size() - operands; i < constant.size(); i++)
+            fold = fold && constant[i];
+        constant.resize(constant.size() - operands);
+        constant.push_back(fold);
+        if(!fold)
+        {
+            result.push_back(token);
+            continue;
+        }
+        duint op1 = result[result.size() - operands].number();
+        duint op2 = operands == 2 ? result.back().number() : 0;
+        duint value = 0;
+        if(signedcalc)
+            signedOperation(token.type(), op1, op2, value);
+        else
+            unsignedOperation(token.type(), op1, op2, value);
+        result.resize(result.size() - operands);
+        result.push_back(Token(value));
+    }
+    return result;
+}
+
 bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly) const
 {
     value = 0;
-    if(!mPrefixTokens.size() || !mIsValidExpression)
+    const auto & prefixTokens = signedcalc ? mSignedPrefixTokens : mPrefixTokens;
+    if(!prefixTokens.size() || !mIsValidExpression)
         return false;
-    std::stack<duint> stack;
+    std::vector<duint> stack;
+    stack.reserve(prefixTokens.size());
     //calculate the result from the RPN queue
-    for(const auto & token : mPrefixTokens)
+    for(const auto & token : prefixTokens)
     {
         if(token.isOperator())
         {
@@ -514,13 +626,13 @@ bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool silent, bo
             case Token::Type::OperatorLogicalNot:
                 if(stack.size() < 1)
                     return false;
-                op1 = stack.top();
-                stack.pop();
+                op1 = stack.back();
+                stack.pop_back();
                 if(signedcalc)
                     signedOperation(token.type(), op1, op2, result);
                 else
                     unsignedOperation(token.type(), op1, op2, result);
-                stack.push(result);
+                stack.push_back(result);
                 break;
             case Token::Type::OperatorMul:
             case Token::Type::OperatorHiMul:
@@ -543,15 +655,15 @@ bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool silent, bo
             case Token::Type::OperatorLogicalOr:
                 if(stack.size() < 2)
                     return false;
-                op2 = stack.top();
-                stack.pop();
-                op1 = stack.top();
-                stack.pop();
+                op2 = stack.back();
+                stack.pop_back();
+                op1 = stack.back();
+                stack.pop_back();
                 if(signedcalc)
                     signedOperation(token.type(), op1, op2, result);
                 else
                     unsignedOperation(token.type(), op1, op2, result);
-                stack.push(result);
+                stack.push_back(result);
                 break;
             case Token::Type::Error:
                 return false;
@@ -562,13 +674,21 @@ bool ExpressionParser::Calculate(duint & value, bool signedcalc, bool silent, bo
         else
         {
             duint result;
-            if(!valfromstring_noexpr(token.data().c_str(), &result, silent, baseonly, value_size, isvar, hexonly))
+            if(token.isNumber())  //numbers are parsed with the expression
+            {
+                result = token.number();
+                if(value_size)
+                    *value_size = 0;
+                if(isvar)
+                    *isvar = false;
+            }
+            else if(!valfromstring_type(token.valueType(), token.data().c_str(), &result, silent, baseonly, value_size, isvar, hexonly))
                 return false;
-            stack.push(result);
+            stack.push_back(result);
         }
     }
     if(stack.empty())  //empty result stack means error
         return false;
-    value = stack.top();
+    value = stack.back();
     return true;
 }
@@ -2,6 +2,7 @@
 #define _EXPRESSION_PARSER_H
 
 #include "_global.h"
+#include "value.h"
 
 class ExpressionParser
 {
@@ -60,15 +61,22 @@ public:
         };
 
         Token(const String & data, const Type type);
+        explicit Token(duint number);
         const String & data() const;
         Type type() const;
+        VALTYPE valueType() const;
+        duint number() const;
         Associativity associativity() const;
         int precedence() const;
+        int operandCount() const;
         bool isOperator() const;
+        bool isNumber() const;
 
     private:
         String mData;
         Type mType;
+        VALTYPE mValueType;
+        duint mNumber;
     };
 
 private:
@@ -76,6 +84,7 @@ private:
     bool isUnaryOperator() const;
     void tokenize();
     void shuntingYard();
+    std::vector<Token> foldConstants(bool signedcalc) const;
     void addOperatorToken(const char ch, const Token::Type type);
     bool unsignedOperation(const Token::Type type, const duint op1, const duint op2, duint & result) const;
     bool signedOperation(const Token::Type type, const dsint op1, const dsint op2, duint & result) const;
@@ -84,6 +93,7 @@ private:
     bool mIsValidExpression;
     std::vector<Token> mTokens;
     std::vector<Token> mPrefixTokens;
+    std::vector<Token> mSignedPrefixTokens;
     String mCurToken;
 };
 
@@ -2,6 +2,7 @@
 #include "module.h"
 #include "memory.h"
 #include "threading.h"
+#include "intervalindex.h"
 
 struct FunctionSerializer : JSONWrapper<FUNCTIONSINFO>
 {
@@ -51,6 +52,62 @@ protected:
 
 static Functions functions;
 
+// Flat interval index per module hash (RVA ranges), rebuilt when the functions changed
+static std::unordered_map<duint, IntervalIndex<const FUNCTIONSINFO*>> functionsIndex;
+static duint functionsIndexGeneration = ~0;
+
+static bool functionIndexIsStale()
+{
+    return functionsIndexGeneration != functions.GetGenerationUnsafe();
+}
+
+static void functionIndexUpdate()
+{
+    // Unsynchronized check first, the disassembly asks for every visible row
+    if(!functionIndexIsStale())
+        return;
+
+    EXCLUSIVE_ACQUIRE(LockFunctions);
+    if(!functionIndexIsStale())
+        return;
+
+    functionsIndex.clear();
+    for(const auto & itr : functions.GetDataUnsafe())
+        functionsIndex[itr.first.first].Add(itr.first.second.first, itr.first.second.second, &itr.second);
+    for(auto & itr : functionsIndex)
+        itr.second.Build();
+    functionsIndexGeneration = functions.GetGenerationUnsafe();
+}
+
+// Looks up the first function overlapping [Start, End] (virtual addresses in the module of Start)
+static bool functionFind(duint Start, duint End, FUNCTIONSINFO* Info, duint* ModuleBase)
+{
+    auto moduleBase = ModBaseFromAddr(Start);
+    auto key = ModHashFromAddr(moduleBase);
+    while(true)
+    {
+        functionIndexUpdate();
+
+        SHARED_ACQUIRE(LockFunctions);
+
+        // Functions changed after the update, do it again
+        if(functionIndexIsStale())
+            continue;
+
+        auto index = functionsIndex.find(key);
+        if(index == functionsIndex.end())
+            return false;
+        auto found = index->second.Find(Start - moduleBase, End - moduleBase);
+        if(!found)
+            return false;
+        if(Info)
+            *Info = *found->value;
+        if(ModuleBase)
+            *ModuleBase = moduleBase;
+        return true;
+    }
+}
+
 bool FunctionAdd(duint Start, duint End, bool Manual, duint InstructionCount)
 {
     // Make sure memory is readable
@@ -63,8 +120,8 @@ bool FunctionAdd(duint Start, duint End, bool Manual, duint InstructionCount)
     if(moduleBase != ModBaseFromAddr(End))
         return false;
 
-    // Fail if 'Start' and 'End' are incompatible
-    if(Start > End || FunctionOverlaps(Start, End))
+    // Fail if 'Start' and 'End' are incompatible, the map is used directly to not rebuild the index for every function
+    if(Start > End || functions.Contains(Functions::VaKey(Start, End)))
         return false;
 
     FUNCTIONSINFO function;
@@ -81,13 +138,13 @@ bool FunctionAdd(duint Start, duint End, bool Manual, duint InstructionCount)
 bool FunctionGet(duint Address, duint* Start, duint* End, duint* InstrCount)
 {
     FUNCTIONSINFO function;
-    if(!functions.Get(Functions::VaKey(Address, Address), function))
+    duint moduleBase;
+    if(!functionFind(Address, Address, &function, &moduleBase))
         return false;
-    functions.AdjustValue(function);
     if(Start)
-        *Start = function.start;
+        *Start = function.start + moduleBase;
     if(End)
-        *End = function.end;
+        *End = function.end + moduleBase;
     if(InstrCount)
         *InstrCount = function.instructioncount;
     return true;
@@ -98,7 +155,7 @@ bool FunctionOverlaps(duint Start, duint End)
     // A function can't end before it begins
     if(Start > End)
         return false;
-    return functions.Contains(Functions::VaKey(Start, End));
+    return functionFind(Start, End, nullptr, nullptr);
 }
 
 bool FunctionDelete(duint Address)
@@ -135,6 +192,49 @@ void FunctionDelRange(duint Start, duint End, bool DeleteManual)
     }
 }
 
+void FunctionReplaceRange(duint Start, duint End, const std::vector<FUNCTIONRANGE> & Functions)
+{
+    // The start and end address must be in the same module
+    auto moduleBase = ModBaseFromAddr(Start);
+
+    if(moduleBase != ModBaseFromAddr(End))
+        return;
+
+    FUNCTIONSINFO function;
+    if(!ModNameFromAddr(Start, function.mod, true))
+        *function.mod = '\0';
+    function.manual = false;
+
+    // Same checks as FunctionAdd, overlapping functions are rejected when they are inserted
+    std::vector<FUNCTIONSINFO> list;
+    list.reserve(Functions.size());
+    for(const auto & range : Functions)
+    {
+        if(range.start > range.end || ModBaseFromAddr(range.start) != moduleBase || ModBaseFromAddr(range.end) != moduleBase)
+            continue;
+        if(!MemIsValidReadPtr(range.start))
+            continue;
+        function.start = range.start - moduleBase;
+        function.end = range.end - moduleBase;
+        function.instructioncount = range.instructioncount;
+        list.push_back(function);
+    }
+
+    // Convert these to a relative offset
+    Start -= moduleBase;
+    End -= moduleBase;
+
+    functions.ReplaceWhere([ = ](const FUNCTIONSINFO & value)
+    {
+        if(value.manual)
+            return false;
+        return value.end >= Start && value.start <= End;
+    }, list, [](const FUNCTIONSINFO & a, const FUNCTIONSINFO & b)
+    {
+        return a.start == b.start && a.end == b.end && a.instructioncount == b.instructioncount && a.manual == b.manual;
+    });
+}
+
 void FunctionCacheSave(JSON Root)
 {
     functions.CacheSave(Root);
@@ -163,5 +263,5 @@ void FunctionGetList(std::vector<FUNCTIONSINFO> & list)
 
 bool FunctionGetInfo(duint Address, FUNCTIONSINFO & info)
 {
-    return functions.Get(Functions::VaKey(Address, Address), info);
+    return functionFind(Address, Address, &info, nullptr);
 }
@@ -12,11 +12,19 @@ struct FUNCTIONSINFO
     duint instructioncount;
 };
 
+struct FUNCTIONRANGE
+{
+    duint start;
+    duint end;
+    duint instructioncount;
+};
+
 bool FunctionAdd(duint Start, duint End, bool Manual, duint InstructionCount = 0);
 bool FunctionGet(duint Address, duint* Start = nullptr, duint* End = nullptr, duint* InstrCount = nullptr);
 bool FunctionOverlaps(duint Start, duint End);
 bool FunctionDelete(duint Address);
 void FunctionDelRange(duint Start, duint End, bool DeleteManual = false);
+void FunctionReplaceRange(duint Start, duint End, const std::vector<FUNCTIONRANGE> & Functions);
 void FunctionCacheSave(JSON Root);
 void FunctionCacheLoad(JSON Root);
 bool FunctionEnum(FUNCTIONSINFO* List, size_t* Size);
@@ -0,0 +1,189 @@
+/**
+ @file imageview.cpp
+
+ @brief Implements local copies of debuggee memory backed by module image mappings.
+ */
+
+#include "imageview.h"
+#include "memory.h"
+#include "module.h"
+#include "debugger.h"
+#include "handle.h"
+
+// Shared bit of PSAPI_WORKING_SET_EX_BLOCK, at the same position for valid and invalid pages
+#define WORKING_SET_SHARED (ULONG_PTR(1) << 15)
+
+typedef BOOL(WINAPI* QUERYWORKINGSETEX)(HANDLE hProcess, PVOID pv, DWORD cb);
+
+ImageView::ImageView()
+{
+    mView = nullptr;
+    mData = nullptr;
+    mSize = 0;
+    mRemotePages = 0;
+}
+
+ImageView::~ImageView()
+{
+    release();
+}
+
+bool ImageView::Read(duint Base, duint Size)
+{
+    release();
+    mSize = Size;
+    mRemotePages = 0;
+
+    auto modBase = ModBaseFromAddr(Base);
+    auto modSize = modBase ? ModSizeFromAddr(modBase) : 0;
+    if(modBase && Base + Size <= modBase + modSize && mapModule(modBase, modSize))
+    {
+        mData = mView + (Base - modBase);
+        return readChangedPages(modBase, Base, Size);
+    }
+
+    mBuffer.resize(Size);
+    mData = mBuffer.data();
+    mRemotePages = (Size + PAGE_SIZE - 1) / PAGE_SIZE;
+    return MemRead(Base, mData, Size);
+}
+
+bool ImageView::mapModule(duint ModBase, duint ModSize)
+{
+    char modPath[MAX_PATH] = "";
+    if(!ModPathFromAddr(ModBase, modPath, MAX_PATH))
+        return false;
+    Handle hFile = CreateFileW(StringUtils::Utf8ToUtf16(modPath).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return false;
+    Handle hSection = CreateFileMappingW(hFile, nullptr, PAGE_READONLY | SEC_IMAGE, 0, 0, nullptr);
+    if(!hSection)
+        return false;
+    mView = (unsigned char*)MapViewOfFile(hSection, FILE_MAP_COPY, 0, 0, 0);
+    if(!mView)
+        return false;
+
+    // The file on disk has to be the one the module was loaded from
+    auto dosHeader = PIMAGE_DOS_HEADER(mView);
+    auto ntHeaders = PIMAGE_NT_HEADERS(mView + dosHeader->e_lfanew);
+    IMAGE_DOS_HEADER remoteDosHeader;
+    IMAGE_NT_HEADERS remoteNtHeaders;
+    if(!MemRead(ModBase, &remoteDosHeader, sizeof(remoteDosHeader)) ||
+            remoteDosHeader.e_lfanew != dosHeader->e_lfanew ||
+            !MemRead(ModBase + remoteDosHeader.e_lfanew, &remoteNtHeaders, sizeof(remoteNtHeaders)) ||
+            remoteNtHeaders.FileHeader.TimeDateStamp != ntHeaders->FileHeader.TimeDateStamp ||
+            remoteNtHeaders.OptionalHeader.CheckSum != ntHeaders->OptionalHeader.CheckSum ||
+            remoteNtHeaders.OptionalHeader.SizeOfImage != ntHeaders->OptionalHeader.SizeOfImage ||
+            ntHeaders->OptionalHeader.SizeOfImage < ModSize)
+    {
+        release();
+        return false;
+    }
+
+    // Sections without read access (common in packed images) would fault when the view is read, the whole view has
+    // to be readable before anything looks at it
+    if(!makeWritable(mView, duint(ntHeaders->OptionalHeader.SizeOfImage)))
+    {
+        release();
+        return false;
+    }
+
+    // The header has the base the section was relocated to, usually the one the debuggee has it at as well
+    auto delta = ModBase - duint(ntHeaders->OptionalHeader.ImageBase);
+    if(delta)
+        relocate(ModSize, delta);
+    return true;
+}
+
+void ImageView::relocate(duint ModSize, duint Delta)
+{
+    auto ntHeaders = PIMAGE_NT_HEADERS(mView + PIMAGE_DOS_HEADER(mView)->e_lfanew);
+    const auto & directory = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    duint offset = directory.VirtualAddress;
+    duint end = offset + directory.Size;
+    if(!offset || end > ModSize)
+        return;
+    while(offset + sizeof(IMAGE_BASE_RELOCATION) <= end)
+    {
+        auto block = PIMAGE_BASE_RELOCATION(mView + offset);
+        if(block->SizeOfBlock < sizeof(IMAGE_BASE_RELOCATION) || offset + block->SizeOfBlock > end)
+            break;
+        auto page = duint(block->VirtualAddress);
+        if(page >= ModSize)
+        {
+            offset += block->SizeOfBlock;
+            continue;
+        }
+        auto entries = (const WORD*)(block + 1);
+        auto count = (block->SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) / sizeof(WORD);
+        for(duint i = 0; i < count; i++)
+        {
+            duint fixup = page + (entries[i] & 0xFFF);
+            switch(entries[i] >> 12)
+            {
+            case IMAGE_REL_BASED_HIGHLOW:
+                if(fixup + sizeof(DWORD) <= ModSize)
+                    *(DWORD*)(mView + fixup) += DWORD(Delta);
+                break;
+#ifdef _WIN64
+            case IMAGE_REL_BASED_DIR64:
+                if(fixup + sizeof(ULONGLONG) <= ModSize)
+                    *(ULONGLONG*)(mView + fixup) += ULONGLONG(Delta);
+                break;
+#endif //_WIN64
+            }
+        }
+        offset += block->SizeOfBlock;
+    }
+}
+
+bool ImageView::readChangedPages(duint ModBase, duint Start, duint Size)
+{
+    // Pages that are still shared with the file were never written by the debuggee (writing makes a private copy)
+    static auto queryWorkingSetEx = (QUERYWORKINGSETEX)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "K32QueryWorkingSetEx");
+    auto firstPage = Start & ~duint(PAGE_SIZE - 1);
+    auto pageCount = (Start + Size - firstPage + PAGE_SIZE - 1) / PAGE_SIZE;
+    std::vector<PSAPI_WORKING_SET_EX_INFORMATION> pages(pageCount);
+    for(duint i = 0; i < pageCount; i++)
+        pages[i].VirtualAddress = PVOID(firstPage + i * PAGE_SIZE);
+    bool shared = queryWorkingSetEx && queryWorkingSetEx(fdProcessInfo->hProcess, pages.data(), DWORD(pages.size() * sizeof(pages[0])));
+
+    // Only the pages whose contents actually differ stop sharing the mapping here
+    unsigned char remote[PAGE_SIZE];
+    auto result = true;
+    for(duint i = 0; i < pageCount; i++)
+    {
+        if(shared && (pages[i].VirtualAttributes.Flags & WORKING_SET_SHARED))
+            continue;
+        auto address = firstPage + i * PAGE_SIZE;
+        auto local = mView + (address - ModBase);
+        mRemotePages++;
+        if(!MemRead(address, remote, PAGE_SIZE))
+        {
+            // The file's bytes are not what the debuggee has there (decommitted or guarded), fail like a copy would
+            memset(local, 0, PAGE_SIZE);
+            result = false;
+            continue;
+        }
+        if(memcmp(local, remote, PAGE_SIZE))
+            memcpy(local, remote, PAGE_SIZE);
+    }
+    return result;
+}
+
+bool ImageView::makeWritable(unsigned char* Address, duint Size)
+{
+    // Image mappings are copy-on-write, the pages that are written become private to the debugger and the others
+    // stay shared with the file
+    DWORD oldProtect;
+    return !!VirtualProtect(Address, Size, PAGE_WRITECOPY, &oldProtect);
+}
+
+void ImageView::release()
+{
+    if(mView)
+        UnmapViewOfFile(mView);
+    mView = nullptr;
+    mBuffer.clear();
+    mData = nullptr;
+}
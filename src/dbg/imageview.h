@@ -0,0 +1,48 @@
+#ifndef _IMAGEVIEW_H
+#define _IMAGEVIEW_H
+
+#include "_global.h"
+
+// Local copy of a range of the debuggee. When the range lies in a module, the pages the debuggee did not write to
+// are served from an image mapping of the module file (rebased to the module base) instead of being copied, only
+// the pages that differ are read from the debuggee.
+class ImageView
+{
+public:
+    ImageView();
+    ImageView(const ImageView & that) = delete;
+    ~ImageView();
+
+    bool Read(duint Base, duint Size);
+
+    unsigned char* Data() const
+    {
+        return mData;
+    }
+
+    duint Size() const
+    {
+        return mSize;
+    }
+
+    // Number of pages that were read from the debuggee
+    duint RemotePages() const
+    {
+        return mRemotePages;
+    }
+
+private:
+    unsigned char* mView;
+    std::vector<unsigned char> mBuffer; // the range is not in a module
+    unsigned char* mData;
+    duint mSize;
+    duint mRemotePages;
+
+    bool mapModule(duint ModBase, duint ModSize);
+    void relocate(duint ModSize, duint Delta);
+    bool readChangedPages(duint ModBase, duint Start, duint Size);
+    bool makeWritable(unsigned char* Address, duint Size);
+    void release();
+};
+
+#endif // _IMAGEVIEW_H
@@ -37,6 +37,15 @@
 #include "error.h"
 #include "recursiveanalysis.h"
 #include "xrefsanalysis.h"
+#include "jobs.h"
+#include "stringscan.h"
+#include "yararules.h"
+#include "mementropy.h"
+#include "memsnapshot.h"
+#include "imageview.h"
+#include <ppl.h>
+#include <atomic>
+#include <thread>
 
 static bool bRefinit = false;
 static int maxFindResults = 5000;
@@ -845,11 +854,11 @@ static bool cbRefFind(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFIN
 {
     if(!disasm || !basicinfo)  //initialize
     {
-        GuiReferenceInitialize(refinfo->name);
-        GuiReferenceAddColumn(2 * sizeof(duint), "Address");
-        GuiReferenceAddColumn(0, "Disassembly");
-        GuiReferenceSetRowCount(0);
-        GuiReferenceReloadData();
+        JobRefInitialize(refinfo->job, refinfo->name);
+        JobRefAddColumn(refinfo->job, 2 * sizeof(duint), "Address");
+        JobRefAddColumn(refinfo->job, 0, "Disassembly");
+        JobRefSetRowCount(refinfo->job, 0);
+        JobRefReloadData(refinfo->job);
         return true;
     }
     bool found = false;
@@ -878,13 +887,8 @@ static bool cbRefFind(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFIN
     {
         char addrText[20] = "";
         sprintf(addrText, "%p", disasm->Address());
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-        else
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
+        RefSetCellContent(refinfo, 0, addrText);
+        RefSetCellContent(refinfo, 1, disasm->InstructionText().c_str());
     }
     return found;
 }
@@ -937,50 +941,52 @@ CMDRESULT cbInstrRefFindRange(int argc, char* argv[])
         if(refFindType != CURRENT_REGION && refFindType != CURRENT_MODULE && refFindType != ALL_MODULES)
             refFindType = CURRENT_REGION;
 
-    int found = RefFind(addr, size, cbRefFind, &range, false, title, (REFFINDTYPE)refFindType, false);
-    dprintf("%u reference(s) in %ums\n", found, GetTickCount() - ticks);
-    varset("$result", found, false);
-    return STATUS_CONTINUE;
+    bool started = JobStart(title, [ = ](unsigned int job)
+    {
+        VALUERANGE jobRange = range;
+        int found = RefFind(addr, size, cbRefFind, &jobRange, false, title, (REFFINDTYPE)refFindType, false, job);
+        dprintf("%u reference(s) in %ums\n", found, GetTickCount() - ticks);
+        JobSetResult(job, found);
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
 }
 
 bool cbRefStr(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 {
     if(!disasm || !basicinfo)  //initialize
     {
-        GuiReferenceInitialize(refinfo->name);
-        GuiReferenceAddColumn(2 * sizeof(duint), "Address");
-        GuiReferenceAddColumn(64, "Disassembly");
-        GuiReferenceAddColumn(500, "String");
-        GuiReferenceSetSearchStartCol(2); //only search the strings
-        GuiReferenceReloadData();
+        JobRefInitialize(refinfo->job, refinfo->name);
+        JobRefAddColumn(refinfo->job, 2 * sizeof(duint), "Address");
+        JobRefAddColumn(refinfo->job, 64, "Disassembly");
+        JobRefAddColumn(refinfo->job, 500, "String");
+        JobRefSetSearchStartCol(refinfo->job, 2); //only search the strings
+        JobRefReloadData(refinfo->job);
         return true;
     }
     bool found = false;
     char string[MAX_STRING_SIZE] = "";
     if(basicinfo->branch)  //branches have no strings (jmp dword [401000])
         return false;
+    // The strings are looked up in module snapshots instead of reading the debuggee for every operand
+    auto strings = (StringTableCache*)refinfo->userinfo;
     if((basicinfo->type & TYPE_VALUE) == TYPE_VALUE)
     {
-        if(DbgGetStringAt(basicinfo->value.value, string))
+        if(strings->GetStringAt(basicinfo->value.value, string))
             found = true;
     }
     if((basicinfo->type & TYPE_MEMORY) == TYPE_MEMORY)
     {
-        if(DbgGetStringAt(basicinfo->memory.value, string))
+        if(strings->GetStringAt(basicinfo->memory.value, string))
             found = true;
     }
     if(found)
     {
         char addrText[20] = "";
         sprintf(addrText, fhex, disasm->Address());
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[4096] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-        else
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
-        GuiReferenceSetCellContent(refinfo->refcount, 2, string);
+        RefSetCellContent(refinfo, 0, addrText);
+        RefSetCellContent(refinfo, 1, disasm->InstructionText().c_str());
+        RefSetCellContent(refinfo, 2, string);
     }
     return found;
 }
@@ -1002,11 +1008,25 @@ CMDRESULT cbInstrRefStr(int argc, char* argv[])
         if(refFindType != CURRENT_REGION && refFindType != CURRENT_MODULE && refFindType != ALL_MODULES)
             refFindType = CURRENT_REGION;
 
+    // Every module of the search keeps its string table until the search is done
+    size_t modules = 1;
+    if(refFindType == ALL_MODULES)
+    {
+        std::vector<MODINFO> modList;
+        ModGetList(modList);
+        modules = modList.size();
+    }
+
     duint ticks = GetTickCount();
-    int found = RefFind(addr, size, cbRefStr, 0, false, "Strings", (REFFINDTYPE)refFindType, false);
-    dprintf("%u string(s) in %ums\n", found, GetTickCount() - ticks);
-    varset("$result", found, false);
-    return STATUS_CONTINUE;
+    bool started = JobStart("Strings", [ = ](unsigned int job)
+    {
+        StringTableCache strings(modules);
+        int found = RefFind(addr, size, cbRefStr, &strings, false, "Strings", (REFFINDTYPE)refFindType, false, job);
+        dprintf("%u string(s) in %ums\n", found, GetTickCount() - ticks);
+        JobSetResult(job, found);
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
 }
 
 CMDRESULT cbInstrSetstr(int argc, char* argv[])
@@ -1190,12 +1210,6 @@ CMDRESULT cbInstrFindAll(int argc, char* argv[])
         dprintf("invalid memory address " fhex "!\n", addr);
         return STATUS_ERROR;
     }
-    Memory<unsigned char*> data(size, "cbInstrFindAll:data");
-    if(!MemRead(base, data(), size))
-    {
-        dputs("failed to read memory!");
-        return STATUS_ERROR;
-    }
     duint start = addr - base;
     duint find_size = 0;
     bool findData = false;
@@ -1213,65 +1227,75 @@ CMDRESULT cbInstrFindAll(int argc, char* argv[])
     }
     else
         find_size = size - start;
-    //setup reference view
-    char patternshort[256] = "";
-    strncpy_s(patternshort, pattern, min(16, len));
-    if(len > 16)
-        strcat_s(patternshort, "...");
-    char patterntitle[256] = "";
-    sprintf_s(patterntitle, "Pattern: %s", patternshort);
-    GuiReferenceInitialize(patterntitle);
-    GuiReferenceAddColumn(2 * sizeof(duint), "Address");
-    if(findData)
-        GuiReferenceAddColumn(0, "&Data&");
-    else
-        GuiReferenceAddColumn(0, "Disassembly");
-    GuiReferenceReloadData();
-    DWORD ticks = GetTickCount();
-    int refCount = 0;
-    duint i = 0;
-    duint result = 0;
     std::vector<PatternByte> searchpattern;
     if(!patterntransform(pattern, searchpattern))
     {
         dputs("failed to transform pattern!");
         return STATUS_ERROR;
     }
-    while(refCount < maxFindResults)
+    char patternshort[256] = "";
+    strncpy_s(patternshort, pattern, min(16, len));
+    if(len > 16)
+        strcat_s(patternshort, "...");
+    char patterntitle[256] = "";
+    sprintf_s(patterntitle, "Pattern: %s", patternshort);
+    bool started = JobStart(patterntitle, [ = ](unsigned int job)
     {
-        duint foundoffset = patternfind(data() + start + i, find_size - i, searchpattern);
-        if(foundoffset == -1)
-            break;
-        i += foundoffset + 1;
-        result = addr + i - 1;
-        char msg[deflen] = "";
-        sprintf(msg, fhex, result);
-        GuiReferenceSetRowCount(refCount + 1);
-        GuiReferenceSetCellContent(refCount, 0, msg);
-        if(findData)
+        Memory<unsigned char*> data(size, "cbInstrFindAll:data");
+        if(!MemRead(base, data(), size))
         {
-            Memory<unsigned char*> printData(searchpattern.size(), "cbInstrFindAll:printData");
-            MemRead(result, printData(), printData.size());
-            for(size_t j = 0, k = 0; j < printData.size(); j++)
-            {
-                if(j)
-                    k += sprintf(msg + k, " ");
-                k += sprintf(msg + k, "%.2X", printData()[j]);
-            }
+            dputs("failed to read memory!");
+            return false;
         }
+        //setup reference view
+        JobRefInitialize(job, patterntitle);
+        JobRefAddColumn(job, 2 * sizeof(duint), "Address");
+        if(findData)
+            JobRefAddColumn(job, 0, "&Data&");
         else
+            JobRefAddColumn(job, 0, "Disassembly");
+        JobRefReloadData(job);
+        DWORD ticks = GetTickCount();
+        int refCount = 0;
+        duint i = 0;
+        duint result = 0;
+        while(refCount < maxFindResults && !JobIsCancelled(job))
         {
-            if(!GuiGetDisassembly(result, msg))
-                strcpy_s(msg, "[Error disassembling]");
+            duint foundoffset = patternfind(data() + start + i, find_size - i, searchpattern);
+            if(foundoffset == -1)
+                break;
+            i += foundoffset + 1;
+            result = addr + i - 1;
+            char msg[deflen] = "";
+            sprintf(msg, fhex, result);
+            JobRefSetRowCount(job, refCount + 1);
+            JobRefSetCellContent(job, refCount, 0, msg);
+            if(findData)
+            {
+                Memory<unsigned char*> printData(searchpattern.size(), "cbInstrFindAll:printData");
+                MemRead(result, printData(), printData.size());
+                for(size_t j = 0, k = 0; j < printData.size(); j++)
+                {
+                    if(j)
+                        k += sprintf(msg + k, " ");
+                    k += sprintf(msg + k, "%.2X", printData()[j]);
+                }
+            }
+            else
+            {
+                if(!GuiGetDisassembly(result, msg))
+                    strcpy_s(msg, "[Error disassembling]");
+            }
+            JobRefSetCellContent(job, refCount, 1, msg);
+            result++;
+            refCount++;
         }
-        GuiReferenceSetCellContent(refCount, 1, msg);
-        result++;
-        refCount++;
-    }
-    GuiReferenceReloadData();
-    dprintf("%d occurrences found in %ums\n", refCount, GetTickCount() - ticks);
-    varset("$result", refCount, false);
-    return STATUS_CONTINUE;
+        JobRefReloadData(job);
+        dprintf("%d occurrences found in %ums\n", refCount, GetTickCount() - ticks);
+        JobSetResult(job, refCount);
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
 }
 
 CMDRESULT cbInstrFindMemAll(int argc, char* argv[])
@@ -1323,73 +1347,78 @@ CMDRESULT cbInstrFindMemAll(int argc, char* argv[])
     }
     SHARED_RELEASE();
 
-    DWORD ticks = GetTickCount();
-
-    std::vector<duint> results;
-    if(!MemFindInMap(searchPages, searchpattern, results, maxFindResults))
-    {
-        dputs("MemFindInMap failed!");
-        return STATUS_ERROR;
-    }
-
-    //setup reference view
     char patternshort[256] = "";
     strncpy_s(patternshort, pattern, min(16, len));
     if(len > 16)
         strcat_s(patternshort, "...");
     char patterntitle[256] = "";
     sprintf_s(patterntitle, "Pattern: %s", patternshort);
-    GuiReferenceInitialize(patterntitle);
-    GuiReferenceAddColumn(2 * sizeof(duint), "Address");
-    if(findData)
-        GuiReferenceAddColumn(0, "&Data&");
-    else
-        GuiReferenceAddColumn(0, "Disassembly");
-    GuiReferenceReloadData();
-
-    int refCount = 0;
-    for(duint result : results)
+    bool started = JobStart(patterntitle, [ = ](unsigned int job)
     {
-        char msg[deflen] = "";
-        sprintf(msg, fhex, result);
-        GuiReferenceSetRowCount(refCount + 1);
-        GuiReferenceSetCellContent(refCount, 0, msg);
+        //setup reference view
+        JobRefInitialize(job, patterntitle);
+        JobRefAddColumn(job, 2 * sizeof(duint), "Address");
         if(findData)
-        {
-            Memory<unsigned char*> printData(searchpattern.size(), "cbInstrFindAll:printData");
-            MemRead(result, printData(), printData.size());
-            for(size_t j = 0, k = 0; j < printData.size(); j++)
-            {
-                if(j)
-                    k += sprintf(msg + k, " ");
-                k += sprintf(msg + k, "%.2X", printData()[j]);
-            }
-        }
+            JobRefAddColumn(job, 0, "&Data&");
         else
+            JobRefAddColumn(job, 0, "Disassembly");
+        JobRefReloadData(job);
+
+        DWORD ticks = GetTickCount();
+
+        std::vector<duint> results;
+        if(!MemFindInMap(searchPages, searchpattern, results, maxFindResults, true, job))
         {
-            if(!GuiGetDisassembly(result, msg))
-                strcpy_s(msg, "[Error disassembling]");
+            dputs("MemFindInMap failed!");
+            return false;
         }
-        GuiReferenceSetCellContent(refCount, 1, msg);
-        refCount++;
-    }
 
-    GuiReferenceReloadData();
-    dprintf("%d occurrences found in %ums\n", refCount, GetTickCount() - ticks);
-    varset("$result", refCount, false);
+        int refCount = 0;
+        for(duint result : results)
+        {
+            if(JobIsCancelled(job))
+                break;
+            char msg[deflen] = "";
+            sprintf(msg, fhex, result);
+            JobRefSetRowCount(job, refCount + 1);
+            JobRefSetCellContent(job, refCount, 0, msg);
+            if(findData)
+            {
+                Memory<unsigned char*> printData(searchpattern.size(), "cbInstrFindAll:printData");
+                MemRead(result, printData(), printData.size());
+                for(size_t j = 0, k = 0; j < printData.size(); j++)
+                {
+                    if(j)
+                        k += sprintf(msg + k, " ");
+                    k += sprintf(msg + k, "%.2X", printData()[j]);
+                }
+            }
+            else
+            {
+                if(!GuiGetDisassembly(result, msg))
+                    strcpy_s(msg, "[Error disassembling]");
+            }
+            JobRefSetCellContent(job, refCount, 1, msg);
+            refCount++;
+        }
 
-    return STATUS_CONTINUE;
+        JobRefReloadData(job);
+        dprintf("%d occurrences found in %ums\n", refCount, GetTickCount() - ticks);
+        JobSetResult(job, refCount);
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
 }
 
 static bool cbModCallFind(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo)
 {
     if(!disasm || !basicinfo)  //initialize
     {
-        GuiReferenceInitialize(refinfo->name);
-        GuiReferenceAddColumn(2 * sizeof(duint), "Address");
-        GuiReferenceAddColumn(20, "Disassembly");
-        GuiReferenceAddColumn(MAX_LABEL_SIZE, "Destination");
-        GuiReferenceReloadData();
+        JobRefInitialize(refinfo->job, refinfo->name);
+        JobRefAddColumn(refinfo->job, 2 * sizeof(duint), "Address");
+        JobRefAddColumn(refinfo->job, 20, "Disassembly");
+        JobRefAddColumn(refinfo->job, MAX_LABEL_SIZE, "Destination");
+        JobRefReloadData(refinfo->job);
         return true;
     }
     bool found = false;
@@ -1406,19 +1435,9 @@ static bool cbModCallFind(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, R
         char moduleTargetText[256] = "";
         sprintf(addrText, "%p", disasm->Address());
         sprintf(moduleTargetText, "%s.%s", module, label);
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-        {
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-            GuiReferenceSetCellContent(refinfo->refcount, 2, moduleTargetText);
-        }
-        else
-        {
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
-            GuiReferenceSetCellContent(refinfo->refcount, 2, moduleTargetText);
-        }
+        RefSetCellContent(refinfo, 0, addrText);
+        RefSetCellContent(refinfo, 1, disasm->InstructionText().c_str());
+        RefSetCellContent(refinfo, 2, moduleTargetText);
     }
     return found;
 }
@@ -1439,10 +1458,14 @@ CMDRESULT cbInstrModCallFind(int argc, char* argv[])
             refFindType = CURRENT_REGION;
 
     duint ticks = GetTickCount();
-    int found = RefFind(addr, size, cbModCallFind, 0, false, "Calls", (REFFINDTYPE)refFindType, false);
-    dprintf("%u call(s) in %ums\n", found, GetTickCount() - ticks);
-    varset("$result", found, false);
-    return STATUS_CONTINUE;
+    bool started = JobStart("Calls", [ = ](unsigned int job)
+    {
+        int found = RefFind(addr, size, cbModCallFind, 0, false, "Calls", (REFFINDTYPE)refFindType, false, job);
+        dprintf("%u call(s) in %ums\n", found, GetTickCount() - ticks);
+        JobSetResult(job, found);
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
 }
 
 CMDRESULT cbInstrCommentList(int argc, char* argv[])
@@ -1662,19 +1685,23 @@ static bool cbFindAsm(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFIN
         GuiReferenceReloadData();
         return true;
     }
-    const char* instruction = (const char*)refinfo->userinfo;
-    bool found = !_stricmp(instruction, basicinfo->instruction);
+    // The first instruction is at a match of its encodings, the rest of the sequence follows it
+    const auto & instructions = *(const std::vector<String>*)refinfo->userinfo;
+    bool found = !_stricmp(instructions[0].c_str(), basicinfo->instruction);
+    duint next = (duint)disasm->Address() + disasm->Size();
+    for(size_t i = 1; found && i < instructions.size(); i++)
+    {
+        BASIC_INSTRUCTION_INFO nextinfo;
+        memset(&nextinfo, 0, sizeof(BASIC_INSTRUCTION_INFO));
+        found = disasmfast(next, &nextinfo) && !_stricmp(instructions[i].c_str(), nextinfo.instruction);
+        next += nextinfo.size;
+    }
     if(found)
     {
         char addrText[20] = "";
         sprintf(addrText, fhex, disasm->Address());
-        GuiReferenceSetRowCount(refinfo->refcount + 1);
-        GuiReferenceSetCellContent(refinfo->refcount, 0, addrText);
-        char disassembly[GUI_MAX_DISASSEMBLY_SIZE] = "";
-        if(GuiGetDisassembly((duint)disasm->Address(), disassembly))
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disassembly);
-        else
-            GuiReferenceSetCellContent(refinfo->refcount, 1, disasm->InstructionText().c_str());
+        RefSetCellContent(refinfo, 0, addrText);
+        RefSetCellContent(refinfo, 1, disasm->InstructionText().c_str());
     }
     return found;
 }
@@ -1700,41 +1727,55 @@ CMDRESULT cbInstrFindAsm(int argc, char* argv[])
         if(refFindType != CURRENT_REGION && refFindType != CURRENT_MODULE && refFindType != ALL_MODULES)
             refFindType = CURRENT_REGION;
 
-    unsigned char dest[16];
-    int asmsize = 0;
-    char error[MAX_ERROR_SIZE] = "";
-    if(!assemble(addr + size / 2, dest, &asmsize, argv[1], error))
+    // Instructions separated by ';' are searched as a sequence, the first one is looked up by its encodings
+    std::vector<String> instructions;
+    std::vector<std::vector<PatternByte>> patterns;
+    String query;
+    duint asmAddr = addr + size / 2;
+    for(const auto & part : StringUtils::Split(argv[1], ';'))
+    {
+        auto text = StringUtils::Trim(part);
+        if(text.empty())
+            continue;
+        unsigned char dest[16];
+        int asmsize = 0;
+        char error[MAX_ERROR_SIZE] = "";
+        std::vector<std::vector<PatternByte>> partPatterns;
+        if(!assemblepatterns(asmAddr, text.c_str(), partPatterns, dest, &asmsize, error))
+        {
+            dprintf("failed to assemble \"%s\" (%s)!\n", text.c_str(), error);
+            return STATUS_ERROR;
+        }
+        BASIC_INSTRUCTION_INFO basicinfo;
+        memset(&basicinfo, 0, sizeof(BASIC_INSTRUCTION_INFO));
+        disasmfast(dest, asmAddr, &basicinfo);
+        if(instructions.empty())
+            patterns = partPatterns;
+        else
+            query += "; ";
+        query += basicinfo.instruction;
+        instructions.push_back(basicinfo.instruction);
+        asmAddr += asmsize;
+    }
+    if(instructions.empty())
     {
-        dprintf("failed to assemble \"%s\" (%s)!\n", argv[1], error);
+        dputs("no instructions to search for!");
         return STATUS_ERROR;
     }
-    BASIC_INSTRUCTION_INFO basicinfo;
-    memset(&basicinfo, 0, sizeof(BASIC_INSTRUCTION_INFO));
-    disasmfast(dest, addr + size / 2, &basicinfo);
 
     duint ticks = GetTickCount();
     char title[256] = "";
-    sprintf_s(title, "Command: \"%s\"", basicinfo.instruction);
-    int found = RefFind(addr, size, cbFindAsm, (void*)&basicinfo.instruction[0], false, title, (REFFINDTYPE)refFindType, true);
+    sprintf_s(title, "Command: \"%s\"", query.c_str());
+    int found;
+    if(patterns.empty())
+        found = RefFind(addr, size, cbFindAsm, &instructions, false, title, (REFFINDTYPE)refFindType, true);
+    else
+        found = RefFindPatterns(addr, size, patterns, cbFindAsm, &instructions, false, title, (REFFINDTYPE)refFindType, true);
     dprintf("%u result(s) in %ums\n", found, GetTickCount() - ticks);
     varset("$result", found, false);
     return STATUS_CONTINUE;
 }
 
-static void yaraCompilerCallback(int error_level, const char* file_name, int line_number, const char* message, void* user_data)
-{
-    switch(error_level)
-    {
-    case YARA_ERROR_LEVEL_ERROR:
-        dprintf("[YARA ERROR] ");
-        break;
-    case YARA_ERROR_LEVEL_WARNING:
-        dprintf("[YARA WARNING] ");
-        break;
-    }
-    dprintf("File: \"%s\", Line: %d, Message: \"%s\"\n", file_name, line_number, message);
-}
-
 static String yara_print_string(const uint8_t* data, int length)
 {
     String result = "\"";
@@ -1766,19 +1807,38 @@ static String yara_print_hex_string(const uint8_t* data, int length)
     return result;
 }
 
+struct YaraMatch
+{
+    duint addr;
+    String rule;
+    String data;
+};
+
 struct YaraScanInfo
 {
     duint base;
     int index;
     bool rawFile;
     const char* modname;
+    unsigned int job;
+    std::vector<YaraMatch>* matches; //regions scanned in parallel collect their matches instead of adding them to the view
 
-    YaraScanInfo(duint base, bool rawFile, const char* modname)
-        : base(base), index(0), rawFile(rawFile), modname(modname)
+    YaraScanInfo(duint base, bool rawFile, const char* modname, unsigned int job, std::vector<YaraMatch>* matches = nullptr)
+        : base(base), index(0), rawFile(rawFile), modname(modname), job(job), matches(matches)
     {
     }
 };
 
+static void yaraAddReference(unsigned int job, int index, const YaraMatch & match)
+{
+    JobRefSetRowCount(job, index + 1);
+    char addr_text[deflen] = "";
+    sprintf(addr_text, fhex, match.addr);
+    JobRefSetCellContent(job, index, 0, addr_text); //Address
+    JobRefSetCellContent(job, index, 1, match.rule.c_str()); //Rule
+    JobRefSetCellContent(job, index, 2, match.data.c_str()); //Data
+}
+
 static int yaraScanCallback(int message, void* message_data, void* user_data)
 {
     YaraScanInfo* scanInfo = (YaraScanInfo*)user_data;
@@ -1790,28 +1850,25 @@ static int yaraScanCallback(int message, void* message_data, void* user_data)
         YR_RULE* yrRule = (YR_RULE*)message_data;
         auto addReference = [scanInfo, yrRule](duint addr, const char* identifier, const std::string & pattern)
         {
-            auto index = scanInfo->index;
-            GuiReferenceSetRowCount(index + 1);
-            scanInfo->index++;
-
-            char addr_text[deflen] = "";
-            sprintf(addr_text, fhex, addr);
-            GuiReferenceSetCellContent(index, 0, addr_text); //Address
-            String ruleFullName = "";
-            ruleFullName += yrRule->identifier;
+            YaraMatch match;
+            match.addr = addr;
+            match.rule = yrRule->identifier;
             if(identifier)
             {
-                ruleFullName += ".";
-                ruleFullName += identifier;
+                match.rule += ".";
+                match.rule += identifier;
             }
-            GuiReferenceSetCellContent(index, 1, ruleFullName.c_str()); //Rule
-            GuiReferenceSetCellContent(index, 2, pattern.c_str()); //Data
+            match.data = pattern;
+            if(scanInfo->matches)
+                scanInfo->matches->push_back(match);
+            else
+                yaraAddReference(scanInfo->job, scanInfo->index, match);
+            scanInfo->index++;
         };
 
         if(STRING_IS_NULL(yrRule->strings))
         {
             dprintf("[YARA] Global rule \"%s\' matched!\n", yrRule->identifier);
-            GuiReferenceSetRowCount(1);
             addReference(base, nullptr, "");
         }
         else
@@ -1846,6 +1903,9 @@ static int yaraScanCallback(int message, void* message_data, void* user_data)
 
     case CALLBACK_MSG_RULE_NOT_MATCHING:
     {
+        //a parallel scan would print this for every rule in every region
+        if(scanInfo->matches)
+            break;
         YR_RULE* yrRule = (YR_RULE*)message_data;
         dprintf("[YARA] Rule \"%s\" did not match!\n", yrRule->identifier);
     }
@@ -1853,20 +1913,53 @@ static int yaraScanCallback(int message, void* message_data, void* user_data)
 
     case CALLBACK_MSG_SCAN_FINISHED:
     {
-        dputs("[YARA] Scan finished!");
+        if(!scanInfo->matches)
+            dputs("[YARA] Scan finished!");
     }
     break;
 
     case CALLBACK_MSG_IMPORT_MODULE:
     {
+        if(scanInfo->matches)
+            break;
         YR_MODULE_IMPORT* yrModuleImport = (YR_MODULE_IMPORT*)message_data;
         dprintf("[YARA] Imported module \"%s\"!\n", yrModuleImport->module_name);
     }
     break;
     }
+    if(JobIsCancelled(scanInfo->job))
+        return CALLBACK_ABORT;
     return ERROR_SUCCESS; //nicely undocumented what this should be
 }
 
+static int yaraScanMem(YR_RULES* yrRules, uint8_t* data, duint size, YaraScanInfo & scanInfo)
+{
+    //the compiled rules are shared by all scans, wait until one of their MAX_THREADS scan slots is free
+    int err;
+    while((err = yr_rules_scan_mem(yrRules, data, size, 0, yaraScanCallback, &scanInfo, 0)) == ERROR_TOO_MANY_SCAN_THREADS && !JobIsCancelled(scanInfo.job))
+        Sleep(10);
+    return err;
+}
+
+static void yaraInitReferenceView(unsigned int job, const String & rulesFile, const char* target)
+{
+    String fullName;
+    const char* fileName = strrchr(rulesFile.c_str(), '\\');
+    if(fileName)
+        fullName = fileName + 1;
+    else
+        fullName = rulesFile;
+    fullName += " (";
+    fullName += target;
+    fullName += ")"; //nanana, very ugly code (long live open source)
+    JobRefInitialize(job, fullName.c_str());
+    JobRefAddColumn(job, sizeof(duint) * 2, "Address");
+    JobRefAddColumn(job, 48, "Rule");
+    JobRefAddColumn(job, 0, "Data");
+    JobRefSetRowCount(job, 0);
+    JobRefReloadData(job);
+}
+
 CMDRESULT cbInstrYara(int argc, char* argv[])
 {
     if(argc < 2)  //yara rulesFile, addr_of_mempage, size_of_scan
@@ -1905,97 +1998,150 @@ CMDRESULT cbInstrYara(int argc, char* argv[])
             addr = MemFindBaseAddr(addr, &size);
         base = addr;
     }
-    std::vector<unsigned char> rawFileData;
-    if(rawFile)  //read the file from disk
-    {
-        char modPath[MAX_PATH] = "";
-        if(!ModPathFromAddr(base, modPath, MAX_PATH))
+    String rulesFile = argv[1];
+    String modName = argv[2];
+    bool started = JobStart("YARA", [ = ](unsigned int job)
+    {
+        auto yrRules = YaraRulesGet(rulesFile);
+        if(!yrRules)
+            return false;
+
+        //the file is scanned straight from a read-only mapping, the memory from the module image where it is unmodified
+        HANDLE fileHandle = nullptr;
+        DWORD fileSize = 0;
+        HANDLE fileMapHandle = nullptr;
+        ULONG_PTR fileMapVa = 0;
+        ImageView memData;
+        uint8_t* data;
+        duint scanSize;
+        if(rawFile)
         {
-            dprintf("failed to get module path for " fhex "!\n", base);
-            return STATUS_ERROR;
+            char modPath[MAX_PATH] = "";
+            if(!ModPathFromAddr(base, modPath, MAX_PATH))
+            {
+                dprintf("failed to get module path for " fhex "!\n", base);
+                return false;
+            }
+            if(!StaticFileLoadW(StringUtils::Utf8ToUtf16(modPath).c_str(), UE_ACCESS_READ, false, &fileHandle, &fileSize, &fileMapHandle, &fileMapVa))
+            {
+                dprintf("failed to read file \"%s\"!\n", modPath);
+                return false;
+            }
+            data = (uint8_t*)fileMapVa;
+            scanSize = fileSize;
         }
-        if(!FileHelper::ReadAllData(modPath, rawFileData))
+        else
         {
-            dprintf("failed to read file \"%s\"!\n", modPath);
-            return STATUS_ERROR;
+            if(!memData.Read(base, size))
+            {
+                dprintf("failed to read memory page %p[%X]!\n", base, size);
+                return false;
+            }
+            data = memData.Data();
+            scanSize = size;
         }
-        size = rawFileData.size();
-    }
-    Memory<uint8_t*> data(size);
-    if(rawFile)
-        memcpy(data(), rawFileData.data(), size);
-    else if(!MemRead(base, data(), size))
+
+        //initialize new reference tab
+        char modname[MAX_MODULE_SIZE] = "";
+        if(!ModNameFromAddr(base, modname, true))
+            sprintf_s(modname, "%p", base);
+        yaraInitReferenceView(job, rulesFile, modname);
+        YaraScanInfo scanInfo(base, rawFile, modName.c_str(), job);
+        duint ticks = GetTickCount();
+        dputs("[YARA] Scan started...");
+        int err = yaraScanMem(yrRules.get(), data, scanSize, scanInfo);
+        if(rawFile)
+            StaticFileUnloadW(nullptr, false, fileHandle, fileSize, fileMapHandle, fileMapVa);
+        JobRefReloadData(job);
+        switch(err)
+        {
+        case ERROR_SUCCESS:
+            dprintf("%u scan results in %ums...\n", scanInfo.index, GetTickCount() - ticks);
+            return true;
+        case ERROR_TOO_MANY_MATCHES:
+            dputs("too many matches!");
+            break;
+        default:
+            dputs("error while scanning memory!");
+            break;
+        }
+        return false;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
+}
+
+CMDRESULT cbInstrYaraAll(int argc, char* argv[])
+{
+    if(argc < 2)  //yaraall rulesFile
     {
-        dprintf("failed to read memory page %p[%X]!\n", base, size);
+        dputs("not enough arguments!");
         return STATUS_ERROR;
     }
 
-    String rulesContent;
-    if(!FileHelper::ReadAllText(argv[1], rulesContent))
+    SHARED_ACQUIRE(LockMemoryPages);
+    std::vector<SimplePage> scanPages;
+    for(auto & itr : memoryPages)
     {
-        dprintf("Failed to read the rules file \"%s\"\n", argv[1]);
-        return STATUS_ERROR;
+        const auto & mbi = itr.second.mbi;
+        if(mbi.State != MEM_COMMIT || (mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+            continue;
+        scanPages.push_back(SimplePage(duint(mbi.BaseAddress), mbi.RegionSize));
     }
+    SHARED_RELEASE();
 
-    bool bSuccess = false;
-    YR_COMPILER* yrCompiler;
-    if(yr_compiler_create(&yrCompiler) == ERROR_SUCCESS)
+    String rulesFile = argv[1];
+    bool started = JobStart("YARA", [ = ](unsigned int job)
     {
-        yr_compiler_set_callback(yrCompiler, yaraCompilerCallback, 0);
-        if(yr_compiler_add_string(yrCompiler, rulesContent.c_str(), nullptr) == 0)   //no errors found
+        auto yrRules = YaraRulesGet(rulesFile);
+        if(!yrRules)
+            return false;
+
+        yaraInitReferenceView(job, rulesFile, "all regions");
+        duint ticks = GetTickCount();
+        dprintf("[YARA] Scanning %d regions...\n", int(scanPages.size()));
+
+        //every worker takes the next region, its matches are added to the view as soon as the region is done
+        std::atomic<size_t> nextPage(0);
+        int index = 0;
+        size_t donePages = 0;
+        int failedPages = 0;
+        auto workerCount = min(size_t(max(std::thread::hardware_concurrency(), 1u)), size_t(MAX_THREADS));
+        concurrency::parallel_for(size_t(0), min(workerCount, scanPages.size()), [&](size_t)
         {
-            YR_RULES* yrRules;
-            if(yr_compiler_get_rules(yrCompiler, &yrRules) == ERROR_SUCCESS)
+            std::vector<uint8_t> data;
+            std::vector<YaraMatch> matches;
+            for(auto i = nextPage++; i < scanPages.size() && !JobIsCancelled(job); i = nextPage++)
             {
-                //initialize new reference tab
-                char modname[MAX_MODULE_SIZE] = "";
-                if(!ModNameFromAddr(base, modname, true))
-                    sprintf_s(modname, "%p", base);
-                String fullName;
-                const char* fileName = strrchr(argv[1], '\\');
-                if(fileName)
-                    fullName = fileName + 1;
-                else
-                    fullName = argv[1];
-                fullName += " (";
-                fullName += modname;
-                fullName += ")"; //nanana, very ugly code (long live open source)
-                GuiReferenceInitialize(fullName.c_str());
-                GuiReferenceAddColumn(sizeof(duint) * 2, "Address");
-                GuiReferenceAddColumn(48, "Rule");
-                GuiReferenceAddColumn(0, "Data");
-                GuiReferenceSetRowCount(0);
-                GuiReferenceReloadData();
-                YaraScanInfo scanInfo(base, rawFile, argv[2]);
-                duint ticks = GetTickCount();
-                dputs("[YARA] Scan started...");
-                int err = yr_rules_scan_mem(yrRules, data(), size, 0, yaraScanCallback, &scanInfo, 0);
-                GuiReferenceReloadData();
-                switch(err)
+                const auto & page = scanPages[i];
+                int err = ERROR_SUCCESS;
+                matches.clear();
+                data.resize(page.size);
+                bool read = MemRead(page.address, data.data(), page.size);
+                if(read)
                 {
-                case ERROR_SUCCESS:
-                    dprintf("%u scan results in %ums...\n", scanInfo.index, GetTickCount() - ticks);
-                    bSuccess = true;
-                    break;
-                case ERROR_TOO_MANY_MATCHES:
-                    dputs("too many matches!");
-                    break;
-                default:
-                    dputs("error while scanning memory!");
-                    break;
+                    YaraScanInfo scanInfo(page.address, false, nullptr, job, &matches);
+                    err = yaraScanMem(yrRules.get(), data.data(), page.size, scanInfo);
                 }
-                yr_rules_destroy(yrRules);
+
+                EXCLUSIVE_ACQUIRE(LockYaraOutput);
+                if(!read || err != ERROR_SUCCESS)
+                    failedPages++;
+                for(const auto & match : matches)
+                    yaraAddReference(job, index++, match);
+                donePages++;
+                JobRefSetProgress(job, int(donePages * 100 / scanPages.size()));
             }
-            else
-                dputs("error while getting the rules!");
-        }
-        else
-            dputs("errors in the rules file!");
-        yr_compiler_destroy(yrCompiler);
-    }
-    else
-        dputs("yr_compiler_create failed!");
-    return bSuccess ? STATUS_CONTINUE : STATUS_ERROR;
+            yr_finalize_thread();
+        });
+
+        JobRefSetProgress(job, 100);
+        JobRefReloadData(job);
+        dprintf("%d scan results in %ums...\n", index, GetTickCount() - ticks);
+        if(failedPages)
+            dprintf("%d region(s) could not be scanned!\n", failedPages);
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
 }
 
 CMDRESULT cbInstrYaramod(int argc, char* argv[])
@@ -2013,6 +2159,229 @@ CMDRESULT cbInstrYaramod(int argc, char* argv[])
     return cmddirectexec("yara \"%s\",%s,%s", argv[1], argv[2], argc > 3 && *argv[3] == '1' ? "1" : "0");
 }
 
+static bool entropyAll(unsigned int job, const std::vector<MEMPAGE> & pages)
+{
+    JobRefInitialize(job, "Entropy");
+    JobRefAddColumn(job, 2 * sizeof(duint), "Address");
+    JobRefAddColumn(job, 2 * sizeof(duint), "Size");
+    JobRefAddColumn(job, 8, "Entropy");
+    JobRefAddColumn(job, 8, "Max");
+    JobRefAddColumn(job, 0, "Info");
+    JobRefReloadData(job);
+
+    DWORD ticks = GetTickCount();
+    int count = 0;
+    for(size_t i = 0; i < pages.size(); i++)
+    {
+        const auto & page = pages[i];
+        duint base = duint(page.mbi.BaseAddress);
+        ENTROPYRESULT result;
+        if(!EntropyMeasure(base, page.mbi.RegionSize, 1, result, job))
+            break;
+        JobRefSetProgress(job, int(i * 100 / pages.size()));
+        if(!result.size)
+            continue;
+
+        char text[deflen] = "";
+        JobRefSetRowCount(job, count + 1);
+        sprintf_s(text, fhex, base);
+        JobRefSetCellContent(job, count, 0, text);
+        sprintf_s(text, fhex, duint(page.mbi.RegionSize));
+        JobRefSetCellContent(job, count, 1, text);
+        sprintf_s(text, "%.3f", result.entropy);
+        JobRefSetCellContent(job, count, 2, text);
+        sprintf_s(text, "%.3f", result.maxWindow);
+        JobRefSetCellContent(job, count, 3, text);
+        JobRefSetCellContent(job, count, 4, page.info);
+        count++;
+    }
+    JobRefSetProgress(job, 100);
+    JobRefReloadData(job);
+    dprintf("%d regions measured in %ums\n", count, GetTickCount() - ticks);
+    GuiUpdateMemoryView();
+    return true;
+}
+
+CMDRESULT cbInstrEntropy(int argc, char* argv[])
+{
+    //entropy [addr[, size[, windowPages]]]
+    if(argc < 2)  //every committed region
+    {
+        SHARED_ACQUIRE(LockMemoryPages);
+        std::vector<MEMPAGE> pages;
+        for(auto & itr : memoryPages)
+        {
+            const auto & mbi = itr.second.mbi;
+            if(mbi.State == MEM_COMMIT && !(mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+                pages.push_back(itr.second);
+        }
+        SHARED_RELEASE();
+        bool started = JobStart("Entropy", [ = ](unsigned int job)
+        {
+            return entropyAll(job, pages);
+        });
+        return started ? STATUS_CONTINUE : STATUS_ERROR;
+    }
+
+    duint addr;
+    if(!valfromstring(argv[1], &addr))
+    {
+        dprintf("invalid value \"%s\"!\n", argv[1]);
+        return STATUS_ERROR;
+    }
+    duint size = 0;
+    if(argc > 2 && !valfromstring(argv[2], &size))
+        size = 0;
+    if(!size)
+        addr = MemFindBaseAddr(addr, &size);
+    if(!size)
+    {
+        dprintf("invalid memory address \"%s\"!\n", argv[1]);
+        return STATUS_ERROR;
+    }
+    duint windowPages = 1;
+    if(argc > 3 && (!valfromstring(argv[3], &windowPages) || !windowPages))
+    {
+        dprintf("invalid window size \"%s\"!\n", argv[3]);
+        return STATUS_ERROR;
+    }
+
+    bool started = JobStart("Entropy", [ = ](unsigned int job)
+    {
+        DWORD ticks = GetTickCount();
+        ENTROPYRESULT result;
+        if(!EntropyMeasure(addr, size, windowPages, result, job))
+            return false;
+        if(!result.size)
+        {
+            dprintf("failed to read memory %p[%X]!\n", addr, size);
+            return false;
+        }
+
+        //one row for every window
+        char title[deflen] = "";
+        sprintf_s(title, "Entropy %p[%X]", addr, size);
+        JobRefInitialize(job, title);
+        JobRefAddColumn(job, 2 * sizeof(duint), "Address");
+        JobRefAddColumn(job, 0, "Entropy");
+        JobRefSetRowCount(job, int(result.windows.size()));
+        for(size_t i = 0; i < result.windows.size(); i++)
+        {
+            if(JobIsCancelled(job))
+                break;
+            char text[deflen] = "";
+            sprintf_s(text, fhex, addr + i * PAGE_SIZE);
+            JobRefSetCellContent(job, int(i), 0, text);
+            if(result.windows[i] < 0)
+                strcpy_s(text, "???");
+            else
+                sprintf_s(text, "%.3f", result.windows[i]);
+            JobRefSetCellContent(job, int(i), 1, text);
+        }
+        JobRefReloadData(job);
+
+        //the most common byte values
+        unsigned char values[256];
+        for(int i = 0; i < 256; i++)
+            values[i] = (unsigned char)i;
+        std::partial_sort(values, values + 4, values + 256, [&result](unsigned char a, unsigned char b)
+        {
+            return result.histogram[a] > result.histogram[b];
+        });
+        String common;
+        for(int i = 0; i < 4 && result.histogram[values[i]]; i++)
+        {
+            char text[32] = "";
+            sprintf_s(text, "%s%02X (%.1f%%)", i ? ", " : "", values[i], result.histogram[values[i]] * 100.0 / result.size);
+            common += text;
+        }
+        dprintf("Entropy of %p[%X]: %.3f bits per byte (windows %.3f - %.3f), most common: %s, %ums\n",
+                addr, size, result.entropy, result.minWindow, result.maxWindow, common.c_str(), GetTickCount() - ticks);
+        GuiUpdateMemoryView();
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
+}
+
+CMDRESULT cbInstrMemSnapshot(int argc, char* argv[])
+{
+    DWORD ticks = GetTickCount();
+    int snapshot = MemSnapshotTake();
+    std::vector<SNAPSHOTRANGE> ranges;
+    MemSnapshotDiff(snapshot - 1, snapshot, ranges);
+    duint changed = 0;
+    for(const auto & range : ranges)
+        changed += range.size;
+    dprintf("Snapshot %d taken in %ums, %u page(s) changed since the previous one\n", snapshot, GetTickCount() - ticks, DWORD(changed / PAGE_SIZE));
+    varset("$result", snapshot, false);
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrMemDiff(int argc, char* argv[])
+{
+    //memdiff [first[, second]], compares the last two snapshots by default
+    duint second = MemSnapshotCount();
+    if(argc > 2 && !valfromstring(argv[2], &second))
+    {
+        dprintf("invalid value \"%s\"!\n", argv[2]);
+        return STATUS_ERROR;
+    }
+    duint first = second ? second - 1 : 0;
+    if(argc > 1 && !valfromstring(argv[1], &first))
+    {
+        dprintf("invalid value \"%s\"!\n", argv[1]);
+        return STATUS_ERROR;
+    }
+    std::vector<SNAPSHOTRANGE> ranges;
+    if(!MemSnapshotDiff(int(first), int(second), ranges))
+    {
+        dprintf("invalid snapshots %d and %d (%d taken)!\n", int(first), int(second), MemSnapshotCount());
+        return STATUS_ERROR;
+    }
+
+    bool started = JobStart("Memory diff", [ = ](unsigned int job)
+    {
+        char title[deflen] = "";
+        sprintf_s(title, "Memory diff %d-%d", int(first), int(second));
+        JobRefInitialize(job, title);
+        JobRefAddColumn(job, 2 * sizeof(duint), "Address");
+        JobRefAddColumn(job, 2 * sizeof(duint), "Size");
+        JobRefAddColumn(job, 10, "Change");
+        JobRefAddColumn(job, 0, "Bytes changed");
+        JobRefSetRowCount(job, int(ranges.size()));
+        for(size_t i = 0; i < ranges.size(); i++)
+        {
+            if(JobIsCancelled(job))
+                break;
+            const auto & range = ranges[i];
+            char text[deflen] = "";
+            sprintf_s(text, fhex, range.start);
+            JobRefSetCellContent(job, int(i), 0, text);
+            sprintf_s(text, fhex, range.size);
+            JobRefSetCellContent(job, int(i), 1, text);
+            switch(range.type)
+            {
+            case SnapshotPageAdded:
+                JobRefSetCellContent(job, int(i), 2, "added");
+                break;
+            case SnapshotPageRemoved:
+                JobRefSetCellContent(job, int(i), 2, "removed");
+                break;
+            case SnapshotPageModified:
+                JobRefSetCellContent(job, int(i), 2, "modified");
+                sprintf_s(text, "%u", DWORD(range.changedBytes));
+                JobRefSetCellContent(job, int(i), 3, text);
+                break;
+            }
+        }
+        JobRefReloadData(job);
+        dprintf("%d changed range(s) between snapshot %d and %d\n", int(ranges.size()), int(first), int(second));
+        JobSetResult(job, ranges.size());
+        return true;
+    });
+    return started ? STATUS_CONTINUE : STATUS_ERROR;
+}
+
 CMDRESULT cbInstrLog(int argc, char* argv[])
 {
     //log "format {0} string",arg1, arg2, argN
@@ -2373,6 +2742,86 @@ CMDRESULT cbInstrSetMaxFindResult(int argc, char* argv[])
     return STATUS_CONTINUE;
 }
 
+CMDRESULT cbInstrJobs(int argc, char* argv[])
+{
+    JobPrintList();
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrJobCancel(int argc, char* argv[])
+{
+    if(argc < 2)  //jobcancel without arguments cancels everything
+    {
+        JobCancelAll();
+        dputs("all jobs cancelled!");
+        return STATUS_CONTINUE;
+    }
+    duint id;
+    if(!valfromstring(argv[1], &id))
+    {
+        dprintf("Invalid expression: \"%s\"", argv[1]);
+        return STATUS_ERROR;
+    }
+    if(!JobCancel((unsigned int)id))
+    {
+        dprintf("no job with id %X!\n", (unsigned int)id);
+        return STATUS_ERROR;
+    }
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrJobWait(int argc, char* argv[])
+{
+    if(argc < 2)  //jobwait without arguments waits for everything
+    {
+        JobWaitAll();
+        return STATUS_CONTINUE;
+    }
+    duint id;
+    if(!valfromstring(argv[1], &id))
+    {
+        dprintf("Invalid expression: \"%s\"", argv[1]);
+        return STATUS_ERROR;
+    }
+    duint result;
+    if(!JobWait((unsigned int)id, &result))
+    {
+        dprintf("no result for job %X!\n", (unsigned int)id);
+        return STATUS_ERROR;
+    }
+    varset("$result", result, false);
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrCmdBenchmark(int argc, char* argv[])
+{
+    //cmdbench [count], ["command"]
+    duint count = 100000;
+    if(argc > 1 && !valfromstring(argv[1], &count, false))
+    {
+        dprintf("Invalid expression: \"%s\"\n", argv[1]);
+        return STATUS_ERROR;
+    }
+    const char* command = argc > 2 ? argv[2] : "mov $result,0";
+    if(!count)
+        return STATUS_ERROR;
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    for(duint i = 0; i < count; i++)
+    {
+        if(cmddirectexec(command) == STATUS_ERROR)
+        {
+            dprintf("command \"%s\" failed!\n", command);
+            return STATUS_ERROR;
+        }
+    }
+    QueryPerformanceCounter(&end);
+    double seconds = double(end.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+    dprintf("%u commands dispatched in %.3fms (%.0f commands/s)\n", (unsigned int)count, seconds * 1000.0, seconds > 0 ? double(count) / seconds : 0.0);
+    return STATUS_CONTINUE;
+}
+
 CMDRESULT cbInstrSavedata(int argc, char* argv[])
 {
     if(argc < 3)  //savedata filename,addr,size
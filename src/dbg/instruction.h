@@ -67,6 +67,10 @@ CMDRESULT cbInstrSleep(int argc, char* argv[]);
 CMDRESULT cbInstrFindAsm(int argc, char* argv[]);
 CMDRESULT cbInstrYara(int argc, char* argv[]);
 CMDRESULT cbInstrYaramod(int argc, char* argv[]);
+CMDRESULT cbInstrYaraAll(int argc, char* argv[]);
+CMDRESULT cbInstrEntropy(int argc, char* argv[]);
+CMDRESULT cbInstrMemSnapshot(int argc, char* argv[]);
+CMDRESULT cbInstrMemDiff(int argc, char* argv[]);
 CMDRESULT cbInstrLog(int argc, char* argv[]);
 
 CMDRESULT cbInstrCapstone(int argc, char* argv[]);
@@ -80,6 +84,10 @@ CMDRESULT cbInstrCfanalyse(int argc, char* argv[]);
 CMDRESULT cbInstrExanalyse(int argc, char* argv[]);
 CMDRESULT cbInstrVirtualmod(int argc, char* argv[]);
 CMDRESULT cbInstrSetMaxFindResult(int argc, char* argv[]);
+CMDRESULT cbInstrJobs(int argc, char* argv[]);
+CMDRESULT cbInstrJobCancel(int argc, char* argv[]);
+CMDRESULT cbInstrJobWait(int argc, char* argv[]);
+CMDRESULT cbInstrCmdBenchmark(int argc, char* argv[]);
 CMDRESULT cbInstrSavedata(int argc, char* argv[]);
 CMDRESULT cbInstrMnemonichelp(int argc, char* argv[]);
 CMDRESULT cbInstrMnemonicbrief(int argc, char* argv[]);
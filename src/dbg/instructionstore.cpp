@@ -0,0 +1,388 @@
+/**
+ @file instructionstore.cpp
+
+ @brief Implements a decoded instruction store shared by the analyses.
+ */
+
+#include "instructionstore.h"
+#include "threading.h"
+#include "murmurhash.h"
+#include <ppl.h>
+#include <thread>
+
+// Minimum number of bytes decoded by one thread
+#define STORE_CHUNK_MIN 0x10000
+
+// Number of ranges kept in the cache
+#define STORE_CACHE_SIZE 2
+
+// Maximum number of changed ranges remembered by a store
+#define STORE_CHANGES_MAX 256
+
+// Internal flag, the branch destination is the first entry in mValues
+#define STORE_HASBRANCH (1 << 15)
+
+bool InstructionDecode(Capstone & cp, duint addr, const unsigned char* data, int maxSize, DECODEDINSTR & instr)
+{
+    instr.addr = addr;
+    instr.size = 0;
+    instr.flags = 0;
+    instr.branch = 0;
+    instr.refCount = 0;
+    if(maxSize <= 0 || !cp.Disassemble(addr, data, maxSize))
+        return false;
+
+    instr.size = cp.Size();
+    if(cp.InGroup(CS_GRP_CALL))
+        instr.flags |= DECODED_CALL;
+    if(cp.InGroup(CS_GRP_JUMP))
+        instr.flags |= DECODED_JUMP;
+    if(cp.InGroup(CS_GRP_RET))
+        instr.flags |= DECODED_RET;
+    if(cp.IsLoop())
+        instr.flags |= DECODED_LOOP;
+    if(cp.GetId() == X86_INS_JMP)
+        instr.flags |= DECODED_JMP;
+    if(cp.GetId() == X86_INS_LOOP)
+        instr.flags |= DECODED_LOOPINS;
+    if(cp.IsFilling())
+        instr.flags |= DECODED_FILLING;
+    instr.branch = cp.BranchDestination();
+
+    const auto & x86 = cp.x86();
+    for(auto i = 0; i < cp.OpCount() && instr.refCount < DECODED_MAX_REFS; i++)
+    {
+        const auto & op = x86.operands[i];
+        if(op.type == X86_OP_IMM)
+        {
+            if(!i)
+                instr.flags |= DECODED_OP0IMM;
+            instr.refs[instr.refCount] = duint(op.imm);
+            instr.refImm[instr.refCount++] = true;
+        }
+        else if(op.type == X86_OP_MEM)
+        {
+            if(!i)
+                instr.flags |= DECODED_OP0MEM;
+            auto value = duint(op.mem.disp);
+            if(op.mem.base == X86_REG_RIP)  //rip-relative
+                value += addr + instr.size;
+            instr.refs[instr.refCount] = value;
+            instr.refImm[instr.refCount++] = false;
+        }
+    }
+    return true;
+}
+
+void InstructionStore::HashPages(const unsigned char* data, duint size, std::vector<duint> & pageHashes)
+{
+    pageHashes.resize((size + PAGE_SIZE - 1) / PAGE_SIZE);
+    for(duint i = 0; i < pageHashes.size(); i++)
+        pageHashes[i] = duint(murmurhash(data + i * PAGE_SIZE, int(min(duint(PAGE_SIZE), size - i * PAGE_SIZE))));
+}
+
+void InstructionStore::Build(duint base, const unsigned char* data, duint size, duint serial, std::vector<duint> && pageHashes)
+{
+    mBase = base;
+    mSize = size;
+    mSerial = serial;
+    mFirstSerial = serial;
+    mPageHashes = std::move(pageHashes);
+
+    // Every thread starts a linear sweep at the beginning of its chunk
+    duint threads = max(std::thread::hardware_concurrency(), 1u);
+    duint chunkCount = max(min(threads, size / STORE_CHUNK_MIN), duint(1));
+    duint chunkSize = (size + chunkCount - 1) / chunkCount;
+    std::vector<InstructionStore> chunks(chunkCount);
+    concurrency::parallel_for(duint(0), chunkCount, [&](duint i)
+    {
+        Capstone cp;
+        auto & chunk = chunks[i];
+        chunk.mBase = base;
+        chunk.mSize = size;
+        auto end = min((i + 1) * chunkSize, size);
+        for(auto offset = i * chunkSize; offset < end;)
+        {
+            DECODEDINSTR instr;
+            InstructionDecode(cp, base + offset, data + offset, int(min(duint(MAX_DISASM_BUFFER), size - offset)), instr);
+            chunk.append(instr);
+            offset += instr.size ? instr.size : 1;
+        }
+    });
+
+    // Stitch the chunks together, the sweeps synchronize after a few instructions
+    Capstone cp;
+    duint next = 0;
+    for(duint i = 0; i < chunkCount; i++)
+    {
+        auto end = min((i + 1) * chunkSize, size);
+        auto first = chunks[i].Find(base + next);
+        while(first == npos && next < end)
+        {
+            // The previous chunk ended in the middle of an instruction of this chunk's sweep
+            DECODEDINSTR instr;
+            InstructionDecode(cp, base + next, data + next, int(min(duint(MAX_DISASM_BUFFER), size - next)), instr);
+            append(instr);
+            next += instr.size ? instr.size : 1;
+            first = chunks[i].Find(base + next);
+        }
+        if(first != npos)
+        {
+            appendRange(chunks[i], first, chunks[i].Count());
+            next = mOffsets.back() + max(int(mSizes.back()), 1);
+        }
+        chunks[i] = InstructionStore(); // free the chunk early
+    }
+}
+
+void InstructionStore::Update(const InstructionStore & previous, const unsigned char* data, duint serial, std::vector<duint> && pageHashes)
+{
+    mBase = previous.mBase;
+    mSize = previous.mSize;
+    mSerial = serial;
+    mPageHashes = std::move(pageHashes);
+    mFirstSerial = previous.mFirstSerial;
+    mChanges = previous.mChanges;
+    if(mChanges.size() > STORE_CHANGES_MAX)
+    {
+        mFirstSerial = previous.mSerial;
+        mChanges.clear();
+    }
+
+    // Merge the changed pages into ranges
+    std::vector<std::pair<duint, duint>> dirty;
+    for(duint i = 0; i < mPageHashes.size(); i++)
+    {
+        if(mPageHashes[i] == previous.mPageHashes[i])
+            continue;
+        auto start = i * PAGE_SIZE;
+        auto end = min(start + PAGE_SIZE, mSize);
+        if(!dirty.empty() && dirty.back().second == start)
+            dirty.back().second = end;
+        else
+            dirty.push_back(std::make_pair(start, end));
+    }
+
+    Capstone cp;
+    const auto & offsets = previous.mOffsets;
+    size_t copied = 0; // first record of previous that is not copied yet
+    for(size_t i = 0; i < dirty.size(); i++)
+    {
+        // Instructions that start MAX_DISASM_BUFFER bytes before the change did not read any changed byte
+        auto dirtyEnd = dirty[i].second;
+        auto first = size_t(std::lower_bound(offsets.begin(), offsets.end(), DWORD(dirty[i].first > MAX_DISASM_BUFFER ? dirty[i].first - MAX_DISASM_BUFFER + 1 : 0)) - offsets.begin());
+        first = max(first, copied);
+        appendRange(previous, copied, first);
+
+        // Decode until the sweep synchronizes with the previous one after the changed bytes
+        duint start = first < offsets.size() ? offsets[first] : mSize;
+        duint next = start;
+        auto old = first;
+        while(next < mSize)
+        {
+            if(next >= dirtyEnd)
+            {
+                while(old < offsets.size() && offsets[old] < next)
+                    old++;
+                if(old < offsets.size() && offsets[old] == next)
+                {
+                    // The instruction here could read the next changed range
+                    if(i + 1 < dirty.size() && next + MAX_DISASM_BUFFER > dirty[i + 1].first)
+                        dirtyEnd = dirty[++i].second;
+                    else
+                        break;
+                }
+            }
+            DECODEDINSTR instr;
+            InstructionDecode(cp, mBase + next, data + next, int(min(duint(MAX_DISASM_BUFFER), mSize - next)), instr);
+            append(instr);
+            next += instr.size ? instr.size : 1;
+        }
+        copied = next < mSize ? old : offsets.size();
+
+        CHANGE change;
+        change.serial = serial;
+        change.start = mBase + start;
+        change.end = mBase + next;
+        if(change.start != change.end)
+            mChanges.push_back(change);
+    }
+    appendRange(previous, copied, offsets.size());
+}
+
+duint InstructionStore::Base() const
+{
+    return mBase;
+}
+
+duint InstructionStore::Size() const
+{
+    return mSize;
+}
+
+duint InstructionStore::Serial() const
+{
+    return mSerial;
+}
+
+const std::vector<duint> & InstructionStore::PageHashes() const
+{
+    return mPageHashes;
+}
+
+size_t InstructionStore::Count() const
+{
+    return mOffsets.size();
+}
+
+size_t InstructionStore::Find(duint addr, size_t hint) const
+{
+    if(addr < mBase || addr - mBase >= mSize)
+        return npos;
+    auto offset = DWORD(addr - mBase);
+
+    // Linear sweeps ask for the next instruction
+    if(hint != npos)
+    {
+        if(hint + 1 < mOffsets.size() && mOffsets[hint + 1] == offset)
+            return hint + 1;
+        if(hint < mOffsets.size() && mOffsets[hint] == offset)
+            return hint;
+    }
+
+    auto found = std::lower_bound(mOffsets.begin(), mOffsets.end(), offset);
+    if(found == mOffsets.end() || *found != offset)
+        return npos;
+    return found - mOffsets.begin();
+}
+
+size_t InstructionStore::LowerBound(duint addr) const
+{
+    if(addr <= mBase)
+        return 0;
+    if(addr - mBase >= mSize)
+        return mOffsets.size();
+    return std::lower_bound(mOffsets.begin(), mOffsets.end(), DWORD(addr - mBase)) - mOffsets.begin();
+}
+
+bool InstructionStore::ChangesSince(duint serial, std::vector<std::pair<duint, duint>> & ranges) const
+{
+    auto known = serial == mFirstSerial;
+    for(const auto & change : mChanges)
+    {
+        if(change.serial == serial)
+            known = true;
+        else if(known && change.serial > serial)
+            ranges.push_back(std::make_pair(change.start, change.end));
+    }
+    return known;
+}
+
+void InstructionStore::Get(size_t index, DECODEDINSTR & instr) const
+{
+    auto flags = mFlags[index];
+    auto refs = mRefs[index];
+    auto value = mValueIndex[index];
+    instr.addr = mBase + mOffsets[index];
+    instr.size = mSizes[index];
+    instr.flags = flags & ~STORE_HASBRANCH;
+    instr.branch = (flags & STORE_HASBRANCH) ? mValues[value++] : 0;
+    instr.refCount = refs & 0xF;
+    for(auto i = 0; i < instr.refCount; i++)
+    {
+        instr.refs[i] = mValues[value++];
+        instr.refImm[i] = (refs >> (4 + i) & 1) != 0;
+    }
+}
+
+void InstructionStore::append(const DECODEDINSTR & instr)
+{
+    auto flags = WORD(instr.flags);
+    unsigned char refs = instr.refCount;
+    mValueIndex.push_back(DWORD(mValues.size()));
+    if(instr.branch)
+    {
+        flags |= STORE_HASBRANCH;
+        mValues.push_back(instr.branch);
+    }
+    for(auto i = 0; i < instr.refCount; i++)
+    {
+        if(instr.refImm[i])
+            refs |= 1 << (4 + i);
+        mValues.push_back(instr.refs[i]);
+    }
+    mOffsets.push_back(DWORD(instr.addr - mBase));
+    mSizes.push_back((unsigned char)instr.size);
+    mFlags.push_back(flags);
+    mRefs.push_back(refs);
+}
+
+void InstructionStore::appendRange(const InstructionStore & other, size_t first, size_t last)
+{
+    if(first >= last)
+        return;
+    auto valueFirst = other.mValueIndex[first];
+    auto valueLast = last < other.mValueIndex.size() ? other.mValueIndex[last] : DWORD(other.mValues.size());
+    auto valueDelta = DWORD(mValues.size()) - valueFirst;
+    mOffsets.insert(mOffsets.end(), other.mOffsets.begin() + first, other.mOffsets.begin() + last);
+    mSizes.insert(mSizes.end(), other.mSizes.begin() + first, other.mSizes.begin() + last);
+    mFlags.insert(mFlags.end(), other.mFlags.begin() + first, other.mFlags.begin() + last);
+    mRefs.insert(mRefs.end(), other.mRefs.begin() + first, other.mRefs.begin() + last);
+    for(auto i = first; i < last; i++)
+        mValueIndex.push_back(other.mValueIndex[i] + valueDelta);
+    mValues.insert(mValues.end(), other.mValues.begin() + valueFirst, other.mValues.begin() + valueLast);
+}
+
+static std::vector<std::shared_ptr<const InstructionStore>> stores; // most recently used last
+static duint lastSerial = 0;
+
+std::shared_ptr<const InstructionStore> InstructionStoreGet(duint base, const unsigned char* data, duint size)
+{
+    // Patches and self-modifying code are found by comparing the page hashes
+    std::vector<duint> pageHashes;
+    InstructionStore::HashPages(data, size, pageHashes);
+
+    std::shared_ptr<const InstructionStore> previous;
+    duint serial;
+    {
+        EXCLUSIVE_ACQUIRE(LockInstructionStore);
+        for(auto itr = stores.begin(); itr != stores.end(); ++itr)
+        {
+            auto store = *itr;
+            if(store->Base() != base || store->Size() != size)
+                continue;
+            if(store->PageHashes() != pageHashes)
+            {
+                previous = store;
+                break;
+            }
+            stores.erase(itr);
+            stores.push_back(store);
+            return store;
+        }
+        serial = ++lastSerial;
+    }
+
+    // Decode without holding the lock
+    auto store = std::make_shared<InstructionStore>();
+    if(previous)
+        store->Update(*previous, data, serial, std::move(pageHashes));
+    else
+        store->Build(base, data, size, serial, std::move(pageHashes));
+
+    EXCLUSIVE_ACQUIRE(LockInstructionStore);
+    stores.erase(std::remove_if(stores.begin(), stores.end(), [base, size](const std::shared_ptr<const InstructionStore> & cached)
+    {
+        return cached->Base() == base && cached->Size() == size;
+    }), stores.end());
+    stores.push_back(store);
+    if(stores.size() > STORE_CACHE_SIZE)
+        stores.erase(stores.begin());
+    return store;
+}
+
+void InstructionStoreClear()
+{
+    EXCLUSIVE_ACQUIRE(LockInstructionStore);
+    stores.clear();
+}
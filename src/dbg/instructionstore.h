@@ -0,0 +1,92 @@
+#ifndef _INSTRUCTIONSTORE_H
+#define _INSTRUCTIONSTORE_H
+
+#include "_global.h"
+#include <capstone_wrapper.h>
+#include <memory>
+
+// Flow type and operand kinds of a decoded instruction
+enum
+{
+    DECODED_CALL = 1 << 0, // InGroup(CS_GRP_CALL)
+    DECODED_JUMP = 1 << 1, // InGroup(CS_GRP_JUMP)
+    DECODED_RET = 1 << 2, // InGroup(CS_GRP_RET)
+    DECODED_LOOP = 1 << 3, // IsLoop()
+    DECODED_JMP = 1 << 4, // X86_INS_JMP
+    DECODED_LOOPINS = 1 << 5, // X86_INS_LOOP
+    DECODED_FILLING = 1 << 6, // IsFilling()
+    DECODED_OP0IMM = 1 << 7, // first operand is an immediate
+    DECODED_OP0MEM = 1 << 8 // first operand is a memory operand
+};
+
+#define DECODED_MAX_REFS 3
+
+struct DECODEDINSTR
+{
+    duint addr;
+    int size; // 0 for invalid instructions
+    unsigned int flags;
+    duint branch; // BranchDestination()
+    int refCount;
+    duint refs[DECODED_MAX_REFS]; // immediate and memory operands in operand order, memory operands are disp (+ next instruction when rip-relative)
+    bool refImm[DECODED_MAX_REFS];
+};
+
+bool InstructionDecode(Capstone & cp, duint addr, const unsigned char* data, int maxSize, DECODEDINSTR & instr);
+
+// Linear sweep of a range (invalid bytes are skipped one at a time) in structure-of-arrays form
+class InstructionStore
+{
+public:
+    static const size_t npos = size_t(-1);
+
+    static void HashPages(const unsigned char* data, duint size, std::vector<duint> & pageHashes);
+
+    void Build(duint base, const unsigned char* data, duint size, duint serial, std::vector<duint> && pageHashes);
+    // Re-decodes the instructions on the pages that differ from previous and copies the rest
+    void Update(const InstructionStore & previous, const unsigned char* data, duint serial, std::vector<duint> && pageHashes);
+    duint Base() const;
+    duint Size() const;
+    duint Serial() const;
+    const std::vector<duint> & PageHashes() const;
+    size_t Count() const;
+
+    // Ranges that were re-decoded since the store with the given serial, false if it is not a predecessor of this store
+    bool ChangesSince(duint serial, std::vector<std::pair<duint, duint>> & ranges) const;
+
+    // Index of the instruction starting at addr, hint is the index of the previous instruction (npos if unknown)
+    size_t Find(duint addr, size_t hint = npos) const;
+    // Index of the first instruction at or after addr (Count() if there is none)
+    size_t LowerBound(duint addr) const;
+    void Get(size_t index, DECODEDINSTR & instr) const;
+
+private:
+    struct CHANGE
+    {
+        duint serial;
+        duint start;
+        duint end;
+    };
+
+    duint mBase = 0;
+    duint mSize = 0;
+    duint mSerial = 0;
+    duint mFirstSerial = 0; // oldest store covered by mChanges
+    std::vector<CHANGE> mChanges;
+    std::vector<duint> mPageHashes;
+    std::vector<DWORD> mOffsets;
+    std::vector<unsigned char> mSizes;
+    std::vector<WORD> mFlags;
+    std::vector<unsigned char> mRefs; // low nibble: count, high nibble: immediate mask
+    std::vector<DWORD> mValueIndex; // first entry in mValues: branch (if any) followed by the refs
+    std::vector<duint> mValues;
+
+    void append(const DECODEDINSTR & instr);
+    void appendRange(const InstructionStore & other, size_t first, size_t last);
+};
+
+// Shared stores of the most recently analysed ranges, the changed pages are re-decoded when the memory was modified
+std::shared_ptr<const InstructionStore> InstructionStoreGet(duint base, const unsigned char* data, duint size);
+void InstructionStoreClear();
+
+#endif // _INSTRUCTIONSTORE_H
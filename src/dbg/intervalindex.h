@@ -0,0 +1,164 @@
+#ifndef _INTERVALINDEX_H
+#define _INTERVALINDEX_H
+
+#include "_global.h"
+#include <algorithm>
+
+// Static index over inclusive (possibly nested) intervals. The intervals are stored in a flat array sorted by start
+// that doubles as an implicit binary tree: the node at index i has the level k of the number of trailing one bits
+// in i, its children are at i - 2^(k-1) and i + 2^(k-1) and mMaxEnd[i] is the largest end in its subtree.
+// Build is O(n log n), a query is O(log n + number of results) and reports the intervals ordered by start.
+template<class TValue>
+class IntervalIndex
+{
+public:
+    struct Entry
+    {
+        duint start;
+        duint end;
+        TValue value;
+    };
+
+    void Clear()
+    {
+        mEntries.clear();
+        mMaxEnd.clear();
+        mRootLevel = -1;
+    }
+
+    void Reserve(size_t count)
+    {
+        mEntries.reserve(count);
+    }
+
+    // Call Build after adding the last interval
+    void Add(duint start, duint end, const TValue & value)
+    {
+        Entry entry;
+        entry.start = start;
+        entry.end = end;
+        entry.value = value;
+        mEntries.push_back(entry);
+    }
+
+    void Build()
+    {
+        // Sort by start, enclosing intervals before the intervals they contain
+        std::sort(mEntries.begin(), mEntries.end(), [](const Entry & a, const Entry & b)
+        {
+            if(a.start != b.start)
+                return a.start < b.start;
+            return a.end > b.end;
+        });
+
+        auto n = mEntries.size();
+        mMaxEnd.resize(n);
+        mRootLevel = n ? 0 : -1;
+        for(size_t i = 0; i < n; i += 2)
+            mMaxEnd[i] = mEntries[i].end;
+        for(int k = 1; (size_t(1) << k) <= n; k++)
+        {
+            auto half = size_t(1) << (k - 1);
+            for(size_t i = (size_t(1) << k) - 1; i < n; i += size_t(1) << (k + 1))
+            {
+                auto maxEnd = max(mEntries[i].end, mMaxEnd[i - half]);
+                duint rightMaxEnd;
+                if(subtreeMaxEnd(i + half, k - 1, rightMaxEnd))
+                    maxEnd = max(maxEnd, rightMaxEnd);
+                mMaxEnd[i] = maxEnd;
+            }
+            mRootLevel = k;
+        }
+    }
+
+    bool Empty() const
+    {
+        return mEntries.empty();
+    }
+
+    size_t Size() const
+    {
+        return mEntries.size();
+    }
+
+    // Calls callback(const Entry &) for every interval that overlaps [start, end], stops when it returns false
+    template<class TCallback>
+    bool Query(duint start, duint end, TCallback callback) const
+    {
+        struct Node
+        {
+            size_t index;
+            int level;
+            bool leftDone;
+        };
+
+        if(mRootLevel < 0)
+            return true;
+
+        auto n = mEntries.size();
+        Node stack[sizeof(size_t) * 8 * 2 + 2];
+        int top = 0;
+        stack[top++] = { (size_t(1) << mRootLevel) - 1, mRootLevel, false };
+        while(top)
+        {
+            auto node = stack[--top];
+            if(node.level <= 2)
+            {
+                // Small subtree, scan it linearly
+                auto i = node.index >> node.level << node.level;
+                auto last = min(i + (size_t(1) << (node.level + 1)) - 1, n);
+                for(; i < last && mEntries[i].start <= end; i++)
+                    if(mEntries[i].end >= start && !callback(mEntries[i]))
+                        return false;
+            }
+            else if(!node.leftDone)
+            {
+                // Visit the left subtree first, skip it if everything in it ends before start
+                auto left = node.index - (size_t(1) << (node.level - 1));
+                stack[top++] = { node.index, node.level, true };
+                if(left >= n || mMaxEnd[left] >= start)
+                    stack[top++] = { left, node.level - 1, false };
+            }
+            else if(node.index < n && mEntries[node.index].start <= end)
+            {
+                if(mEntries[node.index].end >= start && !callback(mEntries[node.index]))
+                    return false;
+                stack[top++] = { node.index + (size_t(1) << (node.level - 1)), node.level - 1, false };
+            }
+        }
+        return true;
+    }
+
+    // First interval (by start) that overlaps [start, end]
+    const Entry* Find(duint start, duint end) const
+    {
+        const Entry* found = nullptr;
+        Query(start, end, [&found](const Entry & entry)
+        {
+            found = &entry;
+            return false;
+        });
+        return found;
+    }
+
+private:
+    std::vector<Entry> mEntries;
+    std::vector<duint> mMaxEnd;
+    int mRootLevel = -1;
+
+    // Nodes past the end of the array only have (part of) their left subtree
+    bool subtreeMaxEnd(size_t index, int level, duint & maxEnd) const
+    {
+        while(index >= mEntries.size())
+        {
+            if(!level)
+                return false;
+            index -= size_t(1) << (level - 1);
+            level--;
+        }
+        maxEnd = mMaxEnd[index];
+        return true;
+    }
+};
+
+#endif // _INTERVALINDEX_H
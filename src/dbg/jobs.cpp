@@ -0,0 +1,410 @@
+/**
+ @file jobs.cpp
+
+ @brief Implements background jobs for long running searches.
+ */
+
+#include "jobs.h"
+#include "threading.h"
+#include "console.h"
+#include "command.h"
+#include "variable.h"
+
+// Minimum time between two reference view updates of a job (in milliseconds)
+#define JOB_FLUSH_INTERVAL 500
+
+// Number of finished job results kept for jobwait
+#define JOB_MAX_RESULTS 64
+
+struct JOBCELL
+{
+    int row;
+    int col;
+    String text;
+};
+
+struct JOBCOLUMN
+{
+    int width;
+    String title;
+};
+
+struct JOBINFO
+{
+    unsigned int id;
+    String name;
+    CBJOB callback;
+    HANDLE hThread;
+    HANDLE hDone; // signalled when the job finished
+    DWORD ticks;
+    volatile bool cancel;
+    volatile int progress;
+    bool hasResult;
+    duint result;
+
+    // Reference view output, only accessed by the thread running the job
+    int viewId;
+    std::vector<JOBCOLUMN> columns;
+    int searchStartCol;
+    int rowCount;
+    int flushedRowCount;
+    std::vector<JOBCELL> cells;
+    DWORD flushTicks;
+    int taskProgress;
+    String taskTitle;
+};
+
+static std::map<unsigned int, JOBINFO> jobs;
+static std::map<unsigned int, duint> jobResults;
+static unsigned int lastJobId = 0;
+
+static JOBINFO* jobGet(unsigned int Id)
+{
+    // The entry is only erased by the thread running the job, so the pointer stays valid for it
+    SHARED_ACQUIRE(LockJobs);
+    auto found = jobs.find(Id);
+    return found != jobs.end() ? &found->second : nullptr;
+}
+
+static void jobRefFlush(JOBINFO & Job)
+{
+    if(!Job.viewId)
+        return;
+
+    // The update is addressed to the job's own view, the view the bridge writes to is left alone
+    std::vector<REFCOLUMNINFO> columns(Job.columns.size());
+    for(size_t i = 0; i < columns.size(); i++)
+    {
+        columns[i].width = Job.columns[i].width;
+        columns[i].title = Job.columns[i].title.c_str();
+    }
+    std::vector<CELLINFO> cells(Job.cells.size());
+    for(size_t i = 0; i < cells.size(); i++)
+    {
+        cells[i].row = Job.cells[i].row;
+        cells[i].col = Job.cells[i].col;
+        cells[i].str = Job.cells[i].text.c_str();
+    }
+    REFVIEWUPDATE update;
+    memset(&update, 0, sizeof(REFVIEWUPDATE));
+    update.id = Job.viewId;
+    update.columnCount = int(columns.size());
+    update.columns = columns.data();
+    update.searchStartCol = Job.searchStartCol;
+    update.rowCount = Job.rowCount != Job.flushedRowCount ? Job.rowCount : -1;
+    update.cellCount = int(cells.size());
+    update.cells = cells.data();
+    update.progress = Job.progress;
+    update.taskProgress = Job.taskProgress;
+    update.taskTitle = Job.taskTitle.empty() ? nullptr : Job.taskTitle.c_str();
+    if(!GuiReferenceUpdateView(&update))
+    {
+        // The reference view was closed, there is nobody left to look at the results
+        Job.cancel = true;
+        Job.viewId = 0;
+    }
+    Job.columns.clear();
+    Job.searchStartCol = -1;
+    Job.flushedRowCount = Job.rowCount;
+    Job.cells.clear();
+    Job.flushTicks = GetTickCount();
+}
+
+static void jobRefUpdate(JOBINFO & Job)
+{
+    if(GetTickCount() - Job.flushTicks >= JOB_FLUSH_INTERVAL)
+        jobRefFlush(Job);
+}
+
+static bool jobRun(unsigned int Id)
+{
+    auto job = jobGet(Id);
+    bool result = job->callback(Id);
+
+    // Show the remaining results
+    jobRefFlush(*job);
+    if(job->cancel)
+        dprintf("Job %X (%s) cancelled after %ums\n", Id, job->name.c_str(), GetTickCount() - job->ticks);
+
+    // Jobs that run inline return their result like any other command, the others keep it for jobwait
+    bool inlineJob = !job->hThread;
+    bool hasResult = job->hasResult;
+    duint jobResult = job->result;
+
+    EXCLUSIVE_ACQUIRE(LockJobs);
+    if(hasResult && !inlineJob)
+    {
+        if(jobResults.size() >= JOB_MAX_RESULTS)
+            jobResults.erase(jobResults.begin());
+        jobResults[Id] = jobResult;
+    }
+    SetEvent(job->hDone);
+    CloseHandle(job->hDone);
+    if(job->hThread)
+        CloseHandle(job->hThread);
+    jobs.erase(Id);
+    EXCLUSIVE_RELEASE();
+
+    if(hasResult && inlineJob)
+        varset("$result", jobResult, false);
+    return result;
+}
+
+static HANDLE jobDuplicateDoneHandle(const JOBINFO & Job)
+{
+    HANDLE hDone = nullptr;
+    if(!DuplicateHandle(GetCurrentProcess(), Job.hDone, GetCurrentProcess(), &hDone, 0, FALSE, DUPLICATE_SAME_ACCESS))
+        return nullptr;
+    return hDone;
+}
+
+static DWORD WINAPI jobThread(void* lpParameter)
+{
+    jobRun((unsigned int)(duint)lpParameter);
+    return 0;
+}
+
+bool JobStart(const char* Name, const CBJOB & Callback)
+{
+    EXCLUSIVE_ACQUIRE(LockJobs);
+    unsigned int id = ++lastJobId;
+    JOBINFO & job = jobs[id];
+    job.id = id;
+    job.name = Name;
+    job.callback = Callback;
+    job.hThread = nullptr;
+    job.hDone = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    job.ticks = GetTickCount();
+    job.cancel = false;
+    job.progress = 0;
+    job.hasResult = false;
+    job.result = 0;
+    job.viewId = 0;
+    job.searchStartCol = -1;
+    job.rowCount = 0;
+    job.flushedRowCount = 0;
+    job.flushTicks = 0;
+    job.taskProgress = 0;
+
+    // Only commands typed by the user run in the background, scripts expect the results when the command returns
+    if(!cmdisloopthread())
+    {
+        EXCLUSIVE_RELEASE();
+        return jobRun(id);
+    }
+
+    job.hThread = CreateThread(nullptr, 0, jobThread, (void*)(duint)id, CREATE_SUSPENDED, nullptr);
+    if(!job.hThread)
+    {
+        CloseHandle(job.hDone);
+        jobs.erase(id);
+        dputs("Failed to create the job thread!");
+        return false;
+    }
+    dprintf("Job %X started: %s\n", id, Name);
+    ResumeThread(job.hThread);
+    EXCLUSIVE_RELEASE();
+
+    // The command returns before the job is done, use jobwait to get its result
+    varset("$result", id, false);
+    return true;
+}
+
+bool JobCancel(unsigned int Id)
+{
+    SHARED_ACQUIRE(LockJobs);
+    auto found = jobs.find(Id);
+    if(found == jobs.end())
+        return false;
+    found->second.cancel = true;
+    return true;
+}
+
+void JobCancelAll()
+{
+    std::vector<HANDLE> waitHandles;
+    SHARED_ACQUIRE(LockJobs);
+    for(auto & itr : jobs)
+    {
+        itr.second.cancel = true;
+        auto hDone = jobDuplicateDoneHandle(itr.second);
+        if(hDone)
+            waitHandles.push_back(hDone);
+    }
+    SHARED_RELEASE();
+
+    // Wait for the jobs to finish
+    for(auto hDone : waitHandles)
+    {
+        WaitForSingleObject(hDone, INFINITE);
+        CloseHandle(hDone);
+    }
+}
+
+bool JobWait(unsigned int Id, duint* Result)
+{
+    SHARED_ACQUIRE(LockJobs);
+    auto found = jobs.find(Id);
+    HANDLE hDone = found != jobs.end() ? jobDuplicateDoneHandle(found->second) : nullptr;
+    SHARED_RELEASE();
+    if(hDone)
+    {
+        WaitForSingleObject(hDone, INFINITE);
+        CloseHandle(hDone);
+    }
+
+    SHARED_REACQUIRE();
+    auto result = jobResults.find(Id);
+    if(result == jobResults.end())
+        return false;
+    if(Result)
+        *Result = result->second;
+    return true;
+}
+
+void JobWaitAll()
+{
+    std::vector<HANDLE> waitHandles;
+    SHARED_ACQUIRE(LockJobs);
+    for(auto & itr : jobs)
+    {
+        auto hDone = jobDuplicateDoneHandle(itr.second);
+        if(hDone)
+            waitHandles.push_back(hDone);
+    }
+    SHARED_RELEASE();
+
+    for(auto hDone : waitHandles)
+    {
+        WaitForSingleObject(hDone, INFINITE);
+        CloseHandle(hDone);
+    }
+}
+
+void JobSetResult(unsigned int Id, duint Result)
+{
+    auto job = jobGet(Id);
+    if(!job)
+    {
+        varset("$result", Result, false);
+        return;
+    }
+    job->result = Result;
+    job->hasResult = true;
+}
+
+bool JobIsCancelled(unsigned int Id)
+{
+    if(!Id)
+        return false;
+    auto job = jobGet(Id);
+    return !job || job->cancel;
+}
+
+void JobPrintList()
+{
+    SHARED_ACQUIRE(LockJobs);
+    for(const auto & itr : jobs)
+    {
+        const JOBINFO & job = itr.second;
+        dprintf("%X: %s, %d%%, %ums%s\n", job.id, job.name.c_str(), job.progress, GetTickCount() - job.ticks, job.cancel ? " (cancelling)" : "");
+    }
+    dprintf("%d job(s) listed\n", int(jobs.size()));
+}
+
+void JobRefInitialize(unsigned int Id, const char* Name)
+{
+    auto job = jobGet(Id);
+    if(!job)
+    {
+        GuiReferenceInitialize(Name);
+        return;
+    }
+    job->viewId = GuiReferenceInitializeView(Name);
+}
+
+void JobRefAddColumn(unsigned int Id, int Width, const char* Title)
+{
+    auto job = jobGet(Id);
+    if(!job)
+    {
+        GuiReferenceAddColumn(Width, Title);
+        return;
+    }
+    JOBCOLUMN column;
+    column.width = Width;
+    column.title = Title;
+    job->columns.push_back(column);
+    jobRefFlush(*job);
+}
+
+void JobRefSetSearchStartCol(unsigned int Id, int Col)
+{
+    auto job = jobGet(Id);
+    if(!job)
+    {
+        GuiReferenceSetSearchStartCol(Col);
+        return;
+    }
+    job->searchStartCol = Col;
+    jobRefFlush(*job);
+}
+
+void JobRefSetRowCount(unsigned int Id, int Count)
+{
+    auto job = jobGet(Id);
+    if(!job)
+        GuiReferenceSetRowCount(Count);
+    else
+        job->rowCount = Count;
+}
+
+void JobRefSetCellContent(unsigned int Id, int Row, int Col, const char* Str)
+{
+    auto job = jobGet(Id);
+    if(!job)
+    {
+        GuiReferenceSetCellContent(Row, Col, Str);
+        return;
+    }
+    JOBCELL cell;
+    cell.row = Row;
+    cell.col = Col;
+    cell.text = Str;
+    job->cells.push_back(cell);
+    jobRefUpdate(*job);
+}
+
+void JobRefSetProgress(unsigned int Id, int Progress)
+{
+    auto job = jobGet(Id);
+    if(!job)
+    {
+        GuiReferenceSetProgress(Progress);
+        return;
+    }
+    job->progress = Progress;
+    jobRefUpdate(*job);
+}
+
+void JobRefSetCurrentTaskProgress(unsigned int Id, int Progress, const char* TaskTitle)
+{
+    auto job = jobGet(Id);
+    if(!job)
+    {
+        GuiReferenceSetCurrentTaskProgress(Progress, TaskTitle);
+        return;
+    }
+    job->taskProgress = Progress;
+    job->taskTitle = TaskTitle;
+    jobRefUpdate(*job);
+}
+
+void JobRefReloadData(unsigned int Id)
+{
+    auto job = jobGet(Id);
+    if(!job)
+        GuiReferenceReloadData();
+    else
+        jobRefUpdate(*job);
+}
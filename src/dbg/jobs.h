@@ -0,0 +1,33 @@
+#ifndef _JOBS_H
+#define _JOBS_H
+
+#include "_global.h"
+#include <functional>
+
+// Job callback typedef, receives the id of the running job
+typedef std::function<bool(unsigned int)> CBJOB;
+
+bool JobStart(const char* Name, const CBJOB & Callback);
+bool JobCancel(unsigned int Id);
+void JobCancelAll();
+bool JobIsCancelled(unsigned int Id);
+void JobPrintList();
+
+// Waits for a job started in the background and gets the result it set (false when there is none)
+bool JobWait(unsigned int Id, duint* Result);
+void JobWaitAll();
+
+// Sets the $result of a job, directly for jobs that run inline and through jobwait for background jobs
+void JobSetResult(unsigned int Id, duint Result);
+
+// Reference view output of a job (Id 0 writes directly to the current reference view)
+void JobRefInitialize(unsigned int Id, const char* Name);
+void JobRefAddColumn(unsigned int Id, int Width, const char* Title);
+void JobRefSetSearchStartCol(unsigned int Id, int Col);
+void JobRefSetRowCount(unsigned int Id, int Count);
+void JobRefSetCellContent(unsigned int Id, int Row, int Col, const char* Str);
+void JobRefSetProgress(unsigned int Id, int Progress);
+void JobRefSetCurrentTaskProgress(unsigned int Id, int Progress, const char* TaskTitle);
+void JobRefReloadData(unsigned int Id);
+
+#endif // _JOBS_H
@@ -46,6 +46,9 @@ protected:
 
 static Labels labels;
 
+// Incremented on every change, used to invalidate caches that resolve label names
+static volatile LONG labelgeneration = 0;
+
 bool LabelSet(duint Address, const char* Text, bool Manual)
 {
     // A valid memory address must be supplied
@@ -75,6 +78,7 @@ bool LabelSet(duint Address, const char* Text, bool Manual)
     if(!ModNameFromAddr(Address, labelInfo.mod, true))
         *labelInfo.mod = '\0';
 
+    InterlockedIncrement(&labelgeneration);
     return labels.Add(labelInfo);
 }
 
@@ -102,11 +106,13 @@ bool LabelGet(duint Address, char* Text)
 
 bool LabelDelete(duint Address)
 {
+    InterlockedIncrement(&labelgeneration);
     return labels.Delete(Labels::VaKey(Address));
 }
 
 void LabelDelRange(duint Start, duint End, bool Manual)
 {
+    InterlockedIncrement(&labelgeneration);
     labels.DeleteRange(Start, End, [Manual](duint start, duint end, const LABELSINFO & value)
     {
         if(Manual ? !value.manual : value.manual)  //ignore non-matching entries
@@ -124,6 +130,7 @@ void LabelCacheLoad(JSON Root)
 {
     labels.CacheLoad(Root);
     labels.CacheLoad(Root, false, "auto"); //legacy support
+    InterlockedIncrement(&labelgeneration);
 }
 
 bool LabelEnum(LABELSINFO* List, size_t* Size)
@@ -134,6 +141,7 @@ bool LabelEnum(LABELSINFO* List, size_t* Size)
 void LabelClear()
 {
     labels.Clear();
+    InterlockedIncrement(&labelgeneration);
 }
 
 void LabelGetList(std::vector<LABELSINFO> & list)
@@ -145,3 +153,8 @@ bool LabelGetInfo(duint Address, LABELSINFO* info)
 {
     return labels.GetInfo(Address, info);
 }
+
+duint LabelGetGeneration()
+{
+    return duint(labelgeneration);
+}
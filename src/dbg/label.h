@@ -22,5 +22,6 @@ bool LabelEnum(LABELSINFO* List, size_t* Size);
 void LabelClear();
 void LabelGetList(std::vector<LABELSINFO> & list);
 bool LabelGetInfo(duint Address, LABELSINFO* info);
+duint LabelGetGeneration();
 
 #endif // _LABEL_H
\ No newline at end of file
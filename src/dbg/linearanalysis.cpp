@@ -3,6 +3,8 @@
 #include "memory.h"
 #include "function.h"
 
+AnalysisResultCache<LinearAnalysis::Result> LinearAnalysis::mResults;
+
 LinearAnalysis::LinearAnalysis(duint base, duint size) : Analysis(base, size)
 {
 }
@@ -12,22 +14,50 @@ void LinearAnalysis::Analyse()
     dputs("Starting analysis...");
     auto ticks = GetTickCount();
 
-    populateReferences();
-    dprintf("%u called functions populated\n", mFunctions.size());
+    //only redo what depends on changed bytes if this range was analysed before
+    std::vector<std::pair<duint, duint>> changes;
+    auto previous = mResults.Get(mBase, mSize);
+    if(previous && changesSince(previous->serial, changes))
+    {
+        updateReferences(*previous, changes);
+        populateFunctions();
+        reuseFunctions(*previous, changes);
+        dprintf("%u changed range(s), %u called functions populated\n", changes.size(), mFunctions.size());
+    }
+    else
+    {
+        populateReferences();
+        populateFunctions();
+        dprintf("%u called functions populated\n", mFunctions.size());
+    }
     analyseFunctions();
 
+    auto result = std::make_shared<Result>();
+    result->base = mBase;
+    result->size = mSize;
+    result->serial = store().Serial();
+    result->functions = mFunctions;
+    result->references = mReferences;
+    mResults.Put(result);
+
     dprintf("Analysis finished in %ums!\n", GetTickCount() - ticks);
 }
 
 void LinearAnalysis::SetMarkers()
 {
-    FunctionDelRange(mBase, mBase + mSize - 1, false);
+    std::vector<FUNCTIONRANGE> functions;
+    functions.reserve(mFunctions.size());
     for(auto & function : mFunctions)
     {
         if(!function.end)
             continue;
-        FunctionAdd(function.start, function.end, false);
+        FUNCTIONRANGE range;
+        range.start = function.start;
+        range.end = function.end;
+        range.instructioncount = 0;
+        functions.push_back(range);
     }
+    FunctionReplaceRange(mBase, mBase + mSize - 1, functions);
 }
 
 void LinearAnalysis::sortCleanup()
@@ -44,19 +74,73 @@ void LinearAnalysis::populateReferences()
     for(duint i = 0; i < mSize;)
     {
         auto addr = mBase + i;
-        if(mCp.Disassemble(addr, translateAddr(addr), MAX_DISASM_BUFFER))
+        DECODEDINSTR instr;
+        if(decode(addr, instr))
         {
-            auto ref = getReferenceOperand();
+            auto ref = getReferenceOperand(instr);
             if(ref)
-                mFunctions.push_back({ ref, 0 });
-            i += mCp.Size();
+                mReferences.push_back({ addr, ref });
+            i += instr.size;
         }
         else
             i++;
     }
+}
+
+void LinearAnalysis::updateReferences(const Result & previous, const std::vector<std::pair<duint, duint>> & changes)
+{
+    //keep the references of the instructions that were not decoded again
+    for(const auto & reference : previous.references)
+        if(!rangesOverlap(changes, reference.from, reference.from + 1))
+            mReferences.push_back(reference);
+
+    //rescan the changed ranges
+    for(const auto & change : changes)
+    {
+        DECODEDINSTR instr;
+        for(auto index = store().LowerBound(change.first); index < store().Count(); index++)
+        {
+            store().Get(index, instr);
+            if(instr.addr >= change.second)
+                break;
+            if(!instr.size)
+                continue;
+            auto ref = getReferenceOperand(instr);
+            if(ref)
+                mReferences.push_back({ instr.addr, ref });
+        }
+    }
+    std::sort(mReferences.begin(), mReferences.end());
+}
+
+void LinearAnalysis::populateFunctions()
+{
+    mFunctions.clear();
+    mFunctions.reserve(mReferences.size());
+    for(const auto & reference : mReferences)
+        mFunctions.push_back({ reference.to, 0, 0 });
     sortCleanup();
 }
 
+void LinearAnalysis::reuseFunctions(const Result & previous, const std::vector<std::pair<duint, duint>> & changes)
+{
+    //a function end only has to be found again if its boundary moved or it was found by reading changed bytes
+    const auto & functions = previous.functions;
+    for(size_t i = 0; i < mFunctions.size(); i++)
+    {
+        auto & function = mFunctions[i];
+        auto found = std::lower_bound(functions.begin(), functions.end(), function);
+        if(found == functions.end() || found->start != function.start || !found->end)
+            continue;
+        auto maxaddr = i + 1 < mFunctions.size() ? mFunctions[i + 1].start : mBase + mSize;
+        auto previousMaxaddr = found + 1 != functions.end() ? (found + 1)->start : mBase + mSize;
+        if(maxaddr != previousMaxaddr || rangesOverlap(changes, function.start, found->scanEnd + MAX_DISASM_BUFFER))
+            continue;
+        function.end = found->end;
+        function.scanEnd = found->scanEnd;
+    }
+}
+
 void LinearAnalysis::analyseFunctions()
 {
     for(size_t i = 0; i < mFunctions.size(); i++)
@@ -68,24 +152,28 @@ void LinearAnalysis::analyseFunctions()
         if(i < mFunctions.size() - 1)
             maxaddr = mFunctions[i + 1].start;
 
-        auto end = findFunctionEnd(function.start, maxaddr);
+        auto end = findFunctionEnd(function.start, maxaddr, function.scanEnd);
         if(end)
         {
-            if(mCp.Disassemble(end, translateAddr(end), MAX_DISASM_BUFFER))
-                function.end = end + mCp.Size() - 1;
+            DECODEDINSTR instr;
+            if(decode(end, instr))
+                function.end = end + instr.size - 1;
             else
                 function.end = end;
         }
     }
 }
 
-duint LinearAnalysis::findFunctionEnd(duint start, duint maxaddr)
+duint LinearAnalysis::findFunctionEnd(duint start, duint maxaddr, duint & scanEnd)
 {
     //disassemble first instruction for some heuristics
-    if(mCp.Disassemble(start, translateAddr(start), MAX_DISASM_BUFFER))
+    DECODEDINSTR instr;
+    scanEnd = start + 1;
+    if(decode(start, instr))
     {
+        scanEnd = start + instr.size;
         //JMP [123456] ; import
-        if(mCp.InGroup(CS_GRP_JUMP) && mCp.x86().operands[0].type == X86_OP_MEM)
+        if((instr.flags & DECODED_JUMP) && (instr.flags & DECODED_OP0MEM))
             return 0;
     }
 
@@ -94,15 +182,16 @@ duint LinearAnalysis::findFunctionEnd(duint start, duint maxaddr)
     duint jumpback = 0;
     for(duint addr = start, fardest = 0; addr < maxaddr;)
     {
-        if(mCp.Disassemble(addr, translateAddr(addr), MAX_DISASM_BUFFER))
+        scanEnd = max(scanEnd, addr + 1);
+        if(decode(addr, instr))
         {
-            if(addr + mCp.Size() > maxaddr)  //we went past the maximum allowed address
+            scanEnd = max(scanEnd, addr + instr.size);
+            if(addr + instr.size > maxaddr)  //we went past the maximum allowed address
                 break;
 
-            const auto & op = mCp.x86().operands[0];
-            if((mCp.InGroup(CS_GRP_JUMP) || mCp.IsLoop()) && op.type == X86_OP_IMM)   //jump
+            if((instr.flags & (DECODED_JUMP | DECODED_LOOP)) && (instr.flags & DECODED_OP0IMM))   //jump
             {
-                auto dest = duint(op.imm);
+                auto dest = instr.refs[0];
 
                 if(dest >= maxaddr)   //jump across function boundaries
                 {
@@ -112,19 +201,19 @@ duint LinearAnalysis::findFunctionEnd(duint start, duint maxaddr)
                 {
                     fardest = dest;
                 }
-                else if(end && dest < end && (mCp.GetId() == X86_INS_JMP || mCp.GetId() == X86_INS_LOOP)) //save the last JMP backwards
+                else if(end && dest < end && (instr.flags & (DECODED_JMP | DECODED_LOOPINS))) //save the last JMP backwards
                 {
                     jumpback = addr;
                 }
             }
-            else if(mCp.InGroup(CS_GRP_RET))   //possible function end?
+            else if(instr.flags & DECODED_RET)   //possible function end?
             {
                 end = addr;
                 if(fardest < addr)  //we stop if the farthest JXX destination forward is before this RET
                     break;
             }
 
-            addr += mCp.Size();
+            addr += instr.size;
         }
         else
             addr++;
@@ -132,16 +221,15 @@ duint LinearAnalysis::findFunctionEnd(duint start, duint maxaddr)
     return end < jumpback ? jumpback : end;
 }
 
-duint LinearAnalysis::getReferenceOperand() const
+duint LinearAnalysis::getReferenceOperand(const DECODEDINSTR & instr) const
 {
-    for(auto i = 0; i < mCp.OpCount(); i++)
+    if(instr.flags & (DECODED_JUMP | DECODED_LOOP))  //skip jumps/loops
+        return 0;
+    for(auto i = 0; i < instr.refCount; i++)
     {
-        const auto & op = mCp.x86().operands[i];
-        if(mCp.InGroup(CS_GRP_JUMP) || mCp.IsLoop())  //skip jumps/loops
-            continue;
-        if(op.type == X86_OP_IMM)  //we are looking for immediate references
+        if(instr.refImm[i])  //we are looking for immediate references
         {
-            auto dest = duint(op.imm);
+            auto dest = instr.refs[i];
             if(inRange(dest))
                 return dest;
         }
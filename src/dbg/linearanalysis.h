@@ -16,6 +16,7 @@ private:
     {
         duint start;
         duint end;
+        duint scanEnd; //end of the bytes read to find the function end
 
         bool operator<(const FunctionInfo & b) const
         {
@@ -28,13 +29,40 @@ private:
         }
     };
 
+    struct Reference
+    {
+        duint from;
+        duint to;
+
+        bool operator<(const Reference & b) const
+        {
+            return from < b.from;
+        }
+    };
+
+    //everything a later run needs to redo only what depends on changed bytes
+    struct Result
+    {
+        duint base;
+        duint size;
+        duint serial;
+        std::vector<FunctionInfo> functions;
+        std::vector<Reference> references;
+    };
+
+    static AnalysisResultCache<Result> mResults;
+
     std::vector<FunctionInfo> mFunctions;
+    std::vector<Reference> mReferences;
 
     void sortCleanup();
     void populateReferences();
+    void updateReferences(const Result & previous, const std::vector<std::pair<duint, duint>> & changes);
+    void populateFunctions();
+    void reuseFunctions(const Result & previous, const std::vector<std::pair<duint, duint>> & changes);
     void analyseFunctions();
-    duint findFunctionEnd(duint start, duint maxaddr);
-    duint getReferenceOperand() const;
+    duint findFunctionEnd(duint start, duint maxaddr, duint & scanEnd);
+    duint getReferenceOperand(const DECODEDINSTR & instr) const;
 };
 
 #endif //_LINEARANALYSIS_H
\ No newline at end of file
@@ -2,8 +2,89 @@
 #include "memory.h"
 #include "threading.h"
 #include "module.h"
+#include "intervalindex.h"
 
 std::map<DepthModuleRange, LOOPSINFO, DepthModuleRangeCompare> loops;
+static duint loopsGeneration = 0;
+
+// Flat interval index per module hash with the loops of all depths, rebuilt when the loops changed
+static std::unordered_map<duint, IntervalIndex<const LOOPSINFO*>> loopsIndex;
+static duint loopsIndexGeneration = ~0;
+
+static bool loopIndexIsStale()
+{
+    return loopsIndexGeneration != loopsGeneration;
+}
+
+static void loopIndexUpdate()
+{
+    // Unsynchronized check first, the disassembly asks for every visible row
+    if(!loopIndexIsStale())
+        return;
+
+    EXCLUSIVE_ACQUIRE(LockLoops);
+    if(!loopIndexIsStale())
+        return;
+
+    loopsIndex.clear();
+    for(const auto & itr : loops)
+        loopsIndex[itr.first.second.first].Add(itr.second.start, itr.second.end, &itr.second);
+    for(auto & itr : loopsIndex)
+        itr.second.Build();
+    loopsIndexGeneration = loopsGeneration;
+}
+
+// Collects the loops overlapping [Start, End] (virtual addresses in the module of Start), ordered by start
+static void loopQuery(duint Start, duint End, std::vector<LOOPSINFO> & Loops, duint* ModuleBase)
+{
+    auto moduleBase = ModBaseFromAddr(Start);
+    auto key = ModHashFromAddr(moduleBase);
+    if(ModuleBase)
+        *ModuleBase = moduleBase;
+    while(true)
+    {
+        loopIndexUpdate();
+
+        SHARED_ACQUIRE(LockLoops);
+
+        // Loops changed after the update, do it again
+        if(loopIndexIsStale())
+            continue;
+
+        Loops.clear();
+        auto index = loopsIndex.find(key);
+        if(index == loopsIndex.end())
+            return;
+        index->second.Query(Start - moduleBase, End - moduleBase, [&Loops](const IntervalIndex<const LOOPSINFO*>::Entry & entry)
+        {
+            Loops.push_back(*entry.value);
+            return true;
+        });
+        return;
+    }
+}
+
+// Loops of one depth never overlap each other, so the map finds the loop overlapping a range at every depth
+// without the index (which the next query would have to rebuild after every LoopAdd). Requires LockLoops.
+static bool loopOverlapsLocked(int Depth, duint Key, duint Start, duint End, int* FinalDepth, duint* Parent)
+{
+    if(Parent)
+        *Parent = 0;
+    for(;; Depth++)
+    {
+        auto found = loops.find(DepthModuleRange(Depth, ModuleRange(Key, Range(Start, End))));
+        if(found != loops.end() && found->second.start < Start && found->second.end > End)
+        {
+            // The range fits in this loop, look at the next depth
+            if(Parent)
+                *Parent = found->second.start;
+            continue;
+        }
+        if(FinalDepth)
+            *FinalDepth = Depth;
+        return found != loops.end();
+    }
+}
 
 bool LoopAdd(duint Start, duint End, bool Manual)
 {
@@ -23,30 +104,27 @@ bool LoopAdd(duint Start, duint End, bool Manual)
     if(moduleBase != ModBaseFromAddr(End))
         return false;
 
-    // Loops cannot overlap other loops
-    int finalDepth = 0;
-
-    if(LoopOverlaps(0, Start, End, &finalDepth))
-        return false;
-
     // Fill out loop information structure
     LOOPSINFO loopInfo;
     loopInfo.start = Start - moduleBase;
     loopInfo.end = End - moduleBase;
-    loopInfo.depth = finalDepth;
     loopInfo.manual = Manual;
     ModNameFromAddr(Start, loopInfo.mod, true);
-
-    // Link this to a parent loop if one does exist
-    if(finalDepth)
-        LoopGet(finalDepth - 1, Start, &loopInfo.parent, 0);
-    else
-        loopInfo.parent = 0;
+    duint key = ModHashFromAddr(moduleBase);
 
     EXCLUSIVE_ACQUIRE(LockLoops);
 
+    // Loops cannot overlap other loops, the parent is the innermost loop this one fits in
+    int finalDepth = 0;
+    duint parent = 0;
+    if(loopOverlapsLocked(0, key, loopInfo.start, loopInfo.end, &finalDepth, &parent))
+        return false;
+    loopInfo.depth = finalDepth;
+    loopInfo.parent = finalDepth ? parent + moduleBase : 0;
+
     // Insert into list
-    loops.insert(std::make_pair(DepthModuleRange(finalDepth, ModuleRange(ModHashFromAddr(moduleBase), Range(loopInfo.start, loopInfo.end))), loopInfo));
+    loopsGeneration++;
+    loops.insert(std::make_pair(DepthModuleRange(finalDepth, ModuleRange(key, Range(loopInfo.start, loopInfo.end))), loopInfo));
     return true;
 }
 
@@ -55,28 +133,39 @@ bool LoopGet(int Depth, duint Address, duint* Start, duint* End)
 {
     ASSERT_DEBUGGING("Export call");
 
-    // Get the virtual address module
-    const duint moduleBase = ModBaseFromAddr(Address);
+    // All loops containing the address, one per depth
+    std::vector<LOOPSINFO> found;
+    duint moduleBase;
+    loopQuery(Address, Address, found, &moduleBase);
 
-    // Virtual address to relative address
-    Address -= moduleBase;
+    for(const auto & loop : found)
+    {
+        if(loop.depth != Depth)
+            continue;
 
-    SHARED_ACQUIRE(LockLoops);
+        // Return the loop start and end
+        if(Start)
+            *Start = loop.start + moduleBase;
 
-    // Search with this address range
-    auto found = loops.find(DepthModuleRange(Depth, ModuleRange(ModHashFromAddr(moduleBase), Range(Address, Address))));
+        if(End)
+            *End = loop.end + moduleBase;
 
-    if(found == loops.end())
-        return false;
+        return true;
+    }
 
-    // Return the loop start and end
-    if(Start)
-        *Start = found->second.start + moduleBase;
+    return false;
+}
 
-    if(End)
-        *End = found->second.end + moduleBase;
+// Get the number of nested loops containing an address
+int LoopGetDepth(duint Address)
+{
+    std::vector<LOOPSINFO> found;
+    loopQuery(Address, Address, found, nullptr);
 
-    return true;
+    int depth = 0;
+    for(const auto & loop : found)
+        depth = max(depth, loop.depth + 1);
+    return depth;
 }
 
 // Check if a loop overlaps a range, inside is not overlapping
@@ -88,46 +177,8 @@ bool LoopOverlaps(int Depth, duint Start, duint End, int* FinalDepth)
     const duint moduleBase = ModBaseFromAddr(Start);
     const duint key = ModHashFromAddr(moduleBase);
 
-    duint curStart = Start - moduleBase;
-    duint curEnd = End - moduleBase;
-
     SHARED_ACQUIRE(LockLoops);
-
-    // Check if the new loop fits in the old loop
-    for(auto & itr : loops)
-    {
-        // Only look in the current module
-        if(itr.first.second.first != key)
-            continue;
-
-        // Loop must be at this recursive depth
-        if(itr.second.depth != Depth)
-            continue;
-
-        if(itr.second.start < curStart && itr.second.end > curEnd)
-            return LoopOverlaps(Depth + 1, curStart, curEnd, FinalDepth);
-    }
-
-    // Did the user request t the loop depth?
-    if(FinalDepth)
-        *FinalDepth = Depth;
-
-    // Check for loop overlaps
-    for(auto & itr : loops)
-    {
-        // Only look in the current module
-        if(itr.first.second.first != key)
-            continue;
-
-        // Loop must be at this recursive depth
-        if(itr.second.depth != Depth)
-            continue;
-
-        if(itr.second.start <= curEnd && itr.second.end >= curStart)
-            return true;
-    }
-
-    return false;
+    return loopOverlapsLocked(Depth, key, Start - moduleBase, End - moduleBase, FinalDepth, nullptr);
 }
 
 // This should delete a loop and all sub-loops that matches a certain addr
@@ -213,6 +264,7 @@ void LoopCacheLoad(JSON Root)
     };
 
     // Remove existing entries
+    loopsGeneration++;
     loops.clear();
 
     const JSON jsonLoops = json_object_get(Root, "loops");
@@ -260,5 +312,6 @@ bool LoopEnum(LOOPSINFO* List, size_t* Size)
 void LoopClear()
 {
     EXCLUSIVE_ACQUIRE(LockLoops);
+    loopsGeneration++;
     loops.clear();
 }
\ No newline at end of file
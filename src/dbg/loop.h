@@ -15,6 +15,7 @@ struct LOOPSINFO
 
 bool LoopAdd(duint Start, duint End, bool Manual);
 bool LoopGet(int Depth, duint Address, duint* Start, duint* End);
+int LoopGetDepth(duint Address);
 bool LoopOverlaps(int Depth, duint Start, duint End, int* FinalDepth);
 bool LoopDelete(int Depth, duint Address);
 void LoopCacheSave(JSON Root);
@@ -0,0 +1,215 @@
+/**
+ @file mementropy.cpp
+
+ @brief Implements byte histograms and entropy of memory ranges.
+ */
+
+#include "mementropy.h"
+#include "memory.h"
+#include "threading.h"
+#include "jobs.h"
+#include "murmurhash.h"
+#include <array>
+#include <cmath>
+
+// Bytes read from the debuggee at once, ranges of any size are measured with this much memory
+#define ENTROPY_CHUNK_SIZE 0x100000
+
+// Maximum number of page histograms in the cache (512 bytes each)
+#define ENTROPY_CACHE_PAGES 0x10000
+
+typedef std::array<unsigned short, 256> PAGEHISTOGRAM;
+
+struct RANGEENTROPY
+{
+    duint size;
+    double entropy;
+};
+
+// Histograms of page contents by hash, shared by every range (zero pages are everywhere)
+static std::unordered_map<unsigned long long, PAGEHISTOGRAM> pageCache;
+
+// Last measured entropy by range start
+static std::map<duint, RANGEENTROPY> rangeCache;
+
+static unsigned long long entropyPageHash(const unsigned char* data, int size)
+{
+    // 64 bits on both platforms, the cache holds pages from the whole address space
+    unsigned long long hash[2];
+    MurmurHash3_x64_128(data, size, 0x1337, hash);
+    return hash[0];
+}
+
+static void entropyCount(const unsigned char* data, duint size, PAGEHISTOGRAM & histogram)
+{
+    // Four tables keep runs of the same byte from waiting on each other's increments
+    unsigned int counts[4][256] = {};
+    duint i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+        counts[0][data[i]]++;
+        counts[1][data[i + 1]]++;
+        counts[2][data[i + 2]]++;
+        counts[3][data[i + 3]]++;
+    }
+    for(; i < size; i++)
+        counts[0][data[i]]++;
+    for(int j = 0; j < 256; j++)
+        histogram[j] = (unsigned short)(counts[0][j] + counts[1][j] + counts[2][j] + counts[3][j]);
+}
+
+static double entropyCalculate(const unsigned long long* histogram, unsigned long long total)
+{
+    double entropy = 0.0;
+    for(int i = 0; i < 256; i++)
+    {
+        if(!histogram[i])
+            continue;
+        double p = double(histogram[i]) / double(total);
+        entropy -= p * log2(p);
+    }
+    return entropy;
+}
+
+bool EntropyMeasure(duint Start, duint Size, duint WindowPages, ENTROPYRESULT & Result, unsigned int Job)
+{
+    Result.size = 0;
+    Result.entropy = 0.0;
+    Result.minWindow = 0.0;
+    Result.maxWindow = 0.0;
+    memset(Result.histogram, 0, sizeof(Result.histogram));
+    Result.windows.clear();
+    WindowPages = max(WindowPages, duint(1));
+
+    std::vector<unsigned char> chunk(size_t(min(Size, duint(ENTROPY_CHUNK_SIZE))));
+    std::vector<unsigned long long> hashes;
+    std::vector<PAGEHISTOGRAM> histograms;
+    std::vector<duint> pageSizes;
+    std::vector<size_t> missing;
+
+    // The histograms of the pages in the window, the oldest one is replaced by the next page
+    std::vector<PAGEHISTOGRAM> ring(WindowPages);
+    std::vector<duint> ringSizes(WindowPages);
+    unsigned long long window[256] = {};
+    duint windowSize = 0;
+    duint pageIndex = 0;
+    bool hasWindow = false;
+    auto addWindow = [&]()
+    {
+        if(!windowSize)
+        {
+            Result.windows.push_back(-1.0f);
+            return;
+        }
+        auto entropy = entropyCalculate(window, windowSize);
+        Result.windows.push_back(float(entropy));
+        Result.minWindow = hasWindow ? min(Result.minWindow, entropy) : entropy;
+        Result.maxWindow = hasWindow ? max(Result.maxWindow, entropy) : entropy;
+        hasWindow = true;
+    };
+
+    for(duint offset = 0; offset < Size; offset += chunk.size())
+    {
+        if(JobIsCancelled(Job))
+            return false;
+
+        // Read the chunk at once, page by page when part of it is not readable
+        auto chunkSize = min(duint(chunk.size()), Size - offset);
+        auto pageCount = size_t((chunkSize + PAGE_SIZE - 1) / PAGE_SIZE);
+        bool chunkRead = MemRead(Start + offset, chunk.data(), chunkSize);
+        hashes.resize(pageCount);
+        histograms.resize(pageCount);
+        pageSizes.resize(pageCount);
+        for(size_t i = 0; i < pageCount; i++)
+        {
+            auto data = chunk.data() + i * PAGE_SIZE;
+            auto size = min(duint(PAGE_SIZE), chunkSize - i * PAGE_SIZE);
+            pageSizes[i] = chunkRead || MemRead(Start + offset + i * PAGE_SIZE, data, size) ? size : 0;
+            if(pageSizes[i])
+                hashes[i] = entropyPageHash(data, int(size));
+        }
+
+        // Only count the pages that were not seen before
+        missing.clear();
+        SHARED_ACQUIRE(LockEntropy);
+        for(size_t i = 0; i < pageCount; i++)
+        {
+            if(!pageSizes[i])
+            {
+                histograms[i].fill(0);
+                continue;
+            }
+            auto found = pageCache.find(hashes[i]);
+            if(found != pageCache.end())
+                histograms[i] = found->second;
+            else
+                missing.push_back(i);
+        }
+        SHARED_RELEASE();
+        if(!missing.empty())
+        {
+            for(auto i : missing)
+                entropyCount(chunk.data() + i * PAGE_SIZE, pageSizes[i], histograms[i]);
+            EXCLUSIVE_ACQUIRE(LockEntropy);
+            if(pageCache.size() + missing.size() > ENTROPY_CACHE_PAGES)
+                pageCache.clear();
+            for(auto i : missing)
+                pageCache.emplace(hashes[i], histograms[i]);
+        }
+
+        for(size_t i = 0; i < pageCount; i++, pageIndex++)
+        {
+            const auto & histogram = histograms[i];
+            auto & oldest = ring[size_t(pageIndex % WindowPages)];
+            auto & oldestSize = ringSizes[size_t(pageIndex % WindowPages)];
+            if(pageIndex >= WindowPages)
+            {
+                for(int j = 0; j < 256; j++)
+                    window[j] -= oldest[j];
+                windowSize -= oldestSize;
+            }
+            for(int j = 0; j < 256; j++)
+            {
+                window[j] += histogram[j];
+                Result.histogram[j] += histogram[j];
+            }
+            windowSize += pageSizes[i];
+            Result.size += pageSizes[i];
+            oldest = histogram;
+            oldestSize = pageSizes[i];
+            if(pageIndex + 1 >= WindowPages)
+                addWindow();
+        }
+    }
+
+    // The range is shorter than a single window
+    if(pageIndex && pageIndex < WindowPages)
+        addWindow();
+
+    if(!Result.size)
+        return true;
+    Result.entropy = entropyCalculate(Result.histogram, Result.size);
+    RANGEENTROPY cached;
+    cached.size = Size;
+    cached.entropy = Result.entropy;
+    EXCLUSIVE_ACQUIRE(LockEntropy);
+    rangeCache[Start] = cached;
+    return true;
+}
+
+bool EntropyGetCached(duint Start, duint Size, double & Entropy)
+{
+    SHARED_ACQUIRE(LockEntropy);
+    auto found = rangeCache.find(Start);
+    if(found == rangeCache.end() || found->second.size != Size)
+        return false;
+    Entropy = found->second.entropy;
+    return true;
+}
+
+void EntropyClear()
+{
+    EXCLUSIVE_ACQUIRE(LockEntropy);
+    pageCache.clear();
+    rangeCache.clear();
+}
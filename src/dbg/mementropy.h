@@ -0,0 +1,21 @@
+#ifndef _MEMENTROPY_H
+#define _MEMENTROPY_H
+
+#include "_global.h"
+
+struct ENTROPYRESULT
+{
+    duint size; // number of bytes that could be read
+    double entropy; // Shannon entropy of the whole range in bits per byte (0-8)
+    double minWindow; // lowest entropy of a window
+    double maxWindow; // highest entropy of a window
+    unsigned long long histogram[256]; // number of occurrences of every byte value
+    std::vector<float> windows; // entropy of the window starting at every page (-1 when nothing in it could be read)
+};
+
+// Measures a range page by page, the windows are WindowPages pages long and slide one page at a time
+bool EntropyMeasure(duint Start, duint Size, duint WindowPages, ENTROPYRESULT & Result, unsigned int Job = 0);
+bool EntropyGetCached(duint Start, duint Size, double & Entropy);
+void EntropyClear();
+
+#endif // _MEMENTROPY_H
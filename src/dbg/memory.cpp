@@ -10,6 +10,7 @@
 #include "threading.h"
 #include "thread.h"
 #include "module.h"
+#include "jobs.h"
 
 #define PAGE_SHIFT              (12)
 //#define PAGE_SIZE               (4096)
@@ -21,6 +22,16 @@ std::map<Range, MEMPAGE, RangeCompare> memoryPages;
 bool bListAllPages = false;
 DWORD memMapThreadCounter = 0;
 
+// Generation tracking for MemGetMapDiff (protected by LockMemoryPages)
+#define MAX_REMOVED_PAGES 4096
+static duint memoryPagesGeneration = 0;
+static std::unordered_map<duint, duint> memoryPageGenerations; //page base -> generation the page was added/changed in
+static std::unordered_map<duint, duint> memoryRemovedPages; //page base -> generation the page was removed in
+static duint memoryRemovedPrunedGeneration = 0; //removals up to this generation are forgotten
+
+// Incremented by every (partially) successful MemWrite, lets caches of memory contents detect patches
+static volatile LONG memoryWriteGeneration = 0;
+
 void MemUpdateMap()
 {
     // First gather all possible pages in the memory range
@@ -170,7 +181,7 @@ void MemUpdateMap()
 
     // Get a list of threads for information about Kernel/PEB/TEB/Stack ranges
     THREADLIST threadList;
-    ThreadGetList(&threadList);
+    ThreadGetList(&threadList, ThreadFieldBasic);
 
     for(auto & page : pageVector)
     {
@@ -232,15 +243,99 @@ void MemUpdateMap()
         BridgeFree(threadList.list);
 
     // Convert the vector to a map
-    EXCLUSIVE_ACQUIRE(LockMemoryPages);
-    memoryPages.clear();
-
+    std::map<Range, MEMPAGE, RangeCompare> newPages;
     for(auto & page : pageVector)
     {
         duint start = (duint)page.mbi.BaseAddress;
         duint size = (duint)page.mbi.RegionSize;
-        memoryPages.insert(std::make_pair(std::make_pair(start, start + size - 1), page));
+        newPages.insert(std::make_pair(std::make_pair(start, start + size - 1), page));
+    }
+
+    EXCLUSIVE_ACQUIRE(LockMemoryPages);
+
+    // Compare with the previous map to find the added, changed and removed pages
+    bool changed = false;
+    duint generation = memoryPagesGeneration + 1;
+    for(const auto & page : newPages)
+    {
+        duint start = page.first.first;
+        auto found = memoryPages.find(page.first);
+        if(found != memoryPages.end() && found->first == page.first && !memcmp(&found->second, &page.second, sizeof(MEMPAGE)))
+            continue;
+        memoryPageGenerations[start] = generation;
+        memoryRemovedPages.erase(start);
+        changed = true;
+    }
+    for(const auto & page : memoryPages)
+    {
+        duint start = page.first.first;
+        auto found = newPages.find(Range(start, start));
+        if(found != newPages.end() && found->first.first == start)
+            continue;
+        memoryPageGenerations.erase(start);
+        memoryRemovedPages[start] = generation;
+        changed = true;
+    }
+
+    if(changed)
+    {
+        memoryPagesGeneration = generation;
+        if(memoryRemovedPages.size() > MAX_REMOVED_PAGES)
+        {
+            // Clients older than this generation have to get the full map again
+            memoryRemovedPages.clear();
+            memoryRemovedPrunedGeneration = generation;
+        }
+    }
+
+    memoryPages = std::move(newPages);
+}
+
+duint MemGetMapGeneration()
+{
+    SHARED_ACQUIRE(LockMemoryPages);
+    return memoryPagesGeneration;
+}
+
+duint MemGetWriteGeneration()
+{
+    return duint(memoryWriteGeneration);
+}
+
+bool MemGetMapDiff(duint Generation, std::vector<MEMPAGE> & Pages, std::vector<duint> & Removed, duint* NewGeneration)
+{
+    SHARED_ACQUIRE(LockMemoryPages);
+
+    Pages.clear();
+    Removed.clear();
+    if(NewGeneration)
+        *NewGeneration = memoryPagesGeneration;
+
+    // Unknown generation, the whole map is returned
+    if(!Generation || Generation <= memoryRemovedPrunedGeneration || Generation > memoryPagesGeneration)
+    {
+        Pages.reserve(memoryPages.size());
+        for(const auto & page : memoryPages)
+            Pages.push_back(page.second);
+        return false;
     }
+
+    if(Generation == memoryPagesGeneration)
+        return true;
+
+    for(const auto & page : memoryPages)
+    {
+        auto found = memoryPageGenerations.find(page.first.first);
+        if(found != memoryPageGenerations.end() && found->second > Generation)
+            Pages.push_back(page.second);
+    }
+    for(const auto & removed : memoryRemovedPages)
+    {
+        if(removed.second > Generation)
+            Removed.push_back(removed.first);
+    }
+    std::sort(Removed.begin(), Removed.end());
+    return true;
 }
 
 void MemUpdateMapAsync()
@@ -356,7 +451,10 @@ bool MemWrite(duint BaseAddress, const void* Buffer, duint Size, duint* NumberOf
     bool ret = MemoryWriteSafe(fdProcessInfo->hProcess, (LPVOID)BaseAddress, Buffer, Size, NumberOfBytesWritten);
 
     if(ret && *NumberOfBytesWritten == Size)
+    {
+        InterlockedIncrement(&memoryWriteGeneration);
         return true;
+    }
 
     // Write page-by-page (Skip if only 1 page exists)
     // See: MemRead
@@ -387,6 +485,8 @@ bool MemWrite(duint BaseAddress, const void* Buffer, duint Size, duint* NumberOf
         }
     }
 
+    if(*NumberOfBytesWritten > 0)
+        InterlockedIncrement(&memoryWriteGeneration);
     SetLastError(ERROR_PARTIAL_COPY);
     return (*NumberOfBytesWritten > 0);
 }
@@ -410,8 +510,7 @@ bool MemPatch(duint BaseAddress, const void* Buffer, duint Size, duint* NumberOf
     // Are we able to write on this page?
     if(MemWrite(BaseAddress, Buffer, Size, NumberOfBytesWritten))
     {
-        for(duint i = 0; i < Size; i++)
-            PatchSet(BaseAddress + i, oldData()[i], ((const unsigned char*)Buffer)[i]);
+        PatchSetRange(BaseAddress, oldData(), (const unsigned char*)Buffer, Size);
 
         // Done
         return true;
@@ -617,24 +716,26 @@ bool MemFindInPage(SimplePage page, duint startoffset, const std::vector<Pattern
     return true;
 }
 
-bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress)
+bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress, unsigned int job)
 {
     duint count = 0;
     duint total = pages.size();
     for(const auto page : pages)
     {
+        if(JobIsCancelled(job))
+            break;
         if(!MemFindInPage(page, 0, pattern, results, maxresults))
             continue;
         if(progress)
-            GuiReferenceSetProgress(int(floor((float(count) / float(total)) * 100.0f)));
+            JobRefSetProgress(job, int(floor((float(count) / float(total)) * 100.0f)));
         if(results.size() >= maxresults)
             break;
         count++;
     }
     if(progress)
     {
-        GuiReferenceSetProgress(100);
-        GuiReferenceReloadData();
+        JobRefSetProgress(job, 100);
+        JobRefReloadData(job);
     }
     return true;
 }
@@ -23,6 +23,9 @@ struct SimplePage
 
 void MemUpdateMap();
 void MemUpdateMapAsync();
+duint MemGetMapGeneration();
+duint MemGetWriteGeneration();
+bool MemGetMapDiff(duint Generation, std::vector<MEMPAGE> & Pages, std::vector<duint> & Removed, duint* NewGeneration);
 duint MemFindBaseAddr(duint Address, duint* Size, bool Refresh = false);
 bool MemRead(duint BaseAddress, void* Buffer, duint Size, duint* NumberOfBytesRead = nullptr, bool cache = false);
 bool MemReadUnsafe(duint BaseAddress, void* Buffer, duint Size, duint* NumberOfBytesRead = nullptr);
@@ -39,7 +42,7 @@ bool MemGetPageRights(duint Address, char* Rights);
 bool MemPageRightsToString(DWORD Protect, char* Rights);
 bool MemPageRightsFromString(DWORD* Protect, const char* Rights);
 bool MemFindInPage(SimplePage page, duint startoffset, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults);
-bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress = true);
+bool MemFindInMap(const std::vector<SimplePage> & pages, const std::vector<PatternByte> & pattern, std::vector<duint> & results, duint maxresults, bool progress = true, unsigned int job = 0);
 bool MemDecodePointer(duint* Pointer);
 
 #endif // _MEMORY_H
\ No newline at end of file
@@ -0,0 +1,67 @@
+/**
+ @file memsnapshot.cpp
+
+ @brief Implements snapshots of the committed memory and the differences between them.
+ */
+
+#include "memsnapshot.h"
+#include "memory.h"
+#include "threading.h"
+#include "console.h"
+
+// Bytes read from the debuggee at once
+#define SNAPSHOT_CHUNK_SIZE 0x100000
+
+static SnapshotStore snapshots;
+
+int MemSnapshotTake()
+{
+    SHARED_ACQUIRE(LockMemoryPages);
+    std::vector<SimplePage> regions;
+    for(auto & itr : memoryPages)
+    {
+        const auto & mbi = itr.second.mbi;
+        if(mbi.State == MEM_COMMIT && !(mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+            regions.push_back(SimplePage(duint(mbi.BaseAddress), mbi.RegionSize));
+    }
+    SHARED_RELEASE();
+
+    EXCLUSIVE_ACQUIRE(LockMemorySnapshots);
+    int snapshot = snapshots.Begin();
+    std::vector<unsigned char> chunk(SNAPSHOT_CHUNK_SIZE);
+    for(const auto & region : regions)
+    {
+        for(duint offset = 0; offset < region.size; offset += SNAPSHOT_CHUNK_SIZE)
+        {
+            // Read the chunk at once, page by page when part of it is not readable
+            auto address = region.address + offset;
+            auto size = min(duint(SNAPSHOT_CHUNK_SIZE), region.size - offset);
+            bool chunkRead = MemRead(address, chunk.data(), size);
+            for(duint page = 0; page < size; page += PAGE_SIZE)
+            {
+                if(chunkRead || MemRead(address + page, chunk.data() + page, PAGE_SIZE))
+                    snapshots.AddPage(address + page, chunk.data() + page);
+            }
+        }
+    }
+    snapshots.End();
+    return snapshot;
+}
+
+bool MemSnapshotDiff(int First, int Second, std::vector<SNAPSHOTRANGE> & Ranges)
+{
+    SHARED_ACQUIRE(LockMemorySnapshots);
+    return snapshots.Diff(First, Second, Ranges);
+}
+
+int MemSnapshotCount()
+{
+    SHARED_ACQUIRE(LockMemorySnapshots);
+    return snapshots.Count();
+}
+
+void MemSnapshotClear()
+{
+    EXCLUSIVE_ACQUIRE(LockMemorySnapshots);
+    snapshots.Clear();
+}
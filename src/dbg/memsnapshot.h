@@ -0,0 +1,12 @@
+#ifndef _MEMSNAPSHOT_H
+#define _MEMSNAPSHOT_H
+
+#include "_global.h"
+#include "snapshotstore.h"
+
+int MemSnapshotTake();
+bool MemSnapshotDiff(int First, int Second, std::vector<SNAPSHOTRANGE> & Ranges);
+int MemSnapshotCount();
+void MemSnapshotClear();
+
+#endif // _MEMSNAPSHOT_H
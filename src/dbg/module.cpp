@@ -8,6 +8,392 @@
 
 std::map<Range, MODINFO, RangeCompare> modinfo;
 
+// Incremented every time a module is loaded or unloaded
+static volatile LONG modgeneration = 0;
+
+// Lowercase module name hash (with and without extension) -> module base
+static std::unordered_map<duint, duint> modnames;
+
+struct MODRANGE
+{
+    duint base;
+    duint end;     // Last address of the module
+    duint hash;    // MODINFO.hash
+};
+
+// Sorted module ranges, replaced (never modified) on every load/unload so lookups can read them without the lock
+static std::vector<MODRANGE>* volatile modranges = nullptr;
+
+// Replaced module ranges, kept alive until no lookup can still be reading them
+static std::vector<std::vector<MODRANGE>*> modrangesretired;
+
+// Number of lookups reading the module ranges without the lock
+static volatile LONG modrangereaders = 0;
+
+// Maximum length of a forwarder chain (kernel32 -> kernelbase -> ntdll is the usual case)
+#define MAX_FORWARD_DEPTH 8
+
+struct MODEXPORTFORWARD
+{
+    String name;          // Forwarded export name (empty when exported by ordinal only)
+    duint ordinal;        // Forwarded export ordinal
+    String module;        // Lowercase target module (without extension)
+    String target;        // Target export name (empty when forwarded by ordinal)
+    duint targetOrdinal;  // Target export ordinal
+    duint addr;           // Resolved address (0 when unresolved)
+    bool failed;          // Resolving failed with the modules of failedGeneration
+    duint failedGeneration;
+};
+
+struct MODEXPORTS
+{
+    std::unordered_map<String, duint> names;  // Export name -> address
+    std::unordered_map<duint, duint> ordinals; // Export ordinal -> address
+    std::vector<MODEXPORTFORWARD> forwards;
+    std::unordered_map<String, size_t> forwardNames; // Forwarded export name -> index in forwards
+    std::unordered_map<duint, size_t> forwardOrdinals; // Forwarded export ordinal -> index in forwards
+};
+
+// Export resolution cache (module base -> exports), kept apart from MODINFO because ModGetList copies it
+static std::unordered_map<duint, MODEXPORTS> modexports;
+
+static void GetModuleExports(MODEXPORTS & Exports, duint Base, ULONG_PTR FileMapVA, duint FileSize, bool ImageLayout)
+{
+    // Translate an RVA to a local pointer, nullptr when the range is outside of the file
+    auto rvaToPtr = [&](duint Rva, duint Size) -> const unsigned char*
+    {
+        ULONG_PTR ptr = ImageLayout ? FileMapVA + Rva : ConvertVAtoFileOffsetEx(FileMapVA, DWORD(FileSize), 0, Rva, true, true);
+        if(!ptr || ptr < FileMapVA || ptr + Size > FileMapVA + FileSize || ptr + Size < ptr)
+            return nullptr;
+        return (const unsigned char*)ptr;
+    };
+    auto rvaToString = [&](duint Rva) -> String
+    {
+        auto str = (const char*)rvaToPtr(Rva, 1);
+        if(!str)
+            return String();
+        return String(str, strnlen(str, FileMapVA + FileSize - ULONG_PTR(str)));
+    };
+
+    duint exportDirRva = GetPE32DataFromMappedFile(FileMapVA, 0, UE_EXPORTTABLEADDRESS);
+    duint exportDirSize = GetPE32DataFromMappedFile(FileMapVA, 0, UE_EXPORTTABLESIZE);
+    if(!exportDirRva || !exportDirSize)
+        return;
+    auto exportDir = (const IMAGE_EXPORT_DIRECTORY*)rvaToPtr(exportDirRva, sizeof(IMAGE_EXPORT_DIRECTORY));
+    if(!exportDir)
+        return;
+    auto functions = (const DWORD*)rvaToPtr(exportDir->AddressOfFunctions, exportDir->NumberOfFunctions * sizeof(DWORD));
+    auto names = (const DWORD*)rvaToPtr(exportDir->AddressOfNames, exportDir->NumberOfNames * sizeof(DWORD));
+    auto nameOrdinals = (const WORD*)rvaToPtr(exportDir->AddressOfNameOrdinals, exportDir->NumberOfNames * sizeof(WORD));
+    if(!functions)
+        return;
+
+    // Map the function indices to their names
+    std::vector<String> functionNames(exportDir->NumberOfFunctions);
+    if(names && nameOrdinals)
+    {
+        for(DWORD i = 0; i < exportDir->NumberOfNames; i++)
+        {
+            if(nameOrdinals[i] < exportDir->NumberOfFunctions)
+                functionNames[nameOrdinals[i]] = rvaToString(names[i]);
+        }
+    }
+
+    Exports.names.reserve(exportDir->NumberOfNames);
+    Exports.ordinals.reserve(exportDir->NumberOfFunctions);
+    for(DWORD i = 0; i < exportDir->NumberOfFunctions; i++)
+    {
+        duint rva = functions[i];
+        if(!rva)
+            continue;
+        duint ordinal = exportDir->Base + i;
+        const String & name = functionNames[i];
+        if(rva >= exportDirRva && rva < exportDirRva + exportDirSize)
+        {
+            // Forwarded export (MODULE.Name or MODULE.#Ordinal)
+            String forward = rvaToString(rva);
+            auto dot = forward.rfind('.');
+            if(dot == String::npos || dot + 1 == forward.length())
+                continue;
+            MODEXPORTFORWARD forwardInfo;
+            forwardInfo.name = name;
+            forwardInfo.ordinal = ordinal;
+            forwardInfo.module = StringUtils::ToLower(forward.substr(0, dot));
+            forwardInfo.target = forward.substr(dot + 1);
+            forwardInfo.targetOrdinal = 0;
+            if(forwardInfo.target[0] == '#')
+            {
+                forwardInfo.targetOrdinal = duint(atoi(forwardInfo.target.c_str() + 1));
+                forwardInfo.target.clear();
+            }
+            forwardInfo.addr = 0;
+            forwardInfo.failed = false;
+            forwardInfo.failedGeneration = 0;
+            if(!name.empty())
+                Exports.forwardNames[name] = Exports.forwards.size();
+            Exports.forwardOrdinals[ordinal] = Exports.forwards.size();
+            Exports.forwards.push_back(forwardInfo);
+        }
+        else
+        {
+            Exports.ordinals[ordinal] = Base + rva;
+            if(!name.empty())
+                Exports.names[name] = Base + rva;
+        }
+    }
+}
+
+static MODEXPORTS* modExportsFromModuleName(const String & Module)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    auto base = modnames.find(ModHashFromName(Module.c_str()));
+    if(base == modnames.end())
+        return nullptr;
+    auto found = modexports.find(base->second);
+    return found != modexports.end() ? &found->second : nullptr;
+}
+
+static MODEXPORTFORWARD* modFindForward(MODEXPORTS & Exports, const char* Name, duint Ordinal)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    if(Name)
+    {
+        auto found = Exports.forwardNames.find(Name);
+        return found != Exports.forwardNames.end() ? &Exports.forwards[found->second] : nullptr;
+    }
+    auto found = Exports.forwardOrdinals.find(Ordinal);
+    return found != Exports.forwardOrdinals.end() ? &Exports.forwards[found->second] : nullptr;
+}
+
+static void modSetForwardAddress(MODEXPORTS & Exports, MODEXPORTFORWARD & Forward, duint Address)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    Forward.addr = Address;
+    Forward.failed = false;
+    if(Address)
+    {
+        Exports.ordinals[Forward.ordinal] = Address;
+        if(!Forward.name.empty())
+            Exports.names[Forward.name] = Address;
+    }
+    else
+    {
+        Exports.ordinals.erase(Forward.ordinal);
+        if(!Forward.name.empty())
+            Exports.names.erase(Forward.name);
+    }
+}
+
+static duint modResolveForward(const MODEXPORTFORWARD & Forward, int Depth)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS (only reads, so the shared lock is enough)
+    //
+    if(Depth > MAX_FORWARD_DEPTH)
+        return 0;
+    auto exports = modExportsFromModuleName(Forward.module);
+    if(!exports)
+        return 0;
+    if(Forward.target.empty())
+    {
+        auto found = exports->ordinals.find(Forward.targetOrdinal);
+        if(found != exports->ordinals.end())
+            return found->second;
+    }
+    else
+    {
+        auto found = exports->names.find(Forward.target);
+        if(found != exports->names.end())
+            return found->second;
+    }
+
+    // The target is forwarded again
+    auto next = modFindForward(*exports, Forward.target.empty() ? nullptr : Forward.target.c_str(), Forward.targetOrdinal);
+    if(!next)
+        return 0;
+    return next->addr ? next->addr : modResolveForward(*next, Depth + 1);
+}
+
+static void modResolveForwards(const MODINFO & Info)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    String name = Info.name;
+    String fullName = name + Info.extension;
+    for(auto & mod : modexports)
+    {
+        for(auto & forward : mod.second.forwards)
+        {
+            // Resolve the forwards of the new module and the forwards pointing to it
+            if(forward.addr || (mod.first != Info.base && forward.module != name && forward.module != fullName))
+                continue;
+            duint addr = modResolveForward(forward, 0);
+            if(addr)
+                modSetForwardAddress(mod.second, forward, addr);
+        }
+    }
+}
+
+static void modInvalidateForwards(const MODINFO & Info)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    for(auto & mod : modexports)
+    {
+        for(auto & forward : mod.second.forwards)
+        {
+            // Forwards are resolved again when the target module is loaded
+            if(forward.addr >= Info.base && forward.addr < Info.base + Info.size)
+                modSetForwardAddress(mod.second, forward, 0);
+        }
+    }
+}
+
+static duint modResolveExport(duint Base, const char* Name, duint Ordinal)
+{
+    // Failures are remembered until a module is loaded or unloaded
+    duint generation = ModGetGeneration();
+    SHARED_ACQUIRE(LockModules);
+    auto found = modexports.find(Base);
+    if(found == modexports.end())
+        return 0;
+    auto forward = modFindForward(found->second, Name, Ordinal);
+    if(!forward)
+        return 0;
+    if(forward->addr)
+        return forward->addr;
+    if(forward->failed && forward->failedGeneration == generation)
+        return 0;
+
+    // Try the modules that were loaded since the last attempt (longer forwarder chains)
+    duint addr = modResolveForward(*forward, 0);
+    String module = forward->module;
+    String target = forward->target;
+    duint targetOrdinal = forward->targetOrdinal;
+    SHARED_RELEASE();
+
+    // API sets are never loaded in the debuggee, let the local loader resolve them
+    if(!addr && (StringUtils::StartsWith(module, "api-") || StringUtils::StartsWith(module, "ext-")))
+    {
+        HMODULE hModule = LoadLibraryExA(module.c_str(), 0, DONT_RESOLVE_DLL_REFERENCES | LOAD_LIBRARY_AS_DATAFILE);
+        if(hModule)
+        {
+            ULONG_PTR localAddr = (ULONG_PTR)GetProcAddress(hModule, target.empty() ? (LPCSTR)(targetOrdinal & 0xFFFF) : target.c_str());
+            addr = localAddr ? ImporterGetRemoteAPIAddress(fdProcessInfo->hProcess, localAddr) : 0;
+            FreeLibrary(hModule);
+        }
+    }
+
+    // Remember the result, the module might have been unloaded in the meantime
+    EXCLUSIVE_ACQUIRE(LockModules);
+    found = modexports.find(Base);
+    if(found == modexports.end())
+        return addr;
+    forward = modFindForward(found->second, Name, Ordinal);
+    if(!forward)
+        return addr;
+    if(addr)
+        modSetForwardAddress(found->second, *forward, addr);
+    else
+    {
+        forward->failed = true;
+        forward->failedGeneration = generation;
+    }
+    return addr;
+}
+
+static void modIndexName(const MODINFO & Info)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    char name[MAX_MODULE_SIZE * 2];
+    strcpy_s(name, Info.name);
+    _strlwr_s(name);
+    duint nameHash = ModHashFromName(name);
+    strcat_s(name, Info.extension);
+    _strlwr_s(name);
+    duint fullNameHash = ModHashFromName(name);
+
+    // The module with the lowest base wins when names are loaded more than once
+    for(auto hash : { fullNameHash, nameHash })
+    {
+        if(!hash)
+            continue;
+        auto found = modnames.find(hash);
+        if(found == modnames.end())
+            modnames.insert(std::make_pair(hash, Info.base));
+        else if(Info.base < found->second)
+            found->second = Info.base;
+    }
+}
+
+static void modUpdateIndex()
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    modnames.clear();
+    auto ranges = new std::vector<MODRANGE>();
+    ranges->reserve(modinfo.size());
+    for(auto & mod : modinfo)
+    {
+        modIndexName(mod.second);
+        MODRANGE range = { mod.first.first, mod.first.second, mod.second.hash };
+        ranges->push_back(range);
+    }
+
+    // Publish the new ranges, lookups in progress keep reading the old ones
+    auto old = (std::vector<MODRANGE>*)InterlockedExchangePointer((PVOID volatile*)&modranges, ranges);
+    if(old)
+        modrangesretired.push_back(old);
+
+    // Lookups register before they load modranges, without any left nobody can hold a retired array
+    if(!modrangereaders)
+    {
+        for(auto retired : modrangesretired)
+            delete retired;
+        modrangesretired.clear();
+    }
+}
+
+static bool modRangeFromAddr(duint Address, MODRANGE & Result)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    InterlockedIncrement(&modrangereaders);
+    const std::vector<MODRANGE>* ranges = modranges;
+    bool result = false;
+    if(ranges && !ranges->empty())
+    {
+        // Find the last module starting at or before the address
+        auto found = std::upper_bound(ranges->begin(), ranges->end(), Address, [](duint addr, const MODRANGE & range)->bool
+        {
+            return addr < range.base;
+        });
+        if(found != ranges->begin())
+        {
+            --found;
+            if(Address <= found->end)
+            {
+                Result = *found;
+                result = true;
+            }
+        }
+    }
+    InterlockedDecrement(&modrangereaders);
+    return result;
+}
+
 void GetModuleInfo(MODINFO & Info, ULONG_PTR FileMapVA)
 {
     // Get the entry point
@@ -106,6 +492,7 @@ bool ModLoad(duint Base, duint Size, const char* FullPath)
     info.fileMapVA = 0;
 
     // Load module data
+    MODEXPORTS exports;
     bool virtualModule = strstr(FullPath, "virtual:\\") == FullPath;
 
     if(!virtualModule)
@@ -116,6 +503,7 @@ bool ModLoad(duint Base, duint Size, const char* FullPath)
         if(StaticFileLoadW(wszFullPath.c_str(), UE_ACCESS_READ, false, &info.fileHandle, &info.loadedSize, &info.fileMap, &info.fileMapVA))
         {
             GetModuleInfo(info, info.fileMapVA);
+            GetModuleExports(exports, Base, info.fileMapVA, info.loadedSize, false);
         }
         else
         {
@@ -133,11 +521,16 @@ bool ModLoad(duint Base, duint Size, const char* FullPath)
 
         // Get information from the local buffer
         GetModuleInfo(info, (ULONG_PTR)data());
+        GetModuleExports(exports, Base, (ULONG_PTR)data(), data.size(), true);
     }
 
     // Add module to list
     EXCLUSIVE_ACQUIRE(LockModules);
     modinfo.insert(std::make_pair(Range(Base, Base + Size - 1), info));
+    modexports[Base] = std::move(exports);
+    modUpdateIndex();
+    modResolveForwards(info);
+    InterlockedIncrement(&modgeneration);
     EXCLUSIVE_RELEASE();
 
     // Put labels for virtual module exports
@@ -171,8 +564,14 @@ bool ModUnload(duint Base)
     if(info.fileMapVA)
         StaticFileUnloadW(StringUtils::Utf8ToUtf16(info.path).c_str(), false, info.fileHandle, info.loadedSize, info.fileMap, info.fileMapVA);
 
+    // Drop the cached exports and the forwards pointing into this module
+    modexports.erase(info.base);
+    modInvalidateForwards(info);
+
     // Remove it from the list
     modinfo.erase(found);
+    modUpdateIndex();
+    InterlockedIncrement(&modgeneration);
     EXCLUSIVE_RELEASE();
 
     // Update symbols
@@ -194,6 +593,16 @@ void ModClear()
     }
 
     modinfo.clear();
+    modexports.clear();
+    modUpdateIndex();
+    InterlockedIncrement(&modgeneration);
+
+    // Nothing is debugged anymore, free the old module ranges once the last lookup is done with them
+    while(modrangereaders)
+        Sleep(0);
+    for(auto ranges : modrangesretired)
+        delete ranges;
+    modrangesretired.clear();
 
     EXCLUSIVE_RELEASE();
 
@@ -237,27 +646,41 @@ bool ModNameFromAddr(duint Address, char* Name, bool Extension)
 
 duint ModBaseFromAddr(duint Address)
 {
-    SHARED_ACQUIRE(LockModules);
-
-    auto module = ModInfoFromAddr(Address);
-
-    if(!module)
+    // The module ranges can be read without the lock
+    MODRANGE range;
+    if(!modRangeFromAddr(Address, range))
         return 0;
 
-    return module->base;
+    return range.base;
+}
+
+duint ModNextBaseFromAddr(duint Address)
+{
+    // The module ranges can be read without the lock
+    InterlockedIncrement(&modrangereaders);
+    const std::vector<MODRANGE>* ranges = modranges;
+    duint base = 0;
+    if(ranges)
+    {
+        auto found = std::upper_bound(ranges->begin(), ranges->end(), Address, [](duint addr, const MODRANGE & range)->bool
+        {
+            return addr < range.base;
+        });
+        if(found != ranges->end())
+            base = found->base;
+    }
+    InterlockedDecrement(&modrangereaders);
+    return base;
 }
 
 duint ModHashFromAddr(duint Address)
 {
     // Returns a unique hash from a virtual address
-    SHARED_ACQUIRE(LockModules);
-
-    auto module = ModInfoFromAddr(Address);
-
-    if(!module)
+    MODRANGE range;
+    if(!modRangeFromAddr(Address, range))
         return Address;
 
-    return module->hash + (Address - module->base);
+    return range.hash + (Address - range.base);
 }
 
 duint ModHashFromName(const char* Module)
@@ -278,8 +701,21 @@ duint ModBaseFromName(const char* Module)
     if(!len)
         return 0;
     ASSERT_TRUE(len < MAX_MODULE_SIZE);
+
+    char lowerModule[MAX_MODULE_SIZE];
+    strcpy_s(lowerModule, Module);
+    _strlwr_s(lowerModule);
     SHARED_ACQUIRE(LockModules);
 
+    auto found = modnames.find(ModHashFromName(lowerModule));
+    if(found == modnames.end())
+        return 0;
+
+    // Make sure this is not a hash collision
+    auto module = ModInfoFromAddr(found->second);
+    if(module && (!_stricmp(module->name, Module) || !_stricmp((String(module->name) + module->extension).c_str(), Module)))
+        return module->base;
+
     for(const auto & i : modinfo)
     {
         const auto & currentModule = i.second;
@@ -400,4 +836,80 @@ bool ModAddImportToModule(duint Base, const MODIMPORTINFO & importInfo)
     pImports->push_back(importInfo);
 
     return true;
+}
+
+duint ModGetGeneration()
+{
+    return duint(modgeneration);
+}
+
+duint ModExportFromName(duint Base, const char* Name)
+{
+    ASSERT_NONNULL(Name);
+    SHARED_ACQUIRE(LockModules);
+
+    auto found = modexports.find(Base);
+    if(found == modexports.end())
+        return 0;
+
+    auto foundName = found->second.names.find(Name);
+    if(foundName != found->second.names.end())
+        return foundName->second;
+
+    if(found->second.forwardNames.find(Name) == found->second.forwardNames.end())
+        return 0;
+
+    // Unresolved forwarders are resolved on demand
+    SHARED_RELEASE();
+    return modResolveExport(Base, Name, 0);
+}
+
+duint ModExportFromOrdinal(duint Base, duint Ordinal)
+{
+    SHARED_ACQUIRE(LockModules);
+
+    auto found = modexports.find(Base);
+    if(found == modexports.end())
+        return 0;
+
+    auto foundOrdinal = found->second.ordinals.find(Ordinal);
+    if(foundOrdinal != found->second.ordinals.end())
+        return foundOrdinal->second;
+
+    if(found->second.forwardOrdinals.find(Ordinal) == found->second.forwardOrdinals.end())
+        return 0;
+
+    // Unresolved forwarders are resolved on demand
+    SHARED_RELEASE();
+    return modResolveExport(Base, nullptr, Ordinal);
+}
+
+void ModExportsFromName(const char* Name, std::vector<duint> & Addresses)
+{
+    ASSERT_NONNULL(Name);
+    Addresses.clear();
+
+    std::vector<duint> bases;
+    duint kernel32 = 0;
+    SHARED_ACQUIRE(LockModules);
+    for(const auto & mod : modinfo)
+    {
+        const MODINFO & info = mod.second;
+        bases.push_back(info.base);
+        if(!_stricmp(info.name, "kernel32") && !_stricmp(info.extension, ".dll"))
+            kernel32 = info.base;
+    }
+    SHARED_RELEASE();
+
+    // Exports of kernel32.dll come first
+    for(auto base : bases)
+    {
+        duint addr = ModExportFromName(base, Name);
+        if(!addr)
+            continue;
+        if(base == kernel32)
+            Addresses.insert(Addresses.begin(), addr);
+        else
+            Addresses.push_back(addr);
+    }
 }
\ No newline at end of file
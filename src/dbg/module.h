@@ -43,6 +43,7 @@ void ModClear();
 MODINFO* ModInfoFromAddr(duint Address);
 bool ModNameFromAddr(duint Address, char* Name, bool Extension);
 duint ModBaseFromAddr(duint Address);
+duint ModNextBaseFromAddr(duint Address);
 duint ModHashFromAddr(duint Address);
 duint ModHashFromName(const char* Module);
 duint ModBaseFromName(const char* Module);
@@ -54,5 +55,9 @@ int ModPathFromAddr(duint Address, char* Path, int Size);
 int ModPathFromName(const char* Module, char* Path, int Size);
 void ModGetList(std::vector<MODINFO> & list);
 bool ModAddImportToModule(duint Base, const MODIMPORTINFO & importInfo);
+duint ModGetGeneration();
+duint ModExportFromName(duint Base, const char* Name);
+duint ModExportFromOrdinal(duint Base, duint Ordinal);
+void ModExportsFromName(const char* Name, std::vector<duint> & Addresses);
 
 #endif // _MODULE_H
\ No newline at end of file
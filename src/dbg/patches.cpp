@@ -10,51 +10,217 @@
 #include "threading.h"
 #include "module.h"
 
-std::unordered_map<duint, PATCHINFO> patches;
+// A run of consecutive patched bytes, none of the new bytes equals its original byte
+struct PATCHRUN
+{
+    std::vector<unsigned char> oldbytes;
+    std::vector<unsigned char> newbytes;
+};
 
-bool PatchSet(duint Address, unsigned char OldByte, unsigned char NewByte)
+typedef std::map<duint, PATCHRUN> PatchRuns;
+
+// The patches of a module, the runs are keyed by the RVA of their first byte and never overlap or touch
+struct PATCHMODULE
 {
-    ASSERT_DEBUGGING("Export call");
+    char mod[MAX_MODULE_SIZE];
+    PatchRuns runs;
+    size_t bytes; // number of patched bytes
+};
 
-    // Address must be valid
-    if(!MemIsValidReadPtr(Address))
-        return false;
+// Keyed by module hash, patches outside of modules use key 0 with virtual addresses
+static std::unordered_map<duint, PATCHMODULE> patches;
+
+static duint patchEnd(PatchRuns::const_iterator Run)
+{
+    return Run->first + Run->second.newbytes.size();
+}
+
+static PATCHMODULE & patchModule(duint Base, const char* Mod)
+{
+    auto & module = patches[Base ? ModHashFromAddr(Base) : 0];
+    if(module.runs.empty())
+    {
+        strcpy_s(module.mod, Mod);
+        module.bytes = 0;
+    }
+    return module;
+}
 
-    // Don't patch anything if the new and old values are the same
-    if(OldByte == NewByte)
-        return true;
+static PATCHMODULE* patchModuleFromAddr(duint Address, duint & Base)
+{
+    Base = ModBaseFromAddr(Address);
+    auto found = patches.find(Base ? ModHashFromAddr(Base) : 0);
+    if(found == patches.end())
+        return nullptr;
+    return &found->second;
+}
 
-    PATCHINFO newPatch;
-    newPatch.addr = Address - ModBaseFromAddr(Address);
-    newPatch.oldbyte = OldByte;
-    newPatch.newbyte = NewByte;
-    ModNameFromAddr(Address, newPatch.mod, true);
+/**
+\brief Gets the part of [Address, End) that is in the same module as Address.
+\param Address The start of the range.
+\param End The end of the range.
+\param [out] Base The base of the module, 0 for memory outside of modules.
+\return The end of the part.
+*/
+static duint patchSplit(duint Address, duint End, duint & Base)
+{
+    Base = ModBaseFromAddr(Address);
+    if(Base)
+        return min(End, Base + ModSizeFromAddr(Address));
 
-    // Generate a key for this address
-    const duint key = ModHashFromAddr(Address);
+    // Memory outside of modules, stop where the next module starts
+    auto nextBase = ModNextBaseFromAddr(Address);
+    return nextBase && nextBase < End ? nextBase : End;
+}
 
-    EXCLUSIVE_ACQUIRE(LockPatches);
+static PatchRuns::iterator patchRunFromRva(PatchRuns & Runs, duint Rva)
+{
+    auto run = Runs.upper_bound(Rva);
+    if(run == Runs.begin())
+        return Runs.end();
+    --run;
+    if(Rva >= patchEnd(run))
+        return Runs.end();
+    return run;
+}
 
-    // Find any patch with this specific address
-    auto found = patches.find(key);
+static void patchInsert(PATCHMODULE & Module, duint Rva, const unsigned char* OldBytes, const unsigned char* NewBytes, duint Size)
+{
+    PATCHRUN run;
+    run.oldbytes.assign(OldBytes, OldBytes + Size);
+    run.newbytes.assign(NewBytes, NewBytes + Size);
+    Module.runs.insert(std::make_pair(Rva, std::move(run)));
+    Module.bytes += Size;
+}
 
-    if(found != patches.end())
+/**
+\brief Stores the new bytes of [Rva, Rva + Size), merging them with the runs that overlap or touch the range.
+*/
+static void patchStore(PATCHMODULE & Module, duint Rva, const unsigned char* OldBytes, const unsigned char* NewBytes, duint Size)
+{
+    auto & runs = Module.runs;
+
+    // Find the runs that overlap or touch the range
+    auto first = runs.upper_bound(Rva);
+    if(first != runs.begin() && patchEnd(std::prev(first)) >= Rva)
+        --first;
+    auto last = first;
+    while(last != runs.end() && last->first <= Rva + Size)
+        ++last;
+
+    duint start = Rva;
+    duint end = Rva + Size;
+    if(first != last)
+    {
+        start = min(start, first->first);
+        end = max(end, patchEnd(std::prev(last)));
+    }
+
+    // Merge everything into one span
+    auto size = end - start;
+    std::vector<unsigned char> oldbytes(size);
+    std::vector<unsigned char> newbytes(size);
+    std::vector<bool> patched(size, false);
+    for(auto itr = first; itr != last; ++itr)
+    {
+        auto offset = itr->first - start;
+        const auto & run = itr->second;
+        std::copy(run.oldbytes.begin(), run.oldbytes.end(), oldbytes.begin() + offset);
+        std::copy(run.newbytes.begin(), run.newbytes.end(), newbytes.begin() + offset);
+        std::fill(patched.begin() + offset, patched.begin() + offset + run.newbytes.size(), true);
+        Module.bytes -= run.newbytes.size();
+    }
+    runs.erase(first, last);
+    for(duint i = 0; i < Size; i++)
     {
-        if(found->second.oldbyte == NewByte)
+        auto offset = Rva - start + i;
+        // Keep the original byte from the previous patch
+        if(!patched[offset])
         {
-            // The patch was undone here
-            patches.erase(found);
-            return true;
+            oldbytes[offset] = OldBytes[i];
+            patched[offset] = true;
         }
+        newbytes[offset] = NewBytes[i];
+    }
 
-        // Keep the original byte from the previous patch
-        newPatch.oldbyte = found->second.oldbyte;
-        found->second = newPatch;
+    // Bytes that have their original value again are not patched anymore
+    for(duint i = 0; i < size;)
+    {
+        if(oldbytes[i] == newbytes[i])
+        {
+            i++;
+            continue;
+        }
+        auto j = i + 1;
+        while(j < size && oldbytes[j] != newbytes[j])
+            j++;
+        patchInsert(Module, start + i, oldbytes.data() + i, newbytes.data() + i, j - i);
+        i = j;
     }
-    else
+}
+
+/**
+\brief Removes the patches in [Rva, End), the parts of runs outside of the range are kept.
+\return The number of removed bytes.
+*/
+static duint patchRemove(PATCHMODULE & Module, duint Base, duint Rva, duint End, bool Restore)
+{
+    auto & runs = Module.runs;
+    auto itr = runs.upper_bound(Rva);
+    if(itr != runs.begin() && patchEnd(std::prev(itr)) > Rva)
+        --itr;
+    duint removed = 0;
+    while(itr != runs.end() && itr->first < End)
+    {
+        auto runStart = itr->first;
+        auto run = std::move(itr->second);
+        auto runEnd = runStart + run.newbytes.size();
+        itr = runs.erase(itr);
+        Module.bytes -= run.newbytes.size();
+
+        auto removeStart = max(runStart, Rva);
+        auto removeEnd = min(runEnd, End);
+        removed += removeEnd - removeStart;
+
+        // Restore the original bytes if necessary
+        if(Restore)
+            MemWrite(Base + removeStart, run.oldbytes.data() + (removeStart - runStart), removeEnd - removeStart);
+
+        if(runStart < removeStart)
+            patchInsert(Module, runStart, run.oldbytes.data(), run.newbytes.data(), removeStart - runStart);
+        if(removeEnd < runEnd)
+            patchInsert(Module, removeEnd, run.oldbytes.data() + (removeEnd - runStart), run.newbytes.data() + (removeEnd - runStart), runEnd - removeEnd);
+    }
+    return removed;
+}
+
+bool PatchSet(duint Address, unsigned char OldByte, unsigned char NewByte)
+{
+    return PatchSetRange(Address, &OldByte, &NewByte, 1);
+}
+
+bool PatchSetRange(duint Address, const unsigned char* OldBytes, const unsigned char* NewBytes, duint Size)
+{
+    ASSERT_DEBUGGING("Export call");
+
+    // Address must be valid
+    if(!MemIsValidReadPtr(Address))
+        return false;
+
+    EXCLUSIVE_ACQUIRE(LockPatches);
+
+    // Store the part in each module separately
+    auto end = Address + Size;
+    for(auto addr = Address; addr < end;)
     {
-        // The entry was never found, insert it
-        patches.insert(std::make_pair(key, newPatch));
+        duint base;
+        auto partEnd = patchSplit(addr, end, base);
+        char mod[MAX_MODULE_SIZE] = "";
+        if(base)
+            ModNameFromAddr(base, mod, true);
+        auto offset = addr - Address;
+        patchStore(patchModule(base, mod), addr - base, OldBytes + offset, NewBytes + offset, partEnd - addr);
+        addr = partEnd;
     }
 
     return true;
@@ -65,41 +231,66 @@ bool PatchGet(duint Address, PATCHINFO* Patch)
     ASSERT_DEBUGGING("Export call");
     SHARED_ACQUIRE(LockPatches);
 
-    // Find this specific address in the list
-    auto found = patches.find(ModHashFromAddr(Address));
-
-    if(found == patches.end())
+    // Find the run with this specific address
+    duint base;
+    auto module = patchModuleFromAddr(Address, base);
+    if(!module)
+        return false;
+    auto rva = Address - base;
+    auto run = patchRunFromRva(module->runs, rva);
+    if(run == module->runs.end())
         return false;
 
     // Did the user request an output buffer?
     if(Patch)
     {
-        *Patch = found->second;
-        Patch->addr += ModBaseFromAddr(Address);
+        strcpy_s(Patch->mod, module->mod);
+        Patch->addr = Address;
+        Patch->oldbyte = run->second.oldbytes[rva - run->first];
+        Patch->newbyte = run->second.newbytes[rva - run->first];
     }
 
     // Return true because the patch was found
     return true;
 }
 
+bool PatchInRange(duint Start, duint End)
+{
+    ASSERT_DEBUGGING("Export call");
+    SHARED_ACQUIRE(LockPatches);
+
+    // [Start, End)
+    for(auto addr = Start; addr < End;)
+    {
+        duint base;
+        auto partEnd = patchSplit(addr, End, base);
+        auto found = patches.find(base ? ModHashFromAddr(base) : 0);
+        if(found != patches.end())
+        {
+            // The first run that ends after the start of the part
+            auto & runs = found->second.runs;
+            auto run = runs.upper_bound(addr - base);
+            if(run != runs.begin() && patchEnd(std::prev(run)) > addr - base)
+                --run;
+            if(run != runs.end() && run->first < partEnd - base)
+                return true;
+        }
+        addr = partEnd;
+    }
+    return false;
+}
+
 bool PatchDelete(duint Address, bool Restore)
 {
     ASSERT_DEBUGGING("Export call");
     EXCLUSIVE_ACQUIRE(LockPatches);
 
-    // Do a list lookup with hash
-    auto found = patches.find(ModHashFromAddr(Address));
-
-    if(found == patches.end())
+    duint base;
+    auto module = patchModuleFromAddr(Address, base);
+    if(!module)
         return false;
-
-    // Restore the original byte at this address
-    if(Restore)
-        MemWrite((found->second.addr + ModBaseFromAddr(Address)), &found->second.oldbyte, sizeof(char));
-
-    // Finally remove it from the list
-    patches.erase(found);
-    return true;
+    auto rva = Address - base;
+    return patchRemove(*module, base, rva, rva + 1, Restore) != 0;
 }
 
 void PatchDelRange(duint Start, duint End, bool Restore)
@@ -115,31 +306,17 @@ void PatchDelRange(duint Start, duint End, bool Restore)
     }
     else
     {
-        // Make sure 'Start' and 'End' reference the same module
-        duint moduleBase = ModBaseFromAddr(Start);
-
-        if(moduleBase != ModBaseFromAddr(End))
-            return;
-
-        // VA to RVA in module
-        Start -= moduleBase;
-        End -= moduleBase;
-
         EXCLUSIVE_ACQUIRE(LockPatches);
-        for(auto itr = patches.begin(); itr != patches.end();)
-        {
-            const auto & currentPatch = itr->second;
-            // [Start, End)
-            if(currentPatch.addr >= Start && currentPatch.addr < End)
-            {
-                // Restore the original byte if necessary
-                if(Restore)
-                    MemWrite((currentPatch.addr + moduleBase), &currentPatch.oldbyte, sizeof(char));
 
-                itr = patches.erase(itr);
-            }
-            else
-                ++itr;
+        // [Start, End), for every module in the range
+        for(auto addr = Start; addr < End;)
+        {
+            duint base;
+            auto partEnd = patchSplit(addr, End, base);
+            auto found = patches.find(base ? ModHashFromAddr(base) : 0);
+            if(found != patches.end())
+                patchRemove(found->second, base, addr - base, partEnd - base, Restore);
+            addr = partEnd;
         }
     }
 }
@@ -150,21 +327,42 @@ bool PatchEnum(PATCHINFO* List, size_t* Size)
     ASSERT_FALSE(!List && !Size);
     SHARED_ACQUIRE(LockPatches);
 
+    // Patches of modules that are not loaded have no address
+    std::vector<std::pair<const PATCHMODULE*, duint>> modules;
+    size_t count = 0;
+    for(auto & itr : patches)
+    {
+        const auto & module = itr.second;
+        auto base = ModBaseFromName(module.mod);
+        if(*module.mod && !base)
+            continue;
+        modules.push_back(std::make_pair(&module, base));
+        count += module.bytes;
+    }
+
     // Did the user request the size?
     if(Size)
     {
-        *Size = patches.size() * sizeof(PATCHINFO);
+        *Size = count * sizeof(PATCHINFO);
 
         if(!List)
             return true;
     }
 
-    // Copy each vector entry to a C-style array
-    for(auto & itr : patches)
+    // Plugins expect one entry per byte
+    for(auto & itr : modules)
     {
-        *List = itr.second;
-        List->addr += ModBaseFromName(itr.second.mod);;
-        List++;
+        for(auto & run : itr.first->runs)
+        {
+            for(size_t i = 0; i < run.second.newbytes.size(); i++)
+            {
+                strcpy_s(List->mod, itr.first->mod);
+                List->addr = itr.second + run.first + i;
+                List->oldbyte = run.second.oldbytes[i];
+                List->newbyte = run.second.newbytes[i];
+                List++;
+            }
+        }
     }
 
     return true;
@@ -260,20 +458,48 @@ int PatchFile(const PATCHINFO* List, int Count, const char* FileName, char* Erro
         return -1;
     }
 
+    // Sort the patches by address, consecutive bytes are written as one run
+    std::vector<const PATCHINFO*> sorted(Count);
+    for(int i = 0; i < Count; i++)
+        sorted[i] = &List[i];
+    std::sort(sorted.begin(), sorted.end(), [](const PATCHINFO * a, const PATCHINFO * b)
+    {
+        return a->addr < b->addr;
+    });
+
     // Begin iterating all patches, applying them to a file
     int patchCount = 0;
 
-    for(int i = 0; i < Count; i++)
+    for(int i = 0; i < Count;)
     {
-        // Convert the virtual address to an offset within disk file data
-        unsigned char* ptr = (unsigned char*)ConvertVAtoFileOffsetEx(fileMapVa, loadedSize, moduleBase, List[i].addr, false, true);
+        int runEnd = i + 1;
+        while(runEnd < Count && sorted[runEnd]->addr == sorted[runEnd - 1]->addr + 1)
+            runEnd++;
+
+        // Convert the virtual addresses to offsets within disk file data, once for the whole run if it is contiguous in the file
+        auto first = (unsigned char*)ConvertVAtoFileOffsetEx(fileMapVa, loadedSize, moduleBase, sorted[i]->addr, false, true);
+        auto last = (unsigned char*)ConvertVAtoFileOffsetEx(fileMapVa, loadedSize, moduleBase, sorted[runEnd - 1]->addr, false, true);
+        if(first && last && duint(last - first) == sorted[runEnd - 1]->addr - sorted[i]->addr)
+        {
+            for(int j = i; j < runEnd; j++)
+                first[j - i] = sorted[j]->newbyte;
+            patchCount += runEnd - i;
+        }
+        else
+        {
+            for(int j = i; j < runEnd; j++)
+            {
+                unsigned char* ptr = (unsigned char*)ConvertVAtoFileOffsetEx(fileMapVa, loadedSize, moduleBase, sorted[j]->addr, false, true);
 
-        // Skip patches that do not have a raw address
-        if(!ptr)
-            continue;
+                // Skip patches that do not have a raw address
+                if(!ptr)
+                    continue;
 
-        *ptr = List[i].newbyte;
-        patchCount++;
+                *ptr = sorted[j]->newbyte;
+                patchCount++;
+            }
+        }
+        i = runEnd;
     }
 
     // Unload the file from memory and commit changes to disk
@@ -292,6 +518,151 @@ int PatchFile(const PATCHINFO* List, int Count, const char* FileName, char* Erro
     return patchCount;
 }
 
+/**
+\brief Applies the patches of a module that were loaded from the database. Runs that do not match the original bytes anymore are dropped.
+\param Module The name of the module, including the extension.
+*/
+void PatchApply(const char* Module)
+{
+    auto base = ModBaseFromName(Module);
+    if(!*Module || !base)
+        return;
+
+    EXCLUSIVE_ACQUIRE(LockPatches);
+    auto found = patches.find(ModHashFromName(Module));
+    if(found == patches.end())
+        return;
+
+    auto & module = found->second;
+    for(auto itr = module.runs.begin(); itr != module.runs.end();)
+    {
+        const auto & run = itr->second;
+        auto size = run.newbytes.size();
+        std::vector<unsigned char> current(size);
+        if(MemRead(base + itr->first, current.data(), size))
+        {
+            // Already patched (for example a module that was loaded again)
+            if(current == run.newbytes)
+            {
+                ++itr;
+                continue;
+            }
+            if(current == run.oldbytes && MemWrite(base + itr->first, run.newbytes.data(), size))
+            {
+                ++itr;
+                continue;
+            }
+        }
+        dprintf("Patch at %s+" fhex " does not match the module anymore, discarded\n", module.mod, itr->first);
+        module.bytes -= size;
+        itr = module.runs.erase(itr);
+    }
+}
+
+static String patchToHex(const std::vector<unsigned char> & Bytes)
+{
+    const char* byteToHex = "0123456789ABCDEF";
+    String hex;
+    hex.resize(Bytes.size() * 2);
+    for(size_t i = 0; i < Bytes.size(); i++)
+    {
+        hex[i * 2] = byteToHex[(Bytes[i] & 0xF0) >> 4];
+        hex[i * 2 + 1] = byteToHex[Bytes[i] & 0xF];
+    }
+    return hex;
+}
+
+static bool patchFromHex(const char* Hex, std::vector<unsigned char> & Bytes)
+{
+    if(!Hex)
+        return false;
+    auto len = strlen(Hex);
+    if(!len || len % 2)
+        return false;
+    Bytes.resize(len / 2);
+    for(size_t i = 0; i < Bytes.size(); i++)
+    {
+        unsigned int value;
+        if(!isxdigit(Hex[i * 2]) || !isxdigit(Hex[i * 2 + 1]) || sscanf_s(Hex + i * 2, "%2X", &value) != 1)
+            return false;
+        Bytes[i] = (unsigned char)value;
+    }
+    return true;
+}
+
+void PatchCacheSave(JSON Root)
+{
+    SHARED_ACQUIRE(LockPatches);
+
+    // Every run is stored as one object with its bytes, patches outside of modules are not saved
+    const JSON jsonPatches = json_array();
+    for(auto & itr : patches)
+    {
+        const auto & module = itr.second;
+        if(!*module.mod)
+            continue;
+        for(auto & run : module.runs)
+        {
+            JSON jsonObj = json_object();
+            json_object_set_new(jsonObj, "module", json_string(module.mod));
+            json_object_set_new(jsonObj, "address", json_hex(run.first));
+            json_object_set_new(jsonObj, "oldbytes", json_string(patchToHex(run.second.oldbytes).c_str()));
+            json_object_set_new(jsonObj, "newbytes", json_string(patchToHex(run.second.newbytes).c_str()));
+            json_array_append_new(jsonPatches, jsonObj);
+        }
+    }
+
+    if(json_array_size(jsonPatches))
+        json_object_set(Root, "patches", jsonPatches);
+
+    // Notify garbage collector
+    json_decref(jsonPatches);
+}
+
+void PatchCacheLoad(JSON Root)
+{
+    std::vector<String> loaded;
+    {
+        EXCLUSIVE_ACQUIRE(LockPatches);
+
+        // Remove all existing elements
+        patches.clear();
+
+        const JSON jsonPatches = json_object_get(Root, "patches");
+        if(!jsonPatches)
+            return;
+
+        size_t i;
+        JSON value;
+        json_array_foreach(jsonPatches, i, value)
+        {
+            auto mod = json_string_value(json_object_get(value, "module"));
+            auto rva = (duint)json_hex_value(json_object_get(value, "address"));
+            std::vector<unsigned char> oldbytes;
+            std::vector<unsigned char> newbytes;
+            if(!mod || !*mod || strlen(mod) >= MAX_MODULE_SIZE)
+                continue;
+            if(!patchFromHex(json_string_value(json_object_get(value, "oldbytes")), oldbytes) ||
+                    !patchFromHex(json_string_value(json_object_get(value, "newbytes")), newbytes) ||
+                    oldbytes.size() != newbytes.size())
+                continue;
+
+            auto & module = patches[ModHashFromName(mod)];
+            if(module.runs.empty())
+            {
+                strcpy_s(module.mod, mod);
+                module.bytes = 0;
+                loaded.push_back(mod);
+            }
+            patchStore(module, rva, oldbytes.data(), newbytes.data(), newbytes.size());
+        }
+    }
+
+    // Modules that are already loaded get their patches now, the others when they are loaded
+    for(auto & mod : loaded)
+        PatchApply(mod.c_str());
+}
+
 void PatchClear(const char* Module)
 {
     EXCLUSIVE_ACQUIRE(LockPatches);
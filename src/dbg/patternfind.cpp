@@ -1,5 +1,7 @@
 #include "patternfind.h"
 #include <vector>
+#include <emmintrin.h>
+#include <intrin.h>
 
 using namespace std;
 
@@ -148,6 +150,56 @@ bool patternsnr(unsigned char* data, size_t datasize, const char* searchpattern,
     return true;
 }
 
+static inline bool patternmatch(const unsigned char* data, const std::vector<PatternByte> & pattern)
+{
+    for(size_t i = 0; i < pattern.size(); i++)
+        if(!patternmatchbyte(data[i], pattern[i]))
+            return false;
+    return true;
+}
+
+void patternfindall(const unsigned char* data, size_t datasize, const std::vector<PatternByte> & pattern, std::vector<size_t> & found)
+{
+    size_t patternsize = pattern.size();
+    if(!patternsize || patternsize > datasize)
+        return;
+    size_t last = datasize - patternsize; //last offset the pattern fits at
+
+    //the first and the last byte without wildcards filter 16 offsets at a time
+    size_t first = patternsize, second = patternsize;
+    for(size_t j = 0; j < patternsize; j++)
+    {
+        if(pattern[j].nibble[0].wildcard || pattern[j].nibble[1].wildcard)
+            continue;
+        if(first == patternsize)
+            first = j;
+        second = j;
+    }
+    size_t i = 0;
+    if(first != patternsize)
+    {
+        auto firstbyte = _mm_set1_epi8(char(pattern[first].nibble[0].data << 4 | pattern[first].nibble[1].data));
+        auto secondbyte = _mm_set1_epi8(char(pattern[second].nibble[0].data << 4 | pattern[second].nibble[1].data));
+        for(; i + 16 <= last + 1; i += 16)
+        {
+            auto eqfirst = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i + first)), firstbyte);
+            auto eqsecond = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i + second)), secondbyte);
+            unsigned long mask = _mm_movemask_epi8(_mm_and_si128(eqfirst, eqsecond));
+            while(mask)
+            {
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                mask &= mask - 1;
+                if(patternmatch(data + i + bit, pattern))
+                    found.push_back(i + bit);
+            }
+        }
+    }
+    for(; i <= last; i++)
+        if(patternmatch(data + i, pattern))
+            found.push_back(i);
+}
+
 size_t patternfind(const unsigned char* data, size_t datasize, const std::vector<PatternByte> & pattern)
 {
     size_t searchpatternsize = pattern.size();
@@ -55,4 +55,12 @@ size_t patternfind(
     const std::vector<PatternByte> & pattern //pattern to search
 );
 
+//returns: nothing, the offsets of all matches are appended to found
+void patternfindall(
+    const unsigned char* data, //data
+    size_t datasize, //size of data
+    const std::vector<PatternByte> & pattern, //pattern to search
+    std::vector<size_t> & found //offsets of the matches
+);
+
 #endif // _PATTERNFIND_H
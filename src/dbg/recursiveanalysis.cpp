@@ -64,17 +64,18 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
         while(true)
         {
             node.icount++;
-            if(!mCp.Disassemble(node.end, translateAddr(node.end)))
+            DECODEDINSTR instr;
+            if(!decode(node.end, instr))
             {
                 node.end++;
                 continue;
             }
-            if(mCp.InGroup(CS_GRP_JUMP) || mCp.IsLoop())  //jump
+            if(instr.flags & (DECODED_JUMP | DECODED_LOOP))  //jump
             {
                 //set the branch destinations
-                node.brtrue = mCp.BranchDestination();
-                if(mCp.GetId() != X86_INS_JMP)  //unconditional jumps dont have a brfalse
-                    node.brfalse = node.end + mCp.Size();
+                node.brtrue = instr.branch;
+                if(!(instr.flags & DECODED_JMP))  //unconditional jumps dont have a brfalse
+                    node.brfalse = node.end + instr.size;
 
                 //add node to the function graph
                 graph.AddNode(node);
@@ -87,17 +88,17 @@ void RecursiveAnalysis::analyzeFunction(duint entryPoint)
 
                 break;
             }
-            if(mCp.InGroup(CS_GRP_CALL))  //call
+            if(instr.flags & DECODED_CALL)  //call
             {
                 //TODO: add this to a queue to be analyzed later
             }
-            if(mCp.InGroup(CS_GRP_RET))  //return
+            if(instr.flags & DECODED_RET)  //return
             {
                 node.terminal = true;
                 graph.AddNode(node);
                 break;
             }
-            node.end += mCp.Size();
+            node.end += instr.size;
         }
     }
     mFunctions.push_back(graph);
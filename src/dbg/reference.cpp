@@ -9,13 +9,257 @@
 #include "console.h"
 #include "module.h"
 #include "threading.h"
+#include "jobs.h"
+#include "imageview.h"
+#include "handle.h"
+#include "patternfind.h"
+#include <ppl.h>
+#include <atomic>
+#include <deque>
+#include <thread>
+
+// Size of the pieces the ranges are split into for the search workers
+#define REF_CHUNK_MIN (64 * 1024)
+#define REF_CHUNK_MAX (1024 * 1024)
+
+// Ranges are read ahead of the merge until this many bytes wait to be merged
+#define REF_READ_AHEAD (64 * 1024 * 1024)
+
+struct REFRANGE
+{
+    duint start;
+    duint size;
+    String title; // task shown in the progress
+    std::shared_ptr<ImageView> data; // released after its last chunk was merged
+};
+
+struct REFCHUNK
+{
+    size_t range;
+    duint start;
+    duint end;
+    duint next; // address after the last instruction of the sweep
+    std::vector<bool> starts; // instruction starts of the sweep
+    std::vector<duint> matches; // address of every match (the rows of cells)
+    std::vector<REFCELL> cells;
+    std::atomic<bool> done;
+};
+
+// Disassembles the instruction at addr and passes it to the callback, returns the number of bytes to skip
+static duint refDisassemble(Capstone & cp, const REFRANGE & range, duint addr, CBREF Callback, REFINFO & refInfo, bool disasmText, bool & found)
+{
+    found = false;
+    int disasmMaxSize = int(min(duint(MAX_DISASM_BUFFER), range.start + range.size - addr)); // Prevent going past the boundary
+    if(!cp.Disassemble(addr, range.data->Data() + (addr - range.start), disasmMaxSize))
+        return 1; // Invalid instruction detected, so just skip the byte
+
+    BASIC_INSTRUCTION_INFO basicinfo;
+    fillbasicinfo(&cp, &basicinfo, disasmText);
+    if(Callback(&cp, &basicinfo, &refInfo))
+    {
+        refInfo.refcount++;
+        found = true;
+    }
+    return cp.Size();
+}
+
+static void refScanChunk(REFCHUNK & chunk, const REFRANGE & range, CBREF Callback, const REFINFO & refInfo, bool disasmText, const std::atomic<bool> & cancel)
+{
+    // Every chunk has its own linear sweep, the sweeps are stitched together when the chunks are merged
+    Capstone cp;
+    REFINFO workerInfo = refInfo;
+    workerInfo.refcount = 0;
+    workerInfo.cells = &chunk.cells;
+    chunk.starts.assign(size_t(chunk.end - chunk.start), false);
+    auto addr = chunk.start;
+    while(addr < chunk.end && !cancel)
+    {
+        chunk.starts[size_t(addr - chunk.start)] = true;
+        bool found;
+        auto len = refDisassemble(cp, range, addr, Callback, workerInfo, disasmText, found);
+        if(found)
+            chunk.matches.push_back(addr);
+        addr += len;
+    }
+    chunk.next = addr;
+}
+
+static void refFindPatternsChunk(REFCHUNK & chunk, const REFRANGE & range, const std::vector<std::vector<PatternByte>> & Patterns, CBREF Callback, const REFINFO & refInfo, bool disasmText)
+{
+    // Matches that start in the chunk, they can end in the next one
+    auto offset = chunk.start - range.start;
+    std::vector<size_t> found;
+    for(const auto & pattern : Patterns)
+    {
+        auto searchSize = min(chunk.end - range.start + pattern.size() - 1, range.size) - offset;
+        patternfindall(range.data->Data() + offset, size_t(searchSize), pattern, found);
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+
+    // Only the instructions at the matches are decoded
+    Capstone cp;
+    REFINFO workerInfo = refInfo;
+    workerInfo.refcount = 0;
+    workerInfo.cells = &chunk.cells;
+    for(auto match : found)
+    {
+        bool isReference;
+        refDisassemble(cp, range, chunk.start + match, Callback, workerInfo, disasmText, isReference);
+        if(isReference)
+            chunk.matches.push_back(chunk.start + match);
+    }
+    chunk.next = chunk.end;
+}
+
+static void refMergeChunk(REFCHUNK & chunk, const REFRANGE & range, Capstone & cp, duint & next, CBREF Callback, REFINFO & refInfo, bool disasmText, bool sweep)
+{
+    auto first = 0;
+    if(sweep)
+    {
+        if(chunk.start == range.start)
+            next = range.start;
+
+        // The previous chunk ended in the middle of an instruction of this chunk's sweep, continue it until they synchronize
+        while(next < chunk.end && !chunk.starts[size_t(next - chunk.start)])
+        {
+            bool found;
+            next += refDisassemble(cp, range, next, Callback, refInfo, disasmText, found);
+        }
+        if(next >= chunk.end)
+            return;
+
+        // Only the matches from the synchronization point on are part of the sweep
+        first = int(std::lower_bound(chunk.matches.begin(), chunk.matches.end(), next) - chunk.matches.begin());
+    }
+    auto count = int(chunk.matches.size()) - first;
+    if(count)
+    {
+        JobRefSetRowCount(refInfo.job, refInfo.refcount + count);
+        for(const auto & cell : chunk.cells)
+            if(cell.row >= first && cell.row < int(chunk.matches.size()))
+                JobRefSetCellContent(refInfo.job, refInfo.refcount + cell.row - first, cell.col, cell.text.c_str());
+        refInfo.refcount += count;
+    }
+    next = chunk.next;
+}
+
+// Linear sweep over the ranges, or only the instructions at the matches of Patterns when it is not null
+static void refSearch(std::vector<REFRANGE> & ranges, const std::vector<std::vector<PatternByte>>* Patterns, CBREF Callback, REFINFO & refInfo, bool Silent, bool disasmText)
+{
+    duint totalSize = 0;
+    for(const auto & range : ranges)
+        totalSize += range.size;
+
+    // The workers scan the chunks in parallel, this thread reads the ranges and merges the chunks in order
+    Handle hChunkDone = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    std::deque<REFCHUNK> chunks;
+    std::atomic<bool> cancel(false);
+    std::atomic<duint> scannedSize(0);
+    concurrency::task_group workers;
+    duint threadCount = max(std::thread::hardware_concurrency(), 1u);
+    size_t readCount = 0;
+    size_t mergedCount = 0;
+    duint readAhead = 0;
+    duint next = 0;
+    int lastPercent = -1;
+    int lastTaskPercent = -1;
+    Capstone cp;
+
+    // The workers only read the shared parts of REFINFO, the row count is changed by the merge
+    const REFINFO workerInfo = refInfo;
+    while(mergedCount < chunks.size() || readCount < ranges.size())
+    {
+        // Stop when the job was cancelled
+        if(JobIsCancelled(refInfo.job))
+        {
+            cancel = true;
+            break;
+        }
+
+        while(readCount < ranges.size() && readAhead < REF_READ_AHEAD)
+        {
+            auto rangeIndex = readCount++;
+            auto & range = ranges[rangeIndex];
+            range.data = std::make_shared<ImageView>();
+            if(!range.data->Read(range.start, range.size))
+            {
+                if(!Silent)
+                    dprintf("Error reading memory in reference search\n");
+                range.data.reset();
+                scannedSize += range.size;
+                continue;
+            }
+            readAhead += range.size;
+
+            auto chunkSize = max(duint(REF_CHUNK_MIN), min(duint(REF_CHUNK_MAX), range.size / threadCount));
+            auto rangeEnd = range.start + range.size;
+            for(auto start = range.start; start < rangeEnd; start += chunkSize)
+            {
+                chunks.emplace_back();
+                auto & chunk = chunks.back();
+                chunk.range = rangeIndex;
+                chunk.start = start;
+                chunk.end = min(start + chunkSize, rangeEnd);
+                chunk.done = false;
+                auto chunkPtr = &chunk;
+                workers.run([&, chunkPtr, rangeIndex]()
+                {
+                    if(Patterns)
+                        refFindPatternsChunk(*chunkPtr, ranges[rangeIndex], *Patterns, Callback, workerInfo, disasmText);
+                    else
+                        refScanChunk(*chunkPtr, ranges[rangeIndex], Callback, workerInfo, disasmText, cancel);
+                    scannedSize += chunkPtr->end - chunkPtr->start;
+                    chunkPtr->done = true;
+                    SetEvent(hChunkDone);
+                });
+            }
+        }
+
+        if(mergedCount < chunks.size() && chunks[mergedCount].done)
+        {
+            auto & chunk = chunks[mergedCount++];
+            auto & range = ranges[chunk.range];
+            refMergeChunk(chunk, range, cp, next, Callback, refInfo, disasmText, !Patterns);
+            if(chunk.end == range.start + range.size)
+            {
+                readAhead -= range.size;
+                range.data.reset();
+            }
+            chunk.starts = std::vector<bool>();
+            chunk.matches = std::vector<duint>();
+            chunk.cells = std::vector<REFCELL>();
+            continue;
+        }
+
+        // Percent = (current / total) * 100
+        int percent = totalSize ? int(duint(scannedSize) * 100 / totalSize) : 100;
+        if(percent != lastPercent)
+        {
+            JobRefSetProgress(refInfo.job, percent);
+            lastPercent = percent;
+        }
+        if(mergedCount < chunks.size())
+        {
+            const auto & chunk = chunks[mergedCount];
+            const auto & range = ranges[chunk.range];
+            int taskPercent = int((chunk.start - range.start) * 100 / range.size);
+            if(taskPercent != lastTaskPercent)
+            {
+                JobRefSetCurrentTaskProgress(refInfo.job, taskPercent, range.title.c_str());
+                lastTaskPercent = taskPercent;
+            }
+            WaitForSingleObject(hChunkDone, 100);
+        }
+    }
+    workers.wait();
+}
 
-int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText)
+static int refFind(duint Address, duint Size, const std::vector<std::vector<PatternByte>>* Patterns, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText, unsigned int Job)
 {
     char fullName[deflen];
     char moduleName[MAX_MODULE_SIZE];
-    duint scanStart, scanSize;
-    REFINFO refInfo;
+    std::vector<REFRANGE> ranges;
 
     if(type == CURRENT_REGION) // Search in current Region
     {
@@ -32,8 +276,10 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
         }
 
         // Assume the entire range is used
-        scanStart = regionBase;
-        scanSize  = regionSize;
+        REFRANGE range;
+        range.start = regionBase;
+        range.size = regionSize;
+        range.title = "Region Search";
 
         // Otherwise use custom boundaries if size was supplied
         if(Size)
@@ -41,29 +287,17 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
             duint maxsize = Size - (Address - regionBase);
 
             // Make sure the size fits in one page
-            scanStart = Address;
-            scanSize  = min(Size, maxsize);
+            range.start = Address;
+            range.size = min(Size, maxsize);
         }
 
         // Determine the full module name
-        if(ModNameFromAddr(scanStart, moduleName, true))
+        if(ModNameFromAddr(range.start, moduleName, true))
             sprintf_s(fullName, "%s (Region %s)", Name, moduleName);
         else
-            sprintf_s(fullName, "%s (Region %p)", Name, scanStart);
+            sprintf_s(fullName, "%s (Region %p)", Name, range.start);
 
-        // Initialize disassembler
-        Capstone cp;
-
-        // Allow an "initialization" notice
-        refInfo.refcount = 0;
-        refInfo.userinfo = UserData;
-        refInfo.name = fullName;
-
-        RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, cp, true, [](int percent)
-        {
-            GuiReferenceSetCurrentTaskProgress(percent, "Region Search");
-            GuiReferenceSetProgress(percent);
-        }, disasmText);
+        ranges.push_back(range);
     }
     else if(type == CURRENT_MODULE) // Search in current Module
     {
@@ -78,37 +312,23 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
             return 0;
         }
 
-        duint modBase = modInfo->base;
-        duint modSize = modInfo->size;
+        REFRANGE range;
+        range.start = modInfo->base;
+        range.size = modInfo->size;
+        range.title = "Module Search";
 
         SHARED_RELEASE();
 
-        scanStart = modBase;
-        scanSize  = modSize;
-
         // Determine the full module name
-        if(ModNameFromAddr(scanStart, moduleName, true))
+        if(ModNameFromAddr(range.start, moduleName, true))
             sprintf_s(fullName, "%s (%s)", Name, moduleName);
         else
-            sprintf_s(fullName, "%s (%p)", Name, scanStart);
-
-        // Initialize disassembler
-        Capstone cp;
-
-        // Allow an "initialization" notice
-        refInfo.refcount = 0;
-        refInfo.userinfo = UserData;
-        refInfo.name = fullName;
+            sprintf_s(fullName, "%s (%p)", Name, range.start);
 
-        RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, cp, true, [](int percent)
-        {
-            GuiReferenceSetCurrentTaskProgress(percent, "Module Search");
-            GuiReferenceSetProgress(percent);
-        }, disasmText);
+        ranges.push_back(range);
     }
     else if(type == ALL_MODULES) // Search in all Modules
     {
-        bool initCallBack = true;
         std::vector<MODINFO> modList;
         ModGetList(modList);
 
@@ -120,98 +340,56 @@ int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Sile
             return 0;
         }
 
-        // Initialize disassembler
-        Capstone cp;
-
         // Determine the full module
         sprintf_s(fullName, "All Modules (%s)", Name);
 
-        // Allow an "initialization" notice
-        refInfo.refcount = 0;
-        refInfo.userinfo = UserData;
-        refInfo.name = fullName;
-
-        for(duint i = 0; i < modList.size(); i++)
+        for(const auto & mod : modList)
         {
-            scanStart = modList[i].base;
-            scanSize  = modList[i].size;
-
-            if(i != 0)
-                initCallBack = false;
-
-            RefFindInRange(scanStart, scanSize, Callback, UserData, Silent, refInfo, cp, initCallBack, [&i, &modList](int percent)
-            {
-                float fPercent = (float)percent / 100.f;
-                float fTotalPercent = ((float)i + fPercent) / (float)modList.size();
-
-                int totalPercent = (int)floor(fTotalPercent * 100.f);
-
-                char tst[256];
-                strcpy_s(tst, modList[i].name);
-
-                GuiReferenceSetCurrentTaskProgress(percent, modList[i].name);
-                GuiReferenceSetProgress(totalPercent);
-            }, disasmText);
+            REFRANGE range;
+            range.start = mod.base;
+            range.size = mod.size;
+            range.title = mod.name;
+            ranges.push_back(range);
         }
     }
 
-    GuiReferenceSetProgress(100);
-    GuiReferenceReloadData();
+    // Allow an "initialization" notice
+    REFINFO refInfo;
+    refInfo.refcount = 0;
+    refInfo.userinfo = UserData;
+    refInfo.name = fullName;
+    refInfo.job = Job;
+    refInfo.cells = nullptr;
+    Callback(0, 0, &refInfo);
+
+    refSearch(ranges, Patterns, Callback, refInfo, Silent, disasmText);
+
+    JobRefSetProgress(Job, 100);
+    JobRefReloadData(Job);
     return refInfo.refcount;
 }
 
-int RefFindInRange(duint scanStart, duint scanSize, CBREF Callback, void* UserData, bool Silent, REFINFO & refInfo, Capstone & cp, bool initCallBack, CBPROGRESS cbUpdateProgress, bool disasmText)
+int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText, unsigned int Job)
 {
-    // Allocate and read a buffer from the remote process
-    Memory<unsigned char*> data(scanSize, "reffind:data");
-
-    if(!MemRead(scanStart, data(), scanSize))
-    {
-        if(!Silent)
-            dprintf("Error reading memory in reference search\n");
-
-        return 0;
-    }
+    return refFind(Address, Size, nullptr, Callback, UserData, Silent, Name, type, disasmText, Job);
+}
 
-    if(initCallBack)
-        Callback(0, 0, &refInfo);
+int RefFindPatterns(duint Address, duint Size, const std::vector<std::vector<PatternByte>> & Patterns, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText, unsigned int Job)
+{
+    return refFind(Address, Size, &Patterns, Callback, UserData, Silent, Name, type, disasmText, Job);
+}
 
-    //concurrency::parallel_for(duint (0), scanSize, [&](duint i)
-    for(duint i = 0; i < scanSize;)
+void RefSetCellContent(REFINFO* refinfo, int col, const char* str)
+{
+    if(refinfo->cells)
     {
-        // Print the progress every 4096 bytes
-        if((i % 0x1000) == 0)
-        {
-            // Percent = (current / total) * 100
-            // Integer = floor(percent)
-            int percent = (int)floor(((float)i / (float)scanSize) * 100.0f);
-
-            cbUpdateProgress(percent);
-        }
-
-        // Disassemble the instruction
-        int disasmMaxSize = min(MAX_DISASM_BUFFER, (int)(scanSize - i)); // Prevent going past the boundary
-        int disasmLen = 1;
-
-        if(cp.Disassemble(scanStart, data() + i, disasmMaxSize))
-        {
-            BASIC_INSTRUCTION_INFO basicinfo;
-            fillbasicinfo(&cp, &basicinfo, disasmText);
-
-            if(Callback(&cp, &basicinfo, &refInfo))
-                refInfo.refcount++;
-
-            disasmLen = cp.Size();
-        }
-        else
-        {
-            // Invalid instruction detected, so just skip the byte
-        }
-
-        scanStart += disasmLen;
-        i += disasmLen;
+        REFCELL cell;
+        cell.row = refinfo->refcount;
+        cell.col = col;
+        cell.text = str;
+        refinfo->cells->push_back(cell);
+        return;
     }
-
-    cbUpdateProgress(100);
-    return refInfo.refcount;
+    JobRefSetRowCount(refinfo->job, refinfo->refcount + 1);
+    JobRefSetCellContent(refinfo->job, refinfo->refcount, col, str);
 }
@@ -3,13 +3,22 @@
 
 #include "_global.h"
 #include "disasm_fast.h"
-#include <functional>
+#include "patternfind.h"
+
+struct REFCELL
+{
+    int row;
+    int col;
+    String text;
+};
 
 struct REFINFO
 {
     int refcount;
     void* userinfo;
     const char* name;
+    unsigned int job;
+    std::vector<REFCELL>* cells; // results of a search worker, merged into the reference view in address order
 };
 
 typedef enum
@@ -19,11 +28,17 @@ typedef enum
     ALL_MODULES
 } REFFINDTYPE;
 
-// Reference callback typedef
+// Reference callback typedef. The search workers call it concurrently, each with its own REFINFO, so it has to be
+// thread-safe: the row of a match is written with RefSetCellContent and userinfo is shared by all workers.
+// The initialization call (disasm == nullptr) is made once by the searching thread.
 typedef bool (*CBREF)(Capstone* disasm, BASIC_INSTRUCTION_INFO* basicinfo, REFINFO* refinfo);
-typedef std::function<void(int)> CBPROGRESS;
 
-int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText);
-int RefFindInRange(duint scanStart, duint scanSize, CBREF Callback, void* UserData, bool Silent, REFINFO & refInfo, Capstone & cp, bool initCallBack, CBPROGRESS cbUpdateProgress, bool disasmText);
+int RefFind(duint Address, duint Size, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText, unsigned int Job = 0);
+
+// Like RefFind, but the callback only gets the instructions at the matches of the patterns
+int RefFindPatterns(duint Address, duint Size, const std::vector<std::vector<PatternByte>> & Patterns, CBREF Callback, void* UserData, bool Silent, const char* Name, REFFINDTYPE type, bool disasmText, unsigned int Job = 0);
+
+// Sets a column of the row of the current match (refinfo->refcount)
+void RefSetCellContent(REFINFO* refinfo, int col, const char* str);
 
 #endif // _REFERENCE_H
\ No newline at end of file
@@ -133,19 +133,48 @@ public:
     bool Delete(const TKey & key)
     {
         EXCLUSIVE_ACQUIRE(TLock);
+        mGeneration++;
         return mMap.erase(key) > 0;
     }
 
     void DeleteWhere(TValuePred predicate)
     {
         EXCLUSIVE_ACQUIRE(TLock);
+        deleteWhereNoLock(predicate);
+    }
+
+    // Replaces the values matching the predicate with the new values that do not collide with an existing key,
+    // values that are equal to their replacement are kept (the generation only changes if something changed)
+    void ReplaceWhere(TValuePred predicate, const std::vector<TValue> & values, std::function<bool(const TValue & a, const TValue & b)> equal)
+    {
+        EXCLUSIVE_ACQUIRE(TLock);
+        TMap updated;
+        for(const auto & value : values)
+            updated.insert(std::make_pair(makeKey(value), value));
+        auto changed = false;
         for(auto itr = mMap.begin(); itr != mMap.end();)
         {
-            if(predicate(itr->second))
-                itr = mMap.erase(itr);
-            else
+            if(!predicate(itr->second))
+            {
+                ++itr;
+                continue;
+            }
+            auto found = updated.find(itr->first);
+            if(found != updated.end() && equal(found->second, itr->second))
+            {
+                updated.erase(found);
                 ++itr;
+            }
+            else
+            {
+                itr = mMap.erase(itr);
+                changed = true;
+            }
         }
+        for(const auto & itr : updated)
+            changed |= mMap.insert(itr).second;
+        if(changed)
+            mGeneration++;
     }
 
     bool GetWhere(TValuePred predicate, TValue & value)
@@ -161,6 +190,7 @@ public:
     void Clear()
     {
         EXCLUSIVE_ACQUIRE(TLock);
+        mGeneration++;
         mMap.clear();
     }
 
@@ -247,6 +277,12 @@ public:
         return mMap;
     }
 
+    // Changes on every modification of the map, read it while holding the lock
+    duint GetGenerationUnsafe() const
+    {
+        return mGeneration;
+    }
+
     virtual void AdjustValue(TValue & value) const = 0;
 
 protected:
@@ -255,13 +291,27 @@ protected:
 
 private:
     TMap mMap;
+    duint mGeneration = 0;
 
     bool addNoLock(const TValue & value)
     {
+        mGeneration++;
         mMap[makeKey(value)] = value;
         return true;
     }
 
+    void deleteWhereNoLock(TValuePred predicate)
+    {
+        mGeneration++;
+        for(auto itr = mMap.begin(); itr != mMap.end();)
+        {
+            if(predicate(itr->second))
+                itr = mMap.erase(itr);
+            else
+                ++itr;
+        }
+    }
+
     bool getWhere(TValuePred predicate, TValue* value)
     {
         SHARED_ACQUIRE(TLock);
@@ -10,9 +10,35 @@
 #include "x64_dbg.h"
 #include "debugger.h"
 #include "filehelper.h"
+#include "commandparser.h"
+#include "threading.h"
+
+enum SCRIPTINTERNALCMD
+{
+    scriptinternalnone,
+    scriptinternalret,
+    scriptinternalinvalid,
+    scriptinternalpause,
+    scriptinternalnop
+};
+
+struct SCRIPTCOMPILEDLINE
+{
+    SCRIPTINTERNALCMD internal; //internal script command
+    COMMAND* cmd; //resolved command (null when it has to be resolved when executing)
+    duint cmdgeneration; //command list generation cmd was resolved in
+    String command; //trimmed command text
+    std::vector<String> args; //tokenised arguments
+    bool isvar; //var command (does not wait for the debuggee)
+    int labelline; //branch destination label line
+    unsigned int hits; //profiler: number of executions
+    LONGLONG ticks; //profiler: performance counter ticks spent on this line
+};
 
 static std::vector<LINEMAPENTRY> linemap;
 
+static std::vector<SCRIPTCOMPILEDLINE> scriptcompiled;
+
 static std::vector<SCRIPTBP> scriptbplist;
 
 static std::vector<int> scriptstack;
@@ -73,6 +99,68 @@ static int scriptinternalstep(int fromIp) //internal step routine
     return fromIp;
 }
 
+static bool scriptisinternalcommand(const char* text, const char* cmd);
+
+static bool scriptresolve(SCRIPTCOMPILEDLINE & line)
+{
+    //commands that need special formatting (x=y, x++) depend on the current variables, resolve them when executing
+    const String & command = line.command;
+    auto len = command.length();
+    if(command.find('=') != String::npos || (len >= 2 && ((command[len - 1] == '+' && command[len - 2] == '+') || (command[len - 1] == '-' && command[len - 2] == '-'))))
+        return false;
+    line.cmd = cmdfind(command.c_str(), 0);
+    if(!line.cmd)
+        line.cmd = cmdget(command.c_str());
+    line.cmdgeneration = cmdgetgeneration();
+    if(!line.cmd)
+        return false;
+    line.isvar = arraycontains(line.cmd->name, "var");
+    return true;
+}
+
+static void scriptcompile()
+{
+    int linecount = (int)linemap.size();
+    std::vector<SCRIPTCOMPILEDLINE>(linecount).swap(scriptcompiled);
+    for(int i = 0; i < linecount; i++)
+    {
+        const LINEMAPENTRY & entry = linemap.at(i);
+        SCRIPTCOMPILEDLINE & line = scriptcompiled.at(i);
+        line.internal = scriptinternalnone;
+        line.cmd = nullptr;
+        line.cmdgeneration = 0;
+        line.isvar = false;
+        line.labelline = 0;
+        line.hits = 0;
+        line.ticks = 0;
+        if(entry.type == linebranch)
+            line.labelline = scriptlabelfind(entry.u.branch.branchlabel);
+        else if(entry.type == linecommand)
+        {
+            const char* text = entry.u.command;
+            if(scriptisinternalcommand(text, "ret"))
+                line.internal = scriptinternalret;
+            else if(scriptisinternalcommand(text, "invalid"))
+                line.internal = scriptinternalinvalid;
+            else if(scriptisinternalcommand(text, "pause"))
+                line.internal = scriptinternalpause;
+            else if(scriptisinternalcommand(text, "nop"))
+                line.internal = scriptinternalnop;
+            else
+            {
+                line.command = StringUtils::Trim(text);
+                if(scriptresolve(line))
+                {
+                    Command commandParsed(line.command);
+                    int argcount = commandParsed.GetArgCount();
+                    for(int j = 0; j < argcount; j++)
+                        line.args.push_back(commandParsed.GetArg(j));
+                }
+            }
+        }
+    }
+}
+
 static bool scriptcreatelinemap(const char* filename)
 {
     String filedata;
@@ -248,6 +336,7 @@ static bool scriptcreatelinemap(const char* filename)
         strcpy_s(entry.u.command, "ret");
         linemap.push_back(entry);
     }
+    scriptcompile();
     return true;
 }
 
@@ -298,19 +387,29 @@ static bool scriptisinternalcommand(const char* text, const char* cmd)
     return false;
 }
 
-static CMDRESULT scriptinternalcmdexec(const char* cmd)
+static CMDRESULT scriptinternalret()
 {
-    if(scriptisinternalcommand(cmd, "ret")) //script finished
+    if(!scriptstack.size()) //nothing on the stack
     {
-        if(!scriptstack.size()) //nothing on the stack
-        {
-            GuiScriptMessage("Script finished!");
-            return STATUS_EXIT;
-        }
-        scriptIp = scriptstack.back(); //set scriptIp to the call address (scriptinternalstep will step over it)
-        scriptstack.pop_back(); //remove last stack entry
-        return STATUS_CONTINUE;
+        GuiScriptMessage("Script finished!");
+        return STATUS_EXIT;
     }
+    scriptIp = scriptstack.back(); //set scriptIp to the call address (scriptinternalstep will step over it)
+    scriptstack.pop_back(); //remove last stack entry
+    return STATUS_CONTINUE;
+}
+
+static void scriptwaitpaused()
+{
+    //block until the debuggee is paused again (NOTE: possible deadlock)
+    while(DbgIsDebugging() && dbgisrunning())
+        waitlocked(WAITID_RUN, 100);
+}
+
+static CMDRESULT scriptinternalcmdexec(const char* cmd)
+{
+    if(scriptisinternalcommand(cmd, "ret")) //script finished
+        return scriptinternalret();
     else if(scriptisinternalcommand(cmd, "invalid")) //invalid command for testing
         return STATUS_ERROR;
     else if(scriptisinternalcommand(cmd, "pause")) //pause the script
@@ -328,8 +427,32 @@ static CMDRESULT scriptinternalcmdexec(const char* cmd)
         return STATUS_CONTINUE;
     }
     CMDRESULT res = cmddirectexec(command);
-    while(DbgIsDebugging() && dbgisrunning()) //while not locked (NOTE: possible deadlock)
-        Sleep(10);
+    scriptwaitpaused();
+    return res;
+}
+
+static CMDRESULT scriptcompiledexec(SCRIPTCOMPILEDLINE & line, const char* cmd)
+{
+    switch(line.internal)
+    {
+    case scriptinternalret: //script finished
+        return scriptinternalret();
+    case scriptinternalinvalid: //invalid command for testing
+        return STATUS_ERROR;
+    case scriptinternalpause: //pause the script
+        return STATUS_PAUSE;
+    case scriptinternalnop: //do nothing
+        return STATUS_CONTINUE;
+    default:
+        break;
+    }
+    if(line.cmd && line.cmdgeneration != cmdgetgeneration() && !scriptresolve(line)) //the command list changed
+        line.cmd = nullptr;
+    if(!line.cmd) //not resolved ahead of time
+        return scriptinternalcmdexec(cmd);
+    CMDRESULT res = cmddirectexecparsed(line.cmd, line.command.c_str(), line.args);
+    if(!line.isvar)
+        scriptwaitpaused();
     return res;
 }
 
@@ -380,10 +503,14 @@ static bool scriptinternalbranch(SCRIPTBRANCHTYPE type) //determine if we should
 static bool scriptinternalcmd()
 {
     bool bContinue = true;
-    LINEMAPENTRY cur = linemap.at(scriptIp - 1);
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    const LINEMAPENTRY & cur = linemap.at(scriptIp - 1);
+    SCRIPTCOMPILEDLINE & line = scriptcompiled.at(scriptIp - 1);
+    line.hits++;
     if(cur.type == linecommand)
     {
-        switch(scriptinternalcmdexec(cur.u.command))
+        switch(scriptcompiledexec(line, cur.u.command))
         {
         case STATUS_CONTINUE:
             break;
@@ -408,8 +535,11 @@ static bool scriptinternalcmd()
         if(cur.u.branch.type == scriptcall) //calls have a special meaning
             scriptstack.push_back(scriptIp);
         if(scriptinternalbranch(cur.u.branch.type))
-            scriptIp = scriptlabelfind(cur.u.branch.branchlabel);
+            scriptIp = line.labelline;
     }
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+    line.ticks += end.QuadPart - start.QuadPart;
     return bContinue;
 }
 
@@ -441,7 +571,6 @@ static DWORD WINAPI scriptRunThread(void* arg)
             scriptIp = scriptinternalstep(scriptIp); //this is the next ip
         if(scriptinternalbpget(scriptIp)) //breakpoint=stop run loop
             bContinue = false;
-        Sleep(1); //don't fry the processor
     }
     bIsRunning = false; //not running anymore
     GuiScriptSetIp(scriptIp);
@@ -633,6 +762,38 @@ CMDRESULT cbScriptMsg(int argc, char* argv[])
     return STATUS_CONTINUE;
 }
 
+CMDRESULT cbScriptProfile(int argc, char* argv[])
+{
+    if(argc > 1 && scmp(argv[1], "clear"))
+    {
+        for(auto & line : scriptcompiled)
+        {
+            line.hits = 0;
+            line.ticks = 0;
+        }
+        dputs("script profile cleared!");
+        return STATUS_CONTINUE;
+    }
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    std::vector<int> lines;
+    for(int i = 0; i < (int)scriptcompiled.size(); i++)
+        if(scriptcompiled.at(i).hits)
+            lines.push_back(i);
+    std::sort(lines.begin(), lines.end(), [](int a, int b)
+    {
+        return scriptcompiled.at(a).ticks > scriptcompiled.at(b).ticks;
+    });
+    for(auto i : lines)
+    {
+        const SCRIPTCOMPILEDLINE & line = scriptcompiled.at(i);
+        double ms = double(line.ticks) * 1000.0 / double(frequency.QuadPart);
+        dprintf("line %d: %u hit(s), %.3fms (%.3fus/hit) %s\n", i + 1, line.hits, ms, ms * 1000.0 / line.hits, linemap.at(i).raw);
+    }
+    dprintf("%d script line(s) executed\n", int(lines.size()));
+    return STATUS_CONTINUE;
+}
+
 CMDRESULT cbScriptMsgyn(int argc, char* argv[])
 {
     if(argc < 2)
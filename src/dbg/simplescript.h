@@ -41,5 +41,6 @@ bool scriptgetbranchinfo(int line, SCRIPTBRANCH* info);
 CMDRESULT cbScriptLoad(int argc, char* argv[]);
 CMDRESULT cbScriptMsg(int argc, char* argv[]);
 CMDRESULT cbScriptMsgyn(int argc, char* argv[]);
+CMDRESULT cbScriptProfile(int argc, char* argv[]);
 
 #endif // _SIMPLESCRIPT_H
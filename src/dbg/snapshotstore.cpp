@@ -0,0 +1,192 @@
+/**
+ @file snapshotstore.cpp
+
+ @brief Implements the page store behind the memory snapshots.
+ */
+
+#include "snapshotstore.h"
+#include <string.h>
+#include <algorithm>
+#include "murmurhash.h"
+#include "lz4/lz4.h"
+
+int SnapshotStore::Begin()
+{
+    mChanges.emplace_back();
+    return ++mSnapshot;
+}
+
+void SnapshotStore::AddPage(size_t Address, const unsigned char* Data)
+{
+    PAGEHASH hash;
+    unsigned long long hashes[2];
+    MurmurHash3_x64_128(Data, SNAPSHOT_PAGE_SIZE, 0x1337, hashes);
+    hash.low = hashes[0];
+    hash.high = hashes[1];
+
+    auto found = mCurrent.find(Address);
+    if(found != mCurrent.end())
+    {
+        found->second.seen = mSnapshot;
+        if(found->second.hash == hash)
+            return;
+        found->second.hash = hash;
+    }
+    else
+    {
+        CURRENTPAGE page;
+        page.hash = hash;
+        page.seen = mSnapshot;
+        mCurrent.insert(std::make_pair(Address, page));
+    }
+    addVersion(Address, true, hash);
+
+    // Store the content unless another page (or an earlier version) already had it
+    if(mContents.count(hash))
+        return;
+    std::vector<char> compressed(LZ4_compressBound(SNAPSHOT_PAGE_SIZE));
+    int size = LZ4_compress((const char*)Data, compressed.data(), SNAPSHOT_PAGE_SIZE);
+    if(size <= 0 || size >= SNAPSHOT_PAGE_SIZE)
+        compressed.assign((const char*)Data, (const char*)Data + SNAPSHOT_PAGE_SIZE);
+    else
+        compressed.resize(size);
+    compressed.shrink_to_fit();
+    mStoredBytes += compressed.size();
+    mContents.insert(std::make_pair(hash, std::move(compressed)));
+}
+
+void SnapshotStore::End()
+{
+    // The pages that were not added to this snapshot are gone
+    for(auto itr = mCurrent.begin(); itr != mCurrent.end();)
+    {
+        if(itr->second.seen == mSnapshot)
+        {
+            ++itr;
+            continue;
+        }
+        addVersion(itr->first, false, itr->second.hash);
+        itr = mCurrent.erase(itr);
+    }
+}
+
+bool SnapshotStore::Diff(int First, int Second, std::vector<SNAPSHOTRANGE> & Ranges) const
+{
+    Ranges.clear();
+    if(First < 0 || Second < 0 || First > mSnapshot || Second > mSnapshot)
+        return false;
+
+    // Only the pages that changed in one of the snapshots in between can differ
+    std::vector<size_t> pages;
+    for(auto i = std::min(First, Second); i < std::max(First, Second); i++)
+        pages.insert(pages.end(), mChanges[i].begin(), mChanges[i].end());
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+    std::vector<unsigned char> first(SNAPSHOT_PAGE_SIZE);
+    std::vector<unsigned char> second(SNAPSHOT_PAGE_SIZE);
+    for(auto address : pages)
+    {
+        auto before = findVersion(address, First);
+        auto after = findVersion(address, Second);
+        bool presentBefore = before && before->present;
+        bool presentAfter = after && after->present;
+        SNAPSHOTCHANGE type;
+        size_t changedBytes = 0;
+        if(presentBefore && presentAfter)
+        {
+            if(before->hash == after->hash)
+                continue;
+            type = SnapshotPageModified;
+            if(getContent(before->hash, first.data()) && getContent(after->hash, second.data()))
+            {
+                for(size_t i = 0; i < SNAPSHOT_PAGE_SIZE; i++)
+                    changedBytes += first[i] != second[i];
+            }
+        }
+        else if(presentBefore)
+            type = SnapshotPageRemoved;
+        else if(presentAfter)
+            type = SnapshotPageAdded;
+        else
+            continue;
+
+        // Merge adjacent pages with the same kind of change
+        if(!Ranges.empty() && Ranges.back().type == type && Ranges.back().start + Ranges.back().size == address)
+        {
+            Ranges.back().size += SNAPSHOT_PAGE_SIZE;
+            Ranges.back().changedBytes += changedBytes;
+            continue;
+        }
+        SNAPSHOTRANGE range;
+        range.start = address;
+        range.size = SNAPSHOT_PAGE_SIZE;
+        range.type = type;
+        range.changedBytes = changedBytes;
+        Ranges.push_back(range);
+    }
+    return true;
+}
+
+int SnapshotStore::Count() const
+{
+    return mSnapshot;
+}
+
+size_t SnapshotStore::StoredPages() const
+{
+    return mContents.size();
+}
+
+size_t SnapshotStore::StoredBytes() const
+{
+    return mStoredBytes;
+}
+
+void SnapshotStore::Clear()
+{
+    mSnapshot = 0;
+    mStoredBytes = 0;
+    mCurrent.clear();
+    mHistory.clear();
+    mChanges.clear();
+    mContents.clear();
+}
+
+void SnapshotStore::addVersion(size_t address, bool present, const PAGEHASH & hash)
+{
+    PAGEVERSION version;
+    version.snapshot = mSnapshot;
+    version.present = present;
+    version.hash = hash;
+    mHistory[address].push_back(version);
+    mChanges.back().push_back(address);
+}
+
+const SnapshotStore::PAGEVERSION* SnapshotStore::findVersion(size_t address, int snapshot) const
+{
+    // The last version recorded at or before the snapshot
+    auto found = mHistory.find(address);
+    if(found == mHistory.end())
+        return nullptr;
+    const auto & versions = found->second;
+    auto next = std::upper_bound(versions.begin(), versions.end(), snapshot, [](int snapshot, const PAGEVERSION & version)
+    {
+        return snapshot < version.snapshot;
+    });
+    return next == versions.begin() ? nullptr : &*(next - 1);
+}
+
+bool SnapshotStore::getContent(const PAGEHASH & hash, unsigned char* data) const
+{
+    auto found = mContents.find(hash);
+    if(found == mContents.end())
+        return false;
+    const auto & content = found->second;
+    if(content.size() == SNAPSHOT_PAGE_SIZE)
+    {
+        memcpy(data, content.data(), SNAPSHOT_PAGE_SIZE);
+        return true;
+    }
+    return LZ4_decompress_safe(content.data(), (char*)data, int(content.size()), SNAPSHOT_PAGE_SIZE) == SNAPSHOT_PAGE_SIZE;
+}
\ No newline at end of file
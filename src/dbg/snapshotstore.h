@@ -0,0 +1,87 @@
+#ifndef _SNAPSHOTSTORE_H
+#define _SNAPSHOTSTORE_H
+
+#include <vector>
+#include <unordered_map>
+#include <stddef.h>
+
+// Size of the pages a SnapshotStore records
+#define SNAPSHOT_PAGE_SIZE 0x1000
+
+enum SNAPSHOTCHANGE
+{
+    SnapshotPageAdded,
+    SnapshotPageRemoved,
+    SnapshotPageModified
+};
+
+struct SNAPSHOTRANGE
+{
+    size_t start;
+    size_t size;
+    SNAPSHOTCHANGE type;
+    size_t changedBytes; // number of bytes that differ (modified ranges only)
+};
+
+// Page contents of a series of snapshots. A snapshot only records the pages that changed since the previous one
+// and every distinct page content is stored once (LZ4 compressed), looked up by its 128-bit hash.
+// The store does not touch the debuggee, the pages are passed in by the caller.
+class SnapshotStore
+{
+public:
+    // Snapshot 0 is the empty address space before the first snapshot
+    int Begin();
+    void AddPage(size_t Address, const unsigned char* Data);
+    void End();
+    bool Diff(int First, int Second, std::vector<SNAPSHOTRANGE> & Ranges) const;
+    int Count() const;
+    size_t StoredPages() const;
+    size_t StoredBytes() const;
+    void Clear();
+
+private:
+    struct PAGEHASH
+    {
+        unsigned long long low;
+        unsigned long long high;
+
+        bool operator==(const PAGEHASH & b) const
+        {
+            return low == b.low && high == b.high;
+        }
+    };
+
+    struct PAGEHASHER
+    {
+        size_t operator()(const PAGEHASH & hash) const
+        {
+            return size_t(hash.low);
+        }
+    };
+
+    struct PAGEVERSION
+    {
+        int snapshot;
+        bool present;
+        PAGEHASH hash;
+    };
+
+    struct CURRENTPAGE
+    {
+        PAGEHASH hash;
+        int seen;
+    };
+
+    int mSnapshot = 0;
+    size_t mStoredBytes = 0;
+    std::unordered_map<size_t, CURRENTPAGE> mCurrent;
+    std::unordered_map<size_t, std::vector<PAGEVERSION>> mHistory; // versions of a page, sorted by snapshot
+    std::vector<std::vector<size_t>> mChanges; // pages that changed in every snapshot
+    std::unordered_map<PAGEHASH, std::vector<char>, PAGEHASHER> mContents;
+
+    void addVersion(size_t address, bool present, const PAGEHASH & hash);
+    const PAGEVERSION* findVersion(size_t address, int snapshot) const;
+    bool getContent(const PAGEHASH & hash, unsigned char* data) const;
+};
+
+#endif // _SNAPSHOTSTORE_H
\ No newline at end of file
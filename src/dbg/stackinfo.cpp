@@ -39,22 +39,37 @@ void stackupdateseh()
     SehCache = std::move(newcache);
 }
 
-bool stackcommentget(duint addr, STACK_COMMENT* comment)
+struct STACKCALLSITE
 {
-    SHARED_ACQUIRE(LockSehCache);
-    const auto found = SehCache.find(addr);
-    if(found != SehCache.end())
+    bool isCall; // the instruction before the value is a call
+    duint callTarget; // destination of that call (0 when unknown)
+};
+
+#define MAX_CALLSITE_CACHE 0x10000
+
+using CallSiteMap = std::unordered_map<duint, STACKCALLSITE>;
+static CallSiteMap CallSiteCache;
+static duint CallSiteCacheGeneration = 0;
+
+static bool stackgetcallsite(duint data, duint & callTarget)
+{
+    // Only return sites in modules are remembered, until the module list, the memory map (the debuggee
+    // unpacking or changing page rights) or the memory contents (MemWrite/patches) change
+    auto cacheable = ModBaseFromAddr(data) != 0;
+    auto generation = ModGetGeneration() + MemGetMapGeneration() + MemGetWriteGeneration();
+    if(cacheable)
     {
-        *comment = found->second;
-        return true;
+        SHARED_ACQUIRE(LockStackCallSites);
+        if(CallSiteCacheGeneration == generation)
+        {
+            const auto found = CallSiteCache.find(data);
+            if(found != CallSiteCache.end())
+            {
+                callTarget = found->second.callTarget;
+                return found->second.isCall;
+            }
+        }
     }
-    SHARED_RELEASE();
-
-    duint data = 0;
-    memset(comment, 0, sizeof(STACK_COMMENT));
-    MemRead(addr, &data, sizeof(duint));
-    if(!MemIsValidReadPtr(data)) //the stack value is no pointer
-        return false;
 
     duint size = 0;
     duint base = MemFindBaseAddr(data, &size);
@@ -67,8 +82,34 @@ bool stackcommentget(duint addr, STACK_COMMENT* comment)
     duint previousInstr = readStart + prev;
 
     BASIC_INSTRUCTION_INFO basicinfo;
-    bool valid = disasmfast(disasmData + prev, previousInstr, &basicinfo);
-    if(valid && basicinfo.call) //call
+    STACKCALLSITE callsite;
+    callsite.isCall = disasmfast(disasmData + prev, previousInstr, &basicinfo) && basicinfo.call;
+    callsite.callTarget = callsite.isCall ? basicinfo.addr : 0;
+
+    if(cacheable)
+    {
+        EXCLUSIVE_ACQUIRE(LockStackCallSites);
+        if(CallSiteCacheGeneration != generation || CallSiteCache.size() >= MAX_CALLSITE_CACHE)
+        {
+            CallSiteCache.clear();
+            CallSiteCacheGeneration = generation;
+        }
+        CallSiteCache[data] = callsite;
+    }
+
+    callTarget = callsite.callTarget;
+    return callsite.isCall;
+}
+
+// The string is looked up when it is not passed (empty when there is none)
+static bool stackcommentfromvalue(duint data, STACK_COMMENT* comment, const char* string = nullptr)
+{
+    memset(comment, 0, sizeof(STACK_COMMENT));
+    if(!MemIsValidReadPtr(data)) //the stack value is no pointer
+        return false;
+
+    duint callTarget = 0;
+    if(stackgetcallsite(data, callTarget)) //call
     {
         char label[MAX_LABEL_SIZE] = "";
         ADDRINFO addrinfo;
@@ -84,7 +125,7 @@ bool stackcommentget(duint addr, STACK_COMMENT* comment)
             sprintf(label, fhex, data);
         strcat(returnToAddr, label);
 
-        data = basicinfo.addr;
+        data = callTarget;
         if(data)
         {
             *label = 0;
@@ -108,8 +149,10 @@ bool stackcommentget(duint addr, STACK_COMMENT* comment)
     }
 
     //string
-    char string[MAX_STRING_SIZE] = "";
-    if(DbgGetStringAt(data, string))
+    char text[MAX_STRING_SIZE] = "";
+    if(!string && DbgGetStringAt(data, text))
+        string = text;
+    if(string && *string)
     {
         strcpy_s(comment->comment, _TRUNCATE, string);
         return true;
@@ -141,6 +184,76 @@ bool stackcommentget(duint addr, STACK_COMMENT* comment)
     return false;
 }
 
+bool stackcommentget(duint addr, STACK_COMMENT* comment)
+{
+    SHARED_ACQUIRE(LockSehCache);
+    const auto found = SehCache.find(addr);
+    if(found != SehCache.end())
+    {
+        *comment = found->second;
+        return true;
+    }
+    SHARED_RELEASE();
+
+    duint data = 0;
+    memset(comment, 0, sizeof(STACK_COMMENT));
+    MemRead(addr, &data, sizeof(duint));
+    return stackcommentfromvalue(data, comment);
+}
+
+// Same strings as DbgGetStringAt, the memory the values (and the pointers at them) point to is read once per
+// cluster of nearby addresses
+static void stackgetstrings(const std::vector<duint> & values, std::vector<String> & strings)
+{
+    auto count = values.size();
+    std::vector<STRING_TYPE> types(count), pointerTypes(count);
+    std::vector<String> direct(count), pointed(count);
+    std::vector<duint> pointers(count);
+    disasmgetstringsat(values.data(), count, MAX_STRING_SIZE - 3, types.data(), direct.data(), pointers.data());
+    disasmgetstringsat(pointers.data(), count, MAX_STRING_SIZE - 3, pointerTypes.data(), pointed.data(), nullptr);
+
+    strings.resize(count);
+    char text[MAX_STRING_SIZE];
+    for(size_t i = 0; i < count; i++)
+    {
+        *text = '\0';
+        if(pointerTypes[i] != str_none)
+            sprintf_s(text, pointerTypes[i] == str_ascii ? "&\"%s\"" : "&L\"%s\"", pointed[i].c_str());
+        else if(types[i] != str_none)
+            sprintf_s(text, types[i] == str_ascii ? "\"%s\"" : "L\"%s\"", direct[i].c_str());
+        strings[i] = text;
+    }
+}
+
+bool stackcommentgetrange(duint addr, duint count, STACK_COMMENT* comments)
+{
+    if(!count)
+        return false;
+
+    // Read the whole window of stack values at once (unreadable values stay zero)
+    std::vector<duint> values(count, 0);
+    MemRead(addr, values.data(), count * sizeof(duint));
+    std::vector<String> strings;
+    stackgetstrings(values, strings);
+
+    for(duint i = 0; i < count; i++)
+    {
+        auto & comment = comments[i];
+        duint slot = addr + i * sizeof(duint);
+        {
+            SHARED_ACQUIRE(LockSehCache);
+            const auto found = SehCache.find(slot);
+            if(found != SehCache.end())
+            {
+                comment = found->second;
+                continue;
+            }
+        }
+        stackcommentfromvalue(values[i], &comment, strings[i].c_str());
+    }
+    return true;
+}
+
 BOOL CALLBACK StackReadProcessMemoryProc64(HANDLE hProcess, DWORD64 lpBaseAddress, PVOID lpBuffer, DWORD nSize, LPDWORD lpNumberOfBytesRead)
 {
     // Fix for 64-bit sizes
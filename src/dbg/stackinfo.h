@@ -19,6 +19,7 @@ struct CALLSTACK
 
 void stackupdateseh();
 bool stackcommentget(duint addr, STACK_COMMENT* comment);
+bool stackcommentgetrange(duint addr, duint count, STACK_COMMENT* comments);
 void stackgetcallstack(duint csp, CALLSTACK* callstack);
 
 #endif //_STACKINFO_H
\ No newline at end of file
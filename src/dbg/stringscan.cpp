@@ -0,0 +1,341 @@
+/**
+ @file stringscan.cpp
+
+ @brief Implements a string table for string reference searches.
+ */
+
+#include "stringscan.h"
+#include "memory.h"
+#include "module.h"
+#include "disasm_helper.h"
+#include "threading.h"
+#include <emmintrin.h>
+#include <intrin.h>
+
+// disasmgetstringat(..., MAX_STRING_SIZE - 3) rejects longer strings
+#define STRING_MAX_LENGTH (MAX_STRING_SIZE - 5)
+
+// Number of snapshots a StringTableCache keeps besides the ones of the modules in the search
+#define STRING_CACHE_SIZE 8
+
+// Largest memory region outside of the modules a StringTableCache takes a snapshot of, pointers into larger regions
+// (heaps, big stacks) are read one by one instead of copying and evicting whole regions over and over
+#define STRING_REGION_MAX_SIZE 0x10000
+
+// One bit per byte in 32 byte words: printable (isprint || isspace in the C locale) and zero
+static void stringClassify(const unsigned char* data, duint size, std::vector<DWORD> & printable, std::vector<DWORD> & zero)
+{
+    auto words = size / 32 + 2;
+    printable.assign(words, 0);
+    zero.assign(words, 0);
+
+    // The signed compares reject 0x80-0xFF together with the control characters
+    const auto printLow = _mm_set1_epi8(0x1F);
+    const auto printHigh = _mm_set1_epi8(0x7F);
+    const auto spaceLow = _mm_set1_epi8(0x08);
+    const auto spaceHigh = _mm_set1_epi8(0x0E);
+    const auto zeroes = _mm_setzero_si128();
+    duint i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        auto chunk = _mm_loadu_si128((const __m128i*)(data + i));
+        auto print = _mm_and_si128(_mm_cmpgt_epi8(chunk, printLow), _mm_cmplt_epi8(chunk, printHigh));
+        auto space = _mm_and_si128(_mm_cmpgt_epi8(chunk, spaceLow), _mm_cmplt_epi8(chunk, spaceHigh));
+        printable[i / 32] |= DWORD(_mm_movemask_epi8(_mm_or_si128(print, space))) << (i % 32);
+        zero[i / 32] |= DWORD(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zeroes))) << (i % 32);
+    }
+    for(; i < size; i++)
+    {
+        auto ch = data[i];
+        if((ch >= 0x20 && ch < 0x7F) || (ch >= 0x09 && ch <= 0x0D))
+            printable[i / 32] |= 1u << (i % 32);
+        else if(!ch)
+            zero[i / 32] |= 1u << (i % 32);
+    }
+}
+
+static DWORD highestBit(DWORD mask)
+{
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return index;
+}
+
+static DWORD lowestBit(DWORD mask)
+{
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+}
+
+// Finds the runs of at least two characters (every character is one step wide) that are followed by a terminator.
+// The masks only have bits at the positions of the characters, prefix holds the mask bits of the previous word.
+static void stringRuns(duint word, DWORD chars, DWORD terminators, DWORD valid, DWORD step, DWORD prefix, duint & runStart, duint base, std::vector<STRINGRUN> & runs)
+{
+    auto candidates = terminators & ((chars << step) | (prefix >> (32 - step))) & ((chars << (step * 2)) | (prefix >> (32 - step * 2)));
+    auto breaks = ~chars & valid;
+    while(candidates)
+    {
+        auto bit = lowestBit(candidates);
+        candidates &= candidates - 1;
+        auto before = breaks & ((1u << bit) - 1);
+        STRINGRUN run;
+        run.start = base + (before ? word * 32 + highestBit(before) + step : runStart);
+        run.end = base + word * 32 + bit;
+        runs.push_back(run);
+    }
+    if(breaks)
+        runStart = word * 32 + highestBit(breaks) + step;
+}
+
+void StringScanRuns(const unsigned char* data, duint size, duint base, STRINGRUNS & runs)
+{
+    std::vector<DWORD> printable, zero;
+    stringClassify(data, size, printable, zero);
+
+    runs.ascii.clear();
+    runs.unicode[0].clear();
+    runs.unicode[1].clear();
+
+    const DWORD parity[2] = { 0x55555555, 0xAAAAAAAA };
+    duint asciiStart = 0;
+    duint unicodeStart[2] = { 0, 1 };
+    DWORD prevPrintable = 0;
+    DWORD prevWide[2] = { 0, 0 };
+    for(duint word = 0; word * 32 < size; word++)
+    {
+        auto p = printable[word];
+        auto z = zero[word];
+        stringRuns(word, p, z, ~0u, 1, prevPrintable, asciiStart, base, runs.ascii);
+        prevPrintable = p;
+
+        // A wide character is printable when its high byte is zero
+        auto nextZero = (z >> 1) | (zero[word + 1] << 31);
+        auto wide = p & nextZero;
+        auto wideZero = z & nextZero;
+        for(int i = 0; i < 2; i++)
+        {
+            stringRuns(word, wide & parity[i], wideZero & parity[i], parity[i], 2, prevWide[i], unicodeStart[i], base, runs.unicode[i]);
+            prevWide[i] = wide & parity[i];
+        }
+    }
+}
+
+static const STRINGRUN* findRun(const std::vector<STRINGRUN> & runs, duint addr)
+{
+    auto found = std::upper_bound(runs.begin(), runs.end(), addr, [](duint addr, const STRINGRUN & run)
+    {
+        return addr < run.start;
+    });
+    if(found == runs.begin())
+        return nullptr;
+    --found;
+    return addr < found->end ? &*found : nullptr;
+}
+
+static void formatString(const char* escaped, STRING_TYPE type, const char* prefix, char* dest)
+{
+    sprintf_s(dest, MAX_STRING_SIZE, type == str_ascii ? "%s\"%s\"" : "%sL\"%s\"", prefix, escaped);
+}
+
+bool StringTable::Build(duint base, duint size)
+{
+    mBase = base;
+    mData.resize(size);
+    if(!size || !MemRead(base, mData.data(), size))
+    {
+        mData.clear();
+        return false;
+    }
+    StringScanRuns(mData.data(), size, base, mRuns);
+    return true;
+}
+
+duint StringTable::Base() const
+{
+    return mBase;
+}
+
+bool StringTable::Contains(duint addr) const
+{
+    return addr >= mBase && addr - mBase < mData.size();
+}
+
+bool StringTable::Read(duint addr, void* buffer, duint size) const
+{
+    if(!Contains(addr) || mData.size() - (addr - mBase) < size)
+        return false;
+    memcpy(buffer, mData.data() + (addr - mBase), size);
+    return true;
+}
+
+bool StringTable::GetString(duint addr, const char* prefix, char* dest) const
+{
+    STRING_TYPE type;
+    duint end;
+    if(!stringAt(addr, type, end))
+        return false;
+    auto data = (const char*)mData.data();
+    String text;
+    if(type == str_ascii)
+    {
+        text.assign(data + (addr - mBase), size_t(end - addr));
+    }
+    else
+    {
+        // Truncate each wchar_t to char
+        text.reserve(size_t(end - addr) / 2);
+        for(auto i = addr - mBase; i < end - mBase; i += 2)
+            text.push_back(data[i]);
+    }
+
+    // Leave room for the prefix and the quotes
+    String escaped = StringUtils::Escape(text);
+    auto limit = MAX_STRING_SIZE - 4 - strlen(prefix);
+    if(escaped.length() > limit)
+        escaped.resize(limit);
+    formatString(escaped.c_str(), type, prefix, dest);
+    return true;
+}
+
+bool StringTable::stringAt(duint addr, STRING_TYPE & type, duint & end) const
+{
+    if(!Contains(addr))
+        return false;
+
+    // First check if this was an ASCII only string, a single character can still be the start of an UTF-16 one
+    auto run = findRun(mRuns.ascii, addr);
+    if(run && run->end - addr >= 2)
+    {
+        if(run->end - addr > STRING_MAX_LENGTH)
+            return false;
+        type = str_ascii;
+        end = run->end;
+        return true;
+    }
+
+    run = findRun(mRuns.unicode[(addr - mBase) & 1], addr);
+    if(run)
+    {
+        auto length = (run->end - addr) / 2;
+        if(length < 2 || length > STRING_MAX_LENGTH)
+            return false;
+        type = str_unicode;
+        end = run->end;
+        return true;
+    }
+    return false;
+}
+
+std::shared_ptr<StringTable> StringTableCache::table(duint addr)
+{
+    // Pointers outside of the modules (heap, stack) get a snapshot of their memory region
+    duint size = 0;
+    auto base = ModBaseFromAddr(addr);
+    if(base)
+        size = ModSizeFromAddr(base);
+    else
+    {
+        base = MemFindBaseAddr(addr, &size);
+        if(size > STRING_REGION_MAX_SIZE)
+            return nullptr;
+    }
+    if(!base)
+        return nullptr;
+
+    // The workers of a reference search share the cache, the tables are looked up under the shared lock
+    std::shared_ptr<TABLEENTRY> entry;
+    {
+        SHARED_ACQUIRE(LockStringTables);
+        auto found = mTables.find(base);
+        if(found != mTables.end())
+            entry = found->second;
+    }
+
+    // The first worker that needs a table builds it outside of the lock, the others wait for it
+    bool build = false;
+    if(!entry)
+    {
+        EXCLUSIVE_ACQUIRE(LockStringTables);
+        auto & found = mTables[base];
+        if(!found)
+        {
+            found = std::make_shared<TABLEENTRY>();
+            found->built = false;
+            found->lastUse = 0;
+            found->hBuilt = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            build = true;
+        }
+        entry = found;
+    }
+    if(build)
+    {
+        auto table = std::make_shared<StringTable>();
+        if(table->Build(base, size))
+            entry->table = table;
+        entry->lastUse = ++mUses;
+        entry->built = true;
+        SetEvent(entry->hBuilt);
+        evict();
+    }
+    else if(!entry->built)
+        WaitForSingleObject(entry->hBuilt, INFINITE);
+    entry->lastUse = ++mUses;
+    return entry->table;
+}
+
+void StringTableCache::evict()
+{
+    // Drop the least recently used table when there are too many, the workers using it keep their reference
+    EXCLUSIVE_ACQUIRE(LockStringTables);
+    size_t count = 0;
+    auto oldest = mTables.end();
+    for(auto itr = mTables.begin(); itr != mTables.end(); ++itr)
+    {
+        const auto & entry = *itr->second;
+        if(!entry.built || !entry.table)
+            continue;
+        count++;
+        if(oldest == mTables.end() || entry.lastUse < oldest->second->lastUse)
+            oldest = itr;
+    }
+    if(count > mCapacity)
+        mTables.erase(oldest);
+}
+
+StringTableCache::StringTableCache(size_t Modules)
+{
+    mCapacity = Modules + STRING_CACHE_SIZE;
+    mUses = 0;
+}
+
+// Same result as DbgGetStringAt, only addresses in very large regions are read from the debuggee
+bool StringTableCache::GetStringAt(duint addr, char* dest)
+{
+    *dest = '\0';
+    auto table = this->table(addr);
+    if(!table)
+        return DbgGetStringAt(addr, dest);
+
+    duint addrPtr;
+    if(table->Read(addr, &addrPtr, sizeof(addrPtr)))
+    {
+        auto ptrTable = this->table(addrPtr);
+        if(ptrTable)
+        {
+            if(ptrTable->GetString(addrPtr, "&", dest))
+                return true;
+        }
+        else if(MemIsValidReadPtr(addrPtr, true))
+        {
+            char string[MAX_STRING_SIZE];
+            STRING_TYPE type;
+            if(disasmgetstringat(addrPtr, &type, string, string, MAX_STRING_SIZE - 3))
+            {
+                formatString(string, type, "&", dest);
+                return true;
+            }
+        }
+    }
+    return table->GetString(addr, "", dest);
+}
@@ -0,0 +1,68 @@
+#ifndef _STRINGSCAN_H
+#define _STRINGSCAN_H
+
+#include "_global.h"
+#include <memory>
+#include <atomic>
+
+// Character range of a NUL-terminated string, end is the address of the terminator
+struct STRINGRUN
+{
+    duint start;
+    duint end;
+};
+
+// Maximal string runs of a buffer, sorted by start
+struct STRINGRUNS
+{
+    std::vector<STRINGRUN> ascii;
+    std::vector<STRINGRUN> unicode[2]; // indexed by the parity of the start offset
+};
+
+void StringScanRuns(const unsigned char* data, duint size, duint base, STRINGRUNS & runs);
+
+// Snapshot of a module (or memory region) with the strings disasmgetstringat would find in it
+class StringTable
+{
+public:
+    bool Build(duint base, duint size);
+    duint Base() const;
+    bool Contains(duint addr) const;
+    bool Read(duint addr, void* buffer, duint size) const;
+    bool GetString(duint addr, const char* prefix, char* dest) const;
+
+private:
+    duint mBase = 0;
+    std::vector<unsigned char> mData;
+    STRINGRUNS mRuns;
+
+    bool stringAt(duint addr, STRING_TYPE & type, duint & end) const;
+};
+
+// String tables of the modules and memory regions referenced during a search, built on first use (thread-safe)
+class StringTableCache
+{
+public:
+    // Modules is the number of modules in the search, their tables are kept together with a few others
+    explicit StringTableCache(size_t Modules = 1);
+
+    bool GetStringAt(duint addr, char* dest);
+
+private:
+    struct TABLEENTRY
+    {
+        std::shared_ptr<StringTable> table; // null when the snapshot failed
+        std::atomic<bool> built;
+        std::atomic<duint> lastUse;
+        Handle hBuilt; // set once the table is built
+    };
+
+    size_t mCapacity;
+    std::atomic<duint> mUses;
+    std::unordered_map<duint, std::shared_ptr<TABLEENTRY>> mTables;
+
+    std::shared_ptr<StringTable> table(duint addr);
+    void evict();
+};
+
+#endif // _STRINGSCAN_H
@@ -10,6 +10,7 @@
 #include "module.h"
 #include "label.h"
 #include "addrinfo.h"
+#include "threading.h"
 
 struct SYMBOLCBDATA
 {
@@ -71,8 +72,11 @@ void SymEnum(duint Base, CBSYMBOLENUM EnumCallback, void* UserData)
     symbolCbData.cbSymbolEnum = EnumCallback;
     symbolCbData.user = UserData;
 
+    // This runs on the GUI thread, symbols that are still loading are listed when the loader refreshes the symbol view
+    if(SymIsPending(Base))
+        SymPrioritize(Base);
     // Enumerate every single symbol for the module in 'base'
-    if(!SafeSymEnumSymbols(fdProcessInfo->hProcess, Base, "*", EnumSymbols, &symbolCbData))
+    else if(!SafeSymEnumSymbols(fdProcessInfo->hProcess, Base, "*", EnumSymbols, &symbolCbData))
         dputs("SymEnumSymbols failed!");
 
     SymEnumImports(Base, EnumCallback, UserData);
@@ -85,27 +89,17 @@ void SymEnumFromCache(duint Base, CBSYMBOLENUM EnumCallback, void* UserData)
 
 bool SymGetModuleList(std::vector<SYMBOLMODULEINFO>* List)
 {
-    //
-    // Inline lambda enum
-    //
-    auto EnumModules = [](LPCTSTR ModuleName, DWORD64 BaseOfDll, PVOID UserContext) -> BOOL
-    {
-        SYMBOLMODULEINFO curModule;
-        curModule.base = (duint)BaseOfDll;
-
-        // Terminate module name if one isn't found
-        if(!ModNameFromAddr(curModule.base, curModule.name, true))
-            curModule.name[0] = '\0';
+    // Use the module list instead of dbghelp, modules with pending symbols are listed too
+    std::vector<MODINFO> modList;
+    ModGetList(modList);
 
-        ((std::vector<SYMBOLMODULEINFO>*)UserContext)->push_back(curModule);
-        return TRUE;
-    };
-
-    // Execute the symbol enumerator (Force cast to STDCALL)
-    if(!SafeSymEnumerateModules64(fdProcessInfo->hProcess, EnumModules, List))
+    for(const auto & mod : modList)
     {
-        dputs("SymEnumerateModules64 failed!");
-        return false;
+        SYMBOLMODULEINFO curModule;
+        curModule.base = mod.base;
+        strcpy_s(curModule.name, mod.name);
+        strcat_s(curModule.name, mod.extension);
+        List->push_back(curModule);
     }
 
     return true;
@@ -173,6 +167,9 @@ void SymDownloadAllSymbols(const char* SymbolStore)
     {
         dprintf("Downloading symbols for %s...\n", module.name);
 
+        // Do not race with the background symbol loader
+        SymWaitModule(module.base, INFINITE);
+
         wchar_t modulePath[MAX_PATH];
         if(!GetModuleFileNameExW(fdProcessInfo->hProcess, (HMODULE)module.base, modulePath, MAX_PATH))
         {
@@ -198,6 +195,229 @@ void SymDownloadAllSymbols(const char* SymbolStore)
         dputs("SymSetSearchPathW (2) failed!");
 }
 
+enum SYMLOADSTATE
+{
+    SymLoadPending,
+    SymLoadLoading,
+    SymLoadLoaded,
+    SymLoadFailed
+};
+
+struct SYMLOADINFO
+{
+    duint base;
+    duint size;
+    WString path;
+    unsigned int priority; // Higher priority modules are loaded first
+    unsigned int sequence; // Load order for modules with the same priority
+    SYMLOADSTATE state;
+    bool unload;           // The module was unloaded while its symbols were loading
+    HANDLE hDone;          // Signalled when the symbols are loaded (or failed to load)
+};
+
+static std::map<duint, SYMLOADINFO> symloads;
+static unsigned int symLoadSequence = 0;
+static unsigned int symLoadPriority = 0;
+static HANDLE hSymLoaderThread = nullptr;
+static HANDLE hSymLoaderEvent = nullptr;
+static volatile bool bSymLoaderStop = false;
+
+static void symLoadSetState(SYMLOADINFO & Info, SYMLOADSTATE State)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    Info.state = State;
+    if(State == SymLoadLoaded || State == SymLoadFailed)
+        SetEvent(Info.hDone);
+    else
+        ResetEvent(Info.hDone);
+}
+
+static void symLoadErase(std::map<duint, SYMLOADINFO>::iterator Itr)
+{
+    //
+    // NOTE: THIS DOES _NOT_ USE LOCKS
+    //
+    // Nobody waits for the module anymore
+    SetEvent(Itr->second.hDone);
+    CloseHandle(Itr->second.hDone);
+    symloads.erase(Itr);
+}
+
+static DWORD WINAPI symLoaderThread(void* lpParameter)
+{
+    while(WaitForSingleObject(hSymLoaderEvent, INFINITE) == WAIT_OBJECT_0 && !bSymLoaderStop)
+    {
+        bool loadedAny = false;
+        while(!bSymLoaderStop)
+        {
+            // Take the pending module with the highest priority
+            EXCLUSIVE_ACQUIRE(LockSymLoader);
+            SYMLOADINFO* next = nullptr;
+            for(auto & itr : symloads)
+            {
+                SYMLOADINFO & info = itr.second;
+                if(info.state != SymLoadPending)
+                    continue;
+                if(!next || info.priority > next->priority || (info.priority == next->priority && info.sequence < next->sequence))
+                    next = &info;
+            }
+            if(!next)
+                break;
+            symLoadSetState(*next, SymLoadLoading);
+            duint base = next->base;
+            DWORD size = DWORD(next->size);
+            WString path = next->path;
+            EXCLUSIVE_RELEASE();
+
+            bool loaded = !!SafeSymLoadModuleExW(fdProcessInfo->hProcess, 0, path.c_str(), 0, (DWORD64)base, size, 0, 0);
+            loadedAny = true;
+
+            EXCLUSIVE_REACQUIRE();
+            auto found = symloads.find(base);
+            bool unload = found == symloads.end() || found->second.unload || found->second.state != SymLoadLoading;
+            if(found != symloads.end())
+            {
+                if(found->second.unload)
+                    symLoadErase(found);
+                else if(found->second.state == SymLoadLoading)
+                    symLoadSetState(found->second, loaded ? SymLoadLoaded : SymLoadFailed);
+            }
+            EXCLUSIVE_RELEASE();
+
+            // The module is gone (or was loaded again), drop the symbols we just loaded
+            if(unload && loaded)
+                SafeSymUnloadModule64(fdProcessInfo->hProcess, (DWORD64)base);
+        }
+
+        // Show the new symbols
+        if(loadedAny && !bSymLoaderStop)
+        {
+            GuiUpdateAllViews();
+            GuiSymbolRefreshCurrent();
+        }
+    }
+    return 0;
+}
+
+void SymLoadModuleAsync(duint Base, duint Size, const char* Path)
+{
+    EXCLUSIVE_ACQUIRE(LockSymLoader);
+    auto found = symloads.find(Base);
+    if(found == symloads.end())
+    {
+        found = symloads.insert(std::make_pair(Base, SYMLOADINFO())).first;
+        found->second.hDone = CreateEventW(nullptr, true, false, nullptr);
+    }
+    SYMLOADINFO & info = found->second;
+    info.base = Base;
+    info.size = Size;
+    info.path = StringUtils::Utf8ToUtf16(Path);
+    info.priority = 0;
+    info.sequence = symLoadSequence++;
+    info.unload = false;
+    symLoadSetState(info, SymLoadPending);
+
+    // Start the loader thread on the first module
+    if(!hSymLoaderThread)
+    {
+        bSymLoaderStop = false;
+        hSymLoaderEvent = CreateEventW(nullptr, false, false, nullptr);
+        hSymLoaderThread = CreateThread(nullptr, 0, symLoaderThread, nullptr, 0, nullptr);
+    }
+    SetEvent(hSymLoaderEvent);
+}
+
+void SymUnloadModule(duint Base)
+{
+    EXCLUSIVE_ACQUIRE(LockSymLoader);
+    auto found = symloads.find(Base);
+    if(found != symloads.end())
+    {
+        SYMLOADSTATE state = found->second.state;
+        if(state == SymLoadLoading)
+        {
+            // The loader thread unloads the symbols when it is done
+            found->second.unload = true;
+            return;
+        }
+        symLoadErase(found);
+        if(state != SymLoadLoaded)
+            return;
+    }
+    EXCLUSIVE_RELEASE();
+
+    SafeSymUnloadModule64(fdProcessInfo->hProcess, (DWORD64)Base);
+}
+
+void SymLoaderStop()
+{
+    EXCLUSIVE_ACQUIRE(LockSymLoader);
+    while(!symloads.empty())
+        symLoadErase(symloads.begin());
+    HANDLE hThread = hSymLoaderThread;
+    hSymLoaderThread = nullptr;
+    bSymLoaderStop = true;
+    EXCLUSIVE_RELEASE();
+
+    if(!hThread)
+        return;
+
+    // Wait for the module that is currently loading
+    SetEvent(hSymLoaderEvent);
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+    CloseHandle(hSymLoaderEvent);
+    hSymLoaderEvent = nullptr;
+}
+
+bool SymIsPending(duint Address)
+{
+    duint base = ModBaseFromAddr(Address);
+    if(!base)
+        return false;
+
+    SHARED_ACQUIRE(LockSymLoader);
+    auto found = symloads.find(base);
+    return found != symloads.end() && (found->second.state == SymLoadPending || found->second.state == SymLoadLoading);
+}
+
+void SymPrioritize(duint Address)
+{
+    duint base = ModBaseFromAddr(Address);
+    if(!base)
+        return;
+
+    EXCLUSIVE_ACQUIRE(LockSymLoader);
+    auto found = symloads.find(base);
+    if(found != symloads.end() && found->second.state == SymLoadPending && found->second.priority != symLoadPriority)
+        found->second.priority = ++symLoadPriority;
+}
+
+bool SymWaitModule(duint Address, DWORD Timeout)
+{
+    duint base = ModBaseFromAddr(Address);
+    if(!base)
+        return true;
+
+    // Load this module next
+    SymPrioritize(Address);
+
+    SHARED_ACQUIRE(LockSymLoader);
+    auto found = symloads.find(base);
+    if(found == symloads.end() || (found->second.state != SymLoadPending && found->second.state != SymLoadLoading))
+        return true;
+    HANDLE hDone = nullptr;
+    if(!DuplicateHandle(GetCurrentProcess(), found->second.hDone, GetCurrentProcess(), &hDone, 0, FALSE, DUPLICATE_SAME_ACCESS))
+        return false;
+    SHARED_RELEASE();
+
+    bool done = WaitForSingleObject(hDone, Timeout) == WAIT_OBJECT_0;
+    CloseHandle(hDone);
+    return done;
+}
+
 bool SymAddrFromName(const char* Name, duint* Address)
 {
     if(!Name || Name[0] == '\0')
@@ -251,6 +471,9 @@ String SymGetSymbolicName(duint Address)
 
 bool SymGetSourceLine(duint Cip, char* FileName, int* Line)
 {
+    if(SymIsPending(Cip))
+        return false;
+
     IMAGEHLP_LINEW64 lineInfo;
     memset(&lineInfo, 0, sizeof(IMAGEHLP_LINE64));
 
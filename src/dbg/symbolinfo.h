@@ -8,6 +8,12 @@ void SymEnumFromCache(duint Base, CBSYMBOLENUM EnumCallback, void* UserData);
 bool SymGetModuleList(std::vector<SYMBOLMODULEINFO>* List);
 void SymUpdateModuleList();
 void SymDownloadAllSymbols(const char* SymbolStore);
+void SymLoadModuleAsync(duint Base, duint Size, const char* Path);
+void SymUnloadModule(duint Base);
+void SymLoaderStop();
+bool SymIsPending(duint Address);
+void SymPrioritize(duint Address);
+bool SymWaitModule(duint Address, DWORD Timeout);
 bool SymAddrFromName(const char* Name, duint* Address);
 String SymGetSymbolicName(duint Address);
 
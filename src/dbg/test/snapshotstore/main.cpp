@@ -0,0 +1,253 @@
+// Tests SnapshotStore with synthetic page sets, it does not need a debuggee.
+// g++ -std=c++11 -D"__declspec(x)=" -I../.. main.cpp ../../snapshotstore.cpp ../../murmurhash.cpp -llz4
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include "snapshotstore.h"
+
+typedef std::map<size_t, std::vector<unsigned char>> PAGESET;
+
+static int failures = 0;
+
+#define CHECK(x) \
+    do \
+    { \
+        if(!(x)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+            failures++; \
+        } \
+    } while(0)
+
+static std::vector<unsigned char> makePage(unsigned char fill)
+{
+    return std::vector<unsigned char>(SNAPSHOT_PAGE_SIZE, fill);
+}
+
+static int take(SnapshotStore & store, const PAGESET & pages)
+{
+    int snapshot = store.Begin();
+    for(const auto & page : pages)
+        store.AddPage(page.first, page.second.data());
+    store.End();
+    return snapshot;
+}
+
+static bool hasRange(const std::vector<SNAPSHOTRANGE> & ranges, size_t start, size_t size, SNAPSHOTCHANGE type, size_t changedBytes)
+{
+    for(const auto & range : ranges)
+    {
+        if(range.start == start && range.size == size && range.type == type && range.changedBytes == changedBytes)
+            return true;
+    }
+    return false;
+}
+
+static void testAddedRemovedModified()
+{
+    SnapshotStore store;
+    PAGESET pages;
+    pages[0x10000] = makePage(0x11);
+    pages[0x11000] = makePage(0x22);
+    pages[0x20000] = makePage(0x33);
+    int first = take(store, pages);
+    CHECK(first == 1);
+
+    pages.erase(0x20000);
+    pages[0x11000][0x10] = 0xFF;
+    pages[0x11000][0x20] = 0xFF;
+    pages[0x30000] = makePage(0x44);
+    int second = take(store, pages);
+    CHECK(second == 2);
+    CHECK(store.Count() == 2);
+
+    std::vector<SNAPSHOTRANGE> ranges;
+    CHECK(store.Diff(first, second, ranges));
+    CHECK(ranges.size() == 3);
+    CHECK(hasRange(ranges, 0x11000, SNAPSHOT_PAGE_SIZE, SnapshotPageModified, 2));
+    CHECK(hasRange(ranges, 0x20000, SNAPSHOT_PAGE_SIZE, SnapshotPageRemoved, 0));
+    CHECK(hasRange(ranges, 0x30000, SNAPSHOT_PAGE_SIZE, SnapshotPageAdded, 0));
+
+    // The reverse diff swaps additions and removals
+    CHECK(store.Diff(second, first, ranges));
+    CHECK(ranges.size() == 3);
+    CHECK(hasRange(ranges, 0x20000, SNAPSHOT_PAGE_SIZE, SnapshotPageAdded, 0));
+    CHECK(hasRange(ranges, 0x30000, SNAPSHOT_PAGE_SIZE, SnapshotPageRemoved, 0));
+
+    // Everything is new compared to the empty address space
+    CHECK(store.Diff(0, first, ranges));
+    CHECK(ranges.size() == 2);
+    CHECK(hasRange(ranges, 0x10000, 2 * SNAPSHOT_PAGE_SIZE, SnapshotPageAdded, 0));
+    CHECK(hasRange(ranges, 0x20000, SNAPSHOT_PAGE_SIZE, SnapshotPageAdded, 0));
+
+    CHECK(store.Diff(second, second, ranges));
+    CHECK(ranges.empty());
+    CHECK(!store.Diff(first, 3, ranges));
+    CHECK(!store.Diff(-1, first, ranges));
+}
+
+static void testSkippedSnapshots()
+{
+    // A page that changes and changes back is the same across the snapshots in between
+    SnapshotStore store;
+    PAGESET pages;
+    pages[0x1000] = makePage(0x01);
+    pages[0x2000] = makePage(0x02);
+    int first = take(store, pages);
+    pages[0x1000][0] = 0x99;
+    int second = take(store, pages);
+    pages[0x1000][0] = 0x01;
+    pages[0x2000][1] = 0x77;
+    int third = take(store, pages);
+
+    std::vector<SNAPSHOTRANGE> ranges;
+    CHECK(store.Diff(first, third, ranges));
+    CHECK(ranges.size() == 1);
+    CHECK(hasRange(ranges, 0x2000, SNAPSHOT_PAGE_SIZE, SnapshotPageModified, 1));
+    CHECK(store.Diff(first, second, ranges));
+    CHECK(ranges.size() == 1);
+    CHECK(hasRange(ranges, 0x1000, SNAPSHOT_PAGE_SIZE, SnapshotPageModified, 1));
+    CHECK(store.Diff(second, third, ranges));
+    CHECK(ranges.size() == 1);
+    CHECK(hasRange(ranges, 0x1000, 2 * SNAPSHOT_PAGE_SIZE, SnapshotPageModified, 2));
+}
+
+static void testDeduplication()
+{
+    // Identical pages are stored once, no matter where or when they appear
+    SnapshotStore store;
+    PAGESET pages;
+    for(size_t i = 0; i < 64; i++)
+        pages[0x100000 + i * SNAPSHOT_PAGE_SIZE] = makePage(0);
+    take(store, pages);
+    CHECK(store.StoredPages() == 1);
+    CHECK(store.StoredBytes() < SNAPSHOT_PAGE_SIZE);
+
+    // Incompressible content is stored as is
+    std::vector<unsigned char> noise(SNAPSHOT_PAGE_SIZE);
+    unsigned int seed = 0x1337;
+    for(auto & byte : noise)
+    {
+        seed = seed * 1103515245 + 12345;
+        byte = (unsigned char)(seed >> 16);
+    }
+    pages[0x200000] = noise;
+    pages[0x300000] = noise;
+    int second = take(store, pages);
+    CHECK(store.StoredPages() == 2);
+
+    std::vector<SNAPSHOTRANGE> ranges;
+    CHECK(store.Diff(second - 1, second, ranges));
+    CHECK(ranges.size() == 2);
+
+    store.Clear();
+    CHECK(store.Count() == 0);
+    CHECK(store.StoredPages() == 0);
+    CHECK(store.StoredBytes() == 0);
+    CHECK(store.Diff(0, 0, ranges));
+    CHECK(ranges.empty());
+}
+
+static void testRandomPageSets()
+{
+    // Compare the diffs of random page sets against a brute force comparison of the sets
+    SnapshotStore store;
+    std::vector<PAGESET> history(1);
+    unsigned int seed = 42;
+    auto next = [&seed]()
+    {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7FFF;
+    };
+    for(int snapshot = 1; snapshot <= 20; snapshot++)
+    {
+        PAGESET pages = history.back();
+        for(int change = 0; change < 16; change++)
+        {
+            size_t address = 0x400000 + (next() % 64) * SNAPSHOT_PAGE_SIZE;
+            switch(next() % 3)
+            {
+            case 0:
+                pages.erase(address);
+                break;
+            case 1:
+                pages[address] = makePage((unsigned char)(next() % 4));
+                break;
+            default:
+                if(pages.count(address))
+                    pages[address][next() % SNAPSHOT_PAGE_SIZE] ^= 0x5A;
+                break;
+            }
+        }
+        CHECK(take(store, pages) == snapshot);
+        history.push_back(pages);
+    }
+
+    for(int first = 0; first < int(history.size()); first++)
+    {
+        for(int second = 0; second < int(history.size()); second++)
+        {
+            std::vector<SNAPSHOTRANGE> ranges;
+            CHECK(store.Diff(first, second, ranges));
+            std::map<size_t, SNAPSHOTRANGE> changed;
+            for(const auto & range : ranges)
+            {
+                for(size_t page = 0; page < range.size; page += SNAPSHOT_PAGE_SIZE)
+                {
+                    SNAPSHOTRANGE single = range;
+                    single.start = range.start + page;
+                    single.size = SNAPSHOT_PAGE_SIZE;
+                    changed[single.start] = single;
+                }
+            }
+
+            const auto & before = history[first];
+            const auto & after = history[second];
+            size_t expected = 0;
+            for(size_t address = 0x400000; address < 0x400000 + 64 * SNAPSHOT_PAGE_SIZE; address += SNAPSHOT_PAGE_SIZE)
+            {
+                auto b = before.find(address);
+                auto a = after.find(address);
+                auto found = changed.find(address);
+                if(b != before.end() && a != after.end())
+                {
+                    size_t changedBytes = 0;
+                    for(size_t i = 0; i < SNAPSHOT_PAGE_SIZE; i++)
+                        changedBytes += b->second[i] != a->second[i];
+                    if(!changedBytes)
+                        continue;
+                    expected++;
+                    CHECK(found != changed.end() && found->second.type == SnapshotPageModified);
+                }
+                else if(b != before.end())
+                {
+                    expected++;
+                    CHECK(found != changed.end() && found->second.type == SnapshotPageRemoved);
+                }
+                else if(a != after.end())
+                {
+                    expected++;
+                    CHECK(found != changed.end() && found->second.type == SnapshotPageAdded);
+                }
+            }
+            CHECK(changed.size() == expected);
+        }
+    }
+}
+
+int main()
+{
+    testAddedRemovedModified();
+    testSkippedSnapshots();
+    testDeduplication();
+    testRandomPageSets();
+    if(failures)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    puts("all checks passed");
+    return 0;
+}
\ No newline at end of file
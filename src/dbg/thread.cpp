@@ -10,6 +10,60 @@
 
 static std::unordered_map<DWORD, THREADINFO> threadList;
 
+// Cached thread state, valid until the thread (or every thread) is invalidated after it was filled
+struct THREADSTATECACHE
+{
+    duint generation;
+    unsigned int fields; // THREADLISTFIELDS that are valid in info
+    THREADALLINFO info;
+};
+
+// Protected by LockThreadStateCache, so filling it does not block the readers of the thread list
+static std::unordered_map<DWORD, THREADSTATECACHE> threadStateCache;
+static std::unordered_map<DWORD, duint> threadInvalidated; // generation of the last invalidation of a thread
+static duint threadAllInvalidated = 1; // generation of the last invalidation of every thread
+static volatile LONG threadGeneration = 1;
+
+static void threadStateCacheGet(DWORD ThreadId, duint Generation, THREADSTATECACHE & Cache)
+{
+    SHARED_ACQUIRE(LockThreadStateCache);
+    auto found = threadStateCache.find(ThreadId);
+    auto invalidated = threadInvalidated.find(ThreadId);
+    auto validFrom = threadAllInvalidated;
+    if(invalidated != threadInvalidated.end())
+        validFrom = max(validFrom, invalidated->second);
+    if(found != threadStateCache.end() && found->second.generation >= validFrom)
+    {
+        Cache = found->second;
+        return;
+    }
+    memset(&Cache, 0, sizeof(THREADSTATECACHE));
+    Cache.generation = Generation;
+    Cache.fields = ThreadFieldBasic;
+}
+
+static void threadStateCacheSet(DWORD ThreadId, const THREADSTATECACHE & Cache)
+{
+    EXCLUSIVE_ACQUIRE(LockThreadStateCache);
+    auto & stored = threadStateCache[ThreadId];
+    if(stored.generation != Cache.generation || (stored.fields & Cache.fields) != Cache.fields)
+        stored = Cache;
+}
+
+static void threadStateCacheErase(DWORD ThreadId)
+{
+    EXCLUSIVE_ACQUIRE(LockThreadStateCache);
+    threadStateCache.erase(ThreadId);
+    threadInvalidated.erase(ThreadId);
+}
+
+static void threadStateCacheClear()
+{
+    EXCLUSIVE_ACQUIRE(LockThreadStateCache);
+    threadStateCache.clear();
+    threadInvalidated.clear();
+}
+
 void ThreadCreate(CREATE_THREAD_DEBUG_INFO* CreateThread)
 {
     THREADINFO curInfo;
@@ -32,6 +86,7 @@ void ThreadCreate(CREATE_THREAD_DEBUG_INFO* CreateThread)
     EXCLUSIVE_ACQUIRE(LockThreads);
     threadList.insert(std::make_pair(curInfo.ThreadId, curInfo));
     EXCLUSIVE_RELEASE();
+    ThreadInvalidateCache(curInfo.ThreadId);
 
     // Notify GUI
     GuiUpdateThreadView();
@@ -51,6 +106,8 @@ void ThreadExit(DWORD ThreadId)
     }
 
     EXCLUSIVE_RELEASE();
+    threadStateCacheErase(ThreadId);
+    ThreadInvalidateCache(ThreadId);
     GuiUpdateThreadView();
 }
 
@@ -67,6 +124,7 @@ void ThreadClear()
 
     // Update the GUI's list
     EXCLUSIVE_RELEASE();
+    threadStateCacheClear();
     GuiUpdateThreadView();
 }
 
@@ -76,7 +134,7 @@ int ThreadGetCount()
     return (int)threadList.size();
 }
 
-void ThreadGetList(THREADLIST* List)
+void ThreadGetList(THREADLIST* List, unsigned int Fields)
 {
     ASSERT_NONNULL(List);
     SHARED_ACQUIRE(LockThreads);
@@ -96,6 +154,7 @@ void ThreadGetList(THREADLIST* List)
 
     // Fill out the list data
     int index = 0;
+    duint generation = ThreadGetGeneration();
 
     for(auto & itr : threadList)
     {
@@ -105,17 +164,68 @@ void ThreadGetList(THREADLIST* List)
         if(threadHandle == hActiveThread)
             List->CurrentThread = index;
 
-        memcpy(&List->list[index].BasicInfo, &itr.second, sizeof(THREADINFO));
-
-        List->list[index].ThreadCip = GetContextDataEx(threadHandle, UE_CIP);
-        List->list[index].SuspendCount = ThreadGetSuspendCount(threadHandle);
-        List->list[index].Priority = ThreadGetPriority(threadHandle);
-        List->list[index].WaitReason = ThreadGetWaitReason(threadHandle);
-        List->list[index].LastError = ThreadGetLastErrorTEB(itr.second.ThreadLocalBase);
+        // Only query the fields that are not cached for this generation yet
+        THREADSTATECACHE cache;
+        threadStateCacheGet(itr.first, generation, cache);
+        auto & info = cache.info;
+        unsigned int missing = Fields & ~cache.fields;
+
+        if(missing & ThreadFieldCip)
+            info.ThreadCip = GetContextDataEx(threadHandle, UE_CIP);
+        if(missing & ThreadFieldSuspendCount)
+            info.SuspendCount = ThreadGetSuspendCount(threadHandle);
+        if(missing & ThreadFieldPriority)
+            info.Priority = ThreadGetPriority(threadHandle);
+        if(missing & ThreadFieldWaitReason)
+            info.WaitReason = ThreadGetWaitReason(threadHandle);
+        if(missing & ThreadFieldLastError)
+            info.LastError = ThreadGetLastErrorTEB(itr.second.ThreadLocalBase);
+        if(missing)
+        {
+            cache.fields |= Fields;
+            threadStateCacheSet(itr.first, cache);
+        }
+
+        memcpy(&info.BasicInfo, &itr.second, sizeof(THREADINFO));
+        memcpy(&List->list[index], &info, sizeof(THREADALLINFO));
+
+        // Fields that were not requested are left zeroed
+        auto & entry = List->list[index];
+        if(!(Fields & ThreadFieldCip))
+            entry.ThreadCip = 0;
+        if(!(Fields & ThreadFieldSuspendCount))
+            entry.SuspendCount = 0;
+        if(!(Fields & ThreadFieldPriority))
+            entry.Priority = THREADPRIORITY(0);
+        if(!(Fields & ThreadFieldWaitReason))
+            entry.WaitReason = THREADWAITREASON(0);
+        if(!(Fields & ThreadFieldLastError))
+            entry.LastError = 0;
         index++;
     }
 }
 
+void ThreadInvalidateCache()
+{
+    // Called whenever the state of all threads may have changed (thread commands), the GUI reloads on a new generation
+    auto generation = duint(InterlockedIncrement(&threadGeneration));
+    EXCLUSIVE_ACQUIRE(LockThreadStateCache);
+    threadAllInvalidated = generation;
+}
+
+void ThreadInvalidateCache(DWORD ThreadId)
+{
+    // Called when the state of a single thread may have changed (debug events, created and exited threads)
+    auto generation = duint(InterlockedIncrement(&threadGeneration));
+    EXCLUSIVE_ACQUIRE(LockThreadStateCache);
+    threadInvalidated[ThreadId] = generation;
+}
+
+duint ThreadGetGeneration()
+{
+    return duint(threadGeneration);
+}
+
 bool ThreadIsValid(DWORD ThreadId)
 {
     SHARED_ACQUIRE(LockThreads);
@@ -199,6 +309,7 @@ bool ThreadSetName(DWORD ThreadId, const char* Name)
             Name = "";
 
         strcpy_s(threadList[ThreadId].threadName, Name);
+        ThreadInvalidateCache();
         return true;
     }
 
@@ -244,7 +355,11 @@ int ThreadSuspendAll()
         if(SuspendThread(entry.second.Handle) != -1)
             count++;
     }
+    SHARED_RELEASE();
 
+    // The suspend counts changed
+    if(count)
+        ThreadInvalidateCache();
     return count;
 }
 
@@ -259,7 +374,10 @@ int ThreadResumeAll()
         if(ResumeThread(entry.second.Handle) != -1)
             count++;
     }
+    SHARED_RELEASE();
 
+    if(count)
+        ThreadInvalidateCache();
     return count;
 }
 
@@ -3,12 +3,16 @@
 
 #include "_global.h"
 #include "debugger.h"
+#include "_dbgfunctions.h"
 
 void ThreadCreate(CREATE_THREAD_DEBUG_INFO* CreateThread);
 void ThreadExit(DWORD ThreadId);
 void ThreadClear();
 int ThreadGetCount();
-void ThreadGetList(THREADLIST* list);
+void ThreadGetList(THREADLIST* list, unsigned int fields = ThreadFieldAll);
+void ThreadInvalidateCache();
+void ThreadInvalidateCache(DWORD ThreadId);
+duint ThreadGetGeneration();
 bool ThreadIsValid(DWORD ThreadId);
 bool ThreadSetName(DWORD ThreadId, const char* name);
 bool ThreadGetTib(duint TEBAddress, NT_TIB* Tib);
@@ -1,6 +1,7 @@
 #include "threading.h"
 
 static HANDLE waitArray[WAITID_LAST];
+static HANDLE lockedArray[WAITID_LAST]; //signaled while the matching waitArray event is locked
 
 void waitclear()
 {
@@ -16,10 +17,12 @@ void wait(WAIT_ID id)
 void lock(WAIT_ID id)
 {
     ResetEvent(waitArray[id]);
+    SetEvent(lockedArray[id]);
 }
 
 void unlock(WAIT_ID id)
 {
+    ResetEvent(lockedArray[id]);
     SetEvent(waitArray[id]);
 }
 
@@ -28,10 +31,18 @@ bool waitislocked(WAIT_ID id)
     return !WaitForSingleObject(waitArray[id], 0) == WAIT_OBJECT_0;
 }
 
+bool waitlocked(WAIT_ID id, DWORD timeout)
+{
+    return WaitForSingleObject(lockedArray[id], timeout) == WAIT_OBJECT_0;
+}
+
 void waitinitialize()
 {
     for(int i = 0; i < WAITID_LAST; i++)
+    {
         waitArray[i] = CreateEventW(NULL, TRUE, TRUE, NULL);
+        lockedArray[i] = CreateEventW(NULL, TRUE, FALSE, NULL);
+    }
 }
 
 void waitdeinitialize()
@@ -40,6 +51,7 @@ void waitdeinitialize()
     {
         wait((WAIT_ID)i);
         CloseHandle(waitArray[i]);
+        CloseHandle(lockedArray[i]);
     }
 }
 
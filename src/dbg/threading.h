@@ -16,6 +16,7 @@ void wait(WAIT_ID id);
 void lock(WAIT_ID id);
 void unlock(WAIT_ID id);
 bool waitislocked(WAIT_ID id);
+bool waitlocked(WAIT_ID id, DWORD timeout);
 void waitinitialize();
 void waitdeinitialize();
 
@@ -46,6 +47,7 @@ enum SectionLock
     LockBreakpoints,
     LockPatches,
     LockThreads,
+    LockThreadStateCache,
     LockSym,
     LockCmdLine,
     LockDatabase,
@@ -59,6 +61,20 @@ enum SectionLock
     LockCrossReferences,
     LockDebugStartStop,
     LockArguments,
+    LockStackCallSites,
+    LockJobs,
+    LockSymLoader,
+    LockCommands,
+    LockExpressionCache,
+    LockLogQueue,
+    LockLogOutput,
+    LockInstructionStore,
+    LockAnalysisResults,
+    LockYaraRules,
+    LockYaraOutput,
+    LockEntropy,
+    LockMemorySnapshots,
+    LockStringTables,
 
     // Number of elements in this enumeration. Must always be the last
     // index.
@@ -15,6 +15,9 @@
 #include "expressionparser.h"
 #include "function.h"
 #include "threading.h"
+#include "thread.h"
+#include <list>
+#include <memory>
 
 static bool dosignedcalc = false;
 
@@ -1060,6 +1063,7 @@ duint getregister(int* size, const char* string)
 */
 bool setregister(const char* string, duint value)
 {
+    ThreadInvalidateCache(); //the thread view shows CIP
     if(scmp(string, "eax"))
         return SetContextDataEx(hActiveThread, UE_EAX, value & 0xFFFFFFFF);
     if(scmp(string, "ebx"))
@@ -1308,140 +1312,73 @@ bool valapifromstring(const char* name, duint* value, int* value_size, bool prin
         if(!strlen(apiname))
             return false;
         duint modbase = ModBaseFromName(modname);
-        wchar_t szModName[MAX_PATH] = L"";
-        if(!GetModuleFileNameExW(fdProcessInfo->hProcess, (HMODULE)modbase, szModName, MAX_PATH))
+        if(!modbase)
         {
             if(!silent)
-                dprintf("could not get filename of module " fhex "\n", modbase);
+                dprintf("could not find module \"%s\"\n", modname);
+            return false;
         }
-        else
+        duint addr = noexports ? 0 : ModExportFromName(modbase, apiname);
+        if(!addr) //not found
         {
-            HMODULE mod = LoadLibraryExW(szModName, 0, DONT_RESOLVE_DLL_REFERENCES | LOAD_LIBRARY_AS_DATAFILE);
-            if(!mod)
+            if(scmp(apiname, "base") || scmp(apiname, "imagebase") || scmp(apiname, "header")) //get loaded base
+                addr = modbase;
+            else if(scmp(apiname, "entrypoint") || scmp(apiname, "entry") || scmp(apiname, "oep") || scmp(apiname, "ep")) //get entry point
             {
-                if(!silent)
-                    dprintf("unable to load library %s\n", szModName);
+                addr = ModEntryFromAddr(modbase);
+                if(!addr) //no entry point (DLL)
+                    addr = modbase;
             }
-            else
+            else if(*apiname == '$') //RVA
             {
-                duint addr = noexports ? 0 : (duint)GetProcAddress(mod, apiname);
-                if(addr) //found exported function
-                    addr = modbase + (addr - (duint)mod); //correct for loaded base
-                else //not found
-                {
-                    if(scmp(apiname, "base") || scmp(apiname, "imagebase") || scmp(apiname, "header")) //get loaded base
-                        addr = modbase;
-                    else if(scmp(apiname, "entrypoint") || scmp(apiname, "entry") || scmp(apiname, "oep") || scmp(apiname, "ep")) //get entry point
-                        addr = modbase + GetPE32DataW(szModName, 0, UE_OEP);
-                    else if(*apiname == '$') //RVA
-                    {
-                        duint rva;
-                        if(valfromstring(apiname + 1, &rva))
-                            addr = modbase + rva;
-                    }
-                    else if(*apiname == '#') //File Offset
-                    {
-                        duint offset;
-                        if(valfromstring(apiname + 1, &offset))
-                            addr = valfileoffsettova(modname, offset);
-                    }
-                    else
-                    {
-                        if(noexports) //get the exported functions with the '?' delimiter
-                        {
-                            addr = (duint)GetProcAddress(mod, apiname);
-                            if(addr) //found exported function
-                                addr = modbase + (addr - (duint)mod); //correct for loaded base
-                        }
-                        else
-                        {
-                            duint ordinal;
-                            if(valfromstring(apiname, &ordinal))
-                            {
-                                addr = (duint)GetProcAddress(mod, (LPCSTR)(ordinal & 0xFFFF));
-                                if(addr) //found exported function
-                                    addr = modbase + (addr - (duint)mod); //correct for loaded base
-                                else if(!ordinal) //support for getting the image base using <modname>:0
-                                    addr = modbase;
-                            }
-                        }
-                    }
-                }
-                FreeLibrary(mod);
-                if(addr) //found!
-                {
-                    if(value_size)
-                        *value_size = sizeof(duint);
-                    if(hexonly)
-                        *hexonly = true;
-                    *value = addr;
-                    return true;
-                }
+                duint rva;
+                if(valfromstring(apiname + 1, &rva))
+                    addr = modbase + rva;
             }
-        }
-        return false;
-    }
-    int found = 0;
-    int kernel32 = -1;
-    DWORD cbNeeded = 0;
-    Memory<duint*> addrfound;
-    if(EnumProcessModules(fdProcessInfo->hProcess, 0, 0, &cbNeeded))
-    {
-        addrfound.realloc(cbNeeded * sizeof(duint), "valapifromstring:addrfound");
-        Memory<HMODULE*> hMods(cbNeeded * sizeof(HMODULE), "valapifromstring:hMods");
-        if(EnumProcessModules(fdProcessInfo->hProcess, hMods(), cbNeeded, &cbNeeded))
-        {
-            for(unsigned int i = 0; i < cbNeeded / sizeof(HMODULE); i++)
+            else if(*apiname == '#') //File Offset
             {
-                wchar_t szModuleName[MAX_PATH] = L"";
-                if(GetModuleFileNameExW(fdProcessInfo->hProcess, hMods()[i], szModuleName, MAX_PATH))
+                duint offset;
+                if(valfromstring(apiname + 1, &offset))
+                    addr = valfileoffsettova(modname, offset);
+            }
+            else
+            {
+                if(noexports) //get the exported functions with the '?' delimiter
+                    addr = ModExportFromName(modbase, apiname);
+                else
                 {
-                    wchar_t* szBaseName = wcsrchr(szModuleName, L'\\');
-                    if(szBaseName)
+                    duint ordinal;
+                    if(valfromstring(apiname, &ordinal))
                     {
-                        szBaseName++;
-                        HMODULE hModule = LoadLibraryExW(szModuleName, 0, DONT_RESOLVE_DLL_REFERENCES | LOAD_LIBRARY_AS_DATAFILE);
-                        if(hModule)
-                        {
-                            ULONG_PTR funcAddress = (ULONG_PTR)GetProcAddress(hModule, name);
-                            if(funcAddress)
-                            {
-                                if(!_wcsicmp(szBaseName, L"kernel32.dll"))
-                                    kernel32 = found;
-                                duint rva = funcAddress - (duint)hModule;
-                                addrfound()[found] = (duint)hMods()[i] + rva;
-                                found++;
-                            }
-                            FreeLibrary(hModule);
-                        }
+                        addr = ModExportFromOrdinal(modbase, ordinal & 0xFFFF);
+                        if(!addr && !ordinal) //support for getting the image base using <modname>:0
+                            addr = modbase;
                     }
                 }
             }
         }
+        if(!addr) //not found
+            return false;
+        if(value_size)
+            *value_size = sizeof(duint);
+        if(hexonly)
+            *hexonly = true;
+        *value = addr;
+        return true;
     }
-    if(!found)
+    std::vector<duint> addrfound; //kernel32 exports come first
+    ModExportsFromName(name, addrfound);
+    if(addrfound.empty())
         return false;
     if(value_size)
         *value_size = sizeof(duint);
     if(hexonly)
         *hexonly = true;
-    if(kernel32 != -1) //prioritize kernel32 exports
-    {
-        *value = addrfound()[kernel32];
-        if(!printall || silent)
-            return true;
-        for(int i = 0; i < found; i++)
-            if(i != kernel32)
-                dprintf(fhex"\n", addrfound()[i]);
-    }
-    else
-    {
-        *value = *addrfound();
-        if(!printall || silent)
-            return true;
-        for(int i = 1; i < found; i++)
-            dprintf(fhex"\n", addrfound()[i]);
-    }
+    *value = addrfound[0];
+    if(!printall || silent)
+        return true;
+    for(size_t i = 1; i < addrfound.size(); i++)
+        dprintf(fhex"\n", addrfound[i]);
     return true;
 }
 
@@ -1490,28 +1427,86 @@ static bool ishexnumber(const char* string)
 }
 
 /**
-\brief Gets a value from a string. This function can parse expressions, memory locations, registers, flags, API names, labels, symbols and variables.
+\brief Classifies a string the way valfromstring_noexpr resolves it. Only the syntax is checked, so the result does not change while debugging.
+\param string The string to classify.
+\return The kind of value the string describes.
+*/
+VALTYPE valtypefromstring(const char* string)
+{
+    if(!*string)
+        return VAL_EMPTY;
+    else if(string[0] == '['
+            || (isdigit(string[0]) && string[1] == ':' && string[2] == '[')
+            || (string[1] == 's' && (string[0] == 'c' || string[0] == 'd' || string[0] == 'e' || string[0] == 'f' || string[0] == 'g' || string[0] == 's') && string[2] == ':' && string[3] == '[')) //memory location
+        return VAL_MEMORY;
+    else if(isregister(string))
+        return VAL_REGISTER;
+    else if(*string == '_' && isflag(string + 1))
+        return VAL_FLAG;
+    else if(isdecnumber(string))
+        return VAL_DECNUMBER;
+    else if(ishexnumber(string))
+        return VAL_HEXNUMBER;
+    return VAL_NAME;
+}
+
+// Labels and symbols resolved by name, only valid as long as the modules and labels do not change
+static std::unordered_map<String, duint> valnames;
+static duint valnamesgeneration = 0;
+
+#define VAL_NAMES_MAX 4096
+
+static duint valnamegeneration()
+{
+    return ModGetGeneration() + LabelGetGeneration();
+}
+
+static bool valnamefromcache(const char* name, duint* value)
+{
+    auto generation = valnamegeneration();
+    SHARED_ACQUIRE(LockExpressionCache);
+    if(valnamesgeneration != generation)
+        return false;
+    auto found = valnames.find(name);
+    if(found == valnames.end())
+        return false;
+    *value = found->second;
+    return true;
+}
+
+static void valnametocache(const char* name, duint value, duint generation)
+{
+    EXCLUSIVE_ACQUIRE(LockExpressionCache);
+    if(valnamesgeneration != generation || valnames.size() >= VAL_NAMES_MAX)
+    {
+        valnames.clear();
+        valnamesgeneration = generation;
+    }
+    valnames[name] = value;
+}
+
+/**
+\brief Gets a value from a string that was already classified with valtypefromstring.
+\param type The type of the string, as returned by valtypefromstring.
 \param string The string to parse.
-\param [out] value The value of the expression. This value cannot be null.
+\param [out] value The value. This value cannot be null.
 \param silent true to not output anything to the console.
 \param baseonly true to skip parsing API names, labels, symbols and variables (basic expressions only).
 \param [out] value_size This function can output the value size parsed (for example memory location size or register size). Can be null.
 \param [out] isvar This function can output if the expression is variable (for example memory locations, registers or variables are variable). Can be null.
 \param [out] hexonly This function can output if the output value should only be printed as hexadecimal (for example addresses). Can be null.
-\return true if the expression was parsed successful, false otherwise.
+\return true if the value was parsed successful, false otherwise.
 */
-bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly)
+bool valfromstring_type(VALTYPE type, const char* string, duint* value, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly)
 {
     if(!value || !string)
         return false;
-    if(!*string)
+    if(type == VAL_EMPTY)
     {
         *value = 0;
         return true;
     }
-    else if(string[0] == '['
-            || (isdigit(string[0]) && string[1] == ':' && string[2] == '[')
-            || (string[1] == 's' && (string[0] == 'c' || string[0] == 'd' || string[0] == 'e' || string[0] == 'f' || string[0] == 'g' || string[0] == 's') && string[2] == ':' && string[3] == '[')) //memory location
+    else if(type == VAL_MEMORY)  //memory location
     {
         if(!DbgIsDebugging())
         {
@@ -1591,7 +1586,7 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
             *isvar = true;
         return true;
     }
-    else if(isregister(string))  //register
+    else if(type == VAL_REGISTER)  //register
     {
         if(!DbgIsDebugging())
         {
@@ -1609,7 +1604,7 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
             *isvar = true;
         return true;
     }
-    else if(*string == '_' && isflag(string + 1))  //flag
+    else if(type == VAL_FLAG)  //flag
     {
         if(!DbgIsDebugging())
         {
@@ -1633,7 +1628,7 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
             *isvar = true;
         return true;
     }
-    else if(isdecnumber(string))  //decimal numbers come 'first'
+    else if(type == VAL_DECNUMBER)  //decimal numbers come 'first'
     {
         if(value_size)
             *value_size = 0;
@@ -1642,7 +1637,7 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
         sscanf(string + 1, "%" fext "u", value);
         return true;
     }
-    else if(ishexnumber(string))  //then hex numbers
+    else if(type == VAL_HEXNUMBER)  //then hex numbers
     {
         if(value_size)
             *value_size = 0;
@@ -1659,10 +1654,19 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
         return false;
     else if(valapifromstring(string, value, value_size, true, silent, hexonly))  //then come APIs
         return true;
-    else if(LabelFromString(string, value))  //then come labels
+    else if(valnamefromcache(string, value))  //labels and symbols that were resolved before
+        return true;
+    auto generation = valnamegeneration();
+    if(LabelFromString(string, value))  //then come labels
+    {
+        valnametocache(string, *value, generation);
         return true;
+    }
     else if(SymAddrFromName(string, value))  //then come symbols
+    {
+        valnametocache(string, *value, generation);
         return true;
+    }
     else if(varget(string, value, value_size, 0))  //then come variables
     {
         if(isvar)
@@ -1680,6 +1684,63 @@ bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool ba
     return false; //nothing was OK
 }
 
+/**
+\brief Gets a value from a string. This function can parse memory locations, registers, flags, numbers, API names, labels, symbols and variables.
+\param string The string to parse.
+\param [out] value The value of the expression. This value cannot be null.
+\param silent true to not output anything to the console.
+\param baseonly true to skip parsing API names, labels, symbols and variables (basic expressions only).
+\param [out] value_size This function can output the value size parsed (for example memory location size or register size). Can be null.
+\param [out] isvar This function can output if the expression is variable (for example memory locations, registers or variables are variable). Can be null.
+\param [out] hexonly This function can output if the output value should only be printed as hexadecimal (for example addresses). Can be null.
+\return true if the expression was parsed successful, false otherwise.
+*/
+bool valfromstring_noexpr(const char* string, duint* value, bool silent, bool baseonly, int* value_size, bool* isvar, bool* hexonly)
+{
+    if(!value || !string)
+        return false;
+    return valfromstring_type(valtypefromstring(string), string, value, silent, baseonly, value_size, isvar, hexonly);
+}
+
+// Parsed expressions, the most recently used one first
+typedef std::list<std::pair<String, std::shared_ptr<const ExpressionParser>>> ExpressionList;
+static ExpressionList valexpressions;
+static std::unordered_map<String, ExpressionList::iterator> valexpressionmap;
+
+#define VAL_EXPRESSIONS_MAX 256
+
+/**
+\brief Gets the parsed expression of a string from the expression cache, the string is only parsed when it is not cached.
+\param string The expression.
+\return The parsed expression, it can be used by multiple threads at once.
+*/
+static std::shared_ptr<const ExpressionParser> valexpressionfromstring(const char* string)
+{
+    EXCLUSIVE_ACQUIRE(LockExpressionCache);
+    auto found = valexpressionmap.find(string);
+    if(found != valexpressionmap.end())
+    {
+        valexpressions.splice(valexpressions.begin(), valexpressions, found->second);
+        return found->second->second;
+    }
+    EXCLUSIVE_RELEASE();
+
+    auto parser = std::make_shared<ExpressionParser>(string);
+
+    EXCLUSIVE_REACQUIRE();
+    if(valexpressionmap.find(string) == valexpressionmap.end())
+    {
+        valexpressions.push_front(std::make_pair(String(string), parser));
+        valexpressionmap[string] = valexpressions.begin();
+        if(valexpressions.size() > VAL_EXPRESSIONS_MAX)
+        {
+            valexpressionmap.erase(valexpressions.back().first);
+            valexpressions.pop_back();
+        }
+    }
+    return parser;
+}
+
 /**
 \brief Gets a value from a string. This function can parse expressions, memory locations, registers, flags, API names, labels, symbols and variables.
 \param string The string to parse.
@@ -1700,9 +1761,9 @@ bool valfromstring(const char* string, duint* value, bool silent, bool baseonly,
         *value = 0;
         return true;
     }
-    ExpressionParser parser(string);
+    auto parser = valexpressionfromstring(string);
     duint result;
-    if(!parser.Calculate(result, valuesignedcalc(), silent, baseonly, value_size, isvar, hexonly))
+    if(!parser->Calculate(result, valuesignedcalc(), silent, baseonly, value_size, isvar, hexonly))
         return false;
     *value = result;
     return true;
@@ -3,10 +3,23 @@
 
 #include "_global.h"
 
+enum VALTYPE
+{
+    VAL_EMPTY,
+    VAL_MEMORY,
+    VAL_REGISTER,
+    VAL_FLAG,
+    VAL_DECNUMBER,
+    VAL_HEXNUMBER,
+    VAL_NAME
+};
+
 //functions
 bool valuesignedcalc();
 void valuesetsignedcalc(bool a);
 bool valapifromstring(const char* name, duint* value, int* value_size, bool printall, bool silent, bool* hexonly);
+VALTYPE valtypefromstring(const char* string);
+bool valfromstring_type(VALTYPE type, const char* string, duint* value, bool silent = true, bool baseonly = false, int* value_size = nullptr, bool* isvar = nullptr, bool* hexonly = nullptr);
 bool valfromstring_noexpr(const char* string, duint* value, bool silent = true, bool baseonly = false, int* value_size = nullptr, bool* isvar = nullptr, bool* hexonly = nullptr);
 bool valfromstring(const char* string, duint* value, bool silent = true, bool baseonly = false, int* value_size = nullptr, bool* isvar = nullptr, bool* hexonly = nullptr);
 bool valflagfromstring(duint eflags, const char* string);
@@ -22,6 +22,7 @@
 #include "filehelper.h"
 #include "database.h"
 #include "mnemonichelp.h"
+#include "yararules.h"
 
 static MESSAGE_STACK* gMsgStack = 0;
 static HANDLE hCommandLoopThread = 0;
@@ -234,6 +235,7 @@ static void registercommands()
     dbgcmdnew("scriptload", cbScriptLoad, false);
     dbgcmdnew("msg", cbScriptMsg, false);
     dbgcmdnew("msgyn", cbScriptMsgyn, false);
+    dbgcmdnew("scriptprofile", cbScriptProfile, false);
     dbgcmdnew("log", cbInstrLog, false); //log command with superawesome hax
 
     //data
@@ -246,6 +248,10 @@ static void registercommands()
     dbgcmdnew("reffindrange\1findrefrange\1refrange", cbInstrRefFindRange, true);
     dbgcmdnew("yara", cbInstrYara, true); //yara test command
     dbgcmdnew("yaramod", cbInstrYaramod, true); //yara rule on module
+    dbgcmdnew("yaraall", cbInstrYaraAll, true); //yara rule on all memory regions
+    dbgcmdnew("entropy", cbInstrEntropy, true); //entropy of memory regions
+    dbgcmdnew("memsnapshot", cbInstrMemSnapshot, true); //snapshot of the committed memory
+    dbgcmdnew("memdiff", cbInstrMemDiff, true); //changed memory between two snapshots
     dbgcmdnew("analyse\1analyze\1anal", cbInstrAnalyse, true); //secret analysis command
 
     //undocumented
@@ -264,6 +270,10 @@ static void registercommands()
     dbgcmdnew("virtualmod", cbInstrVirtualmod, true); //virtual module
     dbgcmdnew("findallmem\1findmemall", cbInstrFindMemAll, true); //memory map pattern find
     dbgcmdnew("setmaxfindresult\1findsetmaxresult", cbInstrSetMaxFindResult, false); //set the maximum number of occurences found
+    dbgcmdnew("jobs\1joblist", cbInstrJobs, false); //list background searches
+    dbgcmdnew("jobcancel", cbInstrJobCancel, false); //cancel background searches
+    dbgcmdnew("jobwait", cbInstrJobWait, false); //wait for background searches
+    dbgcmdnew("cmdbench", cbInstrCmdBenchmark, false); //command dispatch benchmark
     dbgcmdnew("savedata", cbInstrSavedata, true); //save data to disk
     dbgcmdnew("scriptdll\1dllscript", cbScriptDll, false); //execute a script DLL
     dbgcmdnew("mnemonichelp", cbInstrMnemonichelp, false); //mnemonic help
@@ -554,6 +564,7 @@ extern "C" DLL_EXPORT void _dbg_dbgexitsignal()
     dputs("Cleaning up allocated data...");
     cmdfree();
     varfree();
+    YaraRulesClear();
     yr_finalize();
     Capstone::GlobalFinalize();
     dputs("Checking for mem leaks...");
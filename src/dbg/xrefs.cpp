@@ -168,6 +168,81 @@ void XrefDelRange(duint Start, duint End)
     });
 }
 
+static bool xrefSameReferences(const XREFSINFO & a, const XREFSINFO & b)
+{
+    if(a.references.size() != b.references.size())
+        return false;
+    for(const auto & itr : a.references)
+    {
+        auto found = b.references.find(itr.first);
+        if(found == b.references.end() || found->second.type != itr.second.type)
+            return false;
+    }
+    return true;
+}
+
+void XrefReplaceRange(duint Start, duint End, const std::vector<XREFEDGE> & Edges)
+{
+    // The start and end address must be in the same module
+    auto moduleBase = ModBaseFromAddr(Start);
+
+    if(moduleBase != ModBaseFromAddr(End))
+        return;
+
+    // Group the new references by the referenced address
+    std::unordered_map<duint, XREFSINFO> updated;
+    for(const auto & edge : Edges)
+    {
+        if(edge.address < Start || edge.address > End || ModBaseFromAddr(edge.from) != moduleBase)
+            continue;
+        auto key = Xrefs::VaKey(edge.address);
+        auto found = updated.find(key);
+        if(found == updated.end())
+        {
+            XREFSINFO info;
+            if(!ModNameFromAddr(edge.address, info.mod, true))
+                *info.mod = '\0';
+            info.address = edge.address - moduleBase;
+            info.type = XREF_NONE;
+            found = updated.insert({ key, info }).first;
+        }
+        XREF_RECORD record;
+        record.addr = edge.from - moduleBase;
+        record.type = edge.type;
+        found->second.references.insert({ record.addr, record });
+        found->second.type = max(found->second.type, record.type);
+    }
+
+    // Only touch the addresses whose references changed. The entries are picked by their module and address like
+    // XrefDelRange does, the order of the keys says nothing about the module they belong to.
+    char moduleName[MAX_MODULE_SIZE] = "";
+    if(!ModNameFromAddr(Start, moduleName, true))
+        *moduleName = '\0';
+    auto start = Start - moduleBase;
+    auto end = End - moduleBase;
+    EXCLUSIVE_ACQUIRE(LockCrossReferences);
+    auto & mapData = xrefs.GetDataUnsafe();
+    for(auto itr = mapData.begin(); itr != mapData.end();)
+    {
+        const auto & value = itr->second;
+        if(value.address < start || value.address > end || _stricmp(value.mod, moduleName) != 0)
+        {
+            ++itr;
+            continue;
+        }
+        auto found = updated.find(itr->first);
+        if(found != updated.end() && xrefSameReferences(found->second, itr->second))
+        {
+            updated.erase(found);
+            ++itr;
+        }
+        else
+            itr = mapData.erase(itr);
+    }
+    for(auto & itr : updated)
+        mapData.insert(std::move(itr));
+}
+
 void XrefCacheSave(JSON Root)
 {
     xrefs.CacheSave(Root);
@@ -3,7 +3,12 @@
 
 #include "_global.h"
 
-
+struct XREFEDGE
+{
+    duint address; // referenced address
+    duint from;
+    XREFTYPE type;
+};
 
 bool XrefAdd(duint Address, duint From);
 bool XrefGet(duint Address, XREF_INFO* List);
@@ -11,6 +16,7 @@ duint XrefGetCount(duint Address);
 XREFTYPE XrefGetType(duint Address);
 bool XrefDeleteAll(duint Address);
 void XrefDelRange(duint Start, duint End);
+void XrefReplaceRange(duint Start, duint End, const std::vector<XREFEDGE> & Edges);
 void XrefCacheSave(JSON Root);
 void XrefCacheLoad(JSON Root);
 void XrefClear();
@@ -2,45 +2,99 @@
 #include "xrefs.h"
 #include "console.h"
 
+AnalysisResultCache<XrefsAnalysis::Result> XrefsAnalysis::mResults;
+
 void XrefsAnalysis::Analyse()
 {
     dputs("Starting xref analysis...");
     auto ticks = GetTickCount();
 
-    for(auto addr = mBase; addr < mBase + mSize;)
+    std::vector<std::pair<duint, duint>> changes;
+    auto previous = mResults.Get(mBase, mSize);
+    if(previous && changesSince(previous->serial, changes))
     {
-        if(!mCp.Disassemble(addr, translateAddr(addr)))
+        // An xref only depends on the instruction it comes from, rescan the changed ranges
+        for(const auto & xref : previous->xrefs)
+            if(!rangesOverlap(changes, xref.from, xref.from + 1))
+                mXrefs.push_back(xref);
+        for(const auto & change : changes)
         {
-            addr++;
-            continue;
+            DECODEDINSTR instr;
+            for(auto index = store().LowerBound(change.first); index < store().Count(); index++)
+            {
+                store().Get(index, instr);
+                if(instr.addr >= change.second)
+                    break;
+                if(instr.size)
+                    addXref(instr);
+            }
         }
-        addr += mCp.Size();
-
-        XREF xref;
-        xref.addr = 0;
-        xref.from = mCp.Address();
-        for(auto i = 0; i < mCp.OpCount(); i++)
+        std::sort(mXrefs.begin(), mXrefs.end(), [](const XREF & a, const XREF & b)
         {
-            duint dest = mCp.ResolveOpValue(i, [](x86_reg)->size_t
-            {
-                return 0;
-            });
-            if(inRange(dest))
+            return a.from < b.from;
+        });
+        dprintf("%u changed range(s) rescanned\n", changes.size());
+    }
+    else
+    {
+        for(auto addr = mBase; addr < mBase + mSize;)
+        {
+            DECODEDINSTR instr;
+            if(!decode(addr, instr))
             {
-                xref.addr = dest;
-                break;
+                addr++;
+                continue;
             }
+            addr += instr.size;
+            addXref(instr);
         }
-        if(xref.addr)
-            mXrefs.push_back(xref);
     }
 
+    auto result = std::make_shared<Result>();
+    result->base = mBase;
+    result->size = mSize;
+    result->serial = store().Serial();
+    result->xrefs = mXrefs;
+    mResults.Put(result);
+
     dprintf("%u xrefs found in %ums!\n", mXrefs.size(), GetTickCount() - ticks);
 }
 
 void XrefsAnalysis::SetMarkers()
 {
-    XrefDelRange(mBase, mBase + mSize - 1);
+    std::vector<XREFEDGE> edges;
+    edges.reserve(mXrefs.size());
     for(const auto & xref : mXrefs)
-        XrefAdd(xref.addr, xref.from);
+    {
+        XREFEDGE edge;
+        edge.address = xref.addr;
+        edge.from = xref.from;
+        edge.type = xref.type;
+        edges.push_back(edge);
+    }
+    XrefReplaceRange(mBase, mBase + mSize - 1, edges);
+}
+
+void XrefsAnalysis::addXref(const DECODEDINSTR & instr)
+{
+    XREF xref;
+    xref.addr = 0;
+    xref.from = instr.addr;
+    if(instr.flags & DECODED_CALL)
+        xref.type = XREF_CALL;
+    else if(instr.flags & (DECODED_JUMP | DECODED_LOOP))
+        xref.type = XREF_JMP;
+    else
+        xref.type = XREF_DATA;
+    for(auto i = 0; i < instr.refCount; i++)
+    {
+        auto dest = instr.refs[i];
+        if(inRange(dest))
+        {
+            xref.addr = dest;
+            break;
+        }
+    }
+    if(xref.addr)
+        mXrefs.push_back(xref);
 }
@@ -18,7 +18,21 @@ private:
     {
         duint addr;
         duint from;
+        XREFTYPE type;
     };
 
+    // Xrefs sorted by the address of the instruction they come from
+    struct Result
+    {
+        duint base;
+        duint size;
+        duint serial;
+        std::vector<XREF> xrefs;
+    };
+
+    static AnalysisResultCache<Result> mResults;
+
     std::vector<XREF> mXrefs;
+
+    void addXref(const DECODEDINSTR & instr);
 };
\ No newline at end of file
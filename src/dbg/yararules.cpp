@@ -0,0 +1,135 @@
+/**
+ @file yararules.cpp
+
+ @brief Implements a cache of compiled YARA rules.
+ */
+
+#include "yararules.h"
+#include "threading.h"
+#include "console.h"
+#include "filehelper.h"
+#include "stringutils.h"
+
+struct YARARULESINFO
+{
+    FILETIME lastWrite;
+    ULONGLONG size;
+    std::shared_ptr<YR_RULES> rules;
+};
+
+struct YARARULESSTREAM
+{
+    const unsigned char* data;
+    size_t size;
+    size_t offset;
+};
+
+static std::unordered_map<String, YARARULESINFO> rulesCache;
+
+static void yaraCompilerCallback(int error_level, const char* file_name, int line_number, const char* message, void* user_data)
+{
+    switch(error_level)
+    {
+    case YARA_ERROR_LEVEL_ERROR:
+        dprintf("[YARA ERROR] ");
+        break;
+    case YARA_ERROR_LEVEL_WARNING:
+        dprintf("[YARA WARNING] ");
+        break;
+    }
+    dprintf("File: \"%s\", Line: %d, Message: \"%s\"\n", file_name, line_number, message);
+}
+
+static size_t yaraStreamRead(void* ptr, size_t size, size_t count, void* user_data)
+{
+    auto stream = (YARARULESSTREAM*)user_data;
+    if(!size)
+        return 0;
+    count = min(count, (stream->size - stream->offset) / size);
+    memcpy(ptr, stream->data + stream->offset, count * size);
+    stream->offset += count * size;
+    return count;
+}
+
+static YR_RULES* yaraCompile(const String & RulesFile)
+{
+    std::vector<unsigned char> content;
+    if(!FileHelper::ReadAllData(RulesFile, content))
+    {
+        dprintf("Failed to read the rules file \"%s\"\n", RulesFile.c_str());
+        return nullptr;
+    }
+
+    YR_RULES* yrRules = nullptr;
+    if(content.size() >= 4 && !memcmp(content.data(), "YARA", 4))  //compiled rules (yarac)
+    {
+        YARARULESSTREAM rulesStream = { content.data(), content.size(), 0 };
+        YR_STREAM stream;
+        stream.user_data = &rulesStream;
+        stream.read = yaraStreamRead;
+        stream.write = nullptr;
+        if(yr_rules_load_stream(&stream, &yrRules) != ERROR_SUCCESS)
+        {
+            dputs("error while loading the compiled rules!");
+            return nullptr;
+        }
+        return yrRules;
+    }
+
+    content.push_back(0);
+    YR_COMPILER* yrCompiler;
+    if(yr_compiler_create(&yrCompiler) != ERROR_SUCCESS)
+    {
+        dputs("yr_compiler_create failed!");
+        return nullptr;
+    }
+    yr_compiler_set_callback(yrCompiler, yaraCompilerCallback, 0);
+    if(yr_compiler_add_string(yrCompiler, (const char*)content.data(), nullptr) == 0)   //no errors found
+    {
+        if(yr_compiler_get_rules(yrCompiler, &yrRules) != ERROR_SUCCESS)
+        {
+            dputs("error while getting the rules!");
+            yrRules = nullptr;
+        }
+    }
+    else
+        dputs("errors in the rules file!");
+    yr_compiler_destroy(yrCompiler);
+    return yrRules;
+}
+
+std::shared_ptr<YR_RULES> YaraRulesGet(const String & RulesFile)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if(!GetFileAttributesExW(StringUtils::Utf8ToUtf16(RulesFile).c_str(), GetFileExInfoStandard, &attributes))
+    {
+        dprintf("Failed to read the rules file \"%s\"\n", RulesFile.c_str());
+        return nullptr;
+    }
+    auto size = ULONGLONG(attributes.nFileSizeHigh) << 32 | attributes.nFileSizeLow;
+
+    SHARED_ACQUIRE(LockYaraRules);
+    auto found = rulesCache.find(RulesFile);
+    if(found != rulesCache.end() && !CompareFileTime(&found->second.lastWrite, &attributes.ftLastWriteTime) && found->second.size == size)
+        return found->second.rules;
+    SHARED_RELEASE();
+
+    // Compile without holding the lock, a scan of other rules can continue meanwhile
+    auto yrRules = yaraCompile(RulesFile);
+    if(!yrRules)
+        return nullptr;
+    YARARULESINFO info;
+    info.lastWrite = attributes.ftLastWriteTime;
+    info.size = size;
+    info.rules = std::shared_ptr<YR_RULES>(yrRules, yr_rules_destroy);
+
+    EXCLUSIVE_ACQUIRE(LockYaraRules);
+    rulesCache[RulesFile] = info;
+    return info.rules;
+}
+
+void YaraRulesClear()
+{
+    EXCLUSIVE_ACQUIRE(LockYaraRules);
+    rulesCache.clear();
+}
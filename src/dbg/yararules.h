@@ -0,0 +1,11 @@
+#ifndef _YARARULES_H
+#define _YARARULES_H
+
+#include "_global.h"
+#include <memory>
+
+// Compiled rules of a rules file (source or compiled with yarac), cached until the file changes
+std::shared_ptr<YR_RULES> YaraRulesGet(const String & RulesFile);
+void YaraRulesClear();
+
+#endif // _YARARULES_H
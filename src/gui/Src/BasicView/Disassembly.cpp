@@ -438,9 +438,9 @@ QString Disassembly::paintContent(QPainter* painter, dsint rowBase, int rowOffse
     case 2: //draw disassembly (with colours needed)
     {
         int loopsize = 0;
-        int depth = 0;
+        int loopDepth = DbgFunctions()->GetLoopDepth(cur_addr);
 
-        while(1) //paint all loop depths
+        for(int depth = 0; depth < loopDepth; depth++) //paint all loop depths
         {
             LOOPTYPE loopType = DbgGetLoopTypeAt(cur_addr, depth);
             if(loopType == LOOP_NONE)
@@ -464,7 +464,6 @@ QString Disassembly::paintContent(QPainter* painter, dsint rowBase, int rowOffse
                 break;
             }
             loopsize += paintFunctionGraphic(painter, x + loopsize, y, funcType, true);
-            depth++;
         }
 
         RichTextPainter::List richText;
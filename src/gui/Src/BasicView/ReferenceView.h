@@ -12,7 +12,9 @@ class ReferenceView : public SearchListView
 public:
     ReferenceView();
     void setupContextMenu();
+    void connectBridge();
     void disconnectBridge();
+    void updateView(const REFVIEWUPDATE* update);
 
 private slots:
     void addColumnAt(int width, QString title);
@@ -264,6 +264,25 @@ void StdTable::setRowCount(int count)
     AbstractTableView::setRowCount(count);
 }
 
+void StdTable::insertRow(int r)
+{
+    if(r < 0 || r > mData.size())
+        return;
+    QList<QString> row;
+    for(int j = 0; j < getColumnCount(); j++)
+        row.append("");
+    mData.insert(r, row);
+    AbstractTableView::setRowCount(mData.size());
+}
+
+void StdTable::removeRow(int r)
+{
+    if(r < 0 || r >= mData.size())
+        return;
+    mData.removeAt(r);
+    AbstractTableView::setRowCount(mData.size());
+}
+
 void StdTable::deleteAllColumns()
 {
     setRowCount(0);
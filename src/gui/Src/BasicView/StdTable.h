@@ -31,6 +31,8 @@ public:
     // Data Management
     void addColumnAt(int width, QString title, bool isClickable, QString copyTitle = "");
     void setRowCount(int count);
+    void insertRow(int r);
+    void removeRow(int r);
     void deleteAllColumns();
     void setCellContent(int r, int c, QString s);
     QString getCellContent(int r, int c);
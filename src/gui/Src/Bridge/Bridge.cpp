@@ -200,6 +200,8 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
         break;
 
     case GUI_REF_GETROWCOUNT:
+        if(!referenceManager->currentReferenceView())
+            return 0;
         return (void*)referenceManager->currentReferenceView()->mList->getRowCount();
 
     case GUI_REF_DELETEALLCOLUMNS:
@@ -214,6 +216,8 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
     break;
 
     case GUI_REF_GETCELLCONTENT:
+        if(!referenceManager->currentReferenceView())
+            return (void*)"";
         return (void*)referenceManager->currentReferenceView()->mList->getCellContent((int)param1, (int)param2).toUtf8().constData();
 
     case GUI_REF_RELOADDATA:
@@ -239,8 +243,8 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
     case GUI_REF_INITIALIZE:
     {
         BridgeResult result;
-        emit referenceInitialize(QString((const char*)param1));
-        result.Wait();
+        emit referenceInitialize(QString((const char*)param1), (bool)param2);
+        return (void*)result.Wait();
     }
     break;
 
@@ -574,6 +578,14 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
         }
     }
     break;
+
+    case GUI_REF_UPDATEVIEW:
+    {
+        BridgeResult result;
+        emit referenceUpdateView((const REFVIEWUPDATE*)param1);
+        return (void*)result.Wait();
+    }
+    break;
     }
     return nullptr;
 }
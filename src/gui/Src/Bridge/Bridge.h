@@ -72,7 +72,8 @@ signals:
     void referenceSetProgress(int progress);
     void referenceSetCurrentTaskProgress(int progress, QString taskTitle);
     void referenceSetSearchStartCol(int col);
-    void referenceInitialize(QString name);
+    void referenceInitialize(QString name, bool detached);
+    void referenceUpdateView(const REFVIEWUPDATE* update);
     void stackDumpAt(duint va, duint csp);
     void updateDump();
     void updateThreads();
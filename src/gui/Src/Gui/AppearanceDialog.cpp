@@ -526,6 +526,7 @@ void AppearanceDialog::colorInfoListInit()
     colorInfoListAppend("Current Thread", "ThreadCurrentColor", "ThreadCurrentBackgroundColor");
     colorInfoListAppend("Memory Map Breakpoint", "MemoryMapBreakpointColor", "MemoryMapBreakpointBackgroundColor");
     colorInfoListAppend("Memory Map Section Text", "MemoryMapSectionTextColor", "");
+    colorInfoListAppend("Memory Map Entropy", "", "MemoryMapEntropyBackgroundColor");
     colorInfoListAppend("Search Highlight Color", "SearchListViewHighlightColor", "");
 
     //dev helper
@@ -1355,6 +1355,17 @@ void CPUDisassembly::paintEvent(QPaintEvent* event)
     Disassembly::paintEvent(event);
 }
 
+void CPUDisassembly::prepareData()
+{
+    Disassembly::prepareData();
+
+    // The sidebar model is built from the same instruction buffer
+    auto sidebar = mParentCPUWindow->getSidebarWidget();
+
+    if(sidebar)
+        sidebar->reload();
+}
+
 bool CPUDisassembly::getLabelsFromInstruction(duint addr, QSet<QString> & labels)
 {
     BASIC_INSTRUCTION_INFO basicinfo;
@@ -98,6 +98,7 @@ public slots:
 
 protected:
     void paintEvent(QPaintEvent* event);
+    void prepareData();
 
 private:
     bool getLabelsFromInstruction(duint addr, QSet<QString> & labels);
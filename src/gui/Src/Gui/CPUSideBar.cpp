@@ -2,6 +2,7 @@
 #include "Configuration.h"
 #include "Breakpoints.h"
 #include <QToolTip>
+#include <QMenu>
 
 CPUSideBar::CPUSideBar(CPUDisassembly* Ptr, QWidget* parent) : QAbstractScrollArea(parent)
 {
@@ -9,6 +10,12 @@ CPUSideBar::CPUSideBar(CPUDisassembly* Ptr, QWidget* parent) : QAbstractScrollAr
     selectedVA = -1;
     viewableRows = 0;
 
+    mModelDirty = true;
+    mModelBase = 0;
+    mShowPaintTime = ConfigBool("Disassembler", "SideBarPaintTime");
+    mLastPaintTime = 0;
+    mLastModelTime = 0;
+
     mDisas = Ptr;
 
     mInstrBuffer = mDisas->instructionsBuffer();
@@ -88,12 +95,16 @@ void CPUSideBar::repaint()
     viewport()->update();
 }
 
+void CPUSideBar::reload()
+{
+    mModelDirty = true;
+    repaint();
+}
+
 void CPUSideBar::changeTopmostAddress(dsint i)
 {
     topVA = i;
-    memset(&regDump, 0, sizeof(REGDUMP));
-    DbgGetRegDump(&regDump);
-    repaint();
+    reload();
 }
 
 void CPUSideBar::setViewableRows(int rows)
@@ -110,39 +121,13 @@ void CPUSideBar::setSelection(dsint selVA)
     }
 }
 
-bool CPUSideBar::isJump(int i) const
-{
-    const Instruction_t & instr = mInstrBuffer->at(i);
-    Instruction_t::BranchType branchType = instr.branchType;
-    if(branchType != Instruction_t::None)
-    {
-        duint start = mDisas->getBase();
-        duint end = start + mDisas->getSize();
-        duint addr = DbgGetBranchDestination(start + instr.rva);
-
-        if(!addr)
-            return false;
-
-        return addr >= start && addr < end; //do not draw jumps that go out of the section
-    }
-
-    return false;
-}
-
-void CPUSideBar::paintEvent(QPaintEvent* event)
+void CPUSideBar::updateRegLabels()
 {
-    Q_UNUSED(event);
-
-    QPainter painter(this->viewport());
-
-    // Paints background
-    painter.fillRect(painter.viewport(), mBackgroundColor);
-
-    // Don't draw anything if there aren't any instructions to draw
-    if(mInstrBuffer->size() == 0)
+    mRegLabelMap.clear();
+    memset(&regDump, 0, sizeof(REGDUMP));
+    if(!DbgIsDebugging() || !DbgGetRegDump(&regDump))
         return;
 
-    QHash<duint, QString> regLabelMap;
     auto appendReg = [&](duint value, const char* x32name, const char* x64name)
     {
 #ifdef _WIN64
@@ -152,11 +137,11 @@ void CPUSideBar::paintEvent(QPaintEvent* event)
         Q_UNUSED(x64name);
         QString name = x32name;
 #endif //_WIN64
-        auto found = regLabelMap.find(value);
-        if(found == regLabelMap.end())
-            regLabelMap.insert(value, name);
+        auto found = mRegLabelMap.find(value);
+        if(found == mRegLabelMap.end())
+            mRegLabelMap.insert(value, name);
         else
-            regLabelMap.insert(value, QString("%1 %2").arg(found.value()).arg(name));
+            mRegLabelMap.insert(value, QString("%1 %2").arg(found.value()).arg(name));
     };
     const auto & regs = regDump.regcontext;
     appendReg(regs.cip, "EIP", "RIP");
@@ -178,77 +163,225 @@ void CPUSideBar::paintEvent(QPaintEvent* event)
     appendReg(regs.r14, "", "R14");
     appendReg(regs.r15, "", "R15");
 #endif //_WIN64
+}
 
-    int jumpoffset = 0;
+void CPUSideBar::updateModel()
+{
+    mModelDirty = false;
+    mRowInfo.clear();
+
+    duint base = mDisas->getBase();
+    duint end = base + mDisas->getSize();
+    if(base != mModelBase) //a different memory page was loaded, start the lane layout from scratch
+    {
+        mJumpLines.clear();
+        mModelBase = base;
+    }
 
-    dsint last_va = mInstrBuffer->last().rva + mDisas->getBase();
-    dsint first_va = mInstrBuffer->first().rva + mDisas->getBase();
+    updateRegLabels();
 
-    for(int line = 0; line < viewableRows; line++)
+    const int count = mInstrBuffer->size();
+    if(!count || !DbgIsDebugging())
     {
-        if(line >= mInstrBuffer->size()) //at the end of the page it will crash otherwise
-            break;
-        Instruction_t instr = mInstrBuffer->at(line);
-        dsint instrVA = instr.rva + mDisas->getBase();
+        mJumpLines.clear();
+        return;
+    }
 
-        // draw bullet
-        drawBullets(&painter, line, DbgGetBpxTypeAt(instrVA) != bp_none, DbgIsBpDisabled(instrVA), DbgGetBookmarkAt(instrVA));
+    // Query everything the sidebar needs for the visible instructions in a single request
+    mRowInfo.resize(count);
+    for(int i = 0; i < count; i++)
+    {
+        const Instruction_t & instr = mInstrBuffer->at(i);
+        SIDEBARINFO & info = mRowInfo[i];
+        memset(&info, 0, sizeof(SIDEBARINFO));
+        info.addr = base + instr.rva;
+        info.isBranch = instr.branchType != Instruction_t::None;
+    }
+    if(!DbgFunctions()->GetSideBarInfo(mRowInfo.data(), count))
+    {
+        mRowInfo.clear();
+        mJumpLines.clear();
+        return;
+    }
 
-        if(isJump(line)) //handle jumps
-        {
-            bool isJumpGoingToExecute = DbgIsJumpGoingToExecute(instrVA);
-            bool isSelected = (selectedVA == instrVA);
-            bool isConditional = instr.branchType == Instruction_t::Conditional;
+    const duint first_va = mRowInfo.first().addr;
+    const duint last_va = mRowInfo.last().addr;
 
-            /*
-            if(mDisas->currentEIP() != mInstrBuffer->at(line).rva) //create a setting for this
-                isJumpGoingToExecute=false;
-            */
+    // Build the jump edges of this viewport
+    QList<JumpLine> jumps;
+    for(int line = 0; line < count; line++)
+    {
+        const SIDEBARINFO & info = mRowInfo.at(line);
+        duint destVA = info.branchDestination;
+
+        // Do not draw jumps that leave the memory range
+        if(!destVA || destVA < base || destVA >= end)
+            continue;
+
+        // Do not try to draw EBFE (Jump to the same line)
+        if(destVA == info.addr)
+            continue;
+
+        JumpLine jump;
+        jump.start = info.addr;
+        jump.dest = destVA;
+        jump.line = line;
+        jump.lane = 0;
+        jump.conditional = mInstrBuffer->at(line).branchType == Instruction_t::Conditional;
+        jump.isJumpGoingToExecute = info.isJumpGoingToExecute;
+
+        if(destVA > last_va)
+            jump.destLine = viewableRows + 6;
+        else if(destVA < first_va)
+            jump.destLine = -6;
+        else if(destVA > info.addr) //jump goes down, first line at or after the destination
+        {
+            auto found = std::lower_bound(mRowInfo.constBegin(), mRowInfo.constEnd(), destVA, [](const SIDEBARINFO & a, duint b)
+            {
+                return a.addr < b;
+            });
+            jump.destLine = int(found - mRowInfo.constBegin());
+        }
+        else //jump goes up, last line at or before the destination
+        {
+            auto found = std::upper_bound(mRowInfo.constBegin(), mRowInfo.constEnd(), destVA, [](duint a, const SIDEBARINFO & b)
+            {
+                return a < b.addr;
+            });
+            jump.destLine = int(found - mRowInfo.constBegin()) - 1;
+        }
+        jumps.append(jump);
+    }
 
-            jumpoffset++;
+    assignJumpLanes(jumps);
+    mJumpLines = jumps;
+}
 
-            dsint baseAddr = mDisas->getBase();
+void CPUSideBar::assignJumpLanes(QList<JumpLine> & jumps)
+{
+    // Edges that were already visible keep their lane, so scrolling only lays out the edges that scrolled in
+    QHash<QPair<duint, duint>, int> previousLanes;
+    for(const JumpLine & jump : mJumpLines)
+        previousLanes.insert(qMakePair(jump.start, jump.dest), jump.lane);
+
+    QList<JumpLine*> placed;
+    QList<JumpLine*> pending;
+    for(JumpLine & jump : jumps)
+    {
+        auto found = previousLanes.find(qMakePair(jump.start, jump.dest));
+        if(found != previousLanes.end())
+        {
+            jump.lane = found.value();
+            placed.append(&jump);
+        }
+        else
+            pending.append(&jump);
+    }
 
-            dsint destVA = DbgGetBranchDestination(baseAddr + instr.rva);
+    // Interval coloring: shortest edges first so nested jumps end up closest to the instructions
+    std::stable_sort(pending.begin(), pending.end(), [](const JumpLine * a, const JumpLine * b)
+    {
+        return a->high() - a->low() < b->high() - b->low();
+    });
 
-            // Do not try to draw EBFE (Jump to the same line)
-            if(destVA == instrVA)
+    for(JumpLine* jump : pending)
+    {
+        QVector<bool> used;
+        for(const JumpLine* other : placed)
+        {
+            if(other->low() > jump->high() || other->high() < jump->low())
                 continue;
+            if(other->lane >= used.size())
+                used.resize(other->lane + 1);
+            used[other->lane] = true;
+        }
+        int lane = 1;
+        while(lane < used.size() && used[lane])
+            lane++;
+        jump->lane = lane;
+        placed.append(jump);
+    }
+}
 
-            // Do not draw jumps that leave the memory range
-            if(destVA >= mDisas->getBase() + mDisas->getSize() || destVA < mDisas->getBase())
-                continue;
+void CPUSideBar::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
 
-            if(destVA <= last_va && destVA >= first_va)
-            {
-                int destLine = line;
-                while(destLine > -1 && destLine < mInstrBuffer->size())
-                {
-                    dsint va = mInstrBuffer->at(destLine).rva + mDisas->getBase();
-                    if(destVA > instrVA) //jump goes up
-                    {
-                        if(va >= destVA)
-                            break;
-                        destLine++;
-                    }
-                    else //jump goes down
-                    {
-                        if(va <= destVA)
-                            break;
-                        destLine--;
-                    }
-                }
-                drawJump(&painter, line, destLine, jumpoffset, isConditional, isJumpGoingToExecute, isSelected);
-            }
-            else if(destVA > last_va)
-                drawJump(&painter, line, viewableRows + 6, jumpoffset, isConditional, isJumpGoingToExecute, isSelected);
-            else if(destVA < first_va)
-                drawJump(&painter, line, -6, jumpoffset, isConditional, isJumpGoingToExecute, isSelected);
-        }
-        auto found = regLabelMap.find(instrVA);
-        if(found != regLabelMap.end())
+    mPaintTimer.start();
+
+    QPainter painter(this->viewport());
+
+    // Paints background
+    painter.fillRect(painter.viewport(), mBackgroundColor);
+
+    if(mModelDirty)
+    {
+        updateModel();
+        mLastModelTime = mPaintTimer.nsecsElapsed();
+    }
+    else
+        mLastModelTime = 0;
+
+    // Don't draw anything if there aren't any instructions to draw
+    if(mInstrBuffer->size() == 0 || mRowInfo.size() != mInstrBuffer->size())
+    {
+        drawPaintTime(&painter);
+        return;
+    }
+
+    const int lineCount = qMin(viewableRows, mRowInfo.size());
+    for(int line = 0; line < lineCount; line++)
+    {
+        const SIDEBARINFO & info = mRowInfo.at(line);
+        drawBullets(&painter, line, info.bpxType != bp_none, info.isBpDisabled, info.isBookmark);
+    }
+
+    for(const JumpLine & jump : mJumpLines)
+    {
+        if(jump.line >= lineCount)
+            continue;
+        bool isSelected = (selectedVA == dsint(jump.start));
+        drawJump(&painter, jump.line, jump.destLine, jump.lane, jump.conditional, jump.isJumpGoingToExecute, isSelected);
+    }
+
+    for(int line = 0; line < lineCount; line++)
+    {
+        auto found = mRegLabelMap.find(mRowInfo.at(line).addr);
+        if(found != mRegLabelMap.end())
             drawLabel(&painter, line, found.value());
     }
+
+    drawPaintTime(&painter);
+}
+
+void CPUSideBar::drawPaintTime(QPainter* painter)
+{
+    mLastPaintTime = mPaintTimer.nsecsElapsed();
+    if(!mShowPaintTime)
+        return;
+
+    painter->save();
+    painter->setPen(mCipLabelBackgroundColor);
+    QString text = QString("%1us").arg(mLastPaintTime / 1000);
+    if(mLastModelTime)
+        text += QString(" (%1us)").arg(mLastModelTime / 1000);
+    const int y = viewport()->height() - fontHeight;
+    painter->drawText(QRect(1, y, viewport()->width() - 2, fontHeight), Qt::AlignLeft | Qt::AlignVCenter, text);
+    painter->restore();
+}
+
+void CPUSideBar::contextMenuEvent(QContextMenuEvent* event)
+{
+    QMenu wMenu(this);
+    QAction* paintTimeAction = wMenu.addAction(tr("Show paint time"));
+    paintTimeAction->setCheckable(true);
+    paintTimeAction->setChecked(mShowPaintTime);
+    if(wMenu.exec(event->globalPos()) == paintTimeAction)
+    {
+        mShowPaintTime = !mShowPaintTime;
+        Config()->setBool("Disassembler", "SideBarPaintTime", mShowPaintTime);
+        repaint();
+    }
 }
 
 void CPUSideBar::mouseReleaseEvent(QMouseEvent* e)
@@ -2,6 +2,7 @@
 #define CPUSIDEBAR_H
 
 #include <QAbstractScrollArea>
+#include <QElapsedTimer>
 #include "CPUDisassembly.h"
 
 class CPUSideBar : public QAbstractScrollArea
@@ -28,6 +29,7 @@ public slots:
 
     void debugStateChangedSlot(DBGSTATE state);
     void repaint();
+    void reload();
     void changeTopmostAddress(dsint i);
     void setViewableRows(int rows);
     void setSelection(dsint selVA);
@@ -36,13 +38,52 @@ protected:
     void paintEvent(QPaintEvent* event);
     void mouseReleaseEvent(QMouseEvent* e);
     void mouseMoveEvent(QMouseEvent* event);
+    void contextMenuEvent(QContextMenuEvent* event);
 
     void drawLabel(QPainter* painter, int Line, const QString & Text);
     void drawBullets(QPainter* painter, int line, bool ispb, bool isbpdisabled, bool isbookmark);
-    bool isJump(int i) const;
+    void drawPaintTime(QPainter* painter);
     void drawJump(QPainter* painter, int startLine, int endLine, int jumpoffset, bool conditional, bool isexecute, bool isactive);
 
 private:
+    struct JumpLine
+    {
+        duint start; //source address
+        duint dest; //destination address
+        int line; //source line
+        int destLine; //destination line (-6 = above the view, viewableRows + 6 = below the view)
+        int lane; //horizontal offset, assigned by interval coloring
+        bool conditional;
+        bool isJumpGoingToExecute;
+
+        duint low() const
+        {
+            return start < dest ? start : dest;
+        }
+
+        duint high() const
+        {
+            return start < dest ? dest : start;
+        }
+    };
+
+    void updateModel();
+    void updateRegLabels();
+    void assignJumpLanes(QList<JumpLine> & jumps);
+
+    // Per-viewport model, rebuilt when the instruction buffer changes
+    bool mModelDirty;
+    duint mModelBase;
+    QVector<SIDEBARINFO> mRowInfo;
+    QList<JumpLine> mJumpLines;
+    QHash<duint, QString> mRegLabelMap;
+
+    // Paint time counter
+    bool mShowPaintTime;
+    QElapsedTimer mPaintTimer;
+    qint64 mLastPaintTime;
+    qint64 mLastModelTime;
+
     dsint topVA;
     dsint selectedVA;
     QFont m_DefaultFont;
@@ -14,6 +14,7 @@ CPUStack::CPUStack(CPUMultiDump* multiDump, QWidget* parent) : HexDump(parent)
     ColumnDescriptor_t wColDesc;
     DataDescriptor_t dDesc;
     bStackFrozen = false;
+    mAnnotationBase = 0;
     mMultiDump = multiDump;
 
     mForceColumn = 1;
@@ -318,7 +319,7 @@ void CPUStack::getColumnRichText(int col, dsint rva, RichTextPainter::List & ric
     if(wVa < mCsp) //inactive stack
         wActiveStack = false;
 
-    STACK_COMMENT comment;
+    const STACKANNOTATION* annotation = annotationAt(wVa);
     RichTextPainter::CustomRichText_t curData;
     curData.highlight = false;
     curData.flags = RichTextPainter::FlagColor;
@@ -337,8 +338,9 @@ void CPUStack::getColumnRichText(int col, dsint rva, RichTextPainter::List & ric
             }
         }
     }
-    else if(col && DbgStackCommentGet(rvaToVa(wRva), &comment)) //paint stack comments
+    else if(col && annotation && *annotation->comment.comment) //paint stack comments
     {
+        const STACK_COMMENT & comment = annotation->comment;
         if(wActiveStack)
         {
             if(*comment.color)
@@ -373,7 +375,8 @@ QString CPUStack::paintContent(QPainter* painter, dsint rowBase, int rowOffset,
     if(col == 0) // paint stack address
     {
         QColor background;
-        if(DbgGetLabelAt(wVa, SEG_DEFAULT, nullptr)) //label
+        const STACKANNOTATION* annotation = annotationAt(wVa);
+        if(annotation && annotation->hasLabel) //label
         {
             if(wVa == mCsp) //CSP
             {
@@ -412,6 +415,36 @@ QString CPUStack::paintContent(QPainter* painter, dsint rowBase, int rowOffset,
     return HexDump::paintContent(painter, rowBase, rowOffset, col, x, y, w, h);;
 }
 
+void CPUStack::prepareData()
+{
+    HexDump::prepareData();
+
+    // Resolve the annotations of the whole visible window in one request
+    mAnnotations.clear();
+    mAnnotationBase = 0;
+    if(!DbgIsDebugging())
+        return;
+    int wBytePerRowCount = getBytePerRowCount();
+    dsint wRva = getTableOffset() * wBytePerRowCount - mByteOffset;
+    int wCount = (getViewableRowsCount() * wBytePerRowCount) / sizeof(duint);
+    if(wCount <= 0)
+        return;
+    mAnnotationBase = rvaToVa(wRva);
+    mAnnotations.resize(wCount);
+    if(!DbgFunctions()->GetStackAnnotations(mAnnotationBase, wCount, mAnnotations.data()))
+        mAnnotations.clear();
+}
+
+const STACKANNOTATION* CPUStack::annotationAt(duint va) const
+{
+    if(va < mAnnotationBase || (va - mAnnotationBase) % sizeof(duint))
+        return nullptr;
+    duint index = (va - mAnnotationBase) / sizeof(duint);
+    if(index >= duint(mAnnotations.size()))
+        return nullptr;
+    return &mAnnotations.at(index);
+}
+
 void CPUStack::contextMenuEvent(QContextMenuEvent* event)
 {
     dsint selectedAddr = rvaToVa(getInitialSelection());
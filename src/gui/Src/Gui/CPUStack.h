@@ -19,6 +19,7 @@ public:
 
     void getColumnRichText(int col, dsint rva, RichTextPainter::List & richText) override;
     QString paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h) override;
+    void prepareData() override;
     void contextMenuEvent(QContextMenuEvent* event);
     void mouseDoubleClickEvent(QMouseEvent* event);
     void setupContextMenu();
@@ -68,7 +69,11 @@ public slots:
     void dbgStateChangedSlot(DBGSTATE state);
 
 private:
+    const STACKANNOTATION* annotationAt(duint va) const;
+
     duint mCsp;
+    duint mAnnotationBase;
+    QVector<STACKANNOTATION> mAnnotations;
     bool bStackFrozen;
 
     QMenu* mBinaryMenu;
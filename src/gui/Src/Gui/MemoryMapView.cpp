@@ -11,6 +11,7 @@
 MemoryMapView::MemoryMapView(StdTable* parent) : StdTable(parent)
 {
     enableMultiSelection(false);
+    mMemMapGeneration = 0;
 
     int charwidth = getCharWidth();
 
@@ -20,6 +21,7 @@ MemoryMapView::MemoryMapView(StdTable* parent) : StdTable(parent)
     addColumnAt(8 + charwidth * 5, tr("Type"), false, tr("Allocation Type")); //allocation type
     addColumnAt(8 + charwidth * 11, tr("Protection"), false, tr("Current Protection")); //current protection
     addColumnAt(8 + charwidth * 8, tr("Initial"), false, tr("Allocation Protection")); //allocation protection
+    addColumnAt(8 + charwidth * 7, tr("Entropy"), false, tr("Entropy (bits per byte)")); //entropy
     addColumnAt(100, "", false);
 
     connect(Bridge::getBridge(), SIGNAL(updateMemory()), this, SLOT(refreshMap()));
@@ -105,6 +107,10 @@ void MemoryMapView::setupContextMenu()
     mEntropy = new QAction(QIcon(":/icons/images/entropy.png"), tr("Entropy..."), this);
     connect(mEntropy, SIGNAL(triggered()), this, SLOT(entropy()));
 
+    //Entropy of all regions
+    mEntropyAll = new QAction(tr("Measure Entropy of All Regions"), this);
+    connect(mEntropyAll, SIGNAL(triggered()), this, SLOT(entropyAllSlot()));
+
     //Find
     mFindPattern = new QAction(QIcon(":/icons/images/search-for.png"), tr("&Find Pattern..."), this);
     this->addAction(mFindPattern);
@@ -137,6 +143,7 @@ void MemoryMapView::contextMenuSlot(const QPoint & pos)
     wMenu.addAction(mFollowDump);
     wMenu.addAction(mYara);
     wMenu.addAction(mEntropy);
+    wMenu.addAction(mEntropyAll);
     wMenu.addAction(mFindPattern);
     wMenu.addAction(mSwitchView);
     wMenu.addSeparator();
@@ -229,83 +236,161 @@ QString MemoryMapView::paintContent(QPainter* painter, dsint rowBase, int rowOff
             return "";
         }
     }
+    else if(col == 6) //entropy
+    {
+        StdTable::paintContent(painter, rowBase, rowOffset, col, x, y, w, h);
+        int row = int(rowBase + rowOffset);
+        double entropy;
+        if(row >= mPageBases.size() || !DbgFunctions()->GetMemEntropy(mPageBases.at(row), getCellContent(row, 1).toULongLong(0, 16), &entropy))
+            return "";
+        // The more random the data, the stronger the background
+        QColor entropyColor = ConfigColor("MemoryMapEntropyBackgroundColor");
+        if(entropyColor.alpha())
+        {
+            entropyColor.setAlphaF(entropyColor.alphaF() * qMin(entropy / 8.0, 1.0));
+            painter->fillRect(QRect(x, y, w - 1, h), QBrush(entropyColor));
+        }
+        return QString::number(entropy, 'f', 2);
+    }
     return StdTable::paintContent(painter, rowBase, rowOffset, col, x, y, w, h);
 }
 
-void MemoryMapView::refreshMap()
+void MemoryMapView::setPageRow(int row, const MEMPAGE & page)
 {
-    MEMMAP wMemMapStruct;
-    int wI;
+    QString wS;
+    const MEMORY_BASIC_INFORMATION & wMbi = page.mbi;
 
-    memset(&wMemMapStruct, 0, sizeof(MEMMAP));
+    // Base address
+    wS = QString("%1").arg((duint)wMbi.BaseAddress, sizeof(duint) * 2, 16, QChar('0')).toUpper();
+    setCellContent(row, 0, wS);
 
-    DbgMemMap(&wMemMapStruct);
+    // Size
+    wS = QString("%1").arg((duint)wMbi.RegionSize, sizeof(duint) * 2, 16, QChar('0')).toUpper();
+    setCellContent(row, 1, wS);
 
-    setRowCount(wMemMapStruct.count);
+    // Information
+    wS = QString(page.info);
+    setCellContent(row, 2, wS);
 
-    for(wI = 0; wI < wMemMapStruct.count; wI++)
+    // State
+    switch(wMbi.State)
     {
-        QString wS;
-        MEMORY_BASIC_INFORMATION wMbi = (wMemMapStruct.page)[wI].mbi;
+    case MEM_FREE:
+        wS = QString("FREE");
+        break;
+    case MEM_COMMIT:
+        wS = QString("COMM");
+        break;
+    case MEM_RESERVE:
+        wS = QString("RESV");
+        break;
+    default:
+        wS = QString("????");
+    }
+    setCellContent(row, 3, wS);
 
-        // Base address
-        wS = QString("%1").arg((duint)wMbi.BaseAddress, sizeof(duint) * 2, 16, QChar('0')).toUpper();
-        setCellContent(wI, 0, wS);
+    // Type
+    switch(wMbi.Type)
+    {
+    case MEM_IMAGE:
+        wS = QString("IMG");
+        break;
+    case MEM_MAPPED:
+        wS = QString("MAP");
+        break;
+    case MEM_PRIVATE:
+        wS = QString("PRV");
+        break;
+    default:
+        wS = QString("N/A");
+        break;
+    }
+    setCellContent(row, 3, wS);
 
-        // Size
-        wS = QString("%1").arg((duint)wMbi.RegionSize, sizeof(duint) * 2, 16, QChar('0')).toUpper();
-        setCellContent(wI, 1, wS);
+    // current access protection
+    wS = getProtectionString(wMbi.Protect);
+    setCellContent(row, 4, wS);
 
-        // Information
-        wS = QString((wMemMapStruct.page)[wI].info);
-        setCellContent(wI, 2, wS);
+    // allocation protection
+    wS = getProtectionString(wMbi.AllocationProtect);
+    setCellContent(row, 5, wS);
+}
 
-        // State
-        switch(wMbi.State)
+int MemoryMapView::findPageRow(duint base)
+{
+    auto found = std::lower_bound(mPageBases.constBegin(), mPageBases.constEnd(), base);
+    return int(found - mPageBases.constBegin());
+}
+
+void MemoryMapView::refreshMap()
+{
+    MEMMAPDIFF diff;
+    if(!DbgFunctions()->GetMemMapDiff(mMemMapGeneration, &diff))
+        return;
+    mMemMapGeneration = diff.generation;
+
+    // Nothing changed since the last refresh, only the entropy column can be out of date
+    if(!diff.reset && !diff.pageCount && !diff.removedCount)
+    {
+        reloadData();
+        return;
+    }
+
+    // Remember the selected and topmost pages to restore the view afterwards
+    duint selectedBase = 0;
+    duint topBase = 0;
+    if(getInitialSelection() < mPageBases.size())
+        selectedBase = mPageBases.at(getInitialSelection());
+    if(getTableOffset() < mPageBases.size())
+        topBase = mPageBases.at(getTableOffset());
+
+    if(diff.reset)
+    {
+        mPageBases.clear();
+        setRowCount(diff.pageCount);
+        for(int i = 0; i < diff.pageCount; i++)
         {
-        case MEM_FREE:
-            wS = QString("FREE");
-            break;
-        case MEM_COMMIT:
-            wS = QString("COMM");
-            break;
-        case MEM_RESERVE:
-            wS = QString("RESV");
-            break;
-        default:
-            wS = QString("????");
+            mPageBases.append(duint(diff.pages[i].mbi.BaseAddress));
+            setPageRow(i, diff.pages[i]);
         }
-        setCellContent(wI, 3, wS);
-
-        // Type
-        switch(wMbi.Type)
+    }
+    else
+    {
+        for(int i = 0; i < diff.removedCount; i++)
         {
-        case MEM_IMAGE:
-            wS = QString("IMG");
-            break;
-        case MEM_MAPPED:
-            wS = QString("MAP");
-            break;
-        case MEM_PRIVATE:
-            wS = QString("PRV");
-            break;
-        default:
-            wS = QString("N/A");
-            break;
+            int row = findPageRow(diff.removed[i]);
+            if(row < mPageBases.size() && mPageBases.at(row) == diff.removed[i])
+            {
+                mPageBases.removeAt(row);
+                removeRow(row);
+            }
         }
-        setCellContent(wI, 3, wS);
-
-        // current access protection
-        wS = getProtectionString(wMbi.Protect);
-        setCellContent(wI, 4, wS);
+        for(int i = 0; i < diff.pageCount; i++)
+        {
+            duint base = duint(diff.pages[i].mbi.BaseAddress);
+            int row = findPageRow(base);
+            if(row >= mPageBases.size() || mPageBases.at(row) != base)
+            {
+                mPageBases.insert(row, base);
+                insertRow(row);
+            }
+            setPageRow(row, diff.pages[i]);
+        }
+    }
 
-        // allocation protection
-        wS = getProtectionString(wMbi.AllocationProtect);
-        setCellContent(wI, 5, wS);
+    if(diff.pages)
+        BridgeFree(diff.pages);
+    if(diff.removed)
+        BridgeFree(diff.removed);
 
+    // Keep the selection and the scroll position on the same pages
+    if(mPageBases.size())
+    {
+        int selectedRow = qMin(findPageRow(selectedBase), mPageBases.size() - 1);
+        int topRow = qMin(findPageRow(topBase), mPageBases.size() - 1);
+        setSingleSelection(selectedRow);
+        setTableOffset(topRow);
     }
-    if(wMemMapStruct.page != 0)
-        BridgeFree(wMemMapStruct.page);
     reloadData(); //refresh memory map
 }
 
@@ -313,6 +398,8 @@ void MemoryMapView::stateChangedSlot(DBGSTATE state)
 {
     if(state == paused)
         refreshMap();
+    else if(state == stopped)
+        mMemMapGeneration = 0; //get the whole map for the next process
 }
 
 void MemoryMapView::followDumpSlot()
@@ -418,6 +505,7 @@ void MemoryMapView::switchView()
     Config()->writeBools();
     DbgSettingsUpdated();
     DbgFunctions()->MemUpdateMap();
+    mMemMapGeneration = 0;
     setSingleSelection(0);
     setTableOffset(0);
     stateChangedSlot(paused);
@@ -439,6 +527,12 @@ void MemoryMapView::entropy()
     delete[] data;
 }
 
+void MemoryMapView::entropyAllSlot()
+{
+    DbgCmdExec("entropy");
+    emit showReferences();
+}
+
 void MemoryMapView::findPatternSlot()
 {
     HexEditDialog hexEdit(this);
@@ -34,11 +34,17 @@ public slots:
     void pageMemoryRights();
     void refreshMap();
     void entropy();
+    void entropyAllSlot();
     void findPatternSlot();
     void dumpMemory();
 
 private:
     QString getProtectionString(DWORD Protect);
+    void setPageRow(int row, const MEMPAGE & page);
+    int findPageRow(duint base);
+
+    duint mMemMapGeneration;
+    QList<duint> mPageBases; // base address of every row, sorted
 
     QAction* mFollowDump;
     QAction* mFollowDisassembly;
@@ -60,6 +66,7 @@ private:
     QAction* mMemoryRemove;
     QAction* mMemoryExecuteSingleshootToggle;
     QAction* mEntropy;
+    QAction* mEntropyAll;
     QAction* mFindPattern;
 };
 
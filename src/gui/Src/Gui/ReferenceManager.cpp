@@ -6,6 +6,7 @@ ReferenceManager::ReferenceManager(QWidget* parent) : QTabWidget(parent)
     setMovable(true);
     setTabsClosable(true);
     mCurrentReferenceView = 0;
+    mLastReferenceViewId = 0;
 
     //Close All Tabs
     mCloseAllTabs = new QPushButton(this);
@@ -15,7 +16,8 @@ ReferenceManager::ReferenceManager(QWidget* parent) : QTabWidget(parent)
     setCornerWidget(mCloseAllTabs, Qt::TopLeftCorner);
     setContextMenuPolicy(Qt::CustomContextMenu);
 
-    connect(Bridge::getBridge(), SIGNAL(referenceInitialize(QString)), this, SLOT(newReferenceView(QString)));
+    connect(Bridge::getBridge(), SIGNAL(referenceInitialize(QString, bool)), this, SLOT(newReferenceView(QString, bool)));
+    connect(Bridge::getBridge(), SIGNAL(referenceUpdateView(const REFVIEWUPDATE*)), this, SLOT(updateReferenceView(const REFVIEWUPDATE*)));
     connect(this, SIGNAL(tabCloseRequested(int)), this, SLOT(closeTab(int)));
 }
 
@@ -24,23 +26,55 @@ ReferenceView* ReferenceManager::currentReferenceView()
     return mCurrentReferenceView;
 }
 
-void ReferenceManager::newReferenceView(QString name)
+void ReferenceManager::newReferenceView(QString name, bool detached)
 {
-    if(mCurrentReferenceView) //disconnect previous reference view
-        mCurrentReferenceView->disconnectBridge();
-    mCurrentReferenceView = new ReferenceView();
-    connect(mCurrentReferenceView, SIGNAL(showCpu()), this, SIGNAL(showCpu()));
-    insertTab(0, mCurrentReferenceView, name);
+    ReferenceView* view = new ReferenceView();
+    int id = ++mLastReferenceViewId;
+    if(detached) //only written to by id (background searches), the bridge keeps its current reference view
+        view->disconnectBridge();
+    else
+    {
+        if(mCurrentReferenceView) //disconnect previous reference view
+            mCurrentReferenceView->disconnectBridge();
+        mCurrentReferenceView = view;
+    }
+    mReferenceViews.insert(id, view);
+    connect(view, SIGNAL(showCpu()), this, SIGNAL(showCpu()));
+    insertTab(0, view, name);
     setCurrentIndex(0);
+    Bridge::getBridge()->setResult(id);
+}
+
+void ReferenceManager::updateReferenceView(const REFVIEWUPDATE* update)
+{
+    auto found = mReferenceViews.find(update->id);
+    if(found == mReferenceViews.end()) //the tab was closed
+    {
+        Bridge::getBridge()->setResult(0);
+        return;
+    }
+    found.value()->updateView(update);
     Bridge::getBridge()->setResult(1);
 }
 
+void ReferenceManager::removeReferenceView(ReferenceView* view)
+{
+    mReferenceViews.remove(mReferenceViews.key(view));
+    if(view == mCurrentReferenceView)
+        mCurrentReferenceView = 0;
+    view->disconnectBridge();
+    view->deleteLater();
+}
+
 void ReferenceManager::closeTab(int index)
 {
+    ReferenceView* view = (ReferenceView*)widget(index);
     removeTab(index);
+    removeReferenceView(view);
 }
 
 void ReferenceManager::closeAllTabs()
 {
-    clear();
+    while(count())
+        closeTab(0);
 }
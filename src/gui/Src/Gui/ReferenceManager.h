@@ -13,7 +13,8 @@ public:
     ReferenceView* currentReferenceView();
 
 private slots:
-    void newReferenceView(QString name);
+    void newReferenceView(QString name, bool detached);
+    void updateReferenceView(const REFVIEWUPDATE* update);
     void closeTab(int index);
     void closeAllTabs();
 
@@ -21,7 +22,11 @@ signals:
     void showCpu();
 
 private:
+    void removeReferenceView(ReferenceView* view);
+
     ReferenceView* mCurrentReferenceView;
+    int mLastReferenceViewId;
+    QMap<int, ReferenceView*> mReferenceViews;
     QPushButton* mCloseAllTabs;
 };
 
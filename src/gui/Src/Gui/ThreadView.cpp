@@ -211,184 +211,219 @@ ThreadView::ThreadView(StdTable* parent) : StdTable(parent)
     connect(this, SIGNAL(contextMenuSignal(QPoint)), this, SLOT(contextMenuSlot(QPoint)));
 
     setupContextMenu();
+
+    mThreadFields = 0;
+    mThreadGeneration = 0;
+}
+
+void ThreadView::setThreadRow(int row, const THREADALLINFO & info)
+{
+    if(!info.BasicInfo.ThreadNumber)
+        setCellContent(row, 0, "Main");
+    else
+        setCellContent(row, 0, ToDecString(info.BasicInfo.ThreadNumber));
+    setCellContent(row, 1, ToHexString(info.BasicInfo.ThreadId));
+    setCellContent(row, 2, ToPtrString(info.BasicInfo.ThreadStartAddress));
+    setCellContent(row, 3, ToPtrString(info.BasicInfo.ThreadLocalBase));
+    setCellContent(row, 4, ToPtrString(info.ThreadCip));
+    setCellContent(row, 5, ToDecString(info.SuspendCount));
+    QString priorityString;
+    switch(info.Priority)
+    {
+    case _PriorityIdle:
+        priorityString = "Idle";
+        break;
+    case _PriorityAboveNormal:
+        priorityString = "AboveNormal";
+        break;
+    case _PriorityBelowNormal:
+        priorityString = "BelowNormal";
+        break;
+    case _PriorityHighest:
+        priorityString = "Highest";
+        break;
+    case _PriorityLowest:
+        priorityString = "Lowest";
+        break;
+    case _PriorityNormal:
+        priorityString = "Normal";
+        break;
+    case _PriorityTimeCritical:
+        priorityString = "TimeCritical";
+        break;
+    default:
+        priorityString = "Unknown";
+        break;
+    }
+    setCellContent(row, 6, priorityString);
+    QString waitReasonString;
+    switch(info.WaitReason)
+    {
+    case _Executive:
+        waitReasonString = "Executive";
+        break;
+    case _FreePage:
+        waitReasonString = "FreePage";
+        break;
+    case _PageIn:
+        waitReasonString = "PageIn";
+        break;
+    case _PoolAllocation:
+        waitReasonString = "PoolAllocation";
+        break;
+    case _DelayExecution:
+        waitReasonString = "DelayExecution";
+        break;
+    case _Suspended:
+        waitReasonString = "Suspended";
+        break;
+    case _UserRequest:
+        waitReasonString = "UserRequest";
+        break;
+    case _WrExecutive:
+        waitReasonString = "WrExecutive";
+        break;
+    case _WrFreePage:
+        waitReasonString = "WrFreePage";
+        break;
+    case _WrPageIn:
+        waitReasonString = "WrPageIn";
+        break;
+    case _WrPoolAllocation:
+        waitReasonString = "WrPoolAllocation";
+        break;
+    case _WrDelayExecution:
+        waitReasonString = "WrDelayExecution";
+        break;
+    case _WrSuspended:
+        waitReasonString = "WrSuspended";
+        break;
+    case _WrUserRequest:
+        waitReasonString = "WrUserRequest";
+        break;
+    case _WrEventPair:
+        waitReasonString = "WrEventPair";
+        break;
+    case _WrQueue:
+        waitReasonString = "WrQueue";
+        break;
+    case _WrLpcReceive:
+        waitReasonString = "WrLpcReceive";
+        break;
+    case _WrLpcReply:
+        waitReasonString = "WrLpcReply";
+        break;
+    case _WrVirtualMemory:
+        waitReasonString = "WrVirtualMemory";
+        break;
+    case _WrPageOut:
+        waitReasonString = "WrPageOut";
+        break;
+    case _WrRendezvous:
+        waitReasonString = "WrRendezvous";
+        break;
+    case _Spare2:
+        waitReasonString = "Spare2";
+        break;
+    case _Spare3:
+        waitReasonString = "Spare3";
+        break;
+    case _Spare4:
+        waitReasonString = "Spare4";
+        break;
+    case _Spare5:
+        waitReasonString = "Spare5";
+        break;
+    case _WrCalloutStack:
+        waitReasonString = "WrCalloutStack";
+        break;
+    case _WrKernel:
+        waitReasonString = "WrKernel";
+        break;
+    case _WrResource:
+        waitReasonString = "WrResource";
+        break;
+    case _WrPushLock:
+        waitReasonString = "WrPushLock";
+        break;
+    case _WrMutex:
+        waitReasonString = "WrMutex";
+        break;
+    case _WrQuantumEnd:
+        waitReasonString = "WrQuantumEnd";
+        break;
+    case _WrDispatchInt:
+        waitReasonString = "WrDispatchInt";
+        break;
+    case _WrPreempted:
+        waitReasonString = "WrPreempted";
+        break;
+    case _WrYieldExecution:
+        waitReasonString = "WrYieldExecution";
+        break;
+    case _WrFastMutex:
+        waitReasonString = "WrFastMutex";
+        break;
+    case _WrGuardedMutex:
+        waitReasonString = "WrGuardedMutex";
+        break;
+    case _WrRundown:
+        waitReasonString = "WrRundown";
+        break;
+    default:
+        waitReasonString = "Unknown";
+        break;
+    }
+    setCellContent(row, 7, waitReasonString);
+    setCellContent(row, 8, QString("%1").arg(info.LastError, sizeof(unsigned int) * 2, 16, QChar('0')).toUpper());
+    setCellContent(row, 9, info.BasicInfo.threadName);
 }
 
 void ThreadView::updateThreadList()
 {
+    // Wait reason and last error are only queried when their columns are shown
+    unsigned int fields = ThreadFieldCip | ThreadFieldSuspendCount | ThreadFieldPriority;
+    if(!getColumnHidden(7))
+        fields |= ThreadFieldWaitReason;
+    if(!getColumnHidden(8))
+        fields |= ThreadFieldLastError;
+
     THREADLIST threadList;
     memset(&threadList, 0, sizeof(THREADLIST));
-    DbgGetThreadList(&threadList);
+    duint generation = DbgFunctions()->GetThreadListEx(&threadList, fields);
+    bool fullUpdate = fields != mThreadFields || threadList.count != mThreads.size();
+
+    // The active thread can change without the threads changing
+    QString currentThreadId = "NONE";
+    if(threadList.CurrentThread >= 0 && threadList.CurrentThread < threadList.count)
+        currentThreadId = ToHexString(threadList.list[threadList.CurrentThread].BasicInfo.ThreadId);
+    bool currentChanged = currentThreadId != mCurrentThreadId;
+    mCurrentThreadId = currentThreadId;
+    if(!fullUpdate && generation == mThreadGeneration)
+    {
+        // Nothing else changed since the last update
+        if(threadList.list)
+            BridgeFree(threadList.list);
+        if(currentChanged)
+            reloadData();
+        return;
+    }
+    mThreadFields = fields;
+    mThreadGeneration = generation;
+
     setRowCount(threadList.count);
+    mThreads.resize(threadList.count);
     for(int i = 0; i < threadList.count; i++)
     {
-        if(!threadList.list[i].BasicInfo.ThreadNumber)
-            setCellContent(i, 0, "Main");
-        else
-            setCellContent(i, 0, ToDecString(threadList.list[i].BasicInfo.ThreadNumber));
-        setCellContent(i, 1, ToHexString(threadList.list[i].BasicInfo.ThreadId));
-        setCellContent(i, 2, ToPtrString(threadList.list[i].BasicInfo.ThreadStartAddress));
-        setCellContent(i, 3, ToPtrString(threadList.list[i].BasicInfo.ThreadLocalBase));
-        setCellContent(i, 4, ToPtrString(threadList.list[i].ThreadCip));
-        setCellContent(i, 5, ToDecString(threadList.list[i].SuspendCount));
-        QString priorityString;
-        switch(threadList.list[i].Priority)
-        {
-        case _PriorityIdle:
-            priorityString = "Idle";
-            break;
-        case _PriorityAboveNormal:
-            priorityString = "AboveNormal";
-            break;
-        case _PriorityBelowNormal:
-            priorityString = "BelowNormal";
-            break;
-        case _PriorityHighest:
-            priorityString = "Highest";
-            break;
-        case _PriorityLowest:
-            priorityString = "Lowest";
-            break;
-        case _PriorityNormal:
-            priorityString = "Normal";
-            break;
-        case _PriorityTimeCritical:
-            priorityString = "TimeCritical";
-            break;
-        default:
-            priorityString = "Unknown";
-            break;
-        }
-        setCellContent(i, 6, priorityString);
-        QString waitReasonString;
-        switch(threadList.list[i].WaitReason)
-        {
-        case _Executive:
-            waitReasonString = "Executive";
-            break;
-        case _FreePage:
-            waitReasonString = "FreePage";
-            break;
-        case _PageIn:
-            waitReasonString = "PageIn";
-            break;
-        case _PoolAllocation:
-            waitReasonString = "PoolAllocation";
-            break;
-        case _DelayExecution:
-            waitReasonString = "DelayExecution";
-            break;
-        case _Suspended:
-            waitReasonString = "Suspended";
-            break;
-        case _UserRequest:
-            waitReasonString = "UserRequest";
-            break;
-        case _WrExecutive:
-            waitReasonString = "WrExecutive";
-            break;
-        case _WrFreePage:
-            waitReasonString = "WrFreePage";
-            break;
-        case _WrPageIn:
-            waitReasonString = "WrPageIn";
-            break;
-        case _WrPoolAllocation:
-            waitReasonString = "WrPoolAllocation";
-            break;
-        case _WrDelayExecution:
-            waitReasonString = "WrDelayExecution";
-            break;
-        case _WrSuspended:
-            waitReasonString = "WrSuspended";
-            break;
-        case _WrUserRequest:
-            waitReasonString = "WrUserRequest";
-            break;
-        case _WrEventPair:
-            waitReasonString = "WrEventPair";
-            break;
-        case _WrQueue:
-            waitReasonString = "WrQueue";
-            break;
-        case _WrLpcReceive:
-            waitReasonString = "WrLpcReceive";
-            break;
-        case _WrLpcReply:
-            waitReasonString = "WrLpcReply";
-            break;
-        case _WrVirtualMemory:
-            waitReasonString = "WrVirtualMemory";
-            break;
-        case _WrPageOut:
-            waitReasonString = "WrPageOut";
-            break;
-        case _WrRendezvous:
-            waitReasonString = "WrRendezvous";
-            break;
-        case _Spare2:
-            waitReasonString = "Spare2";
-            break;
-        case _Spare3:
-            waitReasonString = "Spare3";
-            break;
-        case _Spare4:
-            waitReasonString = "Spare4";
-            break;
-        case _Spare5:
-            waitReasonString = "Spare5";
-            break;
-        case _WrCalloutStack:
-            waitReasonString = "WrCalloutStack";
-            break;
-        case _WrKernel:
-            waitReasonString = "WrKernel";
-            break;
-        case _WrResource:
-            waitReasonString = "WrResource";
-            break;
-        case _WrPushLock:
-            waitReasonString = "WrPushLock";
-            break;
-        case _WrMutex:
-            waitReasonString = "WrMutex";
-            break;
-        case _WrQuantumEnd:
-            waitReasonString = "WrQuantumEnd";
-            break;
-        case _WrDispatchInt:
-            waitReasonString = "WrDispatchInt";
-            break;
-        case _WrPreempted:
-            waitReasonString = "WrPreempted";
-            break;
-        case _WrYieldExecution:
-            waitReasonString = "WrYieldExecution";
-            break;
-        case _WrFastMutex:
-            waitReasonString = "WrFastMutex";
-            break;
-        case _WrGuardedMutex:
-            waitReasonString = "WrGuardedMutex";
-            break;
-        case _WrRundown:
-            waitReasonString = "WrRundown";
-            break;
-        default:
-            waitReasonString = "Unknown";
-            break;
-        }
-        setCellContent(i, 7, waitReasonString);
-        setCellContent(i, 8, QString("%1").arg(threadList.list[i].LastError, sizeof(unsigned int) * 2, 16, QChar('0')).toUpper());
-        setCellContent(i, 9, threadList.list[i].BasicInfo.threadName);
+        // Only update the rows whose fields changed
+        const THREADALLINFO & info = threadList.list[i];
+        if(!fullUpdate && !memcmp(&mThreads[i], &info, sizeof(THREADALLINFO)))
+            continue;
+        mThreads[i] = info;
+        setThreadRow(i, info);
     }
-    mCurrentThreadId = "NONE";
-    if(threadList.count)
-    {
-        int currentThread = threadList.CurrentThread;
-        if(currentThread >= 0 && currentThread < threadList.count)
-            mCurrentThreadId = ToHexString(threadList.list[currentThread].BasicInfo.ThreadId);
+    if(threadList.list)
         BridgeFree(threadList.list);
-    }
     reloadData();
 }
 
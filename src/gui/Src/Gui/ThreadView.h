@@ -33,7 +33,12 @@ signals:
     void showCpu();
 
 private:
+    void setThreadRow(int row, const THREADALLINFO & info);
+
     QString mCurrentThreadId;
+    QVector<THREADALLINFO> mThreads;
+    unsigned int mThreadFields;
+    duint mThreadGeneration;
     QAction* mSwitchThread;
     QAction* mSuspendThread;
     QAction* mGoToThreadEntry;
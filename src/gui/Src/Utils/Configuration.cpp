@@ -160,6 +160,7 @@ Configuration::Configuration() : QObject(), noMoreMsgbox(false)
     defaultColors.insert("MemoryMapBreakpointColor", QColor("#FFFBF0"));
     defaultColors.insert("MemoryMapBreakpointBackgroundColor", QColor("#FF0000"));
     defaultColors.insert("MemoryMapSectionTextColor", QColor("#8B671F"));
+    defaultColors.insert("MemoryMapEntropyBackgroundColor", QColor("#FF0000"));
     defaultColors.insert("SearchListViewHighlightColor", QColor("#FF0000"));
 
     //bool settings
@@ -172,6 +173,7 @@ Configuration::Configuration() : QObject(), noMoreMsgbox(false)
     disassemblyBool.insert("FindCommandEntireBlock", false);
     disassemblyBool.insert("OnlyCipAutoComments", false);
     disassemblyBool.insert("TabbedMnemonic", false);
+    disassemblyBool.insert("SideBarPaintTime", false);
     defaultBools.insert("Disassembler", disassemblyBool);
 
     QMap<QString, bool> engineBool;